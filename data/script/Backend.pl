@@ -585,6 +585,30 @@ sub GetNextSoundData()
 }
 
 
+=comment
+GetFighterSounds collects every sound that the states of a fighter can
+make, so the frontend can load them before the round starts. The sound
+names are returned in $::CppFighterSounds, separated by spaces.
+
+=cut
+
+sub GetFighterSounds($)
+{
+	my ($fighterenum) = @_;
+	my ($stats, $state, %sounds);
+	
+	$stats = $::FighterStats{$fighterenum};
+	$::CppFighterSounds = '';
+	return unless defined $stats and defined $stats->{STATES};
+	
+	foreach $state (values %{$stats->{STATES}})
+	{
+		$sounds{$state->{SOUND}} = 1 if defined $state->{SOUND};
+	}
+	$::CppFighterSounds = join ' ', sort keys %sounds;
+}
+
+
 sub DoFighterHitEvent($$$)
 {
 	my ($fighter, $other, $hit) = @_;
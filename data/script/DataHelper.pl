@@ -93,18 +93,28 @@ sub LoadFrames ($$$)
 	my ($DataName, $PivotX, $PivotY) = @_;
 	my (@Frames, $data, $frame, $DatName);
 
-	# Make sure that Whatever.dat also exists.
 	$DatName = $DataName;
 	$DatName =~ s/\.txt$//;
-	open DATFILE, "../characters/$DatName" || die ("Couldn't open ../characters/$DatName");
-	close DATFILE;
 	
-	open DATAFILE, "../characters/$DataName" || die ("Couldn't open ../characters/$DataName");
-	$data = '';
-	while ( read DATAFILE, $data, 16384, length($data) )
+	if ( defined &::ReadDataFile )
 	{
+		# The frontend reads the file, from the data archive if there is one.
+		$data = ::ReadDataFile( "characters/$DataName" );
+		die ("Couldn't open characters/$DataName") unless defined $data;
+	}
+	else
+	{
+		# Make sure that Whatever.dat also exists.
+		open DATFILE, "../characters/$DatName" || die ("Couldn't open ../characters/$DatName");
+		close DATFILE;
+		
+		open DATAFILE, "../characters/$DataName" || die ("Couldn't open ../characters/$DataName");
+		$data = '';
+		while ( read DATAFILE, $data, 16384, length($data) )
+		{
+		}
+		close DATAFILE;
 	}
-	close DATAFILE;
 
 	print "$DataName file is ", length($data), " bytes long.\n";
 	
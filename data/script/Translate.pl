@@ -118,6 +118,17 @@ $::English = { 'LanguageCode' => 0,
 	'Height: '			=> undef,
 	'Shoe size: '		=> undef,
 	
+# Replay browser
+
+	"~REPLAYS"			=> undef,
+	'Replays'			=> undef,
+	'Fighter'			=> undef,
+	'All'				=> undef,		# All fighters
+	', only wins'		=> undef,
+	' vs '				=> undef,
+	'No replays.'		=> undef,
+	'Left/Right: fighter, W: only wins, Enter: play, Esc: back' => undef,
+	
 	"Credits"			=> undef,
 	"CreditsText1"		=>
 "OPENMORTAL CREDITS
@@ -0,0 +1,110 @@
+/***************************************************************************
+                          AllocCounter.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "AllocCounter.h"
+#include "config.h"
+
+#include <stdlib.h>
+#include <new>
+
+
+#if defined(_MSC_VER)
+#define ALLOC_THREADLOCAL		__declspec(thread)
+#else
+#define ALLOC_THREADLOCAL		__thread
+#endif
+
+
+/** No constructor runs for this, so it can be counted before main(). */
+static ALLOC_THREADLOCAL long g_iNumAllocations = 0;
+
+
+long GetNumberOfAllocations()
+{
+	return g_iNumAllocations;
+}
+
+
+
+#if defined(__GLIBC__) && defined(ENABLE_ALLOCCOUNTER)
+
+/*************************************************************************
+                     GLIBC: COUNT EVERY malloc()
+*************************************************************************/
+
+extern "C"
+{
+	void* __libc_malloc( size_t a_iSize );
+	void* __libc_calloc( size_t a_iNum, size_t a_iSize );
+	void* __libc_realloc( void* a_pMem, size_t a_iSize );
+
+	void* malloc( size_t a_iSize )
+	{
+		++g_iNumAllocations;
+		return __libc_malloc( a_iSize );
+	}
+
+	void* calloc( size_t a_iNum, size_t a_iSize )
+	{
+		++g_iNumAllocations;
+		return __libc_calloc( a_iNum, a_iSize );
+	}
+
+	void* realloc( void* a_pMem, size_t a_iSize )
+	{
+		++g_iNumAllocations;
+		return __libc_realloc( a_pMem, a_iSize );
+	}
+}
+
+#else
+
+/*************************************************************************
+                     OTHERWISE: COUNT operator new
+*************************************************************************/
+
+#if __cplusplus >= 201103L
+#define ALLOC_THROW
+#define ALLOC_NOTHROW	noexcept
+#else
+#define ALLOC_THROW		throw( std::bad_alloc )
+#define ALLOC_NOTHROW	throw()
+#endif
+
+
+void* operator new( size_t a_iSize ) ALLOC_THROW
+{
+	++g_iNumAllocations;
+	void* pMem = malloc( a_iSize ? a_iSize : 1 );
+	if ( NULL == pMem )
+	{
+		throw std::bad_alloc();
+	}
+	return pMem;
+}
+
+
+void* operator new[]( size_t a_iSize ) ALLOC_THROW
+{
+	return operator new( a_iSize );
+}
+
+
+void operator delete( void* a_pMem ) ALLOC_NOTHROW
+{
+	free( a_pMem );
+}
+
+
+void operator delete[]( void* a_pMem ) ALLOC_NOTHROW
+{
+	free( a_pMem );
+}
+
+#endif
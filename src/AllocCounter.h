@@ -0,0 +1,32 @@
+/***************************************************************************
+                          AllocCounter.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef ALLOCCOUNTER_H
+#define ALLOCCOUNTER_H
+
+
+/**
+\ingroup GameLogic
+\brief Returns how many times the calling thread has allocated memory.
+
+With glibc, if configured with --enable-alloccounter, malloc(), calloc()
+and realloc() are replaced, so every allocation is counted: perl's, SDL's
+and the C++ code's. Otherwise (and in the release builds) only operator
+new is replaced, so only the C++ allocations are counted.
+
+The counter is per thread, so the audio and worker threads do not show
+up in the numbers of the game loop. Take the difference of two calls to
+get the allocations in between; the profiler does this for the phases
+of the frames (see CProfileScope).
+*/
+
+long GetNumberOfAllocations();
+
+
+#endif // ALLOCCOUNTER_H
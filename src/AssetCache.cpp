@@ -0,0 +1,330 @@
+/***************************************************************************
+                          AssetCache.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "AssetCache.h"
+#include "gfx.h"
+#include "common.h"
+
+#include "SDL.h"
+
+#include <stdio.h>
+
+
+#define ASSETCACHE_DEFAULTBUDGET	(32*1024*1024)	///< Until SetBudget() is called.
+
+
+CAssetCache g_oAssetCache;
+
+
+/** An image in the cache. m_itUnused is valid while m_bUnused is set. */
+struct SCachedAsset
+{
+	std::string			m_sKey;
+	SDL_Surface*		m_poSurface;
+	int					m_iRefCount;
+	int					m_iBytes;
+	bool				m_bUnused;
+	std::list<SCachedAsset*>::iterator	m_itUnused;
+};
+
+
+
+/*************************************************************************
+                           SURFACE HANDLE
+*************************************************************************/
+
+
+CSurfaceHandle::CSurfaceHandle()
+{
+	m_poAsset = NULL;
+}
+
+
+CSurfaceHandle::CSurfaceHandle( SCachedAsset* a_poAsset )
+{
+	m_poAsset = a_poAsset;
+	if ( m_poAsset )
+	{
+		g_oAssetCache.AddRef( m_poAsset );
+	}
+}
+
+
+CSurfaceHandle::CSurfaceHandle( const CSurfaceHandle& a_roHandle )
+{
+	m_poAsset = a_roHandle.m_poAsset;
+	if ( m_poAsset )
+	{
+		g_oAssetCache.AddRef( m_poAsset );
+	}
+}
+
+
+CSurfaceHandle::~CSurfaceHandle()
+{
+	Release();
+}
+
+
+CSurfaceHandle& CSurfaceHandle::operator=( const CSurfaceHandle& a_roHandle )
+{
+	if ( a_roHandle.m_poAsset )
+	{
+		g_oAssetCache.AddRef( a_roHandle.m_poAsset );
+	}
+	Release();
+	m_poAsset = a_roHandle.m_poAsset;
+	return *this;
+}
+
+
+/** Returns the shared surface, or NULL if the image couldn't be loaded. */
+SDL_Surface* CSurfaceHandle::Get() const
+{
+	return m_poAsset ? m_poAsset->m_poSurface : NULL;
+}
+
+
+void CSurfaceHandle::Release()
+{
+	if ( m_poAsset )
+	{
+		g_oAssetCache.Release( m_poAsset );
+		m_poAsset = NULL;
+	}
+}
+
+
+/** Returns a private copy of the surface, which the caller may draw on,
+and must free. The copy has the same format and color key. */
+SDL_Surface* CSurfaceHandle::CreateCopy() const
+{
+	SDL_Surface* poSurface = Get();
+	return poSurface ? SDL_ConvertSurface( poSurface, poSurface->format, poSurface->flags ) : NULL;
+}
+
+
+
+/*************************************************************************
+                           ASSET CACHE
+*************************************************************************/
+
+
+CAssetCache::CAssetCache()
+{
+	m_iBudget = ASSETCACHE_DEFAULTBUDGET;
+	m_iBytes = 0;
+	ResetStatistics();
+}
+
+
+CAssetCache::~CAssetCache()
+{
+	// The surfaces still in use are left alone; SDL is shut down by now.
+	m_oUnused.clear();
+	for ( AssetMap::iterator it = m_oAssets.begin(); it != m_oAssets.end(); ++it )
+	{
+		if ( 0 == it->second->m_iRefCount )
+		{
+			delete it->second;
+		}
+	}
+}
+
+
+/** Returns a handle to the image, loading it with LoadBackground() if it
+is not in the cache. The handle is empty if the image couldn't be
+loaded. */
+
+CSurfaceHandle CAssetCache::GetBackground( const char* a_pcFilename, int a_iNumColors, int a_iPaletteOffset )
+{
+	std::string sKey = GetKey( a_pcFilename );
+	bool bShared = NULL == gamescreen->format->palette;
+
+	AssetMap::iterator it = m_oAssets.find( sKey );
+	if ( bShared && it != m_oAssets.end() )
+	{
+		++m_iHits;
+		return CSurfaceHandle( it->second );
+	}
+
+	++m_iMisses;
+	SDL_Surface* poSurface = LoadBackground( a_pcFilename, a_iNumColors, a_iPaletteOffset );
+	if ( NULL == poSurface )
+	{
+		return CSurfaceHandle();
+	}
+
+	SCachedAsset* poAsset = new SCachedAsset;
+	poAsset->m_poSurface = poSurface;
+	poAsset->m_iRefCount = 0;
+	poAsset->m_bUnused = false;
+	poAsset->m_iBytes = poSurface->pitch * poSurface->h;
+	if ( !bShared )
+	{
+		// Loading sets the palette of the screen, so the image is not
+		// kept; it is freed with its last handle (m_sKey stays empty).
+		return CSurfaceHandle( poAsset );
+	}
+
+	Insert( sKey, poAsset );
+
+	// The new asset is referenced, so it can't be evicted.
+	CSurfaceHandle oHandle( poAsset );
+	Evict( m_iBudget );
+	return oHandle;
+}
+
+
+/** Puts an image into the cache that was loaded elsewhere, e.g. with
+ConvertBackground() on a worker thread. The surface must be in the format
+of the screen; the cache takes it over. It is kept like an image that has
+no handles, so it may be evicted before it is used. */
+
+void CAssetCache::AddBackground( const char* a_pcFilename, SDL_Surface* a_poSurface )
+{
+	std::string sKey = GetKey( a_pcFilename );
+	if ( gamescreen->format->palette
+		|| m_oAssets.end() != m_oAssets.find( sKey ) )
+	{
+		SDL_FreeSurface( a_poSurface );
+		return;
+	}
+
+	SCachedAsset* poAsset = new SCachedAsset;
+	poAsset->m_poSurface = a_poSurface;
+	poAsset->m_iRefCount = 0;
+	poAsset->m_iBytes = a_poSurface->pitch * a_poSurface->h;
+	Insert( sKey, poAsset );
+	poAsset->m_itUnused = m_oUnused.insert( m_oUnused.end(), poAsset );
+	poAsset->m_bUnused = true;
+	Evict( m_iBudget );
+}
+
+
+/** Returns a private copy of the image, like LoadBackground() does, but
+through the cache: the image doesn't have to be decoded and converted
+again. The caller must free the surface. */
+
+SDL_Surface* CAssetCache::CopyBackground( const char* a_pcFilename, int a_iNumColors, int a_iPaletteOffset )
+{
+	if ( gamescreen->format->palette )
+	{
+		return LoadBackground( a_pcFilename, a_iNumColors, a_iPaletteOffset );
+	}
+	return GetBackground( a_pcFilename, a_iNumColors, a_iPaletteOffset ).CreateCopy();
+}
+
+
+void CAssetCache::SetBudget( int a_iBytes )
+{
+	m_iBudget = a_iBytes;
+	Evict( m_iBudget );
+}
+
+
+/** Frees every image that has no handle. */
+void CAssetCache::Clear()
+{
+	Evict( 0 );
+}
+
+
+void CAssetCache::ResetStatistics()
+{
+	m_iHits = m_iMisses = m_iEvictions = 0;
+	m_iPeakBytes = m_iBytes;
+}
+
+
+void CAssetCache::Report() const
+{
+	int iRequests = m_iHits + m_iMisses;
+	debug( "Asset cache: %d requests, %d hits (%.1f%%), %d misses, %d evicted.\n",
+		iRequests, m_iHits, iRequests ? m_iHits * 100.0 / iRequests : 0.0, m_iMisses, m_iEvictions );
+	debug( "Asset cache: %d images, %d in use, %.1f MB now, %.1f MB peak, %.1f MB budget.\n",
+		(int) m_oAssets.size(), (int) ( m_oAssets.size() - m_oUnused.size() ),
+		m_iBytes / 1048576.0, m_iPeakBytes / 1048576.0, m_iBudget / 1048576.0 );
+}
+
+
+/** The images are kept by their filename and the pixel format of the
+screen. */
+std::string CAssetCache::GetKey( const char* a_pcFilename ) const
+{
+	SDL_PixelFormat* poFormat = gamescreen->format;
+	char acFormat[64];
+	sprintf( acFormat, "|%d:%x:%x:%x:%x", poFormat->BitsPerPixel,
+		poFormat->Rmask, poFormat->Gmask, poFormat->Bmask, poFormat->Amask );
+	return std::string( a_pcFilename ) + acFormat;
+}
+
+
+void CAssetCache::Insert( const std::string& a_rsKey, SCachedAsset* a_poAsset )
+{
+	a_poAsset->m_sKey = a_rsKey;
+	a_poAsset->m_bUnused = false;
+	m_oAssets[ a_rsKey ] = a_poAsset;
+	m_iBytes += a_poAsset->m_iBytes;
+	if ( m_iBytes > m_iPeakBytes )
+	{
+		m_iPeakBytes = m_iBytes;
+	}
+}
+
+
+void CAssetCache::AddRef( SCachedAsset* a_poAsset )
+{
+	if ( 0 == a_poAsset->m_iRefCount++ && a_poAsset->m_bUnused )
+	{
+		m_oUnused.erase( a_poAsset->m_itUnused );
+		a_poAsset->m_bUnused = false;
+	}
+}
+
+
+void CAssetCache::Release( SCachedAsset* a_poAsset )
+{
+	if ( --a_poAsset->m_iRefCount > 0 )
+	{
+		return;
+	}
+	if ( a_poAsset->m_sKey.empty() )
+	{
+		SDL_FreeSurface( a_poAsset->m_poSurface );
+		delete a_poAsset;
+		return;
+	}
+	a_poAsset->m_itUnused = m_oUnused.insert( m_oUnused.end(), a_poAsset );
+	a_poAsset->m_bUnused = true;
+	Evict( m_iBudget );
+}
+
+
+/** Frees unused assets, least recently used first, until the cache fits
+in a_iBudget bytes. */
+void CAssetCache::Evict( int a_iBudget )
+{
+	while ( m_iBytes > a_iBudget && !m_oUnused.empty() )
+	{
+		SCachedAsset* poAsset = m_oUnused.front();
+		m_oUnused.pop_front();
+		Free( poAsset );
+		++m_iEvictions;
+	}
+}
+
+
+void CAssetCache::Free( SCachedAsset* a_poAsset )
+{
+	m_oAssets.erase( a_poAsset->m_sKey );
+	m_iBytes -= a_poAsset->m_iBytes;
+	SDL_FreeSurface( a_poAsset->m_poSurface );
+	delete a_poAsset;
+}
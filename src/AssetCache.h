@@ -0,0 +1,112 @@
+/***************************************************************************
+                          AssetCache.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+
+#include <string>
+#include <map>
+#include <list>
+
+
+struct SDL_Surface;
+struct SCachedAsset;
+class CAssetCache;
+
+
+/**
+\ingroup Media
+\brief A reference to a surface in CAssetCache.
+
+Handles can be copied freely; the surface stays in the cache as long as
+there is a handle to it. The surface is shared, so it must not be drawn
+on: use CreateCopy() or CAssetCache::CopyBackground() for that.
+*/
+
+class CSurfaceHandle
+{
+public:
+	CSurfaceHandle();
+	CSurfaceHandle( const CSurfaceHandle& a_roHandle );
+	~CSurfaceHandle();
+	CSurfaceHandle&		operator=( const CSurfaceHandle& a_roHandle );
+
+	SDL_Surface*		Get() const;
+	void				Release();
+	SDL_Surface*		CreateCopy() const;
+
+protected:
+	friend class CAssetCache;
+	CSurfaceHandle( SCachedAsset* a_poAsset );
+
+	SCachedAsset*		m_poAsset;
+};
+
+
+/**
+\ingroup Media
+\brief Keeps the images of the screens and demos converted in memory.
+
+The images are loaded with LoadBackground(), and kept by their filename
+and the pixel format of the screen. When the last handle to an image is
+released, the image stays in the cache until the memory budget
+(SState::m_iAssetCacheSize) runs out; then the least recently used images
+are freed first. Images that have handles are never freed, so the budget
+can be exceeded while they are in use.
+
+On a palettized screen loading an image sets the screen's palette, so
+the cache is bypassed there.
+
+The cache must only be used from the main thread.
+*/
+
+class CAssetCache
+{
+public:
+	CAssetCache();
+	~CAssetCache();
+
+	CSurfaceHandle		GetBackground( const char* a_pcFilename, int a_iNumColors, int a_iPaletteOffset = 0 );
+	SDL_Surface*		CopyBackground( const char* a_pcFilename, int a_iNumColors, int a_iPaletteOffset = 0 );
+	void				AddBackground( const char* a_pcFilename, SDL_Surface* a_poSurface );
+
+	void				SetBudget( int a_iBytes );
+	void				Clear();
+	void				ResetStatistics();
+	void				Report() const;
+
+protected:
+	friend class CSurfaceHandle;
+	typedef std::map<std::string,SCachedAsset*> AssetMap;
+	typedef std::list<SCachedAsset*> AssetList;
+
+	std::string			GetKey( const char* a_pcFilename ) const;
+	void				Insert( const std::string& a_rsKey, SCachedAsset* a_poAsset );
+	void				AddRef( SCachedAsset* a_poAsset );
+	void				Release( SCachedAsset* a_poAsset );
+	void				Evict( int a_iBudget );
+	void				Free( SCachedAsset* a_poAsset );
+
+protected:
+	AssetMap			m_oAssets;
+	AssetList			m_oUnused;			///< Unreferenced assets, least recently used first.
+	int					m_iBudget;			///< In bytes.
+	int					m_iBytes;			///< The size of every asset in the cache.
+	int					m_iHits;
+	int					m_iMisses;
+	int					m_iEvictions;
+	int					m_iPeakBytes;
+};
+
+
+extern CAssetCache g_oAssetCache;
+
+
+#endif // ASSETCACHE_H
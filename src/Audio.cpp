@@ -9,18 +9,42 @@
 #include "Audio.h"
 #include "State.h"
 #include "common.h"
+#include "Mixer.h"
+#include "MusicStreamer.h"
+#include "DataArchive.h"
+#include "Tracer.h"
 
+#include "SDL.h"
 #include "SDL_mixer.h"
 
 #include <string>
 #include <map>
-#include <fstream>
+#include <vector>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
 
   
-typedef std::map<std::string,Mix_Chunk*>	SampleMap;
+typedef std::map<std::string,int>			SampleIdMap;
 typedef std::map<std::string,Mix_Music*>	MusicMap;
-typedef SampleMap::iterator			SampleMapIterator;
+typedef std::map<std::string,std::string>	MusicFileMap;
+typedef SampleIdMap::iterator		SampleIdMapIterator;
 typedef MusicMap::iterator			MusicMapIterator;
+typedef MusicFileMap::iterator		MusicFileMapIterator;
+
+
+/**
+\ingroup Media
+A sample known to MszAudio. The chunk is NULL until it is loaded.
+*/
+struct SSample
+{
+	std::string	m_sFilename;
+	Mix_Chunk*	m_poChunk;
+	bool		m_bMissing;		///< Loading failed, don't try again.
+	int			m_iVolume;		///< Volume of the sample in percent, from the sound map.
+	int			m_iPriority;	///< Voice priority, from the sound map.
+};
 
 
 MszAudio* Audio = NULL;
@@ -35,10 +59,23 @@ class MszAudioPriv
 public:
 	bool		m_bAudioOk;
 	int			m_iNumChannels;
-	SampleMap	m_oSamples;
+	SampleIdMap	m_oSampleIds;			///< Sample name -> index in m_aoSamples
+	std::vector<SSample> m_aoSamples;	///< Samples by ID
 	MusicMap	m_oMusics;
+	CMixer		m_oMixer;
+	bool		m_bOwnMixer;			///< Samples are played by m_oMixer, not SDL_mixer.
+	CAudioStats	m_oStats;				///< Owned by the audio callback.
+	CMusicStreamer	m_oStreamer;
+	bool		m_bStreamMusic;			///< Music is played by m_oStreamer, not SDL_mixer.
+	MusicFileMap	m_oMusicFiles;		///< Music name -> file, if streaming.
+	
+	int			AddSample( const char* a_pcSampleName, const char* a_pcFilename );
+	bool		LoadChunk( SSample& a_roSample );
+	
+	static void	MusicHook( void* a_pvPriv, Uint8* a_pcStream, int a_iLength );
 	
 	std::string	m_sSoundDir;
+	std::string	m_sLookupKey;			///< Reused by AddSample(), so finding a known sample doesn't allocate.
 };
 
 
@@ -47,12 +84,26 @@ public:
 #define CHECKOK if ( ! m_poPriv->m_bAudioOk ) return;
 
 
+/** The music hook is the first part of the audio callback, so the
+callback's time is measured from here. */
+void MszAudioPriv::MusicHook( void* a_pvPriv, Uint8* a_pcStream, int a_iLength )
+{
+	MszAudioPriv* poPriv = (MszAudioPriv*) a_pvPriv;
+	poPriv->m_oStats.BeginCallback();
+	g_oTracer.SetThreadName( "audio" );
+	CTraceScope oTrace( "MusicHook" );
+	CMusicStreamer::HookMusic( &poPriv->m_oStreamer, a_pcStream, a_iLength );
+}
+
+
 MszAudio::MszAudio()
 {
 	Audio = this;
 	m_poPriv = new MszAudioPriv;
 	m_poPriv->m_bAudioOk = false;
 	m_poPriv->m_iNumChannels = 0;
+	m_poPriv->m_bOwnMixer = false;
+	m_poPriv->m_bStreamMusic = false;
 	m_poPriv->m_sSoundDir = DATADIR;
 	m_poPriv->m_sSoundDir += "/sound/";
 	
@@ -65,8 +116,14 @@ MszAudio::MszAudio()
 	link_version=Mix_Linked_Version();
 	debug("running with SDL_mixer version: %d.%d.%d\n",
 		link_version->major, link_version->minor, link_version->patch);
+
+	// A small buffer means low latency for the sound effects.
+	int iBuffer = g_oState.m_iAudioBuffer;
+	if ( iBuffer < 128 ) iBuffer = 128;
+	if ( iBuffer > 8192 ) iBuffer = 8192;
+	
 	if ( Mix_OpenAudio( MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT,
-		2 /*stereo*/, 1024*2 /*chunksize*/ ) < 0 )
+		2 /*stereo*/, iBuffer /*chunksize*/ ) < 0 )
 	{
 		debug("Mix_OpenAudio: %s\n", Mix_GetError());
 		SELF.m_bAudioOk = false;
@@ -74,6 +131,31 @@ MszAudio::MszAudio()
 	else
 	{
 		SELF.m_bAudioOk = true;
+		
+		// The sound effects are mixed by CMixer after SDL_mixer has mixed
+		// the music. CMixer only knows signed 16 bit stereo.
+		int iFrequency, iChannels;
+		Uint16 iFormat;
+		Mix_QuerySpec( &iFrequency, &iFormat, &iChannels );
+		if ( AUDIO_S16SYS == iFormat && 2 == iChannels )
+		{
+			SELF.m_bOwnMixer = true;
+			SELF.m_oMixer.SetDeviceLocking( true );
+			SELF.m_oStats.SetFrequency( iFrequency );
+			SELF.m_oMixer.SetStats( &SELF.m_oStats );
+			Mix_SetPostMix( CMixer::PostMix, &SELF.m_oMixer );
+			
+			// The music is decoded on a thread of its own, and SDL_mixer
+			// only copies it from the streamer.
+			if ( SELF.m_oStreamer.Start( iFrequency ) )
+			{
+				SELF.m_bStreamMusic = true;
+				Mix_HookMusic( MszAudioPriv::MusicHook, m_poPriv );
+			}
+		}
+		debug( "Audio: %d Hz, %d channels, buffer %d frames, %s mixer, %s music\n",
+			iFrequency, iChannels, iBuffer, SELF.m_bOwnMixer ? "own" : "SDL_mixer",
+			SELF.m_bStreamMusic ? "streamed" : "SDL_mixer" );
 	}
 
 	m_poPriv->m_iNumChannels = Mix_AllocateChannels(10);
@@ -84,24 +166,40 @@ MszAudio::MszAudio()
 
 MszAudio::~MszAudio()
 {
+	if ( m_poPriv->m_bStreamMusic )
+	{
+		Mix_HookMusic( NULL, NULL );
+		m_poPriv->m_oStreamer.Shutdown();
+	}
+	if ( m_poPriv->m_bOwnMixer )
+	{
+		Mix_SetPostMix( NULL, NULL );
+	}
 	delete m_poPriv;
 	m_poPriv = NULL;
 }
 
 
+bool MszAudio::IsOk()
+{
+	return m_poPriv->m_bAudioOk;
+}
+
+
 void MszAudio::LoadSampleMap()
 {
 	CHECKOK;
 	
 	std::string sFilename = m_poPriv->m_sSoundDir + "soundmap.txt";
-	std::ifstream oInput( sFilename.c_str() );
+	std::string sSoundmap;
 	
-	if ( !oInput.is_open() ) 
+	if ( !ReadDataFile( sFilename.c_str(), sSoundmap ) ) 
 	{
 		debug( "File %d could not be read.\n", sFilename.c_str() );
 		return;
 	}
 	
+	std::istringstream oInput( sSoundmap );
 	std::string sLine;
 	
 	while ( std::getline( oInput, sLine ) )
@@ -132,16 +230,81 @@ void MszAudio::LoadSampleMap()
 			continue;
 		}
 		
-		size_t iFilenameEnd = sLine.find_last_not_of( " \t\r\n" );
+		size_t iFilenameEnd = sLine.find_first_of( " \t\r\n", iFilenameStart );
+		if ( sLine.npos == iFilenameEnd )
+		{
+			iFilenameEnd = sLine.size();
+		}
 		
 		std::string sSampleName = sLine.substr( iFirstChar, iTitleEnd-iFirstChar );
-		std::string sSampleFile = sLine.substr( iFilenameStart, iFilenameEnd - iFilenameStart + 1 );
+		std::string sSampleFile = sLine.substr( iFilenameStart, iFilenameEnd - iFilenameStart );
+		
+		// Optional columns: volume in percent, and priority.
+		int iVolume = 100;
+		int iPriority = 0;
+		sscanf( sLine.c_str() + iFilenameEnd, "%d %d", &iVolume, &iPriority );
 		
 		debug( "MAPPING: '%s' => '%s'\n", sSampleName.c_str(), sSampleFile.c_str() );
 		LoadSample( sSampleFile.c_str(), sSampleName.c_str() );
+		
+		SSample& roSample = m_poPriv->m_aoSamples[ m_poPriv->m_oSampleIds[sSampleName] ];
+		roSample.m_iVolume = iVolume;
+		roSample.m_iPriority = iPriority;
+	}
+}
+
+
+/** Registers a sample by name, or returns the ID of the sample if it is
+already known. */
+int MszAudioPriv::AddSample( const char* a_pcSampleName, const char* a_pcFilename )
+{
+	m_sLookupKey.assign( a_pcSampleName );
+	SampleIdMapIterator it = m_oSampleIds.find( m_sLookupKey );
+	if ( m_oSampleIds.end() != it )
+	{
+		return (*it).second;
+	}
+	
+	SSample oSample;
+	oSample.m_sFilename = a_pcFilename;
+	oSample.m_poChunk = NULL;
+	oSample.m_bMissing = false;
+	oSample.m_iVolume = 100;
+	oSample.m_iPriority = 0;
+	m_aoSamples.push_back( oSample );
+	
+	int iId = m_aoSamples.size() - 1;
+	m_oSampleIds[ m_sLookupKey ] = iId;
+	return iId;
+}
+
+
+/** Loads the sample's file. Mix_LoadWAV converts it to the format of the
+mixer, so nothing is left to do when it is played. */
+bool MszAudioPriv::LoadChunk( SSample& a_roSample )
+{
+	if ( a_roSample.m_poChunk )
+	{
+		return true;
+	}
+	if ( a_roSample.m_bMissing )
+	{
+		return false;
 	}
 	
-	oInput.close();
+	std::string sSampleFile = m_sSoundDir + a_roSample.m_sFilename;
+	CDataFile oFile;
+	if ( oFile.Open( sSampleFile.c_str() ) )
+	{
+		a_roSample.m_poChunk = Mix_LoadWAV_RW( oFile.CreateRWops(), 1 );
+	}
+	if ( NULL == a_roSample.m_poChunk )
+	{
+		debug("Mix_LoadWAV: %s\n", Mix_GetError());
+		a_roSample.m_bMissing = true;
+		return false;
+	}
+	return true;
 }
 
 
@@ -150,61 +313,106 @@ void MszAudio::LoadSample( const char* a_pcFilename, const char* a_pcSampleName
 	CHECKOK;
 
 	std::string sSampleName( a_pcSampleName ? a_pcSampleName : a_pcFilename );
-	std::string sSampleFile = m_poPriv->m_sSoundDir + a_pcFilename;
+	int iId = m_poPriv->AddSample( sSampleName.c_str(), a_pcFilename );
+	SSample& roSample = m_poPriv->m_aoSamples[iId];
 
-	if ( m_poPriv->m_oSamples.count( sSampleName ) )
+	if ( roSample.m_poChunk )
 	{
-		debug( "Key %s already loaded", a_pcSampleName );
+		debug( "Key %s already loaded", sSampleName.c_str() );
 		return;
 	}
 	
-	Mix_Chunk *poSample;
-	poSample=Mix_LoadWAV(sSampleFile.c_str());
-	if(!poSample)
+	roSample.m_sFilename = a_pcFilename;
+	roSample.m_bMissing = false;
+	m_poPriv->LoadChunk( roSample );
+}
+
+
+
+void MszAudio::UnloadSample( const char* a_pcSampleName )
+{
+	SampleIdMapIterator it = m_poPriv->m_oSampleIds.find( a_pcSampleName );
+	if ( m_poPriv->m_oSampleIds.end() == it
+		|| NULL == m_poPriv->m_aoSamples[(*it).second].m_poChunk )
 	{
-		debug("Mix_LoadWAV: %s\n", Mix_GetError());
+		debug( "UnloadSample: sample %s not found", a_pcSampleName );
 		return;
 	}
 
-	m_poPriv->m_oSamples[ sSampleName ] = poSample;
+	// The ID stays valid, the sample will be loaded again if needed.
+	SSample& roSample = m_poPriv->m_aoSamples[(*it).second];
+	m_poPriv->m_oMixer.Stop( (const Sint16*) roSample.m_poChunk->abuf );
+	Mix_FreeChunk( roSample.m_poChunk );
+	roSample.m_poChunk = NULL;
 }
 
 
+/** Returns the ID of a sample name. The ID is valid for the lifetime of
+the MszAudio object. Unknown names are registered as the name of the file
+to load. */
+int MszAudio::GetSampleId( const char* a_pcSampleName )
+{
+	return m_poPriv->AddSample( a_pcSampleName, a_pcSampleName );
+}
 
-void MszAudio::UnloadSample( const char* a_pcSampleName )
+
+/** Loads the sample now, so that playing it later won't have to. */
+void MszAudio::PreloadSample( int a_iSampleId )
 {
-	SampleMapIterator it = m_poPriv->m_oSamples.find( a_pcSampleName );
-	if ( m_poPriv->m_oSamples.end() == it )
+	CHECKOK;
+	
+	if ( a_iSampleId < 0 || a_iSampleId >= (int) m_poPriv->m_aoSamples.size() )
 	{
-		debug( "UnloadSample: sample %s not found", a_pcSampleName );
 		return;
 	}
-
-	Mix_FreeChunk( (*it).second );
-	m_poPriv->m_oSamples.erase( it );
+	m_poPriv->LoadChunk( m_poPriv->m_aoSamples[a_iSampleId] );
 }
 
 
 void MszAudio::PlaySample( const char* a_pcSampleName )
 {
-	Mix_Chunk* poSample;
-	SampleMapIterator it = m_poPriv->m_oSamples.find(a_pcSampleName);
-	if ( m_poPriv->m_oSamples.end() == it )
+	PlaySample( GetSampleId( a_pcSampleName ) );
+}
+
+
+/** Plays a sample.
+
+\param a_iSampleId	See GetSampleId().
+\param a_dEventNs	When the sound was emitted by the backend (GetNanoseconds),
+					for measuring the latency of the audio path. 0 if now.
+*/
+void MszAudio::PlaySample( int a_iSampleId, double a_dEventNs )
+{
+	CHECKOK;
+	
+	if ( a_iSampleId < 0 || a_iSampleId >= (int) m_poPriv->m_aoSamples.size() )
 	{
-		// Try to load the sample..
-		LoadSample( a_pcSampleName );
-		
-		it = m_poPriv->m_oSamples.find(a_pcSampleName);
-		if ( m_poPriv->m_oSamples.end() == it )
+		return;
+	}
+	
+	SSample& roSample = m_poPriv->m_aoSamples[a_iSampleId];
+	if ( NULL == roSample.m_poChunk )
+	{
+		// Try to load the sample.. this should have been preloaded.
+		debug( "PlaySample: sample %s was not preloaded\n", roSample.m_sFilename.c_str() );
+		if ( !m_poPriv->LoadChunk( roSample ) )
 		{
-			debug( "PlaySample: sample %s not found", a_pcSampleName );
 			return;
 		}
 	}
 
-	poSample = (*it).second;
+	Mix_Chunk* poSample = roSample.m_poChunk;
+	g_oTracer.Instant( "PlaySample" );
+	
+	int iVolume = g_oState.m_iSoundVolume * roSample.m_iVolume * 128 / 10000;
+	
+	if ( m_poPriv->m_bOwnMixer )
+	{
+		m_poPriv->m_oMixer.Play( (const Sint16*) poSample->abuf, poSample->alen / 4,
+			iVolume, roSample.m_iPriority, a_dEventNs );
+		return;
+	}
 	
-	int iVolume = g_oState.m_iSoundVolume * 128 / 100;
 	if ( poSample->volume != iVolume )
 	{
 		Mix_VolumeChunk( poSample, iVolume );
@@ -239,6 +447,20 @@ void MszAudio::LoadMusic( const char* a_pcFilename, const char* a_pcMusicName )
 	CHECKOK;
 
 	std::string sMusicName( a_pcMusicName ? a_pcMusicName : a_pcFilename );
+	
+	if ( m_poPriv->m_bStreamMusic )
+	{
+		// The streamer loads it in the background.
+		if ( m_poPriv->m_oMusicFiles.count( sMusicName ) )
+		{
+			debug( "Key %s already loaded", sMusicName.c_str() );
+			return;
+		}
+		m_poPriv->m_oMusicFiles[ sMusicName ] = a_pcFilename;
+		m_poPriv->m_oStreamer.Prefetch( a_pcFilename );
+		return;
+	}
+	
 	std::string sMusicFile = DATADIR;
 	sMusicFile += "/sound/";
 	sMusicFile += a_pcFilename;
@@ -263,6 +485,19 @@ void MszAudio::LoadMusic( const char* a_pcFilename, const char* a_pcMusicName )
 
 void MszAudio::UnloadMusic( const char* a_pcMusicName )
 {
+	if ( m_poPriv->m_bStreamMusic )
+	{
+		MusicFileMapIterator it = m_poPriv->m_oMusicFiles.find( a_pcMusicName );
+		if ( m_poPriv->m_oMusicFiles.end() == it )
+		{
+			debug( "UnloadMusic: music %s not found", a_pcMusicName );
+			return;
+		}
+		m_poPriv->m_oStreamer.Unload( (*it).second.c_str() );
+		m_poPriv->m_oMusicFiles.erase( it );
+		return;
+	}
+	
 	MusicMapIterator it = m_poPriv->m_oMusics.find( a_pcMusicName );
 	if ( m_poPriv->m_oMusics.end() == it )
 	{
@@ -277,6 +512,19 @@ void MszAudio::UnloadMusic( const char* a_pcMusicName )
 
 void MszAudio::PlayMusic( const char* a_pcMusicName )
 {
+	if ( m_poPriv->m_bStreamMusic )
+	{
+		MusicFileMapIterator it = m_poPriv->m_oMusicFiles.find( a_pcMusicName );
+		if ( m_poPriv->m_oMusicFiles.end() == it )
+		{
+			debug( "PlayMusic: music %s not found", a_pcMusicName );
+			return;
+		}
+		SetMusicVolume( g_oState.m_iMusicVolume );
+		m_poPriv->m_oStreamer.Play( (*it).second.c_str(), MUSIC_CROSSFADEMS );
+		return;
+	}
+	
 	MusicMapIterator it = m_poPriv->m_oMusics.find( a_pcMusicName );
 	if ( m_poPriv->m_oMusics.end() == it )
 	{
@@ -292,30 +540,161 @@ void MszAudio::PlayMusic( const char* a_pcMusicName )
 
 void MszAudio::FadeMusic( int a_iMilliSec )
 {
+	if ( m_poPriv->m_bStreamMusic )
+	{
+		m_poPriv->m_oStreamer.FadeOut( a_iMilliSec );
+		return;
+	}
 	Mix_FadeOutMusic( a_iMilliSec );
 }
 
 
 void MszAudio::SetMusicVolume( int a_iVolume )
 {
+	if ( m_poPriv->m_bStreamMusic )
+	{
+		m_poPriv->m_oStreamer.SetVolume( a_iVolume * 128 / 100 );
+		return;
+	}
 	Mix_VolumeMusic( a_iVolume * 128 / 100 );
 }
 
 
 void MszAudio::StopMusic()
 {
+	if ( m_poPriv->m_bStreamMusic )
+	{
+		m_poPriv->m_oStreamer.Halt();
+		return;
+	}
 	Mix_HaltMusic();
 }
 
 
 bool MszAudio::IsMusicPlaying()
 {
+	if ( m_poPriv->m_bStreamMusic )
+	{
+		return m_poPriv->m_oStreamer.IsPlaying();
+	}
 	return Mix_PlayingMusic();
 }
 
 
 
+/*************************************************************************
+                           AUDIO STATISTICS
+*************************************************************************/
 
 
+void MszAudio::ResetStatistics()
+{
+	CHECKOK;
+	
+	SDL_LockAudio();
+	m_poPriv->m_oStats.Reset();
+	SDL_UnlockAudio();
+}
+
+
+/** Reports the latency of the audio path and the load of the callback
+since the last ResetStatistics(). Only works with our own mixer. */
+void MszAudio::ReportStatistics()
+{
+	CHECKOK;
+	
+	if ( !m_poPriv->m_bOwnMixer )
+	{
+		debug( "Audio: no statistics, SDL_mixer plays the samples.\n" );
+		return;
+	}
+	
+	// The statistics belong to the callback; take a copy while it can't run.
+	CAudioStats* poStats = new CAudioStats;
+	SDL_LockAudio();
+	*poStats = m_poPriv->m_oStats;
+	int iNumStolen = m_poPriv->m_oMixer.GetNumberOfStolenVoices();
+	int iNumDropped = m_poPriv->m_oMixer.GetNumberOfDroppedVoices();
+	SDL_UnlockAudio();
+	
+	poStats->Report( iNumStolen, iNumDropped );
+	delete poStats;
+}
+
+
+
+/*************************************************************************
+                           HEADLESS AUDIO TEST
+*************************************************************************/
 
 
+/** Plays the music and a stream of game sounds for a few seconds on SDL's
+dummy audio driver, which runs the callback in real time without a sound
+card, and reports the audio statistics. Every two seconds a burst of
+sounds tests the voice stealing. */
+int DoAudioTest()
+{
+	static const char* apcSounds[] =
+	{
+		"ATTACK_HITS", "ATTACK_MISSES", "ATTACK_BLOCKED", "PLAYER_JUMPS",
+		"PLAYER_LANDS", "UPPERCUT_HITS", "PLAYER_KO", "COMBO",
+	};
+	const int iNumSounds = sizeof(apcSounds) / sizeof(apcSounds[0]);
+	const int iSeconds = 10;
+	
+	if ( NULL == getenv( "SDL_AUDIODRIVER" ) )
+	{
+		putenv( (char*) "SDL_AUDIODRIVER=dummy" );
+	}
+	if ( SDL_Init( SDL_INIT_AUDIO | SDL_INIT_TIMER ) < 0 )
+	{
+		fprintf( stderr, "SDL_Init: %s\n", SDL_GetError() );
+		return 1;
+	}
+	
+	new MszAudio;
+	if ( !Audio->IsOk() )
+	{
+		SDL_Quit();
+		return 1;
+	}
+	
+	int aiSounds[iNumSounds];
+	for ( int i=0; i<iNumSounds; ++i )
+	{
+		aiSounds[i] = Audio->GetSampleId( apcSounds[i] );
+	}
+	
+	Audio->LoadMusic( "ride.mod", "DemoMusic" );
+	Audio->LoadMusic( "2nd_pm.s3m", "GameMusic" );
+	Audio->PlayMusic( "DemoMusic" );
+	Audio->ResetStatistics();
+	
+	int iTickMs = g_oState.m_iGameSpeed > 0 ? g_oState.m_iGameSpeed : 16;
+	int iNumTicks = iSeconds * 1000 / iTickMs;
+	srand( 1 );
+	
+	for ( int iTick=0; iTick<iNumTicks; ++iTick )
+	{
+		if ( iTick == iNumTicks / 2 )
+		{
+			Audio->PlayMusic( "GameMusic" );
+		}
+		
+		// One backend tick: the sounds are emitted together, like in
+		// ReadFromPerl, and played right after.
+		double dEventNs = GetNanoseconds();
+		int iNumNew = ( iTick % ( 2000 / iTickMs ) == 0 ) ? 40 : ( rand() % 4 == 0 ? 1 + rand() % 2 : 0 );
+		for ( int i=0; i<iNumNew; ++i )
+		{
+			Audio->PlaySample( aiSounds[ rand() % iNumSounds ], dEventNs );
+		}
+		SDL_Delay( iTickMs );
+	}
+	
+	Audio->ReportStatistics();
+	delete Audio;
+	Audio = NULL;
+	SDL_Quit();
+	return 0;
+}
@@ -24,6 +24,16 @@ class MszAudioPriv;
 \ingroup Media
 
 This class is a wrapper around SDL_Mixer
+
+Samples are known by name (see soundmap.txt), but each name is resolved
+to an integer ID only once, with GetSampleId(). Playing a sample by its ID
+is a simple array index. Samples that are not in the sound map are loaded
+from the file of the same name; PreloadSample() should be called for
+these before they are needed, because loading is slow.
+
+If libmikmod is available, the music is streamed by CMusicStreamer instead
+of SDL_mixer, and PlayMusic() crossfades from the previous track.
+LoadMusic() only starts loading the track in the background.
 */
 
 class MszAudio
@@ -31,6 +41,7 @@ class MszAudio
 public:
 	MszAudio();
 	~MszAudio();
+	bool IsOk();
 	void LoadSampleMap();
 
 public:
@@ -41,6 +52,13 @@ public:
 	void PlaySample( const char* a_pcSampleName );
 	void PlayFile( const char* a_pcFilename );
 
+	int  GetSampleId( const char* a_pcSampleName );
+	void PreloadSample( int a_iSampleId );
+	void PlaySample( int a_iSampleId, double a_dEventNs=0.0 );
+
+	void ResetStatistics();
+	void ReportStatistics();
+
 	// Music related methods
 
 	void LoadMusic( const char* a_pcFilename, const char* a_pcMusicName=NULL );
@@ -0,0 +1,215 @@
+/***************************************************************************
+                          AudioStats.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "AudioStats.h"
+#include "common.h"
+
+#include <string.h>
+#include <algorithm>
+
+
+
+/*************************************************************************
+                           ROLLING HISTOGRAM
+*************************************************************************/
+
+
+CRollingHistogram::CRollingHistogram()
+{
+	Reset();
+}
+
+
+void CRollingHistogram::Add( double a_dMs )
+{
+	m_adValues[m_iNext] = a_dMs;
+	m_iNext = ( m_iNext + 1 ) % AUDIOSTATS_WINDOW;
+	if ( m_iCount < AUDIOSTATS_WINDOW )
+	{
+		++m_iCount;
+	}
+}
+
+
+void CRollingHistogram::Reset()
+{
+	m_iNext = m_iCount = 0;
+}
+
+
+int CRollingHistogram::GetCount() const
+{
+	return m_iCount;
+}
+
+
+/** Prints the percentiles, and the histogram of the non-empty buckets. */
+void CRollingHistogram::Report( const char* a_pcName ) const
+{
+	if ( 0 == m_iCount )
+	{
+		debug( "  %s: no data\n", a_pcName );
+		return;
+	}
+
+	double adSorted[AUDIOSTATS_WINDOW];
+	memcpy( adSorted, m_adValues, m_iCount * sizeof(double) );
+	std::sort( adSorted, adSorted + m_iCount );
+
+	debug( "  %s (last %d): p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+		a_pcName, m_iCount,
+		adSorted[ m_iCount * 50 / 100 ], adSorted[ m_iCount * 90 / 100 ],
+		adSorted[ m_iCount * 99 / 100 ], adSorted[ m_iCount - 1 ] );
+
+	int aiBuckets[AUDIOSTATS_BUCKETS];
+	memset( aiBuckets, 0, sizeof(aiBuckets) );
+	for ( int i=0; i<m_iCount; ++i )
+	{
+		int iBucket = 0;
+		double dLimit = 1.0 / 16;
+		while ( iBucket < AUDIOSTATS_BUCKETS-1 && adSorted[i] >= dLimit )
+		{
+			++iBucket;
+			dLimit *= 2;
+		}
+		++aiBuckets[iBucket];
+	}
+
+	double dLimit = 1.0 / 16;
+	for ( int i=0; i<AUDIOSTATS_BUCKETS; ++i, dLimit *= 2 )
+	{
+		if ( 0 == aiBuckets[i] )
+		{
+			continue;
+		}
+		char acBar[41];
+		int iLength = aiBuckets[i] * 40 / m_iCount;
+		memset( acBar, '#', iLength );
+		acBar[iLength] = 0;
+		if ( i < AUDIOSTATS_BUCKETS-1 )
+			debug( "    < %8.3f ms %5d %s\n", dLimit, aiBuckets[i], acBar );
+		else
+			debug( "   >= %8.3f ms %5d %s\n", dLimit / 2, aiBuckets[i], acBar );
+	}
+}
+
+
+
+/*************************************************************************
+                           AUDIO STATISTICS
+*************************************************************************/
+
+
+CAudioStats::CAudioStats()
+{
+	m_iFrequency = 0;
+	Reset();
+}
+
+
+void CAudioStats::SetFrequency( int a_iFrequency )
+{
+	m_iFrequency = a_iFrequency;
+}
+
+
+void CAudioStats::Reset()
+{
+	m_dCallbackStartNs = 0.0;
+	m_iNumPending = 0;
+	m_oEventToPlay.Reset();
+	m_oPlayToMix.Reset();
+	m_oEventToOutput.Reset();
+	m_oCallbackTime.Reset();
+	m_iNumCallbacks = 0;
+	m_iNumSounds = 0;
+	m_dCallbackNs = 0.0;
+	m_dBudgetNs = 0.0;
+	m_dMaxLoad = 0.0;
+}
+
+
+/** Called at the start of the audio callback. Only the first call in a
+callback counts. */
+void CAudioStats::BeginCallback()
+{
+	if ( m_dCallbackStartNs <= 0.0 )
+	{
+		m_dCallbackStartNs = GetNanoseconds();
+	}
+}
+
+
+/** Called when a voice is mixed for the first time. */
+void CAudioStats::SoundStarted( SSoundTiming& a_roTiming )
+{
+	a_roTiming.m_dMixNs = m_dCallbackStartNs;
+	m_oEventToPlay.Add( ( a_roTiming.m_dPlayNs - a_roTiming.m_dEventNs ) / 1e6 );
+	m_oPlayToMix.Add( ( a_roTiming.m_dMixNs - a_roTiming.m_dPlayNs ) / 1e6 );
+	++m_iNumSounds;
+
+	if ( m_iNumPending < AUDIOSTATS_MAXPENDING )
+	{
+		m_adPendingEventNs[ m_iNumPending++ ] = a_roTiming.m_dEventNs;
+	}
+}
+
+
+/** Called at the end of the audio callback, which produced the given
+number of frames. */
+void CAudioStats::EndCallback( int a_iNumFrames )
+{
+	if ( m_dCallbackStartNs <= 0.0 )
+	{
+		return;
+	}
+
+	double dNow = GetNanoseconds();
+	double dTime = dNow - m_dCallbackStartNs;
+	double dBudget = m_iFrequency > 0 ? a_iNumFrames * 1e9 / m_iFrequency : 0.0;
+
+	m_oCallbackTime.Add( dTime / 1e6 );
+	++m_iNumCallbacks;
+	m_dCallbackNs += dTime;
+	m_dBudgetNs += dBudget;
+	if ( dBudget > 0 && dTime / dBudget > m_dMaxLoad )
+	{
+		m_dMaxLoad = dTime / dBudget;
+	}
+
+	for ( int i=0; i<m_iNumPending; ++i )
+	{
+		m_oEventToOutput.Add( ( dNow - m_adPendingEventNs[i] ) / 1e6 );
+	}
+	m_iNumPending = 0;
+	m_dCallbackStartNs = 0.0;
+}
+
+
+/** Prints the statistics. The voice counters come from CMixer. */
+void CAudioStats::Report( int a_iNumStolen, int a_iNumDropped ) const
+{
+	if ( 0 == m_iNumCallbacks )
+	{
+		debug( "Audio: no callbacks measured.\n" );
+		return;
+	}
+
+	double dBufferMs = m_dBudgetNs / m_iNumCallbacks / 1e6;
+	debug( "Audio: %d callbacks of %.1f ms, %d sounds, %d voices stolen, %d dropped.\n",
+		m_iNumCallbacks, dBufferMs, m_iNumSounds, a_iNumStolen, a_iNumDropped );
+	debug( "Audio: callback load %.2f%% average, %.2f%% worst.\n",
+		m_dBudgetNs > 0 ? m_dCallbackNs / m_dBudgetNs * 100.0 : 0.0, m_dMaxLoad * 100.0 );
+
+	m_oCallbackTime.Report( "callback time" );
+	m_oEventToPlay.Report( "event -> PlaySample" );
+	m_oPlayToMix.Report( "PlaySample -> mix" );
+	m_oEventToOutput.Report( "event -> output buffer" );
+	debug( "  (the device plays the buffer about %.1f ms after it is handed over)\n", dBufferMs );
+}
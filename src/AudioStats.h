@@ -0,0 +1,101 @@
+/***************************************************************************
+                          AudioStats.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef AUDIOSTATS_H
+#define AUDIOSTATS_H
+
+
+#define AUDIOSTATS_WINDOW		1024	///< The rolling histograms keep this many values.
+#define AUDIOSTATS_BUCKETS		16		///< Powers of two from 1/16 ms up.
+#define AUDIOSTATS_MAXPENDING	64		///< Sounds started in one callback.
+
+
+/**
+\ingroup Media
+Timestamps of one sound on its way through the audio path, in
+GetNanoseconds().
+*/
+struct SSoundTiming
+{
+	double		m_dEventNs;		///< The backend emitted the sound (ReadFromPerl).
+	double		m_dPlayNs;		///< MszAudio::PlaySample() was called.
+	double		m_dMixNs;		///< The callback that first mixed the sound started.
+};
+
+
+/**
+\ingroup Media
+\brief The last AUDIOSTATS_WINDOW values of a measurement, in milliseconds.
+*/
+class CRollingHistogram
+{
+public:
+	CRollingHistogram();
+
+	void		Add( double a_dMs );
+	void		Reset();
+	int			GetCount() const;
+	void		Report( const char* a_pcName ) const;
+
+protected:
+	double		m_adValues[AUDIOSTATS_WINDOW];
+	int			m_iNext;
+	int			m_iCount;
+};
+
+
+/**
+\ingroup Media
+\brief Latency and load measurements of the audio path.
+
+The game thread stamps a sound when the backend emits it and when it is
+played; CMixer keeps the stamps with the voice. Everything else happens
+on the audio thread: the callback calls BeginCallback() when it starts
+(the music hook, or the mixer if there is no music hook), SoundStarted()
+for each voice it mixes for the first time, and EndCallback() when the
+buffer is done.
+
+The callback owns the statistics, so the game thread must copy them with
+the audio device locked before reporting (see MszAudio::ReportStatistics).
+*/
+
+class CAudioStats
+{
+public:
+	CAudioStats();
+
+	void		SetFrequency( int a_iFrequency );
+	void		Reset();
+	void		Report( int a_iNumStolen, int a_iNumDropped ) const;
+
+	// Audio thread only
+	void		BeginCallback();
+	void		SoundStarted( SSoundTiming& a_roTiming );
+	void		EndCallback( int a_iNumFrames );
+
+protected:
+	int			m_iFrequency;
+	double		m_dCallbackStartNs;			///< 0 outside of the callback.
+	double		m_adPendingEventNs[AUDIOSTATS_MAXPENDING];	///< Sounds started in this callback.
+	int			m_iNumPending;
+
+	CRollingHistogram	m_oEventToPlay;		///< Backend event -> PlaySample
+	CRollingHistogram	m_oPlayToMix;		///< PlaySample -> start of the callback that mixes it
+	CRollingHistogram	m_oEventToOutput;	///< Backend event -> buffer handed to SDL
+	CRollingHistogram	m_oCallbackTime;	///< CPU time of the callback
+
+	int			m_iNumCallbacks;
+	int			m_iNumSounds;
+	double		m_dCallbackNs;				///< Total time spent in the callback.
+	double		m_dBudgetNs;				///< Total duration of the buffers produced.
+	double		m_dMaxLoad;					///< Worst callback time / buffer duration.
+};
+
+
+#endif // AUDIOSTATS_H
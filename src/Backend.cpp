@@ -11,10 +11,14 @@
 #include "Backend.h"
 #include "Audio.h"
 #include "State.h"
+#include "Tracer.h"
 
 #include <string>
 #include <stdarg.h>
+#include <string.h>
 #include "MszPerl.h"
+#include <XSUB.h>
+#include "DataArchive.h"
 
 
 /***************************************************************************
@@ -112,7 +116,7 @@ const char* TranslateUTF8( const char* a_pcText )
     XPUSHs(sv_2mortal(newSViv(B)));						\
     PUTBACK ;											\
 														\
-    call_pv( (PROC),  G_DISCARD );						\
+    call_pv( (PROC),  G_DISCARD | G_EVAL );				\
 														\
     FREETMPS;											\
     LEAVE;												\
@@ -123,6 +127,9 @@ Backend::Backend()
 {
 	m_iBgX = m_iBgY = 0;
 	m_iNumDoodads = m_iNumSounds = 0;
+	m_dSoundsNs = 0.0;
+	memset( m_aoSoundIds, 0, sizeof(m_aoSoundIds) );
+	m_poSoundIdsAudio = NULL;
 	for ( int i=0; i<MAXPLAYERS; ++i )
 	{
 		m_aoPlayers[i].m_iX = m_aoPlayers[i].m_iY = 0;
@@ -143,6 +150,37 @@ Backend::~Backend()
 }
 
 
+/***************************************************************************
+                     FUNCTIONS EXPORTED TO PERL
+***************************************************************************/
+
+/** ReadDataFile( $path ): returns the contents of a file under DATADIR, from
+the data archive if it is there, or undef if the file doesn't exist. */
+
+XS(XS_main_ReadDataFile)
+{
+	dXSARGS;
+	if ( items != 1 )
+	{
+		croak( "Usage: ReadDataFile(path)" );
+	}
+	
+	std::string sData;
+	if ( !ReadDataFile( SvPV_nolen( ST(0) ), sData ) )
+	{
+		XSRETURN_UNDEF;
+	}
+	ST(0) = sv_2mortal( newSVpvn( sData.data(), sData.size() ) );
+	XSRETURN(1);
+}
+
+
+static void xs_init( pTHX )
+{
+	newXS( (char*) "main::ReadDataFile", XS_main_ReadDataFile, (char*) __FILE__ );
+}
+
+
 bool Backend::Construct()
 {
 	if ( my_perl != NULL )
@@ -172,7 +210,7 @@ bool Backend::Construct()
 	}
 	
 	perl_construct( my_perl );
-	if ( perl_parse( my_perl, NULL, perl_argc, perl_argv, (char**)NULL ) )
+	if ( perl_parse( my_perl, xs_init, perl_argc, perl_argv, (char**)NULL ) )
 	{
 		char *error = SvPV_nolen(get_sv("@", FALSE));
 		fprintf( stderr, "%s", error );
@@ -190,6 +228,20 @@ bool Backend::Construct()
 }
 
 
+/** Makes the interpreter the current one of the calling thread. The
+backend may be used from a worker thread during startup (see CStartup),
+but only by one thread at a time; every thread must call this before it
+uses the backend after another thread did. */
+
+void Backend::AttachThread()
+{
+	if ( my_perl != NULL )
+	{
+		PERL_SET_CONTEXT( my_perl );
+	}
+}
+
+
 const char* Backend::PerlEvalF( const char* a_pcFormat, ... )
 {
 	va_list ap;
@@ -213,6 +265,36 @@ const char* Backend::PerlEvalF( const char* a_pcFormat, ... )
 }
 
 
+/** Calls a perl sub in the main package without arguments. This does not
+compile any code, so unlike PerlEvalF() it does not allocate memory. */
+void Backend::PerlCall( const char* a_pcProc )
+{
+	call_pv( a_pcProc, G_DISCARD | G_NOARGS | G_EVAL );
+	
+	const char *pcError = SvPV_nolen(get_sv("@", FALSE));
+	if ( pcError && *pcError )
+	{
+		debug( "call '%s': '%s'\n", a_pcProc, pcError );
+		exit(0);
+	}
+}
+
+
+/** Calls a perl sub in the main package with two integer arguments,
+e.g. KeyDown(player,key). */
+void Backend::PerlCall( const char* a_pcProc, int a_iArg1, int a_iArg2 )
+{
+	PERLCALL( a_pcProc, a_iArg1, a_iArg2 );
+	
+	const char *pcError = SvPV_nolen(get_sv("@", FALSE));
+	if ( pcError && *pcError )
+	{
+		debug( "call '%s(%d,%d)': '%s'\n", a_pcProc, a_iArg1, a_iArg2, pcError );
+		exit(0);
+	}
+}
+
+
 const char* Backend::GetPerlString( const char* acScalarName )
 {
 	SV* poScalar = get_sv( acScalarName, FALSE );
@@ -279,6 +361,36 @@ int Backend::GetNumberOfAvailableFighters()
 }
 
 
+/** Returns the number of fighter script files in the characters directory.
+The files are not loaded yet, this must be done with LoadFighterFile().
+
+\see LoadFighterFile
+*/
+int Backend::GetNumberOfFighterFiles()
+{
+#ifdef MACOSX
+	//[segabor]
+	char char_buf[256];
+	sprintf(char_buf, "%s/characters", DATADIR);
+	PerlEvalF( "$CppRetval = GetNumberOfFighterFiles('%s')", char_buf );
+#else
+	PerlEvalF( "$CppRetval = GetNumberOfFighterFiles('%s')", DATADIR "/characters" );
+#endif
+	return GetPerlInt( "CppRetval" );
+}
+
+
+/** Loads the given fighter script file into the backend. The index
+should be less than the value returned by GetNumberOfFighterFiles().
+
+\see GetNumberOfFighterFiles
+*/
+void Backend::LoadFighterFile( int a_iIndex )
+{
+	PerlEvalF( "LoadFighterFile(%d);", a_iIndex );
+}
+
+
 /**
 Makes the perl interpreter advance from the current scene to the next one. 
 This should be called a constant number of time per second to make the game 
@@ -287,13 +399,15 @@ changing the frequency at which this method is called.
 */
 void Backend::AdvancePerl()
 {
-	PerlEvalF("GameAdvance();");
+	CTraceScope oTrace( "GameAdvance" );
+	PerlCall( "GameAdvance" );
 }
 
 
 
 void Backend::ReadFromPerl()
 {
+	CTraceScope oTrace( "ReadFromPerl" );
 	int i;
 
 	if ( perl_bgx == NULL )
@@ -351,7 +465,7 @@ void Backend::ReadFromPerl()
 	
 	for ( m_iNumDoodads=0; m_iNumDoodads<MAXDOODADS; ++m_iNumDoodads )
 	{
-		PERLEVAL("GetNextDoodadData();");
+		PerlCall( "GetNextDoodadData" );
 		
 		SDoodad& oDoodad = m_aoDoodads[m_iNumDoodads];
 		
@@ -386,9 +500,11 @@ void Backend::ReadFromPerl()
 		perl_sound = get_sv("sound", TRUE);
 	}
 	
+	m_dSoundsNs = GetNanoseconds();
+	
 	for ( m_iNumSounds=0; m_iNumSounds<MAXSOUNDS; ++m_iNumSounds )
 	{
-		PERLEVAL("GetNextSoundData();");
+		PerlCall( "GetNextSoundData" );
 		const char* pcSound = SvPV_nolen(perl_sound);
 	
 		if ( NULL == pcSound
@@ -398,7 +514,7 @@ void Backend::ReadFromPerl()
 		}
 		
 		m_asSounds[ m_iNumSounds ] = pcSound;
-		//Audio->PlaySample( pcSound );
+		m_aiSounds[ m_iNumSounds ] = GetSoundId( pcSound );
 	}
 }
 
@@ -409,11 +525,112 @@ bool Backend::IsDead( int a_iPlayer )
 }
 
 
+void Backend::SavePositions( SPositions& a_roOutPositions ) const
+{
+	a_roOutPositions.m_iBgX = m_iBgX;
+	a_roOutPositions.m_iBgY = m_iBgY;
+	int i;
+	for ( i=0; i<MAXPLAYERS; ++i )
+	{
+		a_roOutPositions.m_aiPlayerX[i] = m_aoPlayers[i].m_iX;
+		a_roOutPositions.m_aiPlayerY[i] = m_aoPlayers[i].m_iY;
+	}
+	a_roOutPositions.m_iNumDoodads = m_iNumDoodads;
+	for ( i=0; i<m_iNumDoodads; ++i )
+	{
+		a_roOutPositions.m_aiDoodadX[i] = m_aoDoodads[i].m_iX;
+		a_roOutPositions.m_aiDoodadY[i] = m_aoDoodads[i].m_iY;
+		a_roOutPositions.m_aiDoodadType[i] = m_aoDoodads[i].m_iType;
+	}
+}
+
+
+/** Returns the sample ID of a sound name from the backend. The IDs are
+kept in a small hash table of the names, so looking up a known sound is
+a hash and a strcmp, and allocates nothing. An unknown name is resolved
+with MszAudio::GetSampleId() once.
+
+\return The sample ID, or -1 if there is no audio. */
+
+int Backend::GetSoundId( const char* a_pcSound )
+{
+	if ( NULL == Audio )
+	{
+		return -1;
+	}
+	if ( m_poSoundIdsAudio != Audio )
+	{
+		// The IDs of the previous audio object are not valid any more.
+		memset( m_aoSoundIds, 0, sizeof(m_aoSoundIds) );
+		m_poSoundIdsAudio = Audio;
+	}
+
+	unsigned int iHash = 2166136261u;		// FNV-1a
+	for ( const char* pc = a_pcSound; *pc; ++pc )
+	{
+		iHash = ( iHash ^ (unsigned char) *pc ) * 16777619u;
+	}
+
+	for ( int i=0; i<SOUNDIDCACHESIZE; ++i )
+	{
+		SSoundId& roSoundId = m_aoSoundIds[ ( iHash + i ) & ( SOUNDIDCACHESIZE - 1 ) ];
+		if ( 0 == roSoundId.m_acName[0] )
+		{
+			int iId = Audio->GetSampleId( a_pcSound );
+			if ( strlen( a_pcSound ) < sizeof(roSoundId.m_acName) )
+			{
+				strcpy( roSoundId.m_acName, a_pcSound );
+				roSoundId.m_iId = iId;
+			}
+			return iId;
+		}
+		if ( 0 == strcmp( roSoundId.m_acName, a_pcSound ) )
+		{
+			return roSoundId.m_iId;
+		}
+	}
+
+	// The table is full.
+	return Audio->GetSampleId( a_pcSound );
+}
+
+
 void Backend::PlaySounds()
 {
 	for ( int i=0; i<m_iNumSounds; ++i )
 	{
-		Audio->PlaySample( m_asSounds[i].c_str() );
+		Audio->PlaySample( m_aiSounds[i], m_dSoundsNs );
+	}
+}
+
+
+/** Loads every sound the given fighter can make, so that none of them
+has to be loaded from disk during the round. Their IDs are cached by
+GetSoundId() too, so the ticks only look them up. */
+void Backend::PreloadFighterSounds( FighterEnum a_enFighter )
+{
+	if ( NULL == Audio )
+	{
+		return;
+	}
+	
+	PerlEvalF( "GetFighterSounds(%d);", a_enFighter );
+	std::string sSounds = GetPerlString( "CppFighterSounds" );
+	
+	std::string::size_type iStart = 0;
+	while ( iStart < sSounds.size() )
+	{
+		std::string::size_type iEnd = sSounds.find( ' ', iStart );
+		if ( std::string::npos == iEnd )
+		{
+			iEnd = sSounds.size();
+		}
+		if ( iEnd > iStart )
+		{
+			std::string sSound = sSounds.substr( iStart, iEnd - iStart );
+			Audio->PreloadSample( GetSoundId( sSound.c_str() ) );
+		}
+		iStart = iEnd + 1;
 	}
 }
 
@@ -506,6 +723,7 @@ void Backend::ReadFromString( const char* a_pcBuffer )
 	}
 	
 	iTotal += iOffset;
+	m_dSoundsNs = GetNanoseconds();
 	
 	for ( i=0; i<m_iNumSounds; ++i )
 	{
@@ -513,6 +731,7 @@ void Backend::ReadFromString( const char* a_pcBuffer )
 			&j, &iOffset );
 		iTotal += iOffset;
 		m_asSounds[i].assign( a_pcBuffer + iTotal, j );
+		m_aiSounds[i] = GetSoundId( m_asSounds[i].c_str() );
 		iTotal += j;
 	}
 }
@@ -14,10 +14,12 @@
 #include "FighterEnum.h"
 
 class RlePack;
+class MszAudio;
 
 
 #define MAXDOODADS 20
 #define MAXSOUNDS 20
+#define SOUNDIDCACHESIZE 256		///< Must be a power of 2.
 
 
 /**
@@ -30,7 +32,8 @@ player information, doodads, current game state, and so forth. CBackend
 provides access for the frontend to the backend's variables and functions.
 Some of this is done via custom methods (such as GetNumberOfFighters()),
 but certain functions are only available via the "generic" perl interface,
-PerlEvalF().
+PerlEvalF(). PerlEvalF() compiles its code every time; the subs which are
+called in every game tick are called with PerlCall() instead.
 
 It is the CBackend's job to provide variables which describe the current
 \i scene to the frontend. The backend can
@@ -52,10 +55,13 @@ public:
 	Backend();
 	~Backend();
 	bool Construct();
+	void AttachThread();
 	
 	// Miscellaneous
 	
 	const char* PerlEvalF( const char* a_pcFormat, ... );
+	void PerlCall( const char* a_pcProc );
+	void PerlCall( const char* a_pcProc, int a_iArg1, int a_iArg2 );
 	const char* GetPerlString( const char* a_pcScalarName );
 	int GetPerlInt( const char* a_pcScalarName );
 
@@ -64,6 +70,8 @@ public:
 	int GetNumberOfFighters();
 	FighterEnum GetFighterID( int a_iIndex );
 	int GetNumberOfAvailableFighters();
+	int GetNumberOfFighterFiles();
+	void LoadFighterFile( int a_iIndex );
 	
 	// Game data
 	
@@ -71,10 +79,15 @@ public:
 	void ReadFromPerl();
 	bool IsDead( int a_iPlayer );
 	void PlaySounds();
+	void PreloadFighterSounds( FighterEnum a_enFighter );
+	int GetSoundId( const char* a_pcSound );
 	void WriteToString( std::string& a_rsOutString );
 	void ReadFromString( const std::string& a_rsString );
 	void ReadFromString( const char* a_pcBuffer );
 	
+	struct SPositions;
+	void SavePositions( SPositions& a_roOutPositions ) const;
+	
 	
 public:
 	int				m_iGameTick;
@@ -96,7 +109,29 @@ public:
 		std::string m_sText;
 	}				m_aoDoodads[ MAXDOODADS ];
 
+	/** The positions of the things on the scene, without the rest of the
+	data. The frontend keeps the positions of the previous tick in one, to
+	draw frames between two ticks. */
+	struct SPositions
+	{
+		int m_iBgX, m_iBgY;
+		int m_aiPlayerX[MAXPLAYERS], m_aiPlayerY[MAXPLAYERS];
+		int m_iNumDoodads;
+		int m_aiDoodadX[MAXDOODADS], m_aiDoodadY[MAXDOODADS], m_aiDoodadType[MAXDOODADS];
+	};
+
 	std::string		m_asSounds[ MAXSOUNDS ];
+	int				m_aiSounds[ MAXSOUNDS ];	///< The sample IDs of m_asSounds
+	double			m_dSoundsNs;				///< When the sounds were read (GetNanoseconds)
+
+protected:
+	/** A sound name resolved by GetSoundId(). An empty name is a free slot. */
+	struct SSoundId
+	{
+		char m_acName[32];
+		int m_iId;
+	}				m_aoSoundIds[ SOUNDIDCACHESIZE ];
+	MszAudio*		m_poSoundIdsAudio;			///< The IDs in m_aoSoundIds belong to this.
 };
 
 extern Backend g_oBackend;
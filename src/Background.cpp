@@ -12,8 +12,31 @@
 #include "sge_surface.h"
 #include "gfx.h"
 #include "common.h"
+#include "DataArchive.h"
+#include "WorkerPool.h"
 #include <string>
-#include <fstream>
+#include <sstream>
+
+
+class CLayerJob;
+
+
+/** Loads the layers of one background on the worker threads. See the end
+of this file. */
+
+class CBackgroundLoader
+{
+public:
+	CBackgroundLoader( int a_iBackgroundNumber );
+	~CBackgroundLoader();
+
+	int			GetNumber() const;
+	void		Finish( LayerVector& a_raoOutLayers );
+
+protected:
+	int			m_iNumber;
+	std::vector<CLayerJob*>	m_apoJobs;
+};
 
 
 
@@ -33,6 +56,9 @@ D = (BW - 640) / 1280
 
 
 
+CBackgroundLoader* Background::mg_poPrefetch = NULL;
+
+
 Background::Background()
 {
 	m_bOK = false;
@@ -68,61 +94,48 @@ void Background::Clear()
 
 void Background::Load( int a_iBackgroundNumber )
 {
-	char acFilename[FILENAME_MAX+1];
-
-	// 1. Try loading a description-based background.
-	sprintf( acFilename, "%s/gfx/level%d.desc", DATADIR, a_iBackgroundNumber );
-	std::ifstream oInput( acFilename );
-	if ( !oInput.is_open() )
+	CBackgroundLoader* poLoader = mg_poPrefetch;
+	if ( poLoader && poLoader->GetNumber() == a_iBackgroundNumber )
 	{
-		// Description-based background not found. Try simple image-based
-		// background.
-		sprintf( acFilename, "level%d.jpg", a_iBackgroundNumber );
-		SDL_Surface* poImage = LoadBackground( acFilename, 64 );
-		if ( NULL == poImage )
-		{
-			// Couldn't load background.
-			return;
-		}
-		
-		BackgroundLayer oLayer;
-		oLayer.m_poSurface = poImage;
-		oLayer.m_iXOffset = 0;
-		oLayer.m_iYOffset = 0;
-		oLayer.m_dDistance = 1.0;
-		m_aLayers.push_back( oLayer );
-		
-		m_iNumber = a_iBackgroundNumber;
-		m_iFirstExtraLayer = m_aLayers.size();
-		m_bOK = true;
-		return;
+		mg_poPrefetch = NULL;
 	}
-	
-	// 2. Parse description.
-
-	int iNumLayers;
-	oInput >> iNumLayers;
-
-	for ( int i=0; i<iNumLayers; ++i )
+	else
 	{
-		BackgroundLayer oLayer;
-		std::string sFilename;
-		oInput >> sFilename >> oLayer.m_iXOffset >> oLayer.m_iYOffset >> oLayer.m_dDistance;
-		
-		oLayer.m_poSurface = LoadBackground( sFilename.c_str(), 64, 0 );
-		if ( NULL == oLayer.m_poSurface )
-		{
-			continue;
-		}
-		m_aLayers.push_back( oLayer );
+		poLoader = new CBackgroundLoader( a_iBackgroundNumber );
 	}
 	
+	poLoader->Finish( m_aLayers );
+	delete poLoader;
+	
 	m_iFirstExtraLayer = m_aLayers.size();
 	m_bOK = m_aLayers.size() > 0;
 	m_iNumber = m_bOK ? a_iBackgroundNumber : 0;
 }
 
 
+/** Starts loading a background in the background. The layers are kept
+until Load() is called with the same number, or another background is
+prefetched. */
+
+void Background::Prefetch( int a_iBackgroundNumber )		// static
+{
+	if ( mg_poPrefetch && mg_poPrefetch->GetNumber() == a_iBackgroundNumber )
+	{
+		return;
+	}
+	
+	delete mg_poPrefetch;
+	mg_poPrefetch = new CBackgroundLoader( a_iBackgroundNumber );
+}
+
+
+void Background::DiscardPrefetch()		// static
+{
+	delete mg_poPrefetch;
+	mg_poPrefetch = NULL;
+}
+
+
 /** Adds a layer to the background.
 
 The background object will assume ownership of the given structure, including
@@ -165,3 +178,153 @@ void Background::Draw( int a_iXPosition, int a_iYPosition, int a_iYOffset )
 }
 
 
+
+/***************************************************************************
+                     BACKGROUND LOADER
+***************************************************************************/
+
+/** Decodes one layer on a worker thread. The layer is converted to the
+format of the screen too, unless the screen has a palette: that has to
+be set on the main thread. The format is copied when the job is made, as
+the video mode may change while the job runs. */
+
+class CLayerJob: public CJob
+{
+public:
+	CLayerJob( const BackgroundLayer& a_roLayer, const std::string& a_rsFilename )
+	{
+		m_oLayer = a_roLayer;
+		m_oLayer.m_poSurface = NULL;
+		m_sFilename = a_rsFilename;
+		m_poMask = NULL;
+		m_bConvert = NULL == gamescreen->format->palette;
+		m_oFormat = *gamescreen->format;
+		m_oFormat.palette = NULL;
+	}
+	
+	~CLayerJob()
+	{
+		if ( m_oLayer.m_poSurface ) SDL_FreeSurface( m_oLayer.m_poSurface );
+		if ( m_poMask ) SDL_FreeSurface( m_poMask );
+	}
+	
+	void Run()
+	{
+		m_oLayer.m_poSurface = DecodeBackground( m_sFilename.c_str(), &m_poMask );
+		if ( m_oLayer.m_poSurface && m_bConvert )
+		{
+			m_oLayer.m_poSurface = ConvertBackground( m_oLayer.m_poSurface, m_poMask, 64, 0, &m_oFormat );
+			m_poMask = NULL;
+		}
+	}
+	
+	BackgroundLayer	m_oLayer;
+	std::string		m_sFilename;
+	SDL_Surface*	m_poMask;
+	bool			m_bConvert;
+	SDL_PixelFormat	m_oFormat;		///< The screen's format when the job was made, without a palette.
+};
+
+
+/** Reads the description of a background, and queues its layers on
+g_oWorkerPool. */
+
+CBackgroundLoader::CBackgroundLoader( int a_iBackgroundNumber )
+{
+	m_iNumber = a_iBackgroundNumber;
+	
+	char acFilename[FILENAME_MAX+1];
+	BackgroundLayer oLayer;
+	oLayer.m_poSurface = NULL;
+	oLayer.m_iXOffset = 0;
+	oLayer.m_iYOffset = 0;
+	oLayer.m_dDistance = 1.0;
+
+	// 1. Try loading a description-based background.
+	sprintf( acFilename, "%s/gfx/level%d.desc", DATADIR, a_iBackgroundNumber );
+	std::string sDescription;
+	if ( !ReadDataFile( acFilename, sDescription ) )
+	{
+		// Description-based background not found. Try simple image-based
+		// background.
+		sprintf( acFilename, "level%d.jpg", a_iBackgroundNumber );
+		m_apoJobs.push_back( new CLayerJob( oLayer, acFilename ) );
+	}
+	else
+	{
+		// 2. Parse description.
+		
+		std::istringstream oInput( sDescription );
+		int iNumLayers = 0;
+		oInput >> iNumLayers;
+		
+		for ( int i=0; i<iNumLayers; ++i )
+		{
+			std::string sFilename;
+			oInput >> sFilename >> oLayer.m_iXOffset >> oLayer.m_iYOffset >> oLayer.m_dDistance;
+			m_apoJobs.push_back( new CLayerJob( oLayer, sFilename ) );
+		}
+	}
+	
+	for ( unsigned int i=0; i<m_apoJobs.size(); ++i )
+	{
+		g_oWorkerPool.Add( m_apoJobs[i] );
+	}
+}
+
+
+CBackgroundLoader::~CBackgroundLoader()
+{
+	for ( unsigned int i=0; i<m_apoJobs.size(); ++i )
+	{
+		g_oWorkerPool.Cancel( m_apoJobs[i] );
+		delete m_apoJobs[i];
+	}
+}
+
+
+int CBackgroundLoader::GetNumber() const
+{
+	return m_iNumber;
+}
+
+
+/** Waits for the layers, and moves the ones that could be loaded to the
+end of a_raoOutLayers, in the order of the description. */
+
+void CBackgroundLoader::Finish( LayerVector& a_raoOutLayers )
+{
+	for ( unsigned int i=0; i<m_apoJobs.size(); ++i )
+	{
+		CLayerJob* poJob = m_apoJobs[i];
+		g_oWorkerPool.Wait( poJob );
+		
+		BackgroundLayer oLayer = poJob->m_oLayer;
+		if ( NULL == oLayer.m_poSurface )
+		{
+			continue;
+		}
+		
+		if ( !poJob->m_bConvert )
+		{
+			oLayer.m_poSurface = ConvertBackground( oLayer.m_poSurface, poJob->m_poMask, 64, 0 );
+			poJob->m_poMask = NULL;
+		}
+		else if ( oLayer.m_poSurface->format->BitsPerPixel != gamescreen->format->BitsPerPixel
+			|| oLayer.m_poSurface->format->Rmask != gamescreen->format->Rmask
+			|| oLayer.m_poSurface->format->Gmask != gamescreen->format->Gmask
+			|| oLayer.m_poSurface->format->Bmask != gamescreen->format->Bmask )
+		{
+			// The video mode changed since the layer was prefetched.
+			SDL_Surface* poConverted = SDL_DisplayFormat( oLayer.m_poSurface );
+			SDL_FreeSurface( oLayer.m_poSurface );
+			oLayer.m_poSurface = poConverted;
+		}
+		poJob->m_oLayer.m_poSurface = NULL;
+		
+		if ( oLayer.m_poSurface )
+		{
+			a_raoOutLayers.push_back( oLayer );
+		}
+	}
+}
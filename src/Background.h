@@ -12,6 +12,7 @@
 
 #include <vector>
 struct SDL_Surface;
+class CBackgroundLoader;
 
 struct BackgroundLayer
 {
@@ -33,6 +34,10 @@ which has the following format:
 
 Extra layers can be added to the background. These are for dead fighters in
 team game mode.
+
+The layers are decoded and converted on the worker threads (g_oWorkerPool),
+in parallel. Prefetch() starts loading a background while something else is
+going on; a Load() of the same number later only waits for the rest.
 */
 
 class Background
@@ -43,6 +48,8 @@ public:
 
 	void		Clear();
 	void		Load( int a_iBackgroundNumber );
+	static void	Prefetch( int a_iBackgroundNumber );
+	static void	DiscardPrefetch();
 	void		AddExtraLayer( const BackgroundLayer& a_roLayer );
 	void		DeleteExtraLayers();
 
@@ -54,6 +61,8 @@ protected:
 	int			m_iFirstExtraLayer;
 	bool		m_bOK;
 	LayerVector	m_aLayers;
+
+	static CBackgroundLoader*	mg_poPrefetch;
 };
 
 #endif // __BACKGROUND_H
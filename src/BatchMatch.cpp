@@ -0,0 +1,507 @@
+/***************************************************************************
+                          BatchMatch.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+/**
+\file BatchMatch.cpp
+
+Headless simulation of whole matches, for load testing and for measuring
+the engine. The perl backend runs the rounds exactly as Game::DoOneRound
+does, but without video, audio or pacing: the ticks follow each other as
+fast as the CPU allows.
+
+The inputs of the players are either random, or read from a script in
+the input format of the replays ("K tick player key down" lines, see
+Game::SaveReplay()); the script is played again in every round.
+
+The matches are distributed among worker processes like the replays of
+DoReplayCheck(). Every match is seeded with the seed of the batch plus
+its number, so a match plays the same way no matter which worker runs it.
+*/
+
+#include "common.h"
+#include "Backend.h"
+#include "State.h"
+#include "AllocCounter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+
+#include <time.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+
+/***************************************************************************
+                     PRIVATE TYPES AND HELPERS
+***************************************************************************/
+
+
+/** One line of the input script. */
+struct SScriptedKey
+{
+	int		iTick;
+	int		iPlayer;
+	int		iKey;
+	int		iDown;
+};
+
+
+static bool operator<( const SScriptedKey& a_roFirst, const SScriptedKey& a_roSecond )
+{
+	return a_roFirst.iTick < a_roSecond.iTick;
+}
+
+
+/** The outcome of one match, as the workers report it. */
+struct SMatchResult
+{
+	int		aiFighters[2];
+	int		aiRoundsWon[2];
+	int		iWinner;			///< 0 or 1, -1 for a draw.
+	int		iTicks;
+	double	dSeconds;
+	long	iAllocations;		///< In the ticks, not counting GameStart().
+};
+
+
+static double GetWallSeconds()
+{
+#ifndef _WIN32
+	struct timeval oTime;
+	gettimeofday( &oTime, NULL );
+	return oTime.tv_sec + oTime.tv_usec / 1000000.0;
+#else
+	return clock() / (double) CLOCKS_PER_SEC;
+#endif
+}
+
+
+/** A small generator of our own, so that the matches do not depend on
+the rand() of the platform. */
+static int NextRandom( unsigned int& a_riSeed )
+{
+	a_riSeed = a_riSeed * 1103515245 + 12345;
+	return ( a_riSeed >> 16 ) & 0x7fff;
+}
+
+
+static bool LoadInputScript( const char* a_pcFilename, std::vector<SScriptedKey>& a_raoOutKeys )
+{
+	std::ifstream oInput( a_pcFilename );
+	if ( !oInput )
+	{
+		return false;
+	}
+
+	std::string sLine;
+	while ( std::getline( oInput, sLine ) )
+	{
+		SScriptedKey oKey;
+		if ( sLine.size() > 0 && 'K' == sLine[0]
+			&& 4 == sscanf( sLine.c_str()+1, "%d %d %d %d", &oKey.iTick, &oKey.iPlayer, &oKey.iKey, &oKey.iDown ) )
+		{
+			a_raoOutKeys.push_back( oKey );
+		}
+	}
+	std::stable_sort( a_raoOutKeys.begin(), a_raoOutKeys.end() );
+	return true;
+}
+
+
+/** Returns the IDs of the fighters whose data file is installed. */
+static std::vector<int> GetAvailableFighters()
+{
+	std::vector<int> aiFighters;
+	g_oBackend.PerlEvalF( "$::CppRetval = join(' ', sort { $a <=> $b } "
+		"grep { defined $::FighterStats{$_}{DATAFILE} } keys %%::FighterStats);" );
+	const char* pcFighters = g_oBackend.GetPerlString( "CppRetval" );
+
+	int iFighter, iOffset;
+	while ( 1 == sscanf( pcFighters, "%d%n", &iFighter, &iOffset ) )
+	{
+		aiFighters.push_back( iFighter );
+		pcFighters += iOffset;
+	}
+	return aiFighters;
+}
+
+
+static std::string GetFighterName( int a_iFighter )
+{
+	g_oBackend.PerlEvalF( "$::CppRetval = $::FighterStats{%d}{CODENAME} || '?';", a_iFighter );
+	return g_oBackend.GetPerlString( "CppRetval" );
+}
+
+
+
+/***************************************************************************
+                     SIMULATION
+***************************************************************************/
+
+
+/** Presses and releases random keys; each player holds at most one key
+at a time. */
+static void SendRandomKeys( int* a_piHeldKeys, unsigned int& a_riSeed )
+{
+	for ( int i=0; i<2; ++i )
+	{
+		if ( a_piHeldKeys[i] >= 0 )
+		{
+			if ( 0 == NextRandom( a_riSeed ) % 6 )
+			{
+				g_oBackend.PerlCall( "KeyUp", i, a_piHeldKeys[i] );
+				a_piHeldKeys[i] = -1;
+			}
+		}
+		else if ( 0 == NextRandom( a_riSeed ) % 4 )
+		{
+			a_piHeldKeys[i] = NextRandom( a_riSeed ) % 9;
+			g_oBackend.PerlCall( "KeyDown", i, a_piHeldKeys[i] );
+		}
+	}
+}
+
+
+/** Plays a round until the backend is over, the time is up, or 10 seconds
+after a KO, like Game::DoOneRound.
+
+\return 0 or 1 for the winner, -1 for a draw.
+*/
+static int SimulateRound( const std::vector<SScriptedKey>& a_raoScript,
+	unsigned int& a_riSeed, SMatchResult& a_roResult )
+{
+	g_oBackend.PerlEvalF( "GameStart(%d,%d,%d,%d,%d);", g_oState.m_iHitPoints, 2, 1, 0, 0 );
+	g_oBackend.ReadFromPerl();
+
+	int iGameSpeed = MAX( g_oState.m_iGameSpeed, 1 );
+	int iTimeUpTick = ( 2 + g_oState.m_iGameTime ) * 1000 / iGameSpeed;
+	int iKoLength = 10 * 1000 / iGameSpeed;
+	int iKoTick = -1;
+	int aiHeldKeys[2] = { -1, -1 };
+	unsigned int iNextKey = 0;
+
+	double dStart = GetWallSeconds();
+	long iAllocations = GetNumberOfAllocations();
+
+	for ( int iTick=0; ; ++iTick )
+	{
+		// The keys due now are sent before the tick, like Game::Advance;
+		// the tick of a recorded "K" line is the one before the advance.
+		if ( a_raoScript.size() )
+		{
+			while ( iNextKey < a_raoScript.size()
+				&& a_raoScript[iNextKey].iTick <= g_oBackend.m_iGameTick )
+			{
+				const SScriptedKey& roKey = a_raoScript[iNextKey++];
+				g_oBackend.PerlCall( roKey.iDown ? "KeyDown" : "KeyUp", roKey.iPlayer, roKey.iKey );
+			}
+		}
+		else
+		{
+			SendRandomKeys( aiHeldKeys, a_riSeed );
+		}
+
+		g_oBackend.AdvancePerl();
+		g_oBackend.ReadFromPerl();
+		++a_roResult.iTicks;
+
+		if ( g_oBackend.m_iGameOver )
+		{
+			break;
+		}
+		if ( iKoTick < 0 )
+		{
+			if ( g_oBackend.m_bKO )
+			{
+				iKoTick = iTick;
+			}
+			else if ( iTick >= iTimeUpTick )
+			{
+				break;
+			}
+		}
+		else if ( iTick - iKoTick >= iKoLength )
+		{
+			break;
+		}
+	}
+
+	a_roResult.iAllocations += GetNumberOfAllocations() - iAllocations;
+	a_roResult.dSeconds += GetWallSeconds() - dStart;
+
+	int p1h = g_oBackend.m_aoPlayers[0].m_iRealHitPoints;
+	int p2h = g_oBackend.m_aoPlayers[1].m_iRealHitPoints;
+	return p1h > p2h ? 0 : ( p2h > p1h ? 1 : -1 );
+}
+
+
+/** Plays a match of at most three rounds, like Game::Run. */
+static void SimulateMatch( int a_iFighter1, int a_iFighter2,
+	const std::vector<SScriptedKey>& a_raoScript, unsigned int a_iSeed, SMatchResult& a_roResult )
+{
+	a_roResult.aiFighters[0] = a_iFighter1;
+	a_roResult.aiFighters[1] = a_iFighter2;
+	a_roResult.aiRoundsWon[0] = a_roResult.aiRoundsWon[1] = 0;
+	a_roResult.iWinner = -1;
+	a_roResult.iTicks = 0;
+	a_roResult.dSeconds = 0.0;
+	a_roResult.iAllocations = 0;
+
+	g_oState.m_iNumPlayers = 2;
+	g_oBackend.PerlEvalF( "srand(%u);", a_iSeed );
+	g_oBackend.PerlEvalF( "SelectStart(%d);", 2 );
+	g_oBackend.PerlEvalF( "SetPlayerNumber(%d,%d);", 0, a_iFighter1 );
+	g_oBackend.PerlEvalF( "SetPlayerNumber(%d,%d);", 1, a_iFighter2 );
+
+	for ( int iRound=0; iRound<3; ++iRound )
+	{
+		int iWinner = SimulateRound( a_raoScript, a_iSeed, a_roResult );
+		if ( iWinner >= 0 && ++a_roResult.aiRoundsWon[iWinner] >= 2 )
+		{
+			a_roResult.iWinner = iWinner;
+			break;
+		}
+	}
+}
+
+
+/** Plays every a_iNumJobs'th match starting from a_iFirst, and writes one
+line per match to a_poOutput:
+"index fighter1 fighter2 won1 won2 winner ticks seconds allocations". */
+static void SimulateMatches( int a_iNumMatches, int a_iFirst, int a_iNumJobs,
+	const int* a_piFighters, const std::vector<int>& a_raiAvailable,
+	const std::vector<SScriptedKey>& a_raoScript, unsigned int a_iSeed, FILE* a_poOutput )
+{
+	for ( int i=a_iFirst; i<a_iNumMatches; i += a_iNumJobs )
+	{
+		unsigned int iSeed = a_iSeed + i;
+		int aiFighters[2];
+		for ( int j=0; j<2; ++j )
+		{
+			aiFighters[j] = a_piFighters[j] > 0 ? a_piFighters[j]
+				: a_raiAvailable[ NextRandom( iSeed ) % a_raiAvailable.size() ];
+		}
+
+		SMatchResult oResult;
+		SimulateMatch( aiFighters[0], aiFighters[1], a_raoScript, iSeed, oResult );
+
+		fprintf( a_poOutput, "%d %d %d %d %d %d %d %f %ld\n", i,
+			oResult.aiFighters[0], oResult.aiFighters[1],
+			oResult.aiRoundsWon[0], oResult.aiRoundsWon[1], oResult.iWinner,
+			oResult.iTicks, oResult.dSeconds, oResult.iAllocations );
+		fflush( a_poOutput );
+	}
+}
+
+
+
+/***************************************************************************
+                     PUBLIC FUNCTIONS
+***************************************************************************/
+
+
+/** Plays a batch of matches without video and audio, as fast as possible.
+
+The result of every match is printed to stdout, followed by the number of
+wins of each player and the simulation throughput.
+
+\param a_iNumMatches The number of matches to play.
+\param a_pcFighters "id1,id2", the fighters of the two players; NULL or 0
+	for a random installed fighter in every match.
+\param a_pcInputScript The file with the inputs, NULL for random inputs.
+\param a_iSeed The seed of the first match.
+\param a_iNumJobs The number of worker processes to use.
+\param a_dMaxAllocationsPerTick If the ticks allocate more than this on
+	average, the batch fails; 0 for no limit.
+\return 0 if the batch was played, 1 on errors or if there were too many
+	allocations.
+*/
+int DoBatchMatches( int a_iNumMatches, const char* a_pcFighters, const char* a_pcInputScript,
+	unsigned int a_iSeed, int a_iNumJobs, double a_dMaxAllocationsPerTick )
+{
+	// 1. Read the parameters.
+
+	int aiFighters[2] = { 0, 0 };
+	if ( a_pcFighters && 2 != sscanf( a_pcFighters, "%d,%d", &aiFighters[0], &aiFighters[1] ) )
+	{
+		fprintf( stderr, "The fighters should be given as id1,id2\n" );
+		return 1;
+	}
+
+	std::vector<SScriptedKey> aoScript;
+	if ( a_pcInputScript && !LoadInputScript( a_pcInputScript, aoScript ) )
+	{
+		fprintf( stderr, "Can't read the input script %s\n", a_pcInputScript );
+		return 1;
+	}
+
+	if ( a_iNumMatches < 1 ) a_iNumMatches = 1;
+	if ( a_iNumJobs < 1 ) a_iNumJobs = 1;
+	if ( a_iNumJobs > a_iNumMatches ) a_iNumJobs = a_iNumMatches;
+
+	// 2. Load every fighter before forking, so the workers share the work.
+
+	int iNumFighterFiles = g_oBackend.GetNumberOfFighterFiles();
+	for ( int i=0; i<iNumFighterFiles; ++i )
+	{
+		g_oBackend.LoadFighterFile( i );
+	}
+
+	std::vector<int> aiAvailable = GetAvailableFighters();
+	if ( aiAvailable.size() == 0 )
+	{
+		fprintf( stderr, "No fighters are installed.\n" );
+		return 1;
+	}
+
+	// 3. Run the workers, each reporting to a temporary file. The files are
+	// made first, so nothing runs if one can't be made.
+
+#ifdef _WIN32
+	a_iNumJobs = 1;
+#endif
+
+	std::vector<FILE*> apoReports;
+	int i;
+
+	for ( i=0; i<a_iNumJobs; ++i )
+	{
+		FILE* poReport = tmpfile();
+		if ( NULL == poReport )
+		{
+			perror( "Can't create a temporary file for the results" );
+			for ( unsigned int j=0; j<apoReports.size(); ++j )
+			{
+				fclose( apoReports[j] );
+			}
+			return 1;
+		}
+		apoReports.push_back( poReport );
+	}
+
+	double dStart = GetWallSeconds();
+
+#ifndef _WIN32
+	std::vector<pid_t> aiWorkers;
+	fflush( stdout );
+	fflush( stderr );
+
+	for ( i=0; i<a_iNumJobs; ++i )
+	{
+		pid_t iPid = fork();
+		if ( 0 == iPid )
+		{
+			SimulateMatches( a_iNumMatches, i, a_iNumJobs, aiFighters, aiAvailable, aoScript, a_iSeed, apoReports[i] );
+			_exit( 0 );
+		}
+		if ( iPid < 0 )
+		{
+			// Can't fork; do this share of the work here.
+			SimulateMatches( a_iNumMatches, i, a_iNumJobs, aiFighters, aiAvailable, aoScript, a_iSeed, apoReports[i] );
+		}
+		aiWorkers.push_back( iPid );
+	}
+
+	for ( i=0; i<a_iNumJobs; ++i )
+	{
+		int iStatus;
+		if ( aiWorkers[i] > 0 )
+		{
+			waitpid( aiWorkers[i], &iStatus, 0 );
+		}
+	}
+#else
+	SimulateMatches( a_iNumMatches, 0, 1, aiFighters, aiAvailable, aoScript, a_iSeed, apoReports[0] );
+#endif
+
+	double dSeconds = GetWallSeconds() - dStart;
+
+	// 4. Collect the results in the order of the matches.
+
+	std::vector<SMatchResult> aoResults( a_iNumMatches );
+	std::vector<bool> abDone( a_iNumMatches, false );
+
+	for ( i=0; i<(int)apoReports.size(); ++i )
+	{
+		rewind( apoReports[i] );
+
+		char acLine[256];
+		while ( fgets( acLine, sizeof(acLine), apoReports[i] ) )
+		{
+			int iIndex;
+			SMatchResult oResult;
+			if ( 9 != sscanf( acLine, "%d %d %d %d %d %d %d %lf %ld", &iIndex,
+					&oResult.aiFighters[0], &oResult.aiFighters[1],
+					&oResult.aiRoundsWon[0], &oResult.aiRoundsWon[1], &oResult.iWinner,
+					&oResult.iTicks, &oResult.dSeconds, &oResult.iAllocations )
+				|| iIndex < 0 || iIndex >= a_iNumMatches )
+			{
+				continue;
+			}
+			aoResults[iIndex] = oResult;
+			abDone[iIndex] = true;
+		}
+		fclose( apoReports[i] );
+	}
+
+	// 5. Print them.
+
+	int aiWins[3] = { 0, 0, 0 };		// Player 1, player 2, draws
+	int iTotalTicks = 0;
+	long iTotalAllocations = 0;
+	int iNumFailed = 0;
+
+	for ( i=0; i<a_iNumMatches; ++i )
+	{
+		if ( !abDone[i] )
+		{
+			printf( "Match %d: the worker process died\n", i+1 );
+			++iNumFailed;
+			continue;
+		}
+
+		const SMatchResult& roResult = aoResults[i];
+		++aiWins[ roResult.iWinner >= 0 ? roResult.iWinner : 2 ];
+		iTotalTicks += roResult.iTicks;
+		iTotalAllocations += roResult.iAllocations;
+
+		printf( "Match %d: %s vs %s  %d-%d  %s  %d ticks",
+			i+1, GetFighterName( roResult.aiFighters[0] ).c_str(), GetFighterName( roResult.aiFighters[1] ).c_str(),
+			roResult.aiRoundsWon[0], roResult.aiRoundsWon[1],
+			roResult.iWinner < 0 ? "draw" : ( 0 == roResult.iWinner ? "player 1 won" : "player 2 won" ),
+			roResult.iTicks );
+		if ( roResult.dSeconds > 0 )
+		{
+			printf( ", %.0f ticks/s", roResult.iTicks / roResult.dSeconds );
+		}
+		printf( "\n" );
+	}
+
+	double dAllocationsPerTick = iTotalTicks > 0 ? (double) iTotalAllocations / iTotalTicks : 0.0;
+
+	printf( "\n%d matches (seed %u, %s inputs): player 1 won %d, player 2 won %d, %d draws.\n",
+		a_iNumMatches, a_iSeed, aoScript.size() ? "scripted" : "random", aiWins[0], aiWins[1], aiWins[2] );
+	printf( "%d ticks in %.2f s with %d workers (%.0f ticks/s), %.2f allocations per tick.\n",
+		iTotalTicks, dSeconds, a_iNumJobs, dSeconds > 0 ? iTotalTicks / dSeconds : 0.0, dAllocationsPerTick );
+
+	if ( a_dMaxAllocationsPerTick > 0 && dAllocationsPerTick > a_dMaxAllocationsPerTick )
+	{
+		printf( "FAIL: more than %.2f allocations per tick.\n", a_dMaxAllocationsPerTick );
+		return 1;
+	}
+	return iNumFailed ? 1 : 0;
+}
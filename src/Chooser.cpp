@@ -16,6 +16,8 @@
 #include "SDL_image.h"
 #include "gfx.h"
 #include "common.h"
+#include "DataArchive.h"
+#include "PortraitAtlas.h"
 #include "sge_primitives.h"
 
 
@@ -71,6 +73,10 @@ void CChooser::Init()
 	char pcFilename[FILENAME_MAX+1];
 	const char* s;
 	int i;
+
+	// The portraits are taken from the atlas if possible.
+
+	m_oAtlas.Load( DATADIR "/" PORTRAITATLAS_NAME );
 	
 	for ( i=0; i<m_iNumberOfFighters; ++i )
 	{
@@ -83,12 +89,30 @@ void CChooser::Init()
 		g_oBackend.PerlEvalF( "GetFighterStats(%d);", enFighter );
 		s = g_oBackend.GetPerlString( "Portrait" );
 		
+		m_apoPortraits[i] = m_oAtlas.Find( s, m_aoPortraitRects[i] );
+		if ( m_apoPortraits[i] )
+		{
+			continue;
+		}
+
+		// Not in the atlas; load it by itself.
 		strcpy( pcFilename, DATADIR );
 		strcat( pcFilename, "/characters/" );
 		strcat( pcFilename, s );
 		
-		m_apoPortraits[i] = IMG_Load( pcFilename );
-		if ( m_apoPortraits[i] ) SDL_SetColorKey( m_apoPortraits[i], 0, 0 );
+		SDL_Surface* poPortrait = LoadDataImage( pcFilename );
+		if ( poPortrait )
+		{
+			SDL_SetColorKey( poPortrait, 0, 0 );
+			m_apoPortraits[i] = CPortraitAtlas::ConvertSheet( poPortrait );
+			SDL_FreeSurface( poPortrait );
+		}
+		if ( m_apoPortraits[i] )
+		{
+			m_aoPortraitRects[i].x = m_aoPortraitRects[i].y = 0;
+			m_aoPortraitRects[i].w = m_apoPortraits[i]->w;
+			m_aoPortraitRects[i].h = m_apoPortraits[i]->h;
+		}
 	}
 	for ( i=m_iNumberOfFighters; i<100; ++i )
 	{
@@ -128,15 +152,10 @@ void CChooser::Draw()
 		// Calculate the bounding rectangle of the character portrait
 		
 		SDL_Rect oDst = GetRect(i);
-		SDL_Rect oSrc;
-		oSrc.x = (m_apoPortraits[i]->w - oDst.w) / 2;
-		oSrc.y = (m_apoPortraits[i]->h - oDst.h) / 2;
-		oSrc.w = oDst.w;
-		oSrc.h = oDst.h;
 
 		Uint32 iBgColor = m_aenFighters[i] < 100 ? C_YELLOW: C_LIGHTBLUE;
 		sge_FilledRectAlpha( m_poScreen, oDst.x, oDst.y, oDst.x+oDst.w, oDst.y+oDst.h, iBgColor, 64 );
-		SDL_BlitSurface( m_apoPortraits[i], &oSrc, m_poScreen, &oDst );
+		BlitPortrait( i, m_poScreen, oDst );
 		DrawRectangle( i, C_BLACK );
 	}
 }
@@ -213,14 +232,19 @@ void CChooser::MarkFighter( FighterEnum a_enFighter, Uint32 a_iColor )
 
 
 
-SDL_Surface* CChooser::GetPortrait( FighterEnum a_enFighter )
+/** Returns the surface which has the portrait of the fighter (usually a
+sheet of the portrait atlas), and the place of the portrait on it in
+a_roOutRect. Returns NULL if the fighter has no portrait. */
+
+SDL_Surface* CChooser::GetPortrait( FighterEnum a_enFighter, SDL_Rect& a_roOutRect )
 {
 	Init();
 
 	for ( int i=0; i<m_iNumberOfFighters; ++i )
 	{
-		if ( m_aenFighters[i] == a_enFighter )
+		if ( m_aenFighters[i] == a_enFighter && m_apoPortraits[i] )
 		{
+			a_roOutRect = m_aoPortraitRects[i];
 			return m_apoPortraits[i];
 		}
 	}
@@ -231,21 +255,39 @@ SDL_Surface* CChooser::GetPortrait( FighterEnum a_enFighter )
 
 void CChooser::DrawPortrait( FighterEnum a_enFighter, SDL_Surface* a_poScreen, const SDL_Rect& a_roRect )
 {
-	SDL_Surface* poPortrait = GetPortrait( a_enFighter );
+	Init();
 
-	if ( NULL == poPortrait )
+	for ( int i=0; i<m_iNumberOfFighters; ++i )
 	{
-		return ;
+		if ( m_aenFighters[i] == a_enFighter && m_apoPortraits[i] )
+		{
+			BlitPortrait( i, a_poScreen, a_roRect );
+			return;
+		}
 	}
+}
+
 
-	SDL_Rect oDst = a_roRect;
-	SDL_Rect oSrc;
-	oSrc.x = (poPortrait->w - oDst.w) / 2;
-	oSrc.y = (poPortrait->h - oDst.h) / 2;
-	oSrc.w = oDst.w;
-	oSrc.h = oDst.h;
 
-	SDL_BlitSurface( poPortrait, &oSrc, a_poScreen, &oDst );
+/** Draws the middle of portrait #a_iIndex into a_roDst, or the whole
+portrait centered in a_roDst if the rectangle is larger than it. */
+
+void CChooser::BlitPortrait( int a_iIndex, SDL_Surface* a_poScreen, const SDL_Rect& a_roDst )
+{
+	const SDL_Rect& roPortrait = m_aoPortraitRects[a_iIndex];
+	SDL_Rect oDst = a_roDst;
+	SDL_Rect oSrc = roPortrait;
+
+	// Crop the portrait to the sheet, like SDL_BlitSurface would crop it
+	// to its own surface.
+	int iMargin = roPortrait.w - a_roDst.w;
+	if ( iMargin >= 0 ) { oSrc.x += iMargin / 2; oSrc.w = a_roDst.w; }
+	else { oDst.x -= iMargin / 2; }
+	iMargin = roPortrait.h - a_roDst.h;
+	if ( iMargin >= 0 ) { oSrc.y += iMargin / 2; oSrc.h = a_roDst.h; }
+	else { oDst.y -= iMargin / 2; }
+
+	SDL_BlitSurface( m_apoPortraits[a_iIndex], &oSrc, a_poScreen, &oDst );
 }
 
 
@@ -256,11 +298,13 @@ FighterEnum CChooser::GetCurrentFighter( int a_iPlayer )
 }
 
 
-void CChooser::MoveRectangle( int a_iPlayer, int a_iDirection )
-{
-	int& riPlayerPosition = m_aiPlayerPosition[ a_iPlayer ];
+/** Returns the position next to the given one in the given direction
+(Mk_UP, Mk_DOWN, Mk_LEFT or Mk_RIGHT), or the same position at the edge
+of the chooser. */
 
-	int iNew = riPlayerPosition;
+int CChooser::MovePosition( int a_iPosition, int a_iDirection )
+{
+	int iNew = a_iPosition;
 
 	switch ( a_iDirection )
 	{
@@ -269,6 +313,31 @@ void CChooser::MoveRectangle( int a_iPlayer, int a_iDirection )
 	case Mk_LEFT:	if ( iNew % m_iCols > 0 ) --iNew; break;
 	case Mk_RIGHT:	if ( iNew % m_iCols < m_iCols-1 ) ++iNew; break;
 	}
+
+	return iNew;
+}
+
+
+/** Returns the fighter the cursor would move to from a_enFighter in the
+given direction. Used for loading the fighters before they are needed. */
+
+FighterEnum CChooser::GetNeighbor( FighterEnum a_enFighter, int a_iDirection )
+{
+	int iPosition = FighterToPosition( a_enFighter );
+	if ( PositionToFighter( iPosition ) != a_enFighter )
+	{
+		return UNKNOWN;
+	}
+	int iNew = MovePosition( iPosition, a_iDirection );
+	return iNew == iPosition ? UNKNOWN : PositionToFighter( iNew );
+}
+
+
+void CChooser::MoveRectangle( int a_iPlayer, int a_iDirection )
+{
+	int& riPlayerPosition = m_aiPlayerPosition[ a_iPlayer ];
+
+	int iNew = MovePosition( riPlayerPosition, a_iDirection );
 	
 	if ( iNew != riPlayerPosition )
 	{
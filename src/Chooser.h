@@ -14,6 +14,7 @@
 
 #include "FighterEnum.h"
 #include "common.h"
+#include "PortraitAtlas.h"
 #include "SDL.h"
 
 /**
@@ -28,18 +29,20 @@ public:
 	CChooser();
 	~CChooser();
 	
+	void			Init();
 	void			Start( SDL_Surface* m_poScreen );
 	void			Stop();
 
 	void			Resize( int x1, int y1, int x2, int y2 );
 	void			Draw();
 	void			MarkFighter( FighterEnum a_enFighter, Uint32 a_iColor );
-	SDL_Surface*	GetPortrait( FighterEnum a_enFighter );
+	SDL_Surface*	GetPortrait( FighterEnum a_enFighter, SDL_Rect& a_roOutRect );
 	void			DrawPortrait( FighterEnum a_enFighter, SDL_Surface* a_poScreen, const SDL_Rect& a_roRect );
 	
 	FighterEnum		GetCurrentFighter( int a_iPlayer );
 	
 	void			MoveRectangle( int a_iPlayer, int a_iDirection );
+	FighterEnum		GetNeighbor( FighterEnum a_enFighter, int a_iDirection );
 	void			SetRectangle( int a_iPlayer, FighterEnum a_enFighter );
 	void			SetRectangleVisible( int a_iPlayer, bool a_bVisible );
 	bool			IsRectangleVisible( int a_iPlayer );
@@ -47,10 +50,11 @@ public:
 	SDL_Rect		GetFighterRect( FighterEnum a_enFighter );
 
 protected:
-	void			Init();
 	int				FighterToPosition( FighterEnum a_enFighter );
+	int				MovePosition( int a_iPosition, int a_iDirection );
 	FighterEnum		PositionToFighter( int a_iPosition );
 	SDL_Rect		GetRect( int a_iPosition );
+	void			BlitPortrait( int a_iIndex, SDL_Surface* a_poScreen, const SDL_Rect& a_roDst );
 
 	void			ClearRectangle( int a_iPlayer );
 	void			DrawRectangle( int a_iPlayer );
@@ -59,7 +63,9 @@ protected:
 protected:
 	SDL_Surface*	m_poScreen;
 	FighterEnum		m_aenFighters[100];
-	SDL_Surface*	m_apoPortraits[100];
+	SDL_Surface*	m_apoPortraits[100];	///< A sheet of m_oAtlas, or a portrait loaded by itself.
+	SDL_Rect		m_aoPortraitRects[100];	///< The place of each portrait on its surface.
+	CPortraitAtlas	m_oAtlas;
 	bool			m_abRectangleVisible[MAXPLAYERS];
 	int				m_aiPlayerPosition[MAXPLAYERS];
 	Uint32			m_aiColors[MAXPLAYERS];
@@ -0,0 +1,484 @@
+/***************************************************************************
+                          DataArchive.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "config.h"
+#include "DataArchive.h"
+#include "common.h"
+
+#include "SDL.h"
+#include "SDL_image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
+
+CDataArchive g_oDataArchive;
+
+
+static inline Uint32 ReadUint32( const unsigned char* a_pcData )
+{
+	return a_pcData[0] | ( a_pcData[1] << 8 ) | ( a_pcData[2] << 16 ) | ( (Uint32) a_pcData[3] << 24 );
+}
+
+
+
+/*************************************************************************
+                           DATA ARCHIVE
+*************************************************************************/
+
+
+CDataArchive::CDataArchive()
+{
+	m_pcData = NULL;
+	m_iSize = 0;
+	m_iNumEntries = 0;
+	m_pcIndex = NULL;
+	m_iTime = 0;
+	m_poLock = SDL_CreateMutex();
+}
+
+
+CDataArchive::~CDataArchive()
+{
+	Close();
+	SDL_DestroyMutex( m_poLock );
+}
+
+
+/** Maps the archive into memory and checks its index. Returns false if
+the archive doesn't exist or is not valid; the game uses the loose files
+then. */
+
+bool CDataArchive::Open( const char* a_pcFilename )
+{
+	Close();
+
+	struct stat oArchiveStat;
+	if ( stat( a_pcFilename, &oArchiveStat ) < 0 )
+	{
+		return false;
+	}
+	m_iTime = oArchiveStat.st_mtime;
+
+#ifndef _WIN32
+	int iFile = open( a_pcFilename, O_RDONLY );
+	if ( iFile < 0 )
+	{
+		return false;
+	}
+	struct stat oStat;
+	if ( fstat( iFile, &oStat ) < 0 || oStat.st_size < DATAARCHIVE_HEADERSIZE )
+	{
+		close( iFile );
+		return false;
+	}
+	void* pvData = mmap( NULL, oStat.st_size, PROT_READ, MAP_SHARED, iFile, 0 );
+	close( iFile );
+	if ( MAP_FAILED == pvData )
+	{
+		debug( "Can't map %s.\n", a_pcFilename );
+		return false;
+	}
+	m_pcData = (const char*) pvData;
+	m_iSize = oStat.st_size;
+#else
+	// No mmap; read the whole archive instead.
+	FILE* poFile = fopen( a_pcFilename, "rb" );
+	if ( NULL == poFile )
+	{
+		return false;
+	}
+	fseek( poFile, 0, SEEK_END );
+	long iSize = ftell( poFile );
+	fseek( poFile, 0, SEEK_SET );
+	char* pcData = iSize >= DATAARCHIVE_HEADERSIZE ? (char*) malloc( iSize ) : NULL;
+	if ( NULL == pcData || (long) fread( pcData, 1, iSize, poFile ) != iSize )
+	{
+		free( pcData );
+		fclose( poFile );
+		return false;
+	}
+	fclose( poFile );
+	m_pcData = pcData;
+	m_iSize = iSize;
+#endif
+
+	const unsigned char* pcHeader = (const unsigned char*) m_pcData;
+	int iNumEntries = ReadUint32( pcHeader + 8 );
+	if ( 0 != memcmp( pcHeader, "OMDA", 4 )
+		|| DATAARCHIVE_VERSION != ReadUint32( pcHeader + 4 )
+		|| iNumEntries < 0
+		|| iNumEntries > ( m_iSize - DATAARCHIVE_HEADERSIZE ) / DATAARCHIVE_ENTRYSIZE )
+	{
+		debug( "%s is not a valid data archive.\n", a_pcFilename );
+		Close();
+		return false;
+	}
+
+	// Validate the index once, so that Find() doesn't have to.
+
+	m_pcIndex = pcHeader + DATAARCHIVE_HEADERSIZE;
+	for ( int i=0; i<iNumEntries; ++i )
+	{
+		const unsigned char* pcEntry = m_pcIndex + i * DATAARCHIVE_ENTRYSIZE;
+		Uint32 iNameOffset = ReadUint32( pcEntry );
+		Uint32 iNameLength = ReadUint32( pcEntry + 4 );
+		Uint32 iDataOffset = ReadUint32( pcEntry + 8 );
+		Uint32 iStoredSize = ReadUint32( pcEntry + 12 );
+		if ( iNameOffset > (Uint32) m_iSize || iNameLength >= (Uint32) m_iSize - iNameOffset
+			|| iDataOffset > (Uint32) m_iSize || iStoredSize > (Uint32) m_iSize - iDataOffset
+			|| 0 != m_pcData[ iNameOffset + iNameLength ]
+			|| ReadUint32( pcEntry + 16 ) > 0x7fffffff )
+		{
+			debug( "%s: entry %d is corrupt.\n", a_pcFilename, i );
+			Close();
+			return false;
+		}
+	}
+
+	m_iNumEntries = iNumEntries;
+	debug( "Data archive %s: %d files, %d bytes.\n", a_pcFilename, m_iNumEntries, m_iSize );
+	return true;
+}
+
+
+void CDataArchive::Close()
+{
+	SDL_mutexP( m_poLock );
+	for ( std::map<std::string,char*>::iterator it = m_oUnpacked.begin(); it != m_oUnpacked.end(); ++it )
+	{
+		free( it->second );
+	}
+	m_oUnpacked.clear();
+	SDL_mutexV( m_poLock );
+
+	if ( m_pcData )
+	{
+#ifndef _WIN32
+		munmap( (void*) m_pcData, m_iSize );
+#else
+		free( (void*) m_pcData );
+#endif
+	}
+	m_pcData = NULL;
+	m_iSize = 0;
+	m_iNumEntries = 0;
+	m_pcIndex = NULL;
+}
+
+
+bool CDataArchive::IsOpen() const
+{
+	return NULL != m_pcData;
+}
+
+
+int CDataArchive::GetNumberOfEntries() const
+{
+	return m_iNumEntries;
+}
+
+
+/** Looks up an entry by its name relative to DATADIR. The returned data
+points into the archive; it is compressed if the flags say so. Entries
+whose loose file is newer than the archive are not found. */
+
+bool CDataArchive::Find( const char* a_pcName, const char*& a_rpcOutData,
+	int& a_riOutStoredSize, int& a_riOutSize, int& a_riOutFlags ) const
+{
+	int iLow = 0;
+	int iHigh = m_iNumEntries - 1;
+
+	while ( iLow <= iHigh )
+	{
+		int iMiddle = ( iLow + iHigh ) / 2;
+		const unsigned char* pcEntry = m_pcIndex + iMiddle * DATAARCHIVE_ENTRYSIZE;
+		int iCompare = strcmp( a_pcName, m_pcData + ReadUint32( pcEntry ) );
+
+		if ( iCompare < 0 )
+		{
+			iHigh = iMiddle - 1;
+		}
+		else if ( iCompare > 0 )
+		{
+			iLow = iMiddle + 1;
+		}
+		else if ( IsLooseFileNewer( a_pcName ) )
+		{
+			return false;
+		}
+		else
+		{
+			a_rpcOutData = m_pcData + ReadUint32( pcEntry + 8 );
+			a_riOutStoredSize = ReadUint32( pcEntry + 12 );
+			a_riOutSize = ReadUint32( pcEntry + 16 );
+			a_riOutFlags = ReadUint32( pcEntry + 20 );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/** Returns the uncompressed data of an entry which stays valid until the
+archive is closed. This is for the loaders that keep reading the file
+after it was opened (fonts). Compressed entries are decompressed once and
+kept; the startup workers and the main thread may ask at the same time.
+Returns NULL if the entry is not in the archive. */
+
+const char* CDataArchive::GetPersistentData( const char* a_pcName, int& a_riOutSize )
+{
+	const char* pcData;
+	int iStoredSize, iFlags;
+	if ( !Find( a_pcName, pcData, iStoredSize, a_riOutSize, iFlags ) )
+	{
+		return NULL;
+	}
+	if ( 0 == ( iFlags & DATAARCHIVE_LZ4 ) )
+	{
+		return pcData;
+	}
+
+	SDL_mutexP( m_poLock );
+	std::map<std::string,char*>::iterator it = m_oUnpacked.find( a_pcName );
+	char* pcBuffer = NULL;
+	if ( it != m_oUnpacked.end() )
+	{
+		pcBuffer = it->second;
+	}
+	else
+	{
+		pcBuffer = (char*) malloc( a_riOutSize + 1 );
+		if ( NULL == pcBuffer || !LZ4Decompress( pcData, iStoredSize, pcBuffer, a_riOutSize ) )
+		{
+			free( pcBuffer );
+			pcBuffer = NULL;
+		}
+		else
+		{
+			m_oUnpacked[ a_pcName ] = pcBuffer;
+		}
+	}
+	SDL_mutexV( m_poLock );
+	return pcBuffer;
+}
+
+
+/** Returns true if the loose file of the entry was modified after the
+archive was built. */
+
+bool CDataArchive::IsLooseFileNewer( const char* a_pcName ) const
+{
+	char acPath[FILENAME_MAX+1];
+	if ( strlen( DATADIR ) + strlen( a_pcName ) + 1 > FILENAME_MAX )
+	{
+		return false;
+	}
+	sprintf( acPath, "%s/%s", DATADIR, a_pcName );
+
+	struct stat oStat;
+	if ( stat( acPath, &oStat ) < 0 || oStat.st_mtime <= m_iTime )
+	{
+		return false;
+	}
+	debug( "%s is newer than the data archive; rebuild it with mortalpack.\n", acPath );
+	return true;
+}
+
+
+/** Returns the path relative to DATADIR, which is the name of the entry
+in the archive. Paths outside of DATADIR are returned as they are, and
+won't be found. */
+
+const char* CDataArchive::GetRelativePath( const char* a_pcPath )
+{
+	const int iLength = sizeof(DATADIR) - 1;
+	if ( 0 == strncmp( a_pcPath, DATADIR, iLength ) && '/' == a_pcPath[iLength] )
+	{
+		a_pcPath += iLength + 1;
+	}
+	while ( '.' == a_pcPath[0] && '/' == a_pcPath[1] )
+	{
+		a_pcPath += 2;
+	}
+	return a_pcPath;
+}
+
+
+
+/*************************************************************************
+                           DATA FILE
+*************************************************************************/
+
+
+CDataFile::CDataFile()
+{
+	m_pcData = NULL;
+	m_iSize = 0;
+	m_pcBuffer = NULL;
+}
+
+
+CDataFile::~CDataFile()
+{
+	Close();
+}
+
+
+bool CDataFile::Open( const char* a_pcPath )
+{
+	Close();
+
+	// 1. TRY THE ARCHIVE
+
+	const char* pcData;
+	int iStoredSize, iSize, iFlags;
+	if ( g_oDataArchive.IsOpen()
+		&& g_oDataArchive.Find( CDataArchive::GetRelativePath( a_pcPath ), pcData, iStoredSize, iSize, iFlags ) )
+	{
+		if ( 0 == ( iFlags & DATAARCHIVE_LZ4 ) )
+		{
+			m_pcData = pcData;
+			m_iSize = iSize;
+			return true;
+		}
+
+		m_pcBuffer = (char*) malloc( iSize + 1 );
+		if ( m_pcBuffer && LZ4Decompress( pcData, iStoredSize, m_pcBuffer, iSize ) )
+		{
+			m_pcData = m_pcBuffer;
+			m_iSize = iSize;
+			return true;
+		}
+		free( m_pcBuffer );
+		m_pcBuffer = NULL;
+	}
+
+	// 2. TRY THE LOOSE FILE
+
+	std::string sPath( a_pcPath );
+	if ( a_pcPath[0] != '/' && 0 != strncmp( a_pcPath, DATADIR, strlen(DATADIR) ) )
+	{
+		sPath = std::string( DATADIR "/" ) + a_pcPath;
+	}
+
+	FILE* poFile = fopen( sPath.c_str(), "rb" );
+	if ( NULL == poFile )
+	{
+		return false;
+	}
+	fseek( poFile, 0, SEEK_END );
+	long iFileSize = ftell( poFile );
+	fseek( poFile, 0, SEEK_SET );
+
+	m_pcBuffer = iFileSize >= 0 ? (char*) malloc( iFileSize + 1 ) : NULL;
+	if ( NULL == m_pcBuffer || (long) fread( m_pcBuffer, 1, iFileSize, poFile ) != iFileSize )
+	{
+		debug( "Can't read file '%s'.\n", sPath.c_str() );
+		fclose( poFile );
+		Close();
+		return false;
+	}
+	fclose( poFile );
+
+	m_pcData = m_pcBuffer;
+	m_iSize = iFileSize;
+	return true;
+}
+
+
+void CDataFile::Close()
+{
+	free( m_pcBuffer );
+	m_pcBuffer = NULL;
+	m_pcData = NULL;
+	m_iSize = 0;
+}
+
+
+const char* CDataFile::GetData() const
+{
+	return m_pcData;
+}
+
+
+int CDataFile::GetSize() const
+{
+	return m_iSize;
+}
+
+
+/** Returns a read-only RWops over the data. It must be closed before the
+CDataFile is. */
+
+SDL_RWops* CDataFile::CreateRWops() const
+{
+	return m_pcData ? SDL_RWFromConstMem( m_pcData, m_iSize ) : NULL;
+}
+
+
+
+/*************************************************************************
+                           HELPERS
+*************************************************************************/
+
+
+/** Loads an image through the data archive. The surface is not converted
+to the display format. */
+
+SDL_Surface* LoadDataImage( const char* a_pcPath )
+{
+	CDataFile oFile;
+	if ( !oFile.Open( a_pcPath ) )
+	{
+		return NULL;
+	}
+	return IMG_Load_RW( oFile.CreateRWops(), 1 );
+}
+
+
+/** Reads a whole data file into a string. */
+
+bool ReadDataFile( const char* a_pcPath, std::string& a_rsOutData )
+{
+	CDataFile oFile;
+	if ( !oFile.Open( a_pcPath ) )
+	{
+		return false;
+	}
+	a_rsOutData.assign( oFile.GetData(), oFile.GetSize() );
+	return true;
+}
+
+
+/** Decompresses an LZ4 block of exactly a_iSize bytes. Always fails if
+liblz4 is not available. */
+
+bool LZ4Decompress( const char* a_pcSource, int a_iSourceSize, char* a_pcDestination, int a_iSize )
+{
+#ifdef HAVE_LIBLZ4
+	return LZ4_decompress_safe( a_pcSource, a_pcDestination, a_iSourceSize, a_iSize ) == a_iSize;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,127 @@
+/***************************************************************************
+                          DataArchive.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef DATAARCHIVE_H
+#define DATAARCHIVE_H
+
+
+#include <string>
+#include <map>
+
+
+#define DATAARCHIVE_NAME		"openmortal.dat"	///< The archive in DATADIR.
+#define DATAARCHIVE_VERSION		1
+#define DATAARCHIVE_HEADERSIZE	12
+#define DATAARCHIVE_ENTRYSIZE	24
+#define DATAARCHIVE_ALIGN		16				///< The data of each entry starts at a multiple of this.
+#define DATAARCHIVE_LZ4			1				///< Entry flag: the data is LZ4 compressed.
+
+
+struct SDL_RWops;
+struct SDL_Surface;
+struct SDL_mutex;
+
+
+/**
+\ingroup Media
+\brief All the game data in one memory-mapped file.
+
+The archive is built by mortalpack from the installed data directory. Its
+layout is (every number is a little endian 32 bit integer):
+
+\li Header: "OMDA", version, number of entries.
+\li Index: for each entry the name offset, name length, data offset,
+stored size, size and flags. The index is sorted by name (strcmp).
+\li The names, relative to DATADIR, with '/' separators.
+\li The data of the entries, each aligned to DATAARCHIVE_ALIGN bytes.
+
+The archive is mapped into memory once; an uncompressed entry is used
+directly from the mapping. A lookup is a binary search in the index, and
+a stat() of the loose file: if the loose file is newer than the archive
+(it was edited after mortalpack ran), the loose file is used, so a stale
+archive never hides a change in the data directory.
+
+Entries may be LZ4 compressed (if mortalpack was built with liblz4). If
+the game was built without liblz4, compressed entries are treated as if
+they weren't in the archive, and the loose files are used instead.
+
+The game doesn't use this class directly, but CDataFile. Both can be used
+from any thread.
+*/
+
+class CDataArchive
+{
+public:
+	CDataArchive();
+	~CDataArchive();
+
+	bool				Open( const char* a_pcFilename );
+	void				Close();
+	bool				IsOpen() const;
+	int					GetNumberOfEntries() const;
+
+	bool				Find( const char* a_pcName, const char*& a_rpcOutData,
+							int& a_riOutStoredSize, int& a_riOutSize, int& a_riOutFlags ) const;
+	const char*			GetPersistentData( const char* a_pcName, int& a_riOutSize );
+
+	static const char*	GetRelativePath( const char* a_pcPath );
+
+protected:
+	bool				IsLooseFileNewer( const char* a_pcName ) const;
+
+protected:
+	const char*			m_pcData;		///< The mapped archive.
+	int					m_iSize;
+	int					m_iNumEntries;
+	const unsigned char* m_pcIndex;
+	long				m_iTime;		///< The modification time of the archive.
+	std::map<std::string,char*>	m_oUnpacked;	///< Decompressed entries kept for GetPersistentData()
+	SDL_mutex*			m_poLock;		///< Guards m_oUnpacked.
+};
+
+
+extern CDataArchive g_oDataArchive;
+
+
+/**
+\ingroup Media
+\brief The contents of a data file, from the archive or from the disk.
+
+Open() takes a path under DATADIR (or relative to it). If the file is in
+g_oDataArchive, the data points into the mapping, or into a buffer if the
+entry is compressed; otherwise the loose file is read. Either way, the
+whole file is in memory until Close().
+*/
+
+class CDataFile
+{
+public:
+	CDataFile();
+	~CDataFile();
+
+	bool				Open( const char* a_pcPath );
+	void				Close();
+
+	const char*			GetData() const;
+	int					GetSize() const;
+	SDL_RWops*			CreateRWops() const;
+
+protected:
+	const char*			m_pcData;
+	int					m_iSize;
+	char*				m_pcBuffer;		///< Owned by the object, if not NULL.
+};
+
+
+SDL_Surface*	LoadDataImage( const char* a_pcPath );
+bool			ReadDataFile( const char* a_pcPath, std::string& a_rsOutData );
+bool			LZ4Decompress( const char* a_pcSource, int a_iSourceSize, char* a_pcDestination, int a_iSize );
+
+
+#endif // DATAARCHIVE_H
@@ -18,6 +18,8 @@
 #include "RlePack.h"
 #include "FighterStats.h"	// #includes Demo.h
 #include "Event.h"
+#include "AssetCache.h"
+#include "FramePacer.h"
 #include "config.h"
 
 
@@ -26,6 +28,7 @@
 
 Demo::Demo()
 {
+	m_poBackground = NULL;
 	m_poFlyingChars = NULL;
 	m_bAdvanceGame = false;
 }
@@ -35,6 +38,11 @@ Demo::~Demo()
 {
 	delete m_poFlyingChars;
 	m_poFlyingChars = NULL;
+	if ( m_poBackground )
+	{
+		SDL_FreeSurface( m_poBackground );
+		m_poBackground = NULL;
+	}
 }
 
 
@@ -93,8 +101,7 @@ int Demo::Run()
 {
 	SState::TGameMode enOriginalGameMode = g_oState.m_enGameMode;
 
-	int thisTick, lastTick, firstTick, gameSpeed;
-	gameSpeed = 12;
+	CFramePacer oFramePacer( 12 );
 
 	/*
 	if ( m_poBackground )
@@ -103,29 +110,15 @@ int Demo::Run()
 	}
 	*/
 	
-	thisTick = SDL_GetTicks() / gameSpeed;
-	lastTick = thisTick - 1;
-	firstTick = SDL_GetTicks() / gameSpeed;
 	while ( 1 )
 	{
-		// 1. Wait for the next tick (on extremely fast machines..)
-		while (1)
-		{
-			thisTick = SDL_GetTicks() / gameSpeed;
-			if ( thisTick==lastTick )
-			{
-				SDL_Delay(1);
-			}
-			else
-			{
-				break;
-			}
-		}
+		// 1. Wait for the next tick
+		
+		int iNumTicks = oFramePacer.WaitForNextTick();
 		
 		// 2. Call ADVANCE.
 		
-		int iRetVal = Advance(thisTick-lastTick, true);
-		lastTick = thisTick;
+		int iRetVal = Advance(iNumTicks, true);
 		
 		if ( iRetVal )
 		{
@@ -210,7 +203,7 @@ class CreditsDemo: public Demo
 public:
 	CreditsDemo()
 	{
-		m_poBackground = LoadBackground( "Credits.jpg", 240 );
+		m_poBackground = g_oAssetCache.CopyBackground( "Credits.jpg", 240 );
 		SDL_UnlockSurface( m_poBackground );
 		DrawGradientText( "Credits", titleFont, 20, m_poBackground );
 		SDL_Flip( m_poBackground );
@@ -247,7 +240,7 @@ class EuDemo: public Demo
 public:
 	EuDemo()
 	{
-		m_poBackground = LoadBackground( "eu.jpg", 240 );
+		m_poBackground = g_oAssetCache.CopyBackground( "eu.jpg", 240 );
 		SDL_UnlockSurface( m_poBackground );
 		
 		SDL_Rect oRect;
@@ -274,7 +267,7 @@ class Story1Demo: public Demo
 public:
 	Story1Demo()
 	{
-		m_poBackground = LoadBackground( "Story1.jpg", 240 );
+		m_poBackground = g_oAssetCache.CopyBackground( "Story1.jpg", 240 );
 		SDL_UnlockSurface( m_poBackground );
 		
 		SDL_Rect oRect;
@@ -298,7 +291,7 @@ class Story2Demo: public Demo
 public:
 	Story2Demo()
 	{
-		m_poBackground = LoadBackground( "Story2.jpg", 240 );
+		m_poBackground = g_oAssetCache.CopyBackground( "Story2.jpg", 240 );
 		SDL_UnlockSurface( m_poBackground );
 
 		SDL_Rect oRect;
@@ -325,7 +318,7 @@ public:
 	{
 		i = 0;
 		m_iTimeLeft = 50;
-		m_poBackground = LoadBackground( "Mortal.jpg", 240 );
+		m_poBackground = g_oAssetCache.CopyBackground( "Mortal.jpg", 240 );
 		
 		DrawTextMSZ( "Version " VERSION "   2003-2004 by UPi", inkFont, 320, 430, UseShadow | AlignHCenter, C_WHITE, m_poBackground, false );
 		
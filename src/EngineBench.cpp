@@ -0,0 +1,318 @@
+/***************************************************************************
+                          EngineBench.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+/**
+\file EngineBench.cpp
+
+Micro-benchmarks of the hot paths of a game frame: drawing the fighters,
+the background, the texts and the shadows, and the ticks of the perl
+backend. They draw into the screen of SDL's dummy video driver, which is
+an offscreen surface, so they need no display. "make bench" runs them at
+16 and 32 bpp (see Makefile.am).
+
+Every benchmark is calibrated to take at least BENCH_MINRUNNS per run, and
+is run BENCH_RUNS times after a warmup run. The median is the number to
+track across revisions; the min and max show how noisy the machine was.
+The results are printed as tab separated lines, comments start with '#'.
+*/
+
+#include "SDL.h"
+#include "sge_primitives.h"
+#include "sge_bm_text.h"
+
+#include "common.h"
+#include "gfx.h"
+#include "Backend.h"
+#include "Background.h"
+#include "PlayerSelect.h"
+#include "RlePack.h"
+#include "State.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+#define BENCH_RUNS		9
+#define BENCH_MINRUNNS	20e6		///< 20 ms
+
+
+/** Runs a_iOps operations, and returns the nanoseconds they took. Most
+benchmarks time the whole loop, the backend ones only the calls they
+measure. */
+typedef double (*TBenchFunction)( int a_iOps );
+
+
+static RlePack*			g_poBenchPack = NULL;
+static int				g_iBenchSprite = 0;
+static Background*		g_poBenchBackground = NULL;
+static CCachedText		g_oBenchText;
+static std::string		g_sBenchScene;
+static unsigned int		g_iBenchSeed = 1;
+
+
+
+/***************************************************************************
+                     THE BENCHMARKS
+***************************************************************************/
+
+
+static double BenchSprite( int a_iOps )
+{
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		g_poBenchPack->Draw( g_iBenchSprite, 200, 100, false );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+static double BenchSpriteFlipped( int a_iOps )
+{
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		g_poBenchPack->Draw( g_iBenchSprite, 200, 100, true );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+/** Half of the sprite hangs off the left and the bottom of the screen. */
+static double BenchSpriteClipped( int a_iOps )
+{
+	int x = - g_poBenchPack->GetWidth( g_iBenchSprite ) / 2;
+	int y = gamescreen->h - g_poBenchPack->GetHeight( g_iBenchSprite ) / 2;
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		g_poBenchPack->Draw( g_iBenchSprite, x, y, false );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+static double BenchBackground( int a_iOps )
+{
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		g_poBenchBackground->Draw( ( i * 7 ) % 320, 0, 0 );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+static double BenchText( int a_iOps )
+{
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		DrawTextMSZ( "Round 1", inkFont, 320, 200, AlignHCenter, C_WHITE, gamescreen, false );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+static double BenchCachedText( int a_iOps )
+{
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		g_oBenchText.Draw( "Round 1", inkFont, 320, 200, AlignHCenter, C_WHITE, gamescreen );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+/** The shadow of a fighter, as Game::Draw() draws it. */
+static double BenchEllipse( int a_iOps )
+{
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		sge_FilledEllipseAlpha( gamescreen, 320, 440, 50, 8, C_BLACK, 128 );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+/** Starts a new round of the backend, with the two fighters of the
+player selection. */
+static void StartBenchRound()
+{
+	g_oBackend.PerlEvalF( "srand(1);" );
+	g_oBackend.PerlEvalF( "SelectStart(%d);", 2 );
+	g_oBackend.PerlEvalF( "SetPlayerNumber(%d,%d);", 0, g_oPlayerSelect.GetPlayerInfo(0).m_enFighter );
+	g_oBackend.PerlEvalF( "SetPlayerNumber(%d,%d);", 1, g_oPlayerSelect.GetPlayerInfo(1).m_enFighter );
+	g_oBackend.PerlEvalF( "GameStart(%d,%d,%d,%d,%d);", g_oState.m_iHitPoints, 2, 1, 0, 0 );
+	g_oBackend.ReadFromPerl();
+}
+
+
+/** Runs a tick of the backend with random keys, so the fighters move and
+fight. A new round is started when this one is over. Only the calls given
+are timed. */
+static void BenchTick( double& a_rdAdvanceNs, double& a_rdReadNs )
+{
+	if ( g_oBackend.m_iGameOver )
+	{
+		StartBenchRound();
+	}
+
+	double dStart = GetNanoseconds();
+	g_oBackend.AdvancePerl();
+	double dAdvanced = GetNanoseconds();
+	g_oBackend.ReadFromPerl();
+	double dRead = GetNanoseconds();
+	a_rdAdvanceNs += dAdvanced - dStart;
+	a_rdReadNs += dRead - dAdvanced;
+
+	g_iBenchSeed = g_iBenchSeed * 1103515245 + 12345;
+	int iRandom = ( g_iBenchSeed >> 16 ) & 0x7fff;
+	if ( 0 == iRandom % 3 )
+	{
+		g_oBackend.PerlCall( iRandom & 0x100 ? "KeyDown" : "KeyUp", ( iRandom >> 4 ) & 1, ( iRandom >> 5 ) % 9 );
+	}
+}
+
+
+static double BenchAdvance( int a_iOps )
+{
+	double dAdvanceNs = 0.0, dReadNs = 0.0;
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		BenchTick( dAdvanceNs, dReadNs );
+	}
+	return dAdvanceNs;
+}
+
+
+static double BenchReadFromPerl( int a_iOps )
+{
+	double dAdvanceNs = 0.0, dReadNs = 0.0;
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		BenchTick( dAdvanceNs, dReadNs );
+	}
+	return dReadNs;
+}
+
+
+static double BenchWriteToString( int a_iOps )
+{
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		g_oBackend.WriteToString( g_sBenchScene );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+static double BenchReadFromString( int a_iOps )
+{
+	double dStart = GetNanoseconds();
+	for ( int i=0; i<a_iOps; ++i )
+	{
+		g_oBackend.ReadFromString( g_sBenchScene );
+	}
+	return GetNanoseconds() - dStart;
+}
+
+
+
+/***************************************************************************
+                     THE RUNNER
+***************************************************************************/
+
+
+/** Calibrates, runs and prints one benchmark. */
+static void RunBenchmark( const char* a_pcName, TBenchFunction a_pfBench )
+{
+	// 1. Find a number of operations that take long enough to measure.
+
+	int iOps = 1;
+	while ( a_pfBench( iOps ) < BENCH_MINRUNNS && iOps < 1 << 24 )
+	{
+		iOps *= 2;
+	}
+
+	// 2. Warm up, then measure.
+
+	a_pfBench( iOps );
+	double adNsPerOp[BENCH_RUNS];
+	for ( int i=0; i<BENCH_RUNS; ++i )
+	{
+		adNsPerOp[i] = a_pfBench( iOps ) / iOps;
+	}
+	std::sort( adNsPerOp, adNsPerOp + BENCH_RUNS );
+
+	printf( "%s\t%d\t%.1f\t%.1f\t%.1f\t%d\t%d\n", a_pcName, gamescreen->format->BitsPerPixel,
+		adNsPerOp[BENCH_RUNS/2], adNsPerOp[0], adNsPerOp[BENCH_RUNS-1], BENCH_RUNS, iOps );
+	fflush( stdout );
+}
+
+
+/** Runs every benchmark on the current screen. The screen, the fonts, the
+fighters and the player selection must be set up already; main() does
+this for -enginebench, on the dummy video driver.
+
+\return 0 if the benchmarks ran.
+*/
+int DoEngineBenchmark()
+{
+	// 1. Set up the things to draw.
+
+	g_poBenchPack = g_oPlayerSelect.GetPlayerInfo(0).m_poPack;
+	if ( NULL == g_poBenchPack )
+	{
+		fprintf( stderr, "Can't load the fighter to draw.\n" );
+		return 1;
+	}
+	while ( g_iBenchSprite < 100 && g_poBenchPack->GetWidth( g_iBenchSprite ) <= 0 )
+	{
+		++g_iBenchSprite;
+	}
+
+	Background oBackground;
+	oBackground.Load( 1 );
+	if ( !oBackground.IsOK() )
+	{
+		fprintf( stderr, "Can't load the background.\n" );
+		return 1;
+	}
+	g_poBenchBackground = &oBackground;
+	SDL_SetClipRect( gamescreen, NULL );
+
+	StartBenchRound();
+
+	// 2. Run the benchmarks.
+
+	printf( "# OpenMortal engine benchmark, %dx%d %d bpp, %d runs of at least %.0f ms each\n",
+		gamescreen->w, gamescreen->h, gamescreen->format->BitsPerPixel, BENCH_RUNS, BENCH_MINRUNNS / 1e6 );
+	printf( "# name\tbpp\tmedian_ns\tmin_ns\tmax_ns\truns\tops_per_run\n" );
+
+	RunBenchmark( "RlePack::Draw", BenchSprite );
+	RunBenchmark( "RlePack::Draw flipped", BenchSpriteFlipped );
+	RunBenchmark( "RlePack::Draw clipped", BenchSpriteClipped );
+	RunBenchmark( "Background::Draw", BenchBackground );
+	RunBenchmark( "DrawTextMSZ", BenchText );
+	RunBenchmark( "CCachedText::Draw", BenchCachedText );
+	RunBenchmark( "sge_FilledEllipseAlpha", BenchEllipse );
+	RunBenchmark( "Backend::AdvancePerl", BenchAdvance );
+	RunBenchmark( "Backend::ReadFromPerl", BenchReadFromPerl );
+	RunBenchmark( "Backend::WriteToString", BenchWriteToString );
+	RunBenchmark( "Backend::ReadFromString", BenchReadFromString );
+
+	g_poBenchBackground = NULL;
+	g_oBenchText.Clear();
+	return 0;
+}
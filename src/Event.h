@@ -43,6 +43,7 @@ struct SMortalEvent
 	TMortalEventEnum	m_enType;
 	int					m_iPlayer;
 	int					m_iKey;
+	double				m_dNs;			///< GetNanoseconds() when the event was read from SDL.
 };
 
 bool TranslateEvent( const SDL_Event* a_poInSDLEvent, SMortalEvent* a_poOutEvent );
@@ -0,0 +1,332 @@
+/***************************************************************************
+                          FighterCache.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "FighterCache.h"
+#include "PlayerSelect.h"
+#include "WorkerPool.h"
+#include "RlePack.h"
+#include "Backend.h"
+#include "common.h"
+
+#include <string>
+
+
+#define FIGHTERCACHE_DEFAULTBUDGET	(64*1024*1024)	///< Until SetBudget() is called.
+
+
+CFighterCache g_oFighterCache;
+
+
+
+/*************************************************************************
+                           FIGHTER LOAD JOB
+*************************************************************************/
+
+
+/** Loads the RlePack of a fighter on a worker thread. RlePack doesn't use
+the backend or the screen while loading, so this is safe. */
+
+class CFighterLoadJob: public CJob
+{
+public:
+	CFighterLoadJob( const std::string& a_rsFilename )
+	{
+		m_sFilename = a_rsFilename;
+		m_poPack = NULL;
+	}
+
+	virtual void Run()
+	{
+		m_poPack = new RlePack( m_sFilename.c_str(), COLORSPERPLAYER );
+	}
+
+	std::string			m_sFilename;
+	RlePack*			m_poPack;
+};
+
+
+/** A fighter in the cache. While it is loading, m_poJob is set and the
+entry is not in the LRU list. */
+struct SFighterCacheEntry
+{
+	FighterEnum			m_enFighter;
+	std::string			m_sFilename;
+	CFighterLoadJob*	m_poJob;
+	RlePack*			m_poPack;
+	int					m_iBytes;
+	std::list<SFighterCacheEntry*>::iterator	m_itLru;
+};
+
+
+
+/*************************************************************************
+                           FIGHTER CACHE
+*************************************************************************/
+
+
+CFighterCache::CFighterCache()
+{
+	m_iBudget = FIGHTERCACHE_DEFAULTBUDGET;
+	m_iBytes = 0;
+	m_iHits = m_iMisses = m_iEvictions = 0;
+}
+
+
+CFighterCache::~CFighterCache()
+{
+	// The loading entries are left alone; the worker pool is shut down
+	// by now. Clear() should be called before that.
+	for ( EntryList::iterator it = m_oLru.begin(); it != m_oLru.end(); ++it )
+	{
+		delete (*it)->m_poPack;
+		delete *it;
+	}
+}
+
+
+/** Starts loading the fighter in the background, unless it is already
+in the cache or being loaded. */
+
+void CFighterCache::Prefetch( FighterEnum a_enFighter )
+{
+	// The finished prefetches are counted now.
+	Evict( m_iBudget );
+	if ( a_enFighter <= UNKNOWN || Find( a_enFighter ) )
+	{
+		return;
+	}
+
+	g_oBackend.PerlEvalF( "GetFighterStats(%d);", a_enFighter );
+	const char* pcDatafile = g_oBackend.GetPerlString( "Datafile" );
+	if ( NULL == pcDatafile || !*pcDatafile )
+	{
+		return;
+	}
+
+	SFighterCacheEntry* poEntry = new SFighterCacheEntry;
+	poEntry->m_enFighter = a_enFighter;
+	poEntry->m_sFilename = std::string( DATADIR "/characters/" ) + pcDatafile;
+	poEntry->m_poJob = new CFighterLoadJob( poEntry->m_sFilename );
+	poEntry->m_poPack = NULL;
+	poEntry->m_iBytes = 0;
+	m_oEntries[ a_enFighter ] = poEntry;
+
+	g_oWorkerPool.Add( poEntry->m_poJob );
+}
+
+
+/** Returns true while the fighter is being loaded in the background. */
+bool CFighterCache::IsLoading( FighterEnum a_enFighter )
+{
+	SFighterCacheEntry* poEntry = Find( a_enFighter );
+	if ( NULL == poEntry )
+	{
+		return false;
+	}
+	Collect( poEntry );
+	return NULL != poEntry->m_poJob;
+}
+
+
+/** Takes the fighter's RlePack out of the cache. If it is not in the
+cache yet, it is loaded: with a_bWait this returns when the pack is
+loaded, otherwise it returns NULL while the pack is loading, and the
+caller should try again later.
+
+\return The RlePack, which now belongs to the caller, or NULL if it is
+still loading or couldn't be loaded. */
+
+RlePack* CFighterCache::Acquire( FighterEnum a_enFighter, bool a_bWait )
+{
+	SFighterCacheEntry* poEntry = Find( a_enFighter );
+	if ( poEntry )
+	{
+		Collect( poEntry );
+	}
+
+	if ( NULL == poEntry || poEntry->m_poJob )
+	{
+		++m_iMisses;
+		Prefetch( a_enFighter );
+		poEntry = Find( a_enFighter );
+		if ( NULL == poEntry )
+		{
+			return NULL;
+		}
+		// Without worker threads the job is already done.
+		Collect( poEntry );
+		if ( poEntry->m_poJob )
+		{
+			if ( !a_bWait )
+			{
+				return NULL;
+			}
+			// Runs the job right here if no worker started it yet.
+			g_oWorkerPool.Wait( poEntry->m_poJob );
+			Collect( poEntry );
+		}
+	}
+	else
+	{
+		++m_iHits;
+	}
+
+	RlePack* poPack = poEntry->m_poPack;
+	Remove( poEntry );
+	if ( poPack && poPack->Count() <= 0 )
+	{
+		debug( "Couldn't load RlePack: '%s'\n", poEntry->m_sFilename.c_str() );
+		delete poPack;
+		poPack = NULL;
+	}
+	delete poEntry;
+	return poPack;
+}
+
+
+/** Gives a pack back to the cache, which was returned by Acquire(). The
+color offset and the tint of the pack are reset. */
+
+void CFighterCache::Release( FighterEnum a_enFighter, RlePack* a_poPack )
+{
+	if ( NULL == a_poPack )
+	{
+		return;
+	}
+
+	a_poPack->OffsetSprites( 0 );
+	a_poPack->SetTint( NO_TINT );
+
+	SFighterCacheEntry* poEntry = Find( a_enFighter );
+	if ( poEntry && NULL == poEntry->m_poJob )
+	{
+		// Both players had the same fighter; one copy is enough.
+		delete a_poPack;
+		m_oLru.erase( poEntry->m_itLru );
+		poEntry->m_itLru = m_oLru.insert( m_oLru.end(), poEntry );
+		return;
+	}
+
+	if ( poEntry )
+	{
+		// The fighter is being loaded again; the load is not needed.
+		g_oWorkerPool.Cancel( poEntry->m_poJob );
+		delete poEntry->m_poJob->m_poPack;
+		delete poEntry->m_poJob;
+		poEntry->m_poJob = NULL;
+	}
+	else
+	{
+		poEntry = new SFighterCacheEntry;
+		poEntry->m_enFighter = a_enFighter;
+		poEntry->m_poJob = NULL;
+		m_oEntries[ a_enFighter ] = poEntry;
+	}
+
+	poEntry->m_poPack = a_poPack;
+	poEntry->m_iBytes = a_poPack->GetMemorySize();
+	poEntry->m_itLru = m_oLru.insert( m_oLru.end(), poEntry );
+	m_iBytes += poEntry->m_iBytes;
+	Evict( m_iBudget );
+}
+
+
+void CFighterCache::SetBudget( int a_iBytes )
+{
+	m_iBudget = a_iBytes;
+	Evict( m_iBudget );
+}
+
+
+/** Frees every pack in the cache, and stops the loads in progress. Must
+be called before the worker pool is shut down. */
+
+void CFighterCache::Clear()
+{
+	for ( EntryMap::iterator it = m_oEntries.begin(); it != m_oEntries.end(); ++it )
+	{
+		SFighterCacheEntry* poEntry = it->second;
+		if ( poEntry->m_poJob )
+		{
+			g_oWorkerPool.Cancel( poEntry->m_poJob );
+			delete poEntry->m_poJob->m_poPack;
+			delete poEntry->m_poJob;
+		}
+		delete poEntry->m_poPack;
+		delete poEntry;
+	}
+	m_oEntries.clear();
+	m_oLru.clear();
+	m_iBytes = 0;
+}
+
+
+void CFighterCache::Report() const
+{
+	int iRequests = m_iHits + m_iMisses;
+	debug( "Fighter cache: %d requests, %d hits (%.1f%%), %d misses, %d evicted.\n",
+		iRequests, m_iHits, iRequests ? m_iHits * 100.0 / iRequests : 0.0, m_iMisses, m_iEvictions );
+	debug( "Fighter cache: %d fighters, %d loading, %.1f MB now, %.1f MB budget.\n",
+		(int) m_oEntries.size(), (int) ( m_oEntries.size() - m_oLru.size() ),
+		m_iBytes / 1048576.0, m_iBudget / 1048576.0 );
+}
+
+
+SFighterCacheEntry* CFighterCache::Find( FighterEnum a_enFighter )
+{
+	EntryMap::iterator it = m_oEntries.find( a_enFighter );
+	return it == m_oEntries.end() ? NULL : it->second;
+}
+
+
+/** Picks up the pack of a finished load. */
+void CFighterCache::Collect( SFighterCacheEntry* a_poEntry )
+{
+	if ( NULL == a_poEntry->m_poJob || !a_poEntry->m_poJob->IsDone() )
+	{
+		return;
+	}
+
+	// Wait() makes the results of the job visible to this thread.
+	g_oWorkerPool.Wait( a_poEntry->m_poJob );
+	a_poEntry->m_poPack = a_poEntry->m_poJob->m_poPack;
+	delete a_poEntry->m_poJob;
+	a_poEntry->m_poJob = NULL;
+
+	a_poEntry->m_iBytes = a_poEntry->m_poPack ? a_poEntry->m_poPack->GetMemorySize() : 0;
+	a_poEntry->m_itLru = m_oLru.insert( m_oLru.end(), a_poEntry );
+	m_iBytes += a_poEntry->m_iBytes;
+}
+
+
+/** Takes the entry out of the cache, without freeing it. */
+void CFighterCache::Remove( SFighterCacheEntry* a_poEntry )
+{
+	m_oEntries.erase( a_poEntry->m_enFighter );
+	if ( NULL == a_poEntry->m_poJob )
+	{
+		m_oLru.erase( a_poEntry->m_itLru );
+		m_iBytes -= a_poEntry->m_iBytes;
+	}
+}
+
+
+/** Frees the loaded packs, least recently used first, until the cache
+fits in a_iBudget bytes. */
+void CFighterCache::Evict( int a_iBudget )
+{
+	while ( m_iBytes > a_iBudget && !m_oLru.empty() )
+	{
+		SFighterCacheEntry* poEntry = m_oLru.front();
+		Remove( poEntry );
+		delete poEntry->m_poPack;
+		delete poEntry;
+		++m_iEvictions;
+	}
+}
@@ -0,0 +1,81 @@
+/***************************************************************************
+                          FighterCache.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef FIGHTERCACHE_H
+#define FIGHTERCACHE_H
+
+
+#include "FighterEnum.h"
+
+#include <map>
+#include <list>
+
+
+class RlePack;
+struct SFighterCacheEntry;
+
+
+/**
+\ingroup PlayerSelect
+\brief Loads the RlePacks of the fighters in the background, and keeps
+them for later.
+
+Prefetch() starts loading a fighter on CWorkerPool; Acquire() hands the
+RlePack over to a player. The player gives it back with Release() when it
+switches to another fighter, and the pack stays in the cache until the
+memory budget (SState::m_iFighterCacheSize) runs out. Then the least
+recently used packs are freed first. Packs that are being loaded are not
+counted, and are never evicted.
+
+The packs are handed out one at a time, because the player's color offset
+and tint are applied to them. Release() undoes both.
+
+The cache must only be used from the main thread, as the name of the
+data file comes from the backend.
+*/
+
+class CFighterCache
+{
+public:
+	CFighterCache();
+	~CFighterCache();
+
+	void				Prefetch( FighterEnum a_enFighter );
+	bool				IsLoading( FighterEnum a_enFighter );
+	RlePack*			Acquire( FighterEnum a_enFighter, bool a_bWait );
+	void				Release( FighterEnum a_enFighter, RlePack* a_poPack );
+
+	void				SetBudget( int a_iBytes );
+	void				Clear();
+	void				Report() const;
+
+protected:
+	typedef std::map<FighterEnum,SFighterCacheEntry*> EntryMap;
+	typedef std::list<SFighterCacheEntry*> EntryList;
+
+	SFighterCacheEntry*	Find( FighterEnum a_enFighter );
+	void				Collect( SFighterCacheEntry* a_poEntry );
+	void				Remove( SFighterCacheEntry* a_poEntry );
+	void				Evict( int a_iBudget );
+
+protected:
+	EntryMap			m_oEntries;
+	EntryList			m_oLru;				///< Least recently used first.
+	int					m_iBudget;			///< In bytes.
+	int					m_iBytes;			///< The size of the loaded packs in the cache.
+	int					m_iHits;
+	int					m_iMisses;
+	int					m_iEvictions;
+};
+
+
+extern CFighterCache g_oFighterCache;
+
+
+#endif // FIGHTERCACHE_H
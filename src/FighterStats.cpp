@@ -22,6 +22,7 @@
 #include "Backend.h"
 #include "State.h"
 #include "FighterStats.h"
+#include "AssetCache.h"
 
 #include "MszPerl.h"
 
@@ -79,7 +80,7 @@ FighterStatsDemo::FighterStatsDemo( FighterEnum a_iFighter )
 	m_iTimeLeft = 500;
 	m_poStaff = NULL;
 	
-	m_poBackground = LoadBackground( "FighterStats.jpg", 64 );
+	m_poBackground = g_oAssetCache.CopyBackground( "FighterStats.jpg", 64 );
 	DrawGradientText( "Fighter Stats", titleFont, 10, m_poBackground );
 
 	SDL_BlitSurface( m_poBackground, NULL, gamescreen, NULL );
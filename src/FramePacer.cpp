@@ -0,0 +1,304 @@
+/***************************************************************************
+                          FramePacer.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "FramePacer.h"
+#include "common.h"
+#include "State.h"
+
+#include "SDL.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+
+
+#if defined(CLOCK_MONOTONIC) && defined(TIMER_ABSTIME) && !defined(_WIN32)
+#define FRAMEPACER_NANOSLEEP
+#endif
+
+#define FRAMEPACER_MINSPIN		50e3		///< The spin is never shorter than 50 us,
+#define FRAMEPACER_MAXSPIN		2e6			///< and never longer than 2 ms.
+#define FRAMEPACER_INITIALSPIN	500e3
+
+
+
+/*************************************************************************
+                           FRAME PACER
+*************************************************************************/
+
+
+CFramePacer::CFramePacer( int a_iTickMs )
+{
+	m_dSpinNs = FRAMEPACER_INITIALSPIN;
+	Start( a_iTickMs );
+	ResetStatistics();
+}
+
+
+/** Restarts the clock. The first WaitForNextTick() returns right away,
+with one tick. */
+
+void CFramePacer::Start( int a_iTickMs )
+{
+	m_dTickNs = a_iTickMs * 1e6;
+	m_dStartNs = GetNanoseconds() - m_dTickNs;
+	m_dLastFrameNs = m_dStartNs;
+	m_iLastTick = 0;
+}
+
+
+/** Changes the speed of the clock. The tick that is due next comes one
+new tick length after the last one, so no ticks are gained or lost. */
+
+void CFramePacer::SetTickLength( int a_iTickMs )
+{
+	double dLastDueNs = m_dStartNs + m_iLastTick * m_dTickNs;
+	m_dTickNs = a_iTickMs * 1e6;
+	m_dStartNs = dLastDueNs - m_iLastTick * m_dTickNs;
+}
+
+
+/** Waits until the next tick is due, and returns how many ticks passed
+since the last call. This is more than one if the last frame took
+longer than a tick. */
+
+int CFramePacer::WaitForNextTick()
+{
+	double dDueNs = m_dStartNs + ( m_iLastTick + 1 ) * m_dTickNs;
+	WaitUntil( dDueNs );
+	return CountTicks( true, 0.0 );
+}
+
+
+/** Waits until the next frame is due, at a_iFps frames per second, and
+returns how many ticks passed since the last call. This is zero if the
+frames come faster than the ticks; GetTickFraction() tells how far the
+clock is into the next tick then. */
+
+int CFramePacer::WaitForNextFrame( int a_iFps )
+{
+	double dFrameNs = 1e9 / a_iFps;
+	WaitUntil( m_dLastFrameNs + dFrameNs );
+	return CountTicks( false, dFrameNs );
+}
+
+
+/** Returns how much of the current tick has passed, between 0 and 1, as
+of the last wait. */
+
+double CFramePacer::GetTickFraction() const
+{
+	double dFraction = ( m_dLastFrameNs - m_dStartNs ) / m_dTickNs - m_iLastTick;
+	return MAX( 0.0, MIN( 1.0, dFraction ) );
+}
+
+
+/** Returns the number of ticks since Start(), as of the last wait. */
+
+int CFramePacer::GetTick() const
+{
+	return m_iLastTick;
+}
+
+
+void CFramePacer::ResetStatistics()
+{
+	m_iFrames = m_iSkippedTicks = m_iSleeps = m_iIntervals = 0;
+	m_dLateSumNs = m_dLateMaxNs = 0.0;
+	m_dErrorSumNs = m_dErrorSquareSumNs = 0.0;
+}
+
+
+void CFramePacer::Report( const char* a_pcName ) const
+{
+	if ( 0 == m_iIntervals )
+	{
+		debug( "%s: no frames measured.\n", a_pcName );
+		return;
+	}
+
+	double dMeanNs = m_dErrorSumNs / m_iIntervals;
+	double dVariance = m_dErrorSquareSumNs / m_iIntervals - dMeanNs * dMeanNs;
+	debug( "%s: %d frames, %d ticks skipped, %.2f sleeps per waiting frame, spin %.0f us.\n",
+		a_pcName, m_iIntervals, m_iSkippedTicks, m_iFrames ? (double) m_iSleeps / m_iFrames : 0.0,
+		m_dSpinNs / 1e3 );
+	debug( "%s: frames started %.1f us late on average, %.1f us worst; interval deviation %.1f us.\n",
+		a_pcName, m_iFrames ? m_dLateSumNs / m_iFrames / 1e3 : 0.0, m_dLateMaxNs / 1e3,
+		sqrt( dVariance > 0.0 ? dVariance : 0.0 ) / 1e3 );
+}
+
+
+/** Waits until the given time, and measures how late the wait ended. It
+returns right away if the time has already passed. */
+
+void CFramePacer::WaitUntil( double a_dDueNs )
+{
+	if ( GetNanoseconds() >= a_dDueNs )
+	{
+		return;
+	}
+	SleepUntil( a_dDueNs );
+	double dLateNs = GetNanoseconds() - a_dDueNs;
+	m_dLateSumNs += dLateNs;
+	if ( dLateNs > m_dLateMaxNs ) m_dLateMaxNs = dLateNs;
+	++m_iFrames;
+}
+
+
+/** Counts the ticks that passed since the last frame, and records how much
+the frame interval deviated from the ideal a_dFrameNs (or from the length
+of the ticks counted, if that is 0). At least one tick is counted if
+a_bAtLeastOne is set. */
+
+int CFramePacer::CountTicks( bool a_bAtLeastOne, double a_dFrameNs )
+{
+	double dNowNs = GetNanoseconds();
+	int iTick = (int) floor( ( dNowNs - m_dStartNs ) / m_dTickNs );
+	if ( iTick < m_iLastTick + ( a_bAtLeastOne ? 1 : 0 ) )
+	{
+		iTick = m_iLastTick + ( a_bAtLeastOne ? 1 : 0 );
+	}
+	int iNumTicks = iTick - m_iLastTick;
+	if ( iNumTicks > 1 )
+	{
+		m_iSkippedTicks += iNumTicks - 1;
+	}
+
+	double dErrorNs = dNowNs - m_dLastFrameNs - ( a_dFrameNs > 0.0 ? a_dFrameNs : iNumTicks * m_dTickNs );
+	m_dErrorSumNs += dErrorNs;
+	m_dErrorSquareSumNs += dErrorNs * dErrorNs;
+	++m_iIntervals;
+
+	m_dLastFrameNs = dNowNs;
+	m_iLastTick = iTick;
+	return iNumTicks;
+}
+
+
+/** Sleeps until m_dSpinNs before the given time, then spins until it. The
+spin is adjusted after each sleep: it grows to cover the late wakeups
+right away, and shrinks slowly while the sleeps are accurate. */
+
+void CFramePacer::SleepUntil( double a_dNs )
+{
+	double dWakeNs = a_dNs - m_dSpinNs;
+	double dNowNs = GetNanoseconds();
+
+	if ( dWakeNs > dNowNs )
+	{
+		++m_iSleeps;
+#ifdef FRAMEPACER_NANOSLEEP
+		struct timespec oWake;
+		oWake.tv_sec = (time_t) ( dWakeNs / 1e9 );
+		oWake.tv_nsec = (long) ( dWakeNs - oWake.tv_sec * 1e9 );
+		while ( EINTR == clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &oWake, NULL ) ) {}
+#else
+		SDL_Delay( (Uint32) ( ( dWakeNs - dNowNs ) / 1e6 ) );
+#endif
+		double dOversleepNs = GetNanoseconds() - dWakeNs;
+		if ( dOversleepNs > m_dSpinNs )
+		{
+			m_dSpinNs = dOversleepNs;
+		}
+		else
+		{
+			m_dSpinNs = m_dSpinNs * 0.95 + dOversleepNs * 0.05;
+		}
+		m_dSpinNs = MAX( FRAMEPACER_MINSPIN, MIN( FRAMEPACER_MAXSPIN, m_dSpinNs ) );
+	}
+
+	while ( GetNanoseconds() < a_dNs )
+	{
+		// Spin.
+	}
+}
+
+
+
+/*************************************************************************
+                           PACER BENCHMARK
+*************************************************************************/
+
+
+/** Runs an empty game loop for a few seconds at the configured game speed,
+first waiting for the ticks the old way (SDL_GetTicks() and SDL_Delay(1)),
+then with CFramePacer, and prints how accurately the frames started. Needs
+no video. */
+
+int DoPacerBenchmark()
+{
+	const int iTickMs = g_oState.m_iGameSpeed > 0 ? g_oState.m_iGameSpeed : 12;
+	const int iSeconds = 3;
+	const int iNumFrames = iSeconds * 1000 / iTickMs;
+
+	if ( SDL_Init( SDL_INIT_TIMER ) < 0 )
+	{
+		fprintf( stderr, "SDL_Init: %s\n", SDL_GetError() );
+		return 1;
+	}
+
+	printf( "Frame pacing benchmark, %d ms ticks, %d frames each.\n", iTickMs, iNumFrames );
+	printf( "%-14s %10s %10s %10s %10s %10s\n", "method", "late avg", "late max", "deviation", "wakeups", "skipped" );
+
+	// 1. THE OLD LOOP. Its ticks are due on the millisecond boundaries.
+
+	double dLateSumNs = 0.0, dLateMaxNs = 0.0, dSumNs = 0.0, dSquareSumNs = 0.0;
+	int iWakeups = 0, iSkipped = 0;
+	int iThisTick = SDL_GetTicks() / iTickMs;
+	int iLastTick = iThisTick;
+	double dLastNs = GetNanoseconds();
+	double dTickStartNs = dLastNs - ( SDL_GetTicks() % iTickMs ) * 1e6;
+	int i;
+	for ( i=0; i<iNumFrames; ++i )
+	{
+		while ( iThisTick == iLastTick )
+		{
+			iThisTick = SDL_GetTicks() / iTickMs;
+			if ( iThisTick==iLastTick ) { SDL_Delay(1); ++iWakeups; }
+		}
+		double dNowNs = GetNanoseconds();
+		int iNumTicks = iThisTick - iLastTick;
+		iSkipped += iNumTicks - 1;
+		dTickStartNs += iNumTicks * iTickMs * 1e6;
+		double dLateNs = dNowNs - dTickStartNs;
+		dLateSumNs += dLateNs;
+		if ( dLateNs > dLateMaxNs ) dLateMaxNs = dLateNs;
+		double dErrorNs = dNowNs - dLastNs - iNumTicks * iTickMs * 1e6;
+		dSumNs += dErrorNs;
+		dSquareSumNs += dErrorNs * dErrorNs;
+		dLastNs = dNowNs;
+		iLastTick = iThisTick;
+	}
+	double dMeanNs = dSumNs / iNumFrames;
+	printf( "%-14s %8.1fus %8.1fus %8.1fus %10.2f %10d\n", "SDL_Delay(1)",
+		dLateSumNs / iNumFrames / 1e3, dLateMaxNs / 1e3,
+		sqrt( MAX( 0.0, dSquareSumNs / iNumFrames - dMeanNs * dMeanNs ) ) / 1e3,
+		(double) iWakeups / iNumFrames, iSkipped );
+
+	// 2. THE FRAME PACER
+
+	CFramePacer oPacer( iTickMs );
+	oPacer.WaitForNextTick();
+	oPacer.ResetStatistics();
+	for ( i=0; i<iNumFrames; ++i )
+	{
+		oPacer.WaitForNextTick();
+	}
+	dMeanNs = oPacer.m_dErrorSumNs / oPacer.m_iIntervals;
+	printf( "%-14s %8.1fus %8.1fus %8.1fus %10.2f %10d\n", "CFramePacer",
+		oPacer.m_dLateSumNs / MAX( 1, oPacer.m_iFrames ) / 1e3, oPacer.m_dLateMaxNs / 1e3,
+		sqrt( MAX( 0.0, oPacer.m_dErrorSquareSumNs / oPacer.m_iIntervals - dMeanNs * dMeanNs ) ) / 1e3,
+		(double) oPacer.m_iSleeps / iNumFrames, oPacer.m_iSkippedTicks );
+	printf( "The wakeups of CFramePacer are sleeps; it spins for the last %.0f us of each tick.\n",
+		oPacer.m_dSpinNs / 1e3 );
+
+	SDL_Quit();
+	return 0;
+}
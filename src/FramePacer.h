@@ -0,0 +1,78 @@
+/***************************************************************************
+                          FramePacer.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+
+/**
+\ingroup Media
+\brief Waits for the ticks of the game loops, on a nanosecond clock.
+
+The loops used to poll SDL_GetTicks() with SDL_Delay(1) in between, so
+every frame woke up several times, and started up to a millisecond (or a
+scheduler slice) late. CFramePacer sleeps until a little before the next
+tick is due with clock_nanosleep on the monotonic clock (the one
+GetNanoseconds() reads), then spins for the rest. The length of the spin
+is calibrated from how late the sleeps wake up, so it stays short on a
+quiet machine. Where clock_nanosleep is not available, SDL_Delay() is
+used for the sleep.
+
+WaitForNextTick() returns how many ticks have passed since the last call,
+counted from the start of the clock, so rounding never accumulates.
+WaitForNextFrame() paces the frames at a rate of their own instead; it
+returns 0 ticks if no tick passed during the frame, and GetTickFraction()
+tells where the frame falls between two ticks, for interpolation.
+
+The pacer measures how late each frame started compared to when its tick
+was due, and how much the frame intervals deviate from the ideal ones.
+Report() prints these.
+*/
+
+class CFramePacer
+{
+public:
+	CFramePacer( int a_iTickMs = 10 );
+
+	void				Start( int a_iTickMs );
+	void				SetTickLength( int a_iTickMs );
+	int					WaitForNextTick();
+	int					WaitForNextFrame( int a_iFps );
+	int					GetTick() const;
+	double				GetTickFraction() const;
+
+	void				ResetStatistics();
+	void				Report( const char* a_pcName ) const;
+
+protected:
+	void				WaitUntil( double a_dDueNs );
+	int					CountTicks( bool a_bAtLeastOne, double a_dFrameNs );
+	void				SleepUntil( double a_dNs );
+	friend int			DoPacerBenchmark();
+
+protected:
+	double				m_dStartNs;		///< When tick 0 was due.
+	double				m_dTickNs;
+	int					m_iLastTick;
+	double				m_dLastFrameNs;
+	double				m_dSpinNs;		///< The sleep wakes this much before the tick, calibrated.
+
+	// Statistics
+	int					m_iFrames;
+	int					m_iSkippedTicks;
+	int					m_iSleeps;
+	double				m_dLateSumNs;
+	double				m_dLateMaxNs;
+	int					m_iIntervals;
+	double				m_dErrorSumNs;		///< The sum of (interval - ideal interval)
+	double				m_dErrorSquareSumNs;	///< and of its square, for the deviation.
+};
+
+
+#endif // FRAMEPACER_H
@@ -8,6 +8,7 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 #include "SDL_image.h"
 #include "sge_surface.h"
 #include "sge_primitives.h"
@@ -27,6 +28,12 @@
 #include "Game.h"
 #include "Audio.h"
 #include "MortalNetwork.h"
+#include "ReplayLibrary.h"
+#include "GameCapture.h"
+#include "Profiler.h"
+#include "AllocCounter.h"
+#include "Tracer.h"
+#include "InputLatency.h"
 
 
 #include "MszPerl.h"
@@ -52,6 +59,7 @@ From   To   Num   Desc
 */
 
 #define MAXFRAMESKIP 5
+#define REPLAY_VERSION 4
 
 
 
@@ -98,6 +106,7 @@ struct SFpsCounter
 
 CKeyQueue::CKeyQueue()
 {
+	m_oKeys.reserve( 64 );		// More than a round needs, so it never grows.
 	Reset();
 }
 
@@ -111,7 +120,7 @@ void CKeyQueue::Reset()
 }
 
 
-void CKeyQueue::EnqueueKey( int a_iAtTime, int a_iPlayer, int a_iKey, bool a_bDown )
+void CKeyQueue::EnqueueKey( int a_iAtTime, int a_iPlayer, int a_iKey, bool a_bDown, double a_dEventNs )
 {
 	debug( "EnqueueKey( %d, %d, %d, %d ) at %d\n", a_iAtTime, a_iPlayer, a_iKey, a_bDown, g_oBackend.m_iGameTick );
 	SEnqueuedKey oKey;
@@ -119,10 +128,11 @@ void CKeyQueue::EnqueueKey( int a_iAtTime, int a_iPlayer, int a_iKey, bool a_bDo
 	oKey.iPlayer	= a_iPlayer;
 	oKey.iKey		= a_iKey;
 	oKey.bDown		= a_bDown;
+	oKey.dEventNs	= a_dEventNs;
 	
 	if ( m_oKeys.size() == 0 )
 	{
-		m_oKeys.push_front( oKey );
+		m_oKeys.push_back( oKey );
 		return;
 	}
 	
@@ -148,16 +158,31 @@ void CKeyQueue::EnqueueKey( int a_iAtTime, int a_iPlayer, int a_iKey, bool a_bDo
 
 
 /**
-If
+Sends every key which is due at a_iToTime to the backend. If a_psOutRecord
+is not NULL, a "K tick player key down" line is appended to it for every
+dequeued key; these lines make the replay file re-simulatable.
+
+Local key presses are measured by g_oInputLatency from here on.
 */
-void CKeyQueue::DequeueKeys( int a_iToTime )
+void CKeyQueue::DequeueKeys( int a_iToTime, std::string* a_psOutRecord )
 {
 	while ( m_oKeys.size() > 0
 		&& m_oKeys.back().iTime <= a_iToTime )
 	{
 		SEnqueuedKey& roKey = m_oKeys.back();
 		debug( "Dequeued key at %d tick: %d time, %d player, %d key, %d down\n", a_iToTime, roKey.iTime, roKey.iPlayer, roKey.iKey, roKey.bDown );
-		g_oBackend.PerlEvalF( roKey.bDown ? "KeyDown(%d,%d);" : "KeyUp(%d,%d);", roKey.iPlayer, roKey.iKey );
+		g_oBackend.PerlCall( roKey.bDown ? "KeyDown" : "KeyUp", roKey.iPlayer, roKey.iKey );
+		g_oGameCapture.AddKey( roKey.iPlayer, roKey.iKey, roKey.bDown );
+		if ( roKey.bDown && roKey.dEventNs > 0.0 )
+		{
+			g_oInputLatency.KeyApplied( roKey.dEventNs );
+		}
+		if ( a_psOutRecord )
+		{
+			char acBuffer[64];
+			sprintf( acBuffer, "K %d %d %d %d\n", a_iToTime, roKey.iPlayer, roKey.iKey, roKey.bDown );
+			*a_psOutRecord += acBuffer;
+		}
 		m_oKeys.pop_back();
 	}
 }
@@ -189,7 +214,13 @@ Game::Game( bool a_bIsReplay, bool a_bWide, bool a_bDebug)
 		mg_iBackgroundNumber = 1;
 	}
 	
-	m_poDoodads = LoadBackground( "Doodads.png", 48, 64, true );
+	// The next game's background is loaded while this one is played.
+	if ( !IsNetworkGame() )
+	{
+		Background::Prefetch( mg_iBackgroundNumber );
+	}
+	
+	m_oDoodads = g_oAssetCache.GetBackground( "Doodads.png", 48, 64 );
 	
 	int i;
 	for ( i=0; i<g_oState.m_iNumPlayers; ++i )
@@ -203,7 +234,11 @@ Game::Game( bool a_bIsReplay, bool a_bWide, bool a_bDebug)
 	m_iNumberOfRounds = 0;
 
 	SDL_EnableUNICODE( 0 );
-	m_iEnqueueDelay = 10;
+	// Only network games need the lag; local keys go to the very next tick.
+	m_iEnqueueDelay = IsNetworkGame() ? 10 : 0;
+	m_dInterpolation = 1.0;
+	m_iTickAllocations = 0;
+	m_iNumTicks = 0;
 
 }
 
@@ -212,8 +247,7 @@ Game::~Game()
 {
 	delete m_poBackground;
 	m_poBackground = NULL;
-	SDL_FreeSurface( m_poDoodads );
-	m_poDoodads = NULL;
+	m_oDoodads.Release();
 }
 
 
@@ -230,8 +264,9 @@ int Game::Run()
 		// 1. START A ROUND
 		// This will update m_iNumberOfRounds and m_aiRoundsWonByPlayer[]
 
-		m_sReplayString = "";
-		m_aReplayOffsets.clear();
+		m_aoReplayTicks.clear();
+		m_oReplayStrings.Clear();
+		m_sReplayInputs = "";
 		DoOneRound();
 		
 		if ( g_oState.m_bQuitFlag 
@@ -258,11 +293,58 @@ int Game::Run()
 }
 
 
-/** Returns the replay string of the last round.
+/** Returns true if the last round has any ticks to save with SaveReplay().
 */
-std::string& Game::GetReplay()
+bool Game::HasReplay() const
 {
-	return m_sReplayString;
+	return m_aoReplayTicks.size() > 0;
+}
+
+
+/** Returns the average number of allocations in the game ticks of the last
+round (see GetNumberOfAllocations()). Once the buffers of the round are
+reserved, a tick should not need to allocate memory at all. */
+double Game::GetAllocationsPerTick() const
+{
+	return m_iNumTicks > 0 ? (double) m_iTickAllocations / m_iNumTicks : 0.0;
+}
+
+
+/** Saves the last round into a replay file.
+
+The first line contains the two fighters, followed by the replay format
+version, the hit points, number of players, team size and wide mode which
+were passed to GameStart, and the game speed (milliseconds per tick; since
+version 3). Next come the recorded inputs ("K tick player key
+down" and "T tick player fighter" lines) and finally one scene line per
+game tick, as written by Backend::WriteToString().
+
+The tick of a "K" line is the game tick before the advance: the key was
+sent to the backend right before the backend advanced from that tick (see
+Advance()), so a key of the GameStart tick is in the first scene. A "T"
+line has the tick after the advance; the team member was changed after
+the scene of that tick. Before version 4 the keys were sent after the
+tick, so no key was recorded with the GameStart tick, and the "K" lines of
+a tick came before its "T" lines; both orders simulate the same way.
+
+The inputs allow the replay to be simulated again (see DoReplayCheck());
+DoReplay() only needs the scene lines.
+
+During the round only the binary SCaptureTick records are kept; the scene
+lines are formatted here, after the game. This puts each recorded scene
+into g_oBackend in turn.
+*/
+void Game::SaveReplay( const char* a_pcReplayFile )
+{
+	std::ofstream oOutput( a_pcReplayFile );
+	oOutput << m_sReplayHeader << m_sReplayInputs;
+
+	for ( unsigned int i=0; i<m_aoReplayTicks.size(); ++i )
+	{
+		RestoreScene( m_aoReplayTicks[i], m_oReplayStrings );
+		g_oBackend.WriteToString( m_sFrameDesc );
+		oOutput << m_sFrameDesc << '\n';
+	}
 }
 
 
@@ -291,7 +373,7 @@ void Game::DrawHitPointDisplay( int a_iPlayer )
 	oDstRect.y = iY + m_iYOffset;
 	oDstRect.x = iX + oSrcRect.x + (bLeft ? 36 : 0 );
 
-	SDL_BlitSurface( m_poDoodads, &oSrcRect, gamescreen, &oDstRect );
+	SDL_BlitSurface( m_oDoodads.Get(), &oSrcRect, gamescreen, &oDstRect );
 	
 	// The red part
 	if ( bLeft ) 
@@ -300,7 +382,7 @@ void Game::DrawHitPointDisplay( int a_iPlayer )
 		oDstRect.x = iX;
 	oSrcRect.x = (100+iHp) * 2;
 	oSrcRect.w = (100-iHp) * 2;
-	SDL_BlitSurface( m_poDoodads, &oSrcRect, gamescreen, &oDstRect );
+	SDL_BlitSurface( m_oDoodads.Get(), &oSrcRect, gamescreen, &oDstRect );
 
 	// The "won" icon
 	
@@ -312,7 +394,7 @@ void Game::DrawHitPointDisplay( int a_iPlayer )
 	{
 		oDstRect.x = iX + (bLeft ? 0 : 204);
 		oDstRect.y = iY-4 + m_iYOffset;
-		SDL_BlitSurface( m_poDoodads, &oSrcRect , gamescreen, &oDstRect );
+		SDL_BlitSurface( m_oDoodads.Get(), &oSrcRect , gamescreen, &oDstRect );
 	}
 	
 	int iTextW = g_oPlayerSelect.GetFighterNameWidth(a_iPlayer);
@@ -350,37 +432,37 @@ void Game::DrawHitPointDisplays()
 	dst.x = 40;
 	src.x = 0;
 	src.w = hp1*2;
-	SDL_BlitSurface( m_poDoodads, &src, gamescreen, &dst );
+	SDL_BlitSurface( m_oDoodads.Get(), &src, gamescreen, &dst );
 
 	// Player 1, red part.
 	dst.x += hp1*2;
 	src.x = (100 + hp1)*2;
 	src.w = (100-hp1)*2;
-	SDL_BlitSurface( m_poDoodads, &src, gamescreen, &dst );
+	SDL_BlitSurface( m_oDoodads.Get(), &src, gamescreen, &dst );
 
 	// Player 2, red part.
 	dst.x = 400;
 	src.x = 200;
 	src.w = (100-hp2)*2;
-	SDL_BlitSurface( m_poDoodads, &src, gamescreen, &dst );
+	SDL_BlitSurface( m_oDoodads.Get(), &src, gamescreen, &dst );
 	
 	// Player 2, green part.
 	dst.x = 400 + (100-hp2)*2;
 	src.x = (100-hp2)*2;
 	src.w = hp2*2;
-	SDL_BlitSurface( m_poDoodads, &src, gamescreen, &dst );
+	SDL_BlitSurface( m_oDoodads.Get(), &src, gamescreen, &dst );
 	
 	// "Won" icon for Player 1
 	src.x = 0; src.y = 276; src.w = 32; src.h = 32;
 	if ( m_aiRoundsWonByPlayer[0] > 0 )
 	{
 		dst.x = 4; dst.y = 11 + m_iYOffset;
-		SDL_BlitSurface( m_poDoodads, &src, gamescreen, &dst );
+		SDL_BlitSurface( m_oDoodads.Get(), &src, gamescreen, &dst );
 	}
 	if ( m_aiRoundsWonByPlayer[1] > 0 )
 	{
 		dst.x = 604; dst.y = 11 + m_iYOffset;
-		SDL_BlitSurface( m_poDoodads, &src, gamescreen, &dst );
+		SDL_BlitSurface( m_oDoodads.Get(), &src, gamescreen, &dst );
 	}
 
 	int iTextX = 230 - g_oPlayerSelect.GetFighterNameWidth(0);
@@ -400,7 +482,22 @@ void Game::DrawHitPointDisplays()
 */
 void Game::DrawBackground()
 {
-	m_poBackground->Draw( g_oBackend.m_iBgX, g_oBackend.m_iBgY, m_iYOffset );
+	m_poBackground->Draw( Interpolate( m_oLastPositions.m_iBgX, g_oBackend.m_iBgX ),
+		Interpolate( m_oLastPositions.m_iBgY, g_oBackend.m_iBgY ), m_iYOffset );
+}
+
+
+/** Returns a position between its value before the last tick and its
+current value, according to m_dInterpolation. Things that moved too far
+in one tick (teleported, or are a different thing) are not interpolated. */
+
+int Game::Interpolate( int a_iLast, int a_iCurrent ) const
+{
+	if ( m_dInterpolation >= 1.0 || ABS( a_iCurrent - a_iLast ) > 100 )
+	{
+		return a_iCurrent;
+	}
+	return a_iLast + (int) floor( ( a_iCurrent - a_iLast ) * m_dInterpolation + 0.5 );
 }
 
 
@@ -466,16 +563,25 @@ void Game::DrawDoodads()
 	for ( int i=0; i<g_oBackend.m_iNumDoodads; ++i )
 	{
 		Backend::SDoodad& roDoodad = g_oBackend.m_aoDoodads[i];
+		int x = roDoodad.m_iX;
+		int y = roDoodad.m_iY;
+		if ( i < m_oLastPositions.m_iNumDoodads
+			&& roDoodad.m_iType == m_oLastPositions.m_aiDoodadType[i] )
+		{
+			x = Interpolate( m_oLastPositions.m_aiDoodadX[i], x );
+			y = Interpolate( m_oLastPositions.m_aiDoodadY[i], y );
+		}
+		
 		if ( 0 == roDoodad.m_iType )
 		{
 			// Handle text doodads
 			const char *s = roDoodad.m_sText.c_str();
 			
 			int iWidth = sge_BF_TextSize(fastFont, s).w;
-			int iDoodadX = roDoodad.m_iX - iWidth/2;
+			int iDoodadX = x - iWidth/2;
 			if ( iDoodadX + iWidth > gamescreen->w ) iDoodadX = gamescreen->w - iWidth;
 			if ( iDoodadX < 0 ) iDoodadX = 0;
-			int iDoodadY = roDoodad.m_iY;
+			int iDoodadY = y;
 			
 			sge_BF_textout( gamescreen, fastFont, s, iDoodadX, iDoodadY + m_iYOffset );
 			continue;
@@ -484,15 +590,15 @@ void Game::DrawDoodads()
 		if ( roDoodad.m_iGfxOwner >= 0 )
 		{
 			g_oPlayerSelect.GetPlayerInfo(roDoodad.m_iGfxOwner).m_poPack->Draw( 
-				roDoodad.m_iFrame, roDoodad.m_iX, roDoodad.m_iY + m_iYOffset, roDoodad.m_iDir < 1 );
+				roDoodad.m_iFrame, x, y + m_iYOffset, roDoodad.m_iDir < 1 );
 			continue;
 		}
 
 
 		SDL_Rect rsrc, rdst;
 		int w, h, y0;
-		rdst.x = roDoodad.m_iX;
-		rdst.y = roDoodad.m_iY + m_iYOffset;
+		rdst.x = x;
+		rdst.y = y + m_iYOffset;
 		if ( 5 == roDoodad.m_iType )
 		{
 			y0 = 308;
@@ -508,7 +614,7 @@ void Game::DrawDoodads()
 		rsrc.w = w;
 		rsrc.h = h;
 		
-		SDL_BlitSurface( m_poDoodads, &rsrc, gamescreen, &rdst );
+		SDL_BlitSurface( m_oDoodads.Get(), &rsrc, gamescreen, &rdst );
 		//debug( "Doodad x: %d, y: %d, t: %d, f: %d\n", dx, dy, dt, df );
 	}
 }
@@ -534,6 +640,7 @@ Input:
 void Game::Draw()
 {
 	#define GROUNDZERO (440 + m_iYOffset)
+	CTraceScope oTrace( "Draw" );
 
 	m_iYOffset = ( gamescreen->h - 480 ) / 2;
 
@@ -551,10 +658,15 @@ void Game::Draw()
 		SDL_SetClipRect( gamescreen, NULL );
 	}
 	
-	DrawBackground();
+	{
+		CProfileScope oScope( Pp_BACKGROUND );
+		DrawBackground();
+	}
 
 	// DRAW THE SHADOWS
 
+	double dSpritesNs = GetNanoseconds();
+	long iSpritesAllocations = GetNumberOfAllocations();
 	int i;
 
 	for ( i=0; i<g_oState.m_iNumPlayers; ++i )
@@ -567,8 +679,10 @@ void Game::Draw()
 		RlePack* poPack = g_oPlayerSelect.GetPlayerInfo(i).m_poPack;
 		int w = poPack->GetWidth( ABS(iFrame)-1 );
 		int h = poPack->GetHeight( ABS(iFrame)-1 );
+		int x = Interpolate( m_oLastPositions.m_aiPlayerX[i], roPlayer.m_iX );
+		int y = Interpolate( m_oLastPositions.m_aiPlayerY[i], roPlayer.m_iY );
 		
-		h = GROUNDZERO - ( h + roPlayer.m_iY );	// Distance of feet from ground
+		h = GROUNDZERO - ( h + y );	// Distance of feet from ground
 		if ( h < 0 ) h = 0;
 		if ( h > 500 ) h = 500;
 		h = 500 - h;
@@ -577,12 +691,12 @@ void Game::Draw()
 
 		if ( gamescreen->format->BitsPerPixel <= 8 )
 		{
-			sge_FilledEllipse( gamescreen, g_oBackend.m_aoPlayers[i].m_iX + w/2, GROUNDZERO,
+			sge_FilledEllipse( gamescreen, x + w/2, GROUNDZERO,
 				h, h2, C_BLACK );
 		}
 		else
 		{
-			sge_FilledEllipseAlpha( gamescreen, g_oBackend.m_aoPlayers[i].m_iX + w/2, GROUNDZERO,
+			sge_FilledEllipseAlpha( gamescreen, x + w/2, GROUNDZERO,
 				h, h2, C_BLACK, 128 );
 		}
 	}
@@ -595,7 +709,8 @@ void Game::Draw()
 			continue;
 
 		RlePack* poPack = g_oPlayerSelect.GetPlayerInfo(i).m_poPack;
-		poPack->Draw( ABS(iFrame)-1, roPlayer.m_iX, roPlayer.m_iY + m_iYOffset, iFrame<0 );
+		poPack->Draw( ABS(iFrame)-1, Interpolate( m_oLastPositions.m_aiPlayerX[i], roPlayer.m_iX ),
+			Interpolate( m_oLastPositions.m_aiPlayerY[i], roPlayer.m_iY ) + m_iYOffset, iFrame<0 );
 	}
 	
 	if ( m_bDebug )
@@ -611,20 +726,25 @@ void Game::Draw()
 	}
 
 	DrawDoodads();
+	
+	double dHudNs = GetNanoseconds();
+	long iHudAllocations = GetNumberOfAllocations();
+	g_oProfiler.Add( Pp_SPRITES, dHudNs - dSpritesNs, iHudAllocations - iSpritesAllocations );
+	
 	DrawHitPointDisplays();
 
 	if ( Ph_NORMAL == m_enGamePhase )
 	{
 		char s[100];
 		sprintf( s, "%d", m_iGameTime );	// m_iGameTime is maintained by DoGame
-		DrawTextMSZ( s, inkFont, 320, 10 + m_iYOffset, AlignHCenter, C_LIGHTCYAN, gamescreen, false );
+		m_oTimeText.Draw( s, inkFont, 320, 10 + m_iYOffset, AlignHCenter, C_LIGHTCYAN, gamescreen );
 	}
 	else if ( Ph_START == m_enGamePhase )
 	{
 		char s[100];
 		const char* format = Translate( "Round %d" );
 		sprintf( s, format, m_iNumberOfRounds+1 );
-		DrawTextMSZ( s, inkFont, 320, 200 + m_iYOffset, AlignHCenter, C_WHITE, gamescreen, false );
+		m_oTimeText.Draw( s, inkFont, 320, 200 + m_iYOffset, AlignHCenter, C_WHITE, gamescreen );
 	}
 	else if ( Ph_REWIND == m_enGamePhase )
 	{
@@ -645,8 +765,17 @@ void Game::Draw()
 	{
 		sge_BF_textoutf( gamescreen, fastFont, 2, 455 + m_iYOffset, "%d fps", oFpsCounter.m_iFps );
 	}
+	g_oProfiler.Add( Pp_HUD, GetNanoseconds() - dHudNs, GetNumberOfAllocations() - iHudAllocations );
+	
+	if ( g_oProfiler.IsOverlayOn() )
+	{
+		g_oProfiler.DrawOverlay( gamescreen, 10, 40 + m_iYOffset );
+	}
 	
+	CProfileScope oScope( Pp_FLIP );
+	CTraceScope oFlipTrace( "Flip" );
 	SDL_Flip( gamescreen );
+	g_oInputLatency.FrameShown( GetNanoseconds() );
 }
 
 
@@ -679,8 +808,8 @@ bool Game::IsMaster()
 
 /**
 This method reads and updates the game's variables. In replay mode,
-this is done by parsing the replay string. Otherwise the perl
-backend is advanced the given number of steps.
+this is done by restoring the recorded ticks. Otherwise the perl
+backend is advanced the given number of steps, and each tick is recorded.
 
 Whichever the case, the variables will be available in g_oBackend.
 
@@ -696,17 +825,15 @@ void Game::Advance( int a_iNumFrames )
 		// Replay mode...
 
 		m_iFrame += a_iNumFrames;
-		if ( m_iFrame >= ((int)m_aReplayOffsets.size())-1 ) m_iFrame = m_aReplayOffsets.size() - 2;
+		if ( m_iFrame >= (int)m_aoReplayTicks.size() ) m_iFrame = m_aoReplayTicks.size() - 1;
 		if ( m_iFrame <= 0 ) m_iFrame = 0;
-		std::string sFrameDesc = m_sReplayString.substr(
-			m_aReplayOffsets[m_iFrame],
-			m_aReplayOffsets[m_iFrame+1] - m_aReplayOffsets[m_iFrame] );
-		
-		g_oBackend.ReadFromString( sFrameDesc );
+		if ( m_aoReplayTicks.size() )
+		{
+			RestoreScene( m_aoReplayTicks[m_iFrame], m_oReplayStrings );
+		}
 		return;
 	}
 
-	static std::string sFrameDesc;
 	int i;
 	
 	if ( IsNetworkGame() )
@@ -746,19 +873,36 @@ void Game::Advance( int a_iNumFrames )
 		}
 	}
 	
+	long iAllocations = GetNumberOfAllocations();
+	m_iNumTicks += a_iNumFrames;
+	
 	while ( a_iNumFrames > 0 )
 	{
 		-- a_iNumFrames;
-		g_oBackend.AdvancePerl();
-		g_oBackend.ReadFromPerl();
+		{
+			// The keys due now are sent right before the tick which
+			// consumes them, not after the previous one.
+			CProfileScope oScope( Pp_INPUT );
+			m_oKeyQueue.DequeueKeys( g_oBackend.m_iGameTick, &m_sReplayInputs );
+		}
+		g_oBackend.SavePositions( m_oLastPositions );
+		{
+			CProfileScope oScope( Pp_ADVANCE );
+			g_oBackend.AdvancePerl();
+		}
+		{
+			CProfileScope oScope( Pp_READ );
+			g_oBackend.ReadFromPerl();
+		}
 		g_oBackend.PlaySounds();
-		m_oKeyQueue.DequeueKeys( g_oBackend.m_iGameTick );
 		
-		g_oBackend.WriteToString( sFrameDesc );
-		m_sReplayString += sFrameDesc;
-		m_sReplayString += '\n';
-		m_aReplayOffsets.push_back( m_sReplayString.size() );
+		m_aoReplayTicks.resize( m_aoReplayTicks.size() + 1 );
+		SCaptureTick& roTick = m_aoReplayTicks.back();
+		CaptureScene( roTick, m_oReplayStrings );
+		g_oGameCapture.CaptureTick( roTick, m_oReplayStrings );
 	}
+	
+	m_iTickAllocations += GetNumberOfAllocations() - iAllocations;
 }
 
 
@@ -768,7 +912,7 @@ players. It is only called when keypresses are actually relevant for the
 backend (not during instant replay, etc).
 */
 
-void Game::HandleKey( int a_iPlayer, int a_iKey, bool a_bDown )
+void Game::HandleKey( int a_iPlayer, int a_iKey, bool a_bDown, double a_dEventNs )
 {
 	int iCurrentTick = g_oBackend.m_iGameTick + m_iEnqueueDelay;
 	
@@ -779,7 +923,7 @@ void Game::HandleKey( int a_iPlayer, int a_iKey, bool a_bDown )
 		g_poNetwork->SendKeystroke( iCurrentTick, a_iKey, a_bDown );
 	}
 	
-	m_oKeyQueue.EnqueueKey( iCurrentTick, a_iPlayer, a_iKey, a_bDown );
+	m_oKeyQueue.EnqueueKey( iCurrentTick, a_iPlayer, a_iKey, a_bDown, a_dEventNs );
 }
 
 
@@ -793,7 +937,10 @@ Returns 1 on quit event (e.g. if the current game or replay should be aborted),
 
 int Game::ProcessEvents()
 {
+	CProfileScope oScope( Pp_INPUT );
+	CTraceScope oTrace( "ProcessEvents" );
 	SMortalEvent oEvent;
+	g_oInputLatency.Polled( GetNanoseconds() );
 	
 	while (MortalPollEvent(oEvent))
 	{
@@ -829,7 +976,7 @@ int Game::ProcessEvents()
 					Ph_REPLAY != m_enGamePhase )
 					break;
 					
-				HandleKey( oEvent.m_iPlayer, oEvent.m_iKey, Me_PLAYERKEYDOWN == oEvent.m_enType );
+				HandleKey( oEvent.m_iPlayer, oEvent.m_iKey, Me_PLAYERKEYDOWN == oEvent.m_enType, oEvent.m_dNs );
 				break;
 			}
 
@@ -872,28 +1019,19 @@ Rewind will go back in time 200 ticks before the parameter a_iKoAt.
 */
 void Game::InstantReplay( int a_iKoAt )
 {
-	int iCurrentFrame = m_aReplayOffsets.size() - 200;
-	int iThisTick, iLastTick, iGameSpeed;
-	
+	int iCurrentFrame = m_aoReplayTicks.size() - 200;
 	m_enGamePhase = Ph_REWIND;
-	iGameSpeed = 8;
-	iThisTick = SDL_GetTicks() / iGameSpeed;
-	iLastTick = iThisTick - 1;
+	m_oFramePacer.Start( 8 );
 	
-	while ( iCurrentFrame < (int)m_aReplayOffsets.size() - 150 )
+	while ( iCurrentFrame < (int)m_aoReplayTicks.size() - 150 )
 	{
-		// 1. Wait for the next tick (on extremely fast machines..)
-		while (iThisTick == iLastTick)
-		{
-			iThisTick = SDL_GetTicks() / iGameSpeed;
-			if ( iThisTick==iLastTick ) SDL_Delay(1);
-		}
+		// 1. Wait for the next tick
+		
+		int iNumTicks = m_oFramePacer.WaitForNextTick();
 		
 		// 2. Advance as many ticks as necessary..
 		
-		int iNumTicks = iThisTick - iLastTick;
 		if ( iNumTicks > 10 ) iNumTicks = 10;
-		if ( iNumTicks < 0 ) iNumTicks = 0;
 		iCurrentFrame += ( Ph_REWIND == m_enGamePhase ) ? -iNumTicks : +iNumTicks	;
 		
 		if ( Ph_REWIND == m_enGamePhase
@@ -901,23 +1039,16 @@ void Game::InstantReplay( int a_iKoAt )
 		)
 		{
 			m_enGamePhase = Ph_SLOWFORWARD;
-			iGameSpeed = 16;
 			SDL_Delay(500);
+			m_oFramePacer.Start( 16 );
 		}
-		iLastTick = iThisTick;
 		if ( iCurrentFrame < 0 ) iCurrentFrame = 0;
 
 		m_iFrame = iCurrentFrame;
-		if ( m_iFrame >= ((int)m_aReplayOffsets.size())-1 ) m_iFrame = m_aReplayOffsets.size() - 2;		
+		if ( m_iFrame >= (int)m_aoReplayTicks.size() ) m_iFrame = m_aoReplayTicks.size() - 1;
 		if ( m_iFrame <= 0 ) m_iFrame = 0;
-		std::string sFrameDesc = m_sReplayString.substr(
-			m_aReplayOffsets[m_iFrame],
-			m_aReplayOffsets[m_iFrame+1] - m_aReplayOffsets[m_iFrame] );
-		
-		//debug( "PB: Frame %d ofs %d-%d; data: '%s'\n", m_iFrame,
-		//	m_aReplayOffsets[m_iFrame], m_aReplayOffsets[m_iFrame+1], sFrameDesc.c_str() );
 		
-		g_oBackend.ReadFromString( sFrameDesc );
+		RestoreScene( m_aoReplayTicks[m_iFrame], m_oReplayStrings );
 		
 		if ( ProcessEvents() )
 		{
@@ -968,13 +1099,36 @@ void Game::DoOneRound()
 		}
 	}
 	
+	// Load the sounds of every fighter in the round now, rather than on
+	// their first use.
+	
+	for ( int i=0; i<g_oState.m_iNumPlayers; ++i )
+	{
+		const PlayerInfo& roInfo = g_oPlayerSelect.GetPlayerInfo(i);
+		g_oBackend.PreloadFighterSounds( roInfo.m_enFighter );
+		for ( unsigned int j=0; IsTeamMode() && j<roInfo.m_aenTeam.size(); ++j )
+		{
+			g_oBackend.PreloadFighterSounds( roInfo.m_aenTeam[j] );
+		}
+	}
+	
+	int iHitPoints = IsMaster() ? g_oState.m_iHitPoints : g_poNetwork->GetGameParams().iHitPoints;
 	g_oBackend.PerlEvalF( "GameStart(%d,%d,%d,%d,%d);",
-		IsMaster() ? g_oState.m_iHitPoints : g_poNetwork->GetGameParams().iHitPoints,
+		iHitPoints,
 		g_oState.m_iNumPlayers,
 		iTeamSize,
 		m_bWide,
 		m_bDebug );
 	g_oBackend.ReadFromPerl();
+	g_oBackend.SavePositions( m_oLastPositions );
+
+	char acHeader[128];
+	sprintf( acHeader, "%d %d %d %d %d %d %d %d\n",
+		g_oPlayerSelect.GetPlayerInfo(0).m_enFighter,
+		g_oPlayerSelect.GetPlayerInfo(1).m_enFighter,
+		REPLAY_VERSION, iHitPoints, g_oState.m_iNumPlayers, iTeamSize, m_bWide,
+		IsMaster() ? g_oState.m_iGameSpeed : g_poNetwork->GetGameParams().iGameSpeed );
+	m_sReplayHeader = acHeader;
 
 	if ( IsNetworkGame() )
 	{
@@ -984,14 +1138,26 @@ void Game::DoOneRound()
 
 	int iKoFrame = -1;
 	double dGameTime = 2 * 1000;	// Only for the "greeting phase", the real gametime will be set after.
-	int iThisTick, iLastTick, iGameSpeed;
+	int iGameSpeed;
 	bool bHurryUp = false;
 	bool bReplayAfter = true;
 	
 	iGameSpeed = IsMaster() ? g_oState.m_iGameSpeed : g_poNetwork->GetGameParams().iGameSpeed;
-	iThisTick = SDL_GetTicks() / iGameSpeed;
-	iLastTick = iThisTick - 1;
+	int iRenderFps = g_oState.m_iRenderFps;
+	m_oFramePacer.Start( iGameSpeed );
+	m_oFramePacer.ResetStatistics();
 	m_oKeyQueue.Reset();
+	g_oInputLatency.Reset();
+	
+	// Reserve the replay of the whole round (the start, the round and the
+	// KO), so the ticks do not have to grow it.
+	
+	int iRoundTicks = ( 2 + g_oState.m_iGameTime + 10 ) * 1000 / MAX( iGameSpeed, 1 );
+	m_aoReplayTicks.reserve( iRoundTicks );
+	m_sReplayInputs.reserve( 16384 );
+	m_sFrameDesc.reserve( 2048 );
+	m_iTickAllocations = 0;
+	m_iNumTicks = 0;
 	
 	oFpsCounter.Reset();
 	
@@ -1004,19 +1170,39 @@ void Game::DoOneRound()
 			return;
 		}
 		
-		// 1. Wait for the next tick (on extremely fast machines..)
-		while (iThisTick == iLastTick)
+		// 1. Wait for the next tick, or with RENDERFPS, for the next frame.
+		// The frames between two ticks are drawn interpolated.
+		
+		int iNumTicks;
 		{
-			iThisTick = SDL_GetTicks() / iGameSpeed;
-			if ( iThisTick==iLastTick ) SDL_Delay(1);
+			CProfileScope oScope( Pp_WAIT );
+			CTraceScope oTrace( "Wait" );
+			iNumTicks = iRenderFps > 0 ? m_oFramePacer.WaitForNextFrame( iRenderFps )
+				: m_oFramePacer.WaitForNextTick();
+		}
+		g_oProfiler.BeginFrame();
+		
+		// ProcessEvents will read keyboard/gamepad input
+		// It will also transmit them to the remote side in a network game.
+		// It is called right before the ticks, so the keys pressed while
+		// waiting are in them.
+		
+		if ( ProcessEvents() || g_oState.m_bQuitFlag )
+		{
+			bReplayAfter = false;
+			break;
 		}
 		
 		// 2. Advance as many ticks as necessary..
 
-		int iNumTicks = iThisTick - iLastTick;
 		if ( iNumTicks > MAXFRAMESKIP ) iNumTicks = MAXFRAMESKIP;		
-		Advance( iNumTicks );
+		if ( iNumTicks > 0 )
+		{
+			CTraceScope oTrace( "Advance" );
+			Advance( iNumTicks );
+		}
 		dGameTime -= iNumTicks * iGameSpeed;
+		m_dInterpolation = iRenderFps > 0 ? m_oFramePacer.GetTickFraction() : 1.0;
 
 		// 3. Check for state transitions and game time.
 		// START -> NORMAL
@@ -1038,15 +1224,18 @@ void Game::DoOneRound()
 				&& !bHurryUp )
 			{
 				bHurryUp = true;
+				g_oTracer.Instant( "HurryUp" );
 				g_poNetwork->SendHurryup( 1 );
 				HurryUp();
 				iGameSpeed = iGameSpeed * 3 / 4;
+				m_oFramePacer.Start( iGameSpeed );	// HurryUp() paused the game.
 			}
 			if ( g_oBackend.m_bKO )
 			{
 				m_enGamePhase = Ph_KO;
+				g_oTracer.Instant( "KO" );
 				dGameTime = 10 * 1000;
-				iKoFrame = m_aReplayOffsets.size();
+				iKoFrame = m_aoReplayTicks.size();
 			}
 			else if ( dGameTime <= 0 )
 			{
@@ -1059,17 +1248,6 @@ void Game::DoOneRound()
 			
 		m_iGameTime = (int) ((dGameTime + 500.0) / 1000.0);
 		
-		iLastTick = iThisTick;
-		
-		// ProcessEvents will read keyboard/gamepad input
-		// It will also transmit them to the remote side in a network game.
-		
-		if ( ProcessEvents() || g_oState.m_bQuitFlag )
-		{
-			bReplayAfter = false;
-			break;
-		}
-		
 		oFpsCounter.Tick();
 		
 		// 3. Draw the next game screen..
@@ -1078,7 +1256,7 @@ void Game::DoOneRound()
 
 		// 4. Check 'end of round' condition.
 
-		for ( int i=0; i<g_oState.m_iNumPlayers; ++i )
+		for ( int i=0; i<g_oState.m_iNumPlayers && iNumTicks > 0; ++i )
 		{
 			if ( g_oBackend.m_aoPlayers[i].m_iRealHitPoints <= -10000 ) 
 			{
@@ -1091,6 +1269,10 @@ void Game::DoOneRound()
 
 					g_oPlayerSelect.SetPlayer( i, enFighter );
 					g_oBackend.PerlEvalF( "NextTeamMember(%d,%d);", i, enFighter );
+
+					char acBuffer[64];
+					sprintf( acBuffer, "T %d %d %d\n", g_oBackend.m_iGameTick, i, enFighter );
+					m_sReplayInputs += acBuffer;
 				}
 			}
 		}
@@ -1109,6 +1291,12 @@ void Game::DoOneRound()
 		}
 	}
 	
+	m_oFramePacer.Report( "Frame pacing" );
+	debug( "%d game ticks, %.2f allocations per tick\n", m_iNumTicks, GetAllocationsPerTick() );
+	g_oInputLatency.Report( "Input latency" );
+	g_oProfiler.Stop();
+	m_dInterpolation = 1.0;
+	
 	int p1h = g_oBackend.m_aoPlayers[0].m_iRealHitPoints;
 	int p2h = g_oBackend.m_aoPlayers[1].m_iRealHitPoints;
 	
@@ -1157,28 +1345,27 @@ void Game::DoReplay( const char* a_pcReplayFile )
 	
 	std::string sLine;
 	std::getline( oInput, sLine );
+	
+	// Skip the recorded inputs, we only need the scenes.
+	while ( 'K' == oInput.peek() || 'T' == oInput.peek() )
+	{
+		std::getline( oInput, sLine );
+	}
+	
 	g_oPlayerSelect.SetPlayer( 0, (FighterEnum) iPlayer1 );
 	g_oPlayerSelect.SetPlayer( 1, (FighterEnum) iPlayer2 );
 	
-	int iThisTick, iLastTick, iGameSpeed;
-	
 	m_enGamePhase = Ph_REPLAY;
-	iGameSpeed = 12;
-	iThisTick = SDL_GetTicks() / iGameSpeed;
-	iLastTick = iThisTick - 1;
+	m_oFramePacer.Start( 12 );
 	
 	while ( std::getline( oInput, sLine ) )
 	{
-		// 1. Wait for the next tick (on extremely fast machines..)
-		while (iThisTick == iLastTick)
-		{
-			iThisTick = SDL_GetTicks() / iGameSpeed;
-			if ( iThisTick==iLastTick ) SDL_Delay(1);
-		}
+		// 1. Wait for the next tick
+		
+		int iNumTicks = m_oFramePacer.WaitForNextTick();
 		
 		// 2. Advance as many ticks as necessary..
 		
-		int iNumTicks = iThisTick - iLastTick;
 		if ( iNumTicks > 5 ) iNumTicks = 5;
 		
 		for ( int i=0; i< iNumTicks; ++i )
@@ -1190,8 +1377,6 @@ void Game::DoReplay( const char* a_pcReplayFile )
 			break;
 		}
 		
-		iLastTick = iThisTick;
-		
 		g_oBackend.ReadFromString( sLine );
 		
 		if ( ProcessEvents() )
@@ -1229,7 +1414,8 @@ the definition of this method (defined in "common.h"). The method runs
 a cycle of the game (either a normal game, or replay).
 
 In replay mode, DoReplay() is called, and the replay file is required.
-In normal mode, Run() is called. The replay file is recorded, if it is not NULL.
+In normal mode, Run() is called. The replay file is recorded, if it is not NULL,
+and added to the replay library.
 */
 
 int DoGame( char* a_pcReplayFile, bool a_bIsReplay, bool a_bDebug )
@@ -1249,13 +1435,23 @@ int DoGame( char* a_pcReplayFile, bool a_bIsReplay, bool a_bDebug )
 	}
 	else
 	{
+		g_oGameCapture.Start( g_oPlayerSelect.GetPlayerInfo(0).m_enFighter,
+			g_oPlayerSelect.GetPlayerInfo(1).m_enFighter );
+		Audio->ResetStatistics();
 		int iRetval = oGame.Run();
+		g_oGameCapture.Stop();
+		Audio->ReportStatistics();
 		if ( NULL != a_pcReplayFile )
 		{
-			std::ofstream oOutput( a_pcReplayFile );
-			oOutput << 
-				g_oPlayerSelect.GetPlayerInfo(0).m_enFighter << ' ' << 
-				g_oPlayerSelect.GetPlayerInfo(1).m_enFighter << '\n' << oGame.GetReplay();
+			if ( oGame.HasReplay() )
+			{
+				oGame.SaveReplay( a_pcReplayFile );
+				g_oReplayLibrary.AddReplay( a_pcReplayFile, iRetval );
+			}
+			else
+			{
+				remove( a_pcReplayFile );
+			}
 		}
 		return iRetval;
 	}
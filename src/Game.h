@@ -19,7 +19,12 @@ including the game object itself, menus, and connection to the backend.
 
 #include <string>
 #include <vector>
-#include <list>
+
+
+#include "AssetCache.h"
+#include "FramePacer.h"
+#include "gfx.h"
+#include "GameCapture.h"
 
 struct SDL_Surface;
 class Background;
@@ -39,7 +44,7 @@ artificial lag of 10 game ticks.
 
 The actual length of game ticks depends on the game speed (set in the menu),
 for a normal game its 1000/80 = 12.5 ms. This artificial lag is useful for
-network games.
+network games; local games use none, the keys go to the next tick.
 */
 
 class CKeyQueue
@@ -49,8 +54,8 @@ public:
 	~CKeyQueue();
 
 	void Reset();
-	void EnqueueKey( int a_iAtTime, int a_iPlayer, int a_iKey, bool a_bDown );
-	void DequeueKeys( int a_iToTime );
+	void EnqueueKey( int a_iAtTime, int a_iPlayer, int a_iKey, bool a_bDown, double a_dEventNs = 0.0 );
+	void DequeueKeys( int a_iToTime, std::string* a_psOutRecord = NULL );
 
 protected:
 	struct SEnqueuedKey
@@ -59,9 +64,10 @@ protected:
 		int		iPlayer;
 		int		iKey;
 		bool	bDown;
+		double	dEventNs;	///< When the key was read from SDL, 0 for remote keys.
 	};
 
-	typedef std::list<SEnqueuedKey> TEnqueuedKeyList;
+	typedef std::vector<SEnqueuedKey> TEnqueuedKeyList;
 	TEnqueuedKeyList m_oKeys;
 };
 
@@ -83,9 +89,11 @@ public:
 	Game( bool a_bIsReplay, bool m_bWide, bool a_bDebug );
 	~Game();
 	int Run();
-	std::string& GetReplay();
+	bool HasReplay() const;
+	void SaveReplay( const char* a_pcReplayFile );
 	void DoReplay( const char* a_pcReplayFile );
 	static int GetBackgroundNumber();
+	double GetAllocationsPerTick() const;
 	
 protected:
 	void Draw();
@@ -94,13 +102,14 @@ protected:
 	void DrawBackground();
 	void DrawDoodads();
 	void DrawPoly( const char* a_pcName, int a_iColor );
+	int Interpolate( int a_iLast, int a_iCurrent ) const;
 	void AddBodyToBackground( int a_iPlayer );
 	
 	void DoOneRound();
 	
 	void Advance( int a_iNumFrames );
 	int ProcessEvents();
-	void HandleKey( int a_iPlayer, int a_iKey, bool a_bDown );
+	void HandleKey( int a_iPlayer, int a_iKey, bool a_bDown, double a_dEventNs = 0.0 );
 	void HandleKO();
 	
 	void HurryUp();
@@ -121,7 +130,7 @@ protected:
 	int					m_iYOffset;		///< For wide mode.
 	bool				m_bDebug;
 	Background*			m_poBackground;
-	SDL_Surface*		m_poDoodads;
+	CSurfaceHandle		m_oDoodads;
 
 	int					m_aiHitPointDisplayX[MAXPLAYERS];
 	int					m_aiHitPointDisplayY[MAXPLAYERS];
@@ -133,9 +142,18 @@ protected:
 	int					m_iGameTime;
 	CKeyQueue			m_oKeyQueue;
 	int					m_iEnqueueDelay;
+	CFramePacer			m_oFramePacer;
+	Backend::SPositions	m_oLastPositions;	///< The positions before the last tick.
+	double				m_dInterpolation;	///< Where Draw() is between m_oLastPositions (0) and the current ones (1).
 	
-	std::string			m_sReplayString;
-	std::vector<int>	m_aReplayOffsets;
+	std::vector<SCaptureTick>	m_aoReplayTicks;	///< The scene of every tick of the last round.
+	CCaptureStrings		m_oReplayStrings;	///< The strings of m_aoReplayTicks.
+	std::string			m_sReplayHeader;	///< Fighters and GameStart parameters of the last round.
+	std::string			m_sReplayInputs;	///< Keys and team changes of the last round, see SaveReplay().
+	std::string			m_sFrameDesc;		///< A scene line being written by SaveReplay().
+	long				m_iTickAllocations;	///< Allocations in the ticks of the last round.
+	int					m_iNumTicks;
+	CCachedText			m_oTimeText;		///< The time left, or "Round X".
 	
 	enum TGamePhaseEnum		// This enum assumes its values during DoOneRound
 	{
@@ -0,0 +1,471 @@
+/***************************************************************************
+                          GameCapture.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "GameCapture.h"
+#include "ReplayLibrary.h"
+#include "Backend.h"
+#include "State.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include <string.h>
+#include <string>
+
+
+#define CAPTURE_VERSION 2
+#define CAPTURE_HEADERSIZE 24
+
+#if MAXDOODADS != CAPTURE_MAXDOODADS || MAXSOUNDS != CAPTURE_MAXSOUNDS
+#error "The capture records must hold every doodad and sound of the backend."
+#endif
+
+
+CGameCapture g_oGameCapture;
+
+
+static void WriteUint32( FILE* a_poFile, Uint32 a_iValue )
+{
+	Uint8 acBytes[4];
+	acBytes[0] = a_iValue & 0xff;
+	acBytes[1] = (a_iValue >> 8) & 0xff;
+	acBytes[2] = (a_iValue >> 16) & 0xff;
+	acBytes[3] = (a_iValue >> 24) & 0xff;
+	fwrite( acBytes, 4, 1, a_poFile );
+}
+
+
+
+/***************************************************************************
+                    CAPTURE STRINGS AND SCENES
+***************************************************************************/
+
+
+CCaptureStrings::CCaptureStrings()
+{
+	m_iGeneration = 0;
+	m_bFull = false;
+}
+
+
+void CCaptureStrings::Clear()
+{
+	m_asStrings.clear();
+	m_oIndexes.clear();
+	++m_iGeneration;
+	m_bFull = false;
+}
+
+
+/** Returns the index of the string, adding it if it isn't stored yet. */
+int CCaptureStrings::Add( const std::string& a_rsString )
+{
+	std::map<std::string,int>::const_iterator it = m_oIndexes.find( a_rsString );
+	if ( it != m_oIndexes.end() )
+	{
+		return it->second;
+	}
+
+	if ( (int) m_asStrings.size() >= CAPTURE_MAXSTRINGS )
+	{
+		if ( !m_bFull )
+		{
+			debug( "CCaptureStrings: more than %d strings, the rest are dropped.\n", CAPTURE_MAXSTRINGS );
+			m_bFull = true;
+		}
+		return CAPTURE_NOSTRING;
+	}
+
+	int iIndex = m_asStrings.size();
+	m_asStrings.push_back( a_rsString );
+	m_oIndexes[ a_rsString ] = iIndex;
+	return iIndex;
+}
+
+
+const std::string& CCaptureStrings::Get( int a_iIndex ) const
+{
+	static const std::string sEmpty;
+	if ( a_iIndex < 0 || a_iIndex >= (int) m_asStrings.size() )
+	{
+		return sEmpty;
+	}
+	return m_asStrings[a_iIndex];
+}
+
+
+int CCaptureStrings::GetCount() const
+{
+	return m_asStrings.size();
+}
+
+
+int CCaptureStrings::GetGeneration() const
+{
+	return m_iGeneration;
+}
+
+
+/** Records the scene in g_oBackend: the same data as
+Backend::WriteToString(), without formatting any text. The keys of the
+record are left alone. */
+void CaptureScene( SCaptureTick& a_roOutTick, CCaptureStrings& a_roStrings )
+{
+	a_roOutTick.m_iGameTick = g_oBackend.m_iGameTick;
+	a_roOutTick.m_iBgX = g_oBackend.m_iBgX;
+	a_roOutTick.m_iBgY = g_oBackend.m_iBgY;
+
+	int i;
+	for ( i=0; i<MAXPLAYERS; ++i )
+	{
+		const Backend::SPlayer& roPlayer = g_oBackend.m_aoPlayers[i];
+		a_roOutTick.m_aiX[i] = roPlayer.m_iX;
+		a_roOutTick.m_aiY[i] = roPlayer.m_iY;
+		a_roOutTick.m_aiFrame[i] = roPlayer.m_iFrame;
+		a_roOutTick.m_aiHitPoints[i] = roPlayer.m_iHitPoints;
+	}
+
+	// The unused doodads and sounds are zeroed, so they delta-encode to nothing.
+	a_roOutTick.m_iNumDoodads = g_oBackend.m_iNumDoodads;
+	memset( a_roOutTick.m_aoDoodads, 0, sizeof(a_roOutTick.m_aoDoodads) );
+	for ( i=0; i<g_oBackend.m_iNumDoodads; ++i )
+	{
+		const Backend::SDoodad& roDoodad = g_oBackend.m_aoDoodads[i];
+		SCaptureDoodad& roOut = a_roOutTick.m_aoDoodads[i];
+		roOut.m_iX = roDoodad.m_iX;
+		roOut.m_iY = roDoodad.m_iY;
+		roOut.m_iFrame = roDoodad.m_iFrame;
+		roOut.m_iType = roDoodad.m_iType;
+		roOut.m_iDir = roDoodad.m_iDir;
+		roOut.m_iGfxOwner = roDoodad.m_iGfxOwner;
+		roOut.m_iText = roDoodad.m_sText.size() ? a_roStrings.Add( roDoodad.m_sText ) : CAPTURE_NOSTRING;
+	}
+
+	a_roOutTick.m_iNumSounds = g_oBackend.m_iNumSounds;
+	memset( a_roOutTick.m_aiSounds, 0, sizeof(a_roOutTick.m_aiSounds) );
+	for ( i=0; i<g_oBackend.m_iNumSounds; ++i )
+	{
+		a_roOutTick.m_aiSounds[i] = a_roStrings.Add( g_oBackend.m_asSounds[i] );
+	}
+}
+
+
+/** Puts a scene recorded by CaptureScene() back into g_oBackend, like
+Backend::ReadFromString(). The game tick is left alone, and the sounds are
+looked up, but not played. */
+void RestoreScene( const SCaptureTick& a_roTick, const CCaptureStrings& a_roStrings )
+{
+	g_oBackend.m_iBgX = a_roTick.m_iBgX;
+	g_oBackend.m_iBgY = a_roTick.m_iBgY;
+
+	int i;
+	for ( i=0; i<MAXPLAYERS; ++i )
+	{
+		Backend::SPlayer& roPlayer = g_oBackend.m_aoPlayers[i];
+		roPlayer.m_iX = a_roTick.m_aiX[i];
+		roPlayer.m_iY = a_roTick.m_aiY[i];
+		roPlayer.m_iFrame = a_roTick.m_aiFrame[i];
+		roPlayer.m_iHitPoints = a_roTick.m_aiHitPoints[i];
+	}
+
+	g_oBackend.m_iNumDoodads = a_roTick.m_iNumDoodads;
+	for ( i=0; i<a_roTick.m_iNumDoodads; ++i )
+	{
+		const SCaptureDoodad& roDoodad = a_roTick.m_aoDoodads[i];
+		Backend::SDoodad& roOut = g_oBackend.m_aoDoodads[i];
+		roOut.m_iX = roDoodad.m_iX;
+		roOut.m_iY = roDoodad.m_iY;
+		roOut.m_iFrame = roDoodad.m_iFrame;
+		roOut.m_iType = roDoodad.m_iType;
+		roOut.m_iDir = roDoodad.m_iDir;
+		roOut.m_iGfxOwner = roDoodad.m_iGfxOwner;
+		roOut.m_sText = a_roStrings.Get( roDoodad.m_iText );
+	}
+
+	g_oBackend.m_iNumSounds = a_roTick.m_iNumSounds;
+	for ( i=0; i<a_roTick.m_iNumSounds; ++i )
+	{
+		g_oBackend.m_asSounds[i] = a_roStrings.Get( a_roTick.m_aiSounds[i] );
+		g_oBackend.m_aiSounds[i] = g_oBackend.GetSoundId( g_oBackend.m_asSounds[i].c_str() );
+	}
+}
+
+
+
+/***************************************************************************
+                    CGameCapture
+***************************************************************************/
+
+
+CGameCapture::CGameCapture()
+{
+	m_poFile = NULL;
+	m_poMappedStrings = NULL;
+	m_iMappedGeneration = 0;
+	m_poThread = NULL;
+	m_bStopping = false;
+	memset( &m_oCurrent, 0, sizeof(m_oCurrent) );
+	memset( &m_oPrevious, 0, sizeof(m_oPrevious) );
+}
+
+
+CGameCapture::~CGameCapture()
+{
+	Stop();
+}
+
+
+/** Opens a new capture file in the replay directory and starts the
+encoder thread. Returns false if capturing is not possible; in this case
+AddKey() and CaptureTick() do nothing. */
+bool CGameCapture::Start( int a_iFighter1, int a_iFighter2 )
+{
+	Stop();
+
+	// Make room for the new file.
+	g_oReplayLibrary.PruneFiles( ".capture", CAPTURE_MAXFILES - 1 );
+
+	std::string sFilename = g_oReplayLibrary.GetNewReplayFilename( ".capture" );
+	if ( sFilename.size() == 0 )
+	{
+		return false;
+	}
+
+	m_poFile = fopen( sFilename.c_str(), "wb" );
+	if ( NULL == m_poFile )
+	{
+		debug( "CGameCapture::Start: can't open %s\n", sFilename.c_str() );
+		return false;
+	}
+
+	fwrite( "OMCP", 4, 1, m_poFile );
+	WriteUint32( m_poFile, CAPTURE_VERSION );
+	WriteUint32( m_poFile, sizeof(SCaptureTick) );
+	WriteUint32( m_poFile, a_iFighter1 );
+	WriteUint32( m_poFile, a_iFighter2 );
+	WriteUint32( m_poFile, 0 );			// The number of records, see Stop()
+
+	m_oStrings.Clear();
+	m_aiStringMap.clear();
+	m_poMappedStrings = NULL;
+	m_oQueue.Reset();
+	memset( &m_oCurrent, 0, sizeof(m_oCurrent) );
+	memset( &m_oPrevious, 0, sizeof(m_oPrevious) );
+	m_iNumTicks = m_iNumDropped = m_iNumEncoded = 0;
+	m_dCaptureNanoseconds = 0.0;
+	m_iBytesWritten = CAPTURE_HEADERSIZE;
+	m_bStopping = false;
+
+	m_poThread = SDL_CreateThread( EncoderThread, this );
+	if ( NULL == m_poThread )
+	{
+		fclose( m_poFile );
+		m_poFile = NULL;
+		return false;
+	}
+	return true;
+}
+
+
+/** Waits until the encoder has written every queued tick, writes the
+strings and the number of records, then closes the capture file and
+reports the statistics. */
+void CGameCapture::Stop()
+{
+	if ( NULL == m_poThread )
+	{
+		return;
+	}
+
+	m_bStopping = true;
+	SDL_WaitThread( m_poThread, NULL );
+	m_poThread = NULL;
+
+	int iNumStrings = m_oStrings.GetCount();
+	fwrite( "OMST", 4, 1, m_poFile );
+	WriteUint32( m_poFile, iNumStrings );
+	m_iBytesWritten += 8;
+	for ( int i=0; i<iNumStrings; ++i )
+	{
+		const std::string& rsString = m_oStrings.Get( i );
+		WriteUint32( m_poFile, rsString.size() );
+		fwrite( rsString.data(), rsString.size(), 1, m_poFile );
+		m_iBytesWritten += 4 + rsString.size();
+	}
+
+	fseek( m_poFile, CAPTURE_HEADERSIZE - 4, SEEK_SET );
+	WriteUint32( m_poFile, m_iNumEncoded );
+
+	fclose( m_poFile );
+	m_poFile = NULL;
+	m_poMappedStrings = NULL;
+
+	debug( "CGameCapture: %d ticks, %d dropped, %ld bytes (%.1f bytes/tick), %.0f ns/tick on the game thread.\n",
+		m_iNumTicks, m_iNumDropped, m_iBytesWritten,
+		m_iNumTicks ? m_iBytesWritten / (double) m_iNumTicks : 0.0,
+		m_iNumTicks ? m_dCaptureNanoseconds / m_iNumTicks : 0.0 );
+}
+
+
+/** Records a key that was sent to the backend in the current tick. */
+void CGameCapture::AddKey( int a_iPlayer, int a_iKey, bool a_bDown )
+{
+	if ( NULL == m_poThread )
+	{
+		return;
+	}
+
+	if ( m_oCurrent.m_iNumKeys >= CAPTURE_MAXKEYS )
+	{
+		m_oCurrent.m_iFlags |= 1;
+		return;
+	}
+	m_oCurrent.m_aiKeys[ m_oCurrent.m_iNumKeys++ ] =
+		((a_iPlayer & 3) << 6) | (a_bDown ? 0x20 : 0) | (a_iKey & 0x1f);
+}
+
+
+/** Finishes the current tick with the scene recorded by CaptureScene()
+into a_roStrings, and passes it to the encoder thread. */
+void CGameCapture::CaptureTick( const SCaptureTick& a_roScene, const CCaptureStrings& a_roStrings )
+{
+	if ( NULL == m_poThread )
+	{
+		return;
+	}
+
+	double dStart = GetNanoseconds();
+
+	// Everything but the keys comes from the scene.
+	Uint8 iNumKeys = m_oCurrent.m_iNumKeys;
+	Uint8 iFlags = m_oCurrent.m_iFlags;
+	Uint8 aiKeys[CAPTURE_MAXKEYS];
+	memcpy( aiKeys, m_oCurrent.m_aiKeys, sizeof(aiKeys) );
+	m_oCurrent = a_roScene;
+	m_oCurrent.m_iNumKeys = iNumKeys;
+	m_oCurrent.m_iFlags = iFlags;
+	memcpy( m_oCurrent.m_aiKeys, aiKeys, sizeof(aiKeys) );
+
+	int i;
+	for ( i=0; i<m_oCurrent.m_iNumDoodads; ++i )
+	{
+		SCaptureDoodad& roDoodad = m_oCurrent.m_aoDoodads[i];
+		roDoodad.m_iText = MapString( a_roStrings, roDoodad.m_iText );
+	}
+	for ( i=0; i<m_oCurrent.m_iNumSounds; ++i )
+	{
+		m_oCurrent.m_aiSounds[i] = MapString( a_roStrings, m_oCurrent.m_aiSounds[i] );
+	}
+
+	if ( !m_oQueue.Push( m_oCurrent ) )
+	{
+		++m_iNumDropped;
+	}
+
+	memset( m_oCurrent.m_aiKeys, 0, sizeof(m_oCurrent.m_aiKeys) );
+	m_oCurrent.m_iNumKeys = 0;
+	m_oCurrent.m_iFlags = 0;
+
+	++m_iNumTicks;
+	m_dCaptureNanoseconds += GetNanoseconds() - dStart;
+}
+
+
+/** Returns the index in m_oStrings of a string of the scene. The mapping
+is remembered until the scene strings are cleared, so a string is only
+looked up the first time it is used. */
+Uint16 CGameCapture::MapString( const CCaptureStrings& a_roStrings, int a_iIndex )
+{
+	if ( CAPTURE_NOSTRING == a_iIndex )
+	{
+		return CAPTURE_NOSTRING;
+	}
+
+	if ( &a_roStrings != m_poMappedStrings
+		|| a_roStrings.GetGeneration() != m_iMappedGeneration )
+	{
+		m_aiStringMap.clear();
+		m_poMappedStrings = &a_roStrings;
+		m_iMappedGeneration = a_roStrings.GetGeneration();
+	}
+
+	while ( (int) m_aiStringMap.size() <= a_iIndex )
+	{
+		m_aiStringMap.push_back( m_oStrings.Add( a_roStrings.Get( m_aiStringMap.size() ) ) );
+	}
+	return m_aiStringMap[a_iIndex];
+}
+
+
+int CGameCapture::EncoderThread( void* a_pvCapture )
+{
+	((CGameCapture*)a_pvCapture)->RunEncoder();
+	return 0;
+}
+
+
+void CGameCapture::RunEncoder()
+{
+	SCaptureTick oTick;
+
+	while ( 1 )
+	{
+		// Read m_bStopping first: if it was set, everything the game
+		// thread has pushed is already in the queue.
+		bool bStopping = m_bStopping;
+
+		while ( m_oQueue.Pop( oTick ) )
+		{
+			Encode( oTick );
+		}
+
+		if ( bStopping )
+		{
+			break;
+		}
+
+		fflush( m_poFile );
+		SDL_Delay( 20 );
+	}
+}
+
+
+/** Writes one tick as a zero-run compressed XOR delta of the previous one. */
+void CGameCapture::Encode( const SCaptureTick& a_roTick )
+{
+	const Uint8* pcNew = (const Uint8*) &a_roTick;
+	const Uint8* pcOld = (const Uint8*) &m_oPrevious;
+	Uint8 acBuffer[ sizeof(SCaptureTick) * 2 ];
+	int iLength = 0;
+
+	for ( unsigned int i=0; i<sizeof(SCaptureTick); )
+	{
+		Uint8 cDelta = pcNew[i] ^ pcOld[i];
+		if ( cDelta )
+		{
+			acBuffer[iLength++] = cDelta;
+			++i;
+			continue;
+		}
+
+		int iRun = 0;
+		while ( i < sizeof(SCaptureTick) && iRun < 255 && pcNew[i] == pcOld[i] )
+		{
+			++iRun;
+			++i;
+		}
+		acBuffer[iLength++] = 0;
+		acBuffer[iLength++] = iRun;
+	}
+
+	fwrite( acBuffer, iLength, 1, m_poFile );
+	m_iBytesWritten += iLength;
+	++m_iNumEncoded;
+	m_oPrevious = a_roTick;
+}
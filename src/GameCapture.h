@@ -0,0 +1,187 @@
+/***************************************************************************
+                          GameCapture.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef GAMECAPTURE_H
+#define GAMECAPTURE_H
+
+
+#include "SDL_types.h"
+#include "common.h"
+#include "SpscQueue.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+struct SDL_Thread;
+
+
+#define CAPTURE_MAXKEYS		6
+#define CAPTURE_QUEUESIZE	4096
+#define CAPTURE_MAXFILES	50		///< Only the newest this many capture files are kept.
+#define CAPTURE_MAXSTRINGS	65535
+#define CAPTURE_NOSTRING	65535	///< The string index of a missing string.
+#define CAPTURE_MAXDOODADS	20		///< Same as MAXDOODADS in Backend.h
+#define CAPTURE_MAXSOUNDS	20		///< Same as MAXSOUNDS in Backend.h
+
+
+/**
+\ingroup GameLogic
+One doodad of an SCaptureTick.
+*/
+struct SCaptureDoodad
+{
+	Sint16	m_iX, m_iY;
+	Sint16	m_iFrame;
+	Sint8	m_iType;
+	Sint8	m_iDir;
+	Sint8	m_iGfxOwner;
+	Sint8	m_iPadding;
+	Uint16	m_iText;						///< Index in the CCaptureStrings.
+};
+
+
+/**
+\ingroup GameLogic
+One game tick in a capture file, and in the replay of a round. The size
+is fixed, so the encoder can delta-encode each record against the previous
+one. The doodad texts and the sound names are stored in a CCaptureStrings,
+the record only has their indexes.
+*/
+struct SCaptureTick
+{
+	Sint32	m_iGameTick;
+	Sint16	m_iBgX, m_iBgY;
+	Sint16	m_aiX[MAXPLAYERS];
+	Sint16	m_aiY[MAXPLAYERS];
+	Sint16	m_aiFrame[MAXPLAYERS];
+	Sint16	m_aiHitPoints[MAXPLAYERS];
+	Uint8	m_iNumDoodads;
+	Uint8	m_iNumSounds;
+	Uint8	m_iNumKeys;
+	Uint8	m_iFlags;						///< Bit 0: keys were lost (more than CAPTURE_MAXKEYS)
+	Uint8	m_aiKeys[CAPTURE_MAXKEYS];		///< Player in bits 6-7, down in bit 5, key in bits 0-4.
+	Uint16	m_aiSounds[CAPTURE_MAXSOUNDS];	///< Indexes in the CCaptureStrings.
+	SCaptureDoodad	m_aoDoodads[CAPTURE_MAXDOODADS];
+};
+
+
+/**
+\ingroup GameLogic
+\brief The strings referred to by SCaptureTick records.
+
+Texts and sound names change rarely, so each distinct string is stored
+once, and the records refer to it by index. Only a new string allocates
+memory. A round uses a few dozen strings; should CAPTURE_MAXSTRINGS ever be
+reached, Add() logs it and returns CAPTURE_NOSTRING, which stands for an
+empty string.
+
+Clear() starts a new generation, so the users who remember indexes (like
+CGameCapture) can tell that they are no longer valid.
+*/
+
+class CCaptureStrings
+{
+public:
+	CCaptureStrings();
+
+	void				Clear();
+	int					Add( const std::string& a_rsString );
+	const std::string&	Get( int a_iIndex ) const;
+	int					GetCount() const;
+	int					GetGeneration() const;
+
+protected:
+	std::vector<std::string>	m_asStrings;
+	std::map<std::string,int>	m_oIndexes;
+	int					m_iGeneration;
+	bool				m_bFull;		///< Add() has already logged that the table is full.
+};
+
+
+void CaptureScene( SCaptureTick& a_roOutTick, CCaptureStrings& a_roStrings );
+void RestoreScene( const SCaptureTick& a_roTick, const CCaptureStrings& a_roStrings );
+
+
+/**
+\ingroup GameLogic
+\brief Always-on recording of every match for later review.
+
+The game thread fills in one SCaptureTick per game tick: AddKey() for every
+key sent to the backend, then CaptureTick() with the scene, which the game
+has already recorded with CaptureScene() for its own replay. The game's
+strings are only kept for one round, so CaptureTick() maps the string
+indexes of the scene to the capture's own table, which is kept for the
+whole capture; only a string new to the capture is looked up. The record
+is pushed into a lock-free queue, which costs the game thread no more than
+a copy. An encoder thread takes the records from the queue, delta-encodes
+them against the previous record (consecutive ticks differ in very few
+bytes), compresses the zero runs, and streams the result to a capture file
+in the replay directory.
+
+If the queue is ever full (the disk is stalling) records are dropped and
+counted rather than making the game wait. The time spent in CaptureTick()
+is measured, and reported when the capture stops.
+
+File format: the header "OMCP", version, record size, the two fighters
+and the number of records (Uint32 each), then packets: for each of the
+sizeof(SCaptureTick) bytes of the XOR delta, a zero-run is stored as 0x00
+followed by the run length, any other byte as itself. The packets are
+followed by "OMST", the number of strings, and each string as its length
+(Uint32) and its bytes. The number of records is filled in by Stop(); it
+is 0 in the file of a capture which was not stopped.
+
+Start() deletes the oldest capture files, so at most CAPTURE_MAXFILES are
+kept in the replay directory.
+*/
+
+class CGameCapture
+{
+public:
+	CGameCapture();
+	~CGameCapture();
+
+	bool				Start( int a_iFighter1, int a_iFighter2 );
+	void				Stop();
+
+	void				AddKey( int a_iPlayer, int a_iKey, bool a_bDown );
+	void				CaptureTick( const SCaptureTick& a_roScene, const CCaptureStrings& a_roStrings );
+
+protected:
+	static int			EncoderThread( void* a_pvCapture );
+	void				RunEncoder();
+	void				Encode( const SCaptureTick& a_roTick );
+	Uint16				MapString( const CCaptureStrings& a_roStrings, int a_iIndex );
+
+protected:
+	CSpscQueue<SCaptureTick,CAPTURE_QUEUESIZE>	m_oQueue;
+	SCaptureTick		m_oCurrent;			///< The tick being assembled by the game thread.
+	SCaptureTick		m_oPrevious;		///< The last encoded tick (encoder thread).
+
+	FILE*				m_poFile;
+	CCaptureStrings		m_oStrings;			///< Written at the end of the file.
+	std::vector<Uint16>	m_aiStringMap;		///< Scene string index -> m_oStrings index
+	const CCaptureStrings*	m_poMappedStrings;	///< The scene strings of m_aiStringMap
+	int					m_iMappedGeneration;
+	SDL_Thread*			m_poThread;
+	volatile bool		m_bStopping;
+
+	// Statistics
+	int					m_iNumTicks;
+	int					m_iNumDropped;
+	int					m_iNumEncoded;
+	double				m_dCaptureNanoseconds;
+	long				m_iBytesWritten;
+};
+
+
+extern CGameCapture g_oGameCapture;
+
+
+#endif // GAMECAPTURE_H
@@ -15,6 +15,8 @@
 #include "RlePack.h"
 #include "Audio.h"
 #include "Event.h"
+#include "AssetCache.h"
+#include "FramePacer.h"
 
 #include <stdio.h>
 
@@ -39,19 +41,18 @@ void DrawPlayer( int i )
 
 void GameOver( int a_iPlayerWon )
 {
-	SDL_Surface* poBackground = LoadBackground( "GameOver.jpg", 112 );
+	SDL_Surface* poBackground = g_oAssetCache.CopyBackground( "GameOver.jpg", 112 );
 	DrawGradientText( "Final Judgement", titleFont, 20, poBackground );
 	DrawTextMSZ( "Continue?", inkFont, 320, 100, AlignHCenter, C_LIGHTCYAN, poBackground );
-	SDL_Surface* poFoot = LoadBackground( "Foot.jpg", 112, 0, true );
+	CSurfaceHandle oFoot = g_oAssetCache.GetBackground( "Foot.jpg", 112 );
+	SDL_Surface* poFoot = oFoot.Get();
 	
 	SDL_BlitSurface( poBackground, NULL, gamescreen, NULL );
 	
 	g_oBackend.PerlEvalF( "JudgementStart(%d);", a_iPlayerWon );
 	
-	int thisTick, lastTick, firstTick, iGameSpeed;
-	iGameSpeed = 14 ;
-	firstTick = thisTick = SDL_GetTicks() / iGameSpeed;
-	lastTick = thisTick - 1;
+	int iGameSpeed = 14 ;
+	CFramePacer oFramePacer( iGameSpeed );
 	
 	char acString[100];
 	int iTimeLeft = 8000 / iGameSpeed;
@@ -64,29 +65,19 @@ void GameOver( int a_iPlayerWon )
 	
 	while (1)
 	{
-		// 1. Wait for the next tick (on extremely fast machines..)
-		while (1)
-		{
-			thisTick = SDL_GetTicks() / iGameSpeed;
-			if ( thisTick==lastTick )
-			{
-				SDL_Delay(1);
-			}
-			else
-			{
-				break;
-			}
-		}
+		// 1. Wait for the next tick
+
+		int iNumFrames = oFramePacer.WaitForNextTick();
 
 		// 2. Advance as many ticks as necessary..
 		
-		if ( thisTick - lastTick > 5 )
+		if ( iNumFrames > 5 )
 		{
 			iTimeLeft -= 5;
 		}
 		else
 		{
-			iTimeLeft = iTimeLeft - thisTick + lastTick;
+			iTimeLeft -= iNumFrames;
 		}
 		
 		if ( iTimeLeft < 0 && !bTimeUp )
@@ -97,19 +88,17 @@ void GameOver( int a_iPlayerWon )
 		
 		if ( bTimeUp )
 		{
-			iFootY += 12 * (thisTick - lastTick );
+			iFootY += 12 * iNumFrames;
 			if ( iFootY > GROUNDLEVEL - FOOTHEIGHT )
 			{
 				break;
 			}
 		}
 
-		int iNumFrames = thisTick - lastTick;
 		for ( int i=0; i<iNumFrames; ++i )
 		{
 			g_oBackend.AdvancePerl();
 		};
-		lastTick = thisTick;
 
 		SMortalEvent oEvent;
 		while (MortalPollEvent(oEvent))
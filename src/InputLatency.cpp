@@ -0,0 +1,98 @@
+/***************************************************************************
+                          InputLatency.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "InputLatency.h"
+#include "common.h"
+
+#include <algorithm>
+
+
+CInputLatency g_oInputLatency;
+
+
+
+CInputLatency::CInputLatency()
+{
+	Reset();
+}
+
+
+/** Forgets every key and poll; called at the start of a round. */
+
+void CInputLatency::Reset()
+{
+	m_iNumPending = 0;
+	m_iNext = m_iCount = 0;
+	m_dLastPollNs = 0.0;
+	m_dPollIntervalSumNs = m_dPollIntervalMaxNs = 0.0;
+	m_iNumPollIntervals = 0;
+}
+
+
+void CInputLatency::Polled( double a_dNowNs )
+{
+	if ( m_dLastPollNs > 0.0 )
+	{
+		double dIntervalNs = a_dNowNs - m_dLastPollNs;
+		m_dPollIntervalSumNs += dIntervalNs;
+		m_dPollIntervalMaxNs = MAX( m_dPollIntervalMaxNs, dIntervalNs );
+		++m_iNumPollIntervals;
+	}
+	m_dLastPollNs = a_dNowNs;
+}
+
+
+/** A key which was read from SDL at a_dEventNs was sent to the backend. */
+
+void CInputLatency::KeyApplied( double a_dEventNs )
+{
+	if ( m_iNumPending < INPUTLATENCY_MAXPENDING )
+	{
+		m_adPendingNs[m_iNumPending++] = a_dEventNs;
+	}
+}
+
+
+/** A frame was flipped to the screen; it shows every key applied since
+the last one. */
+
+void CInputLatency::FrameShown( double a_dNowNs )
+{
+	for ( int i=0; i<m_iNumPending; ++i )
+	{
+		m_adLatencyNs[m_iNext] = a_dNowNs - m_adPendingNs[i];
+		m_iNext = ( m_iNext + 1 ) % INPUTLATENCY_WINDOW;
+		if ( m_iCount < INPUTLATENCY_WINDOW )
+		{
+			++m_iCount;
+		}
+	}
+	m_iNumPending = 0;
+}
+
+
+void CInputLatency::Report( const char* a_pcName ) const
+{
+	if ( 0 == m_iCount )
+	{
+		debug( "%s: no keys measured.\n", a_pcName );
+		return;
+	}
+
+	double adSorted[INPUTLATENCY_WINDOW];
+	std::copy( m_adLatencyNs, m_adLatencyNs + m_iCount, adSorted );
+	std::sort( adSorted, adSorted + m_iCount );
+
+	debug( "%s: %d keys, keypress to flip p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms.\n",
+		a_pcName, m_iCount, adSorted[ m_iCount * 50 / 100 ] / 1e6, adSorted[ m_iCount * 95 / 100 ] / 1e6,
+		adSorted[ m_iCount * 99 / 100 ] / 1e6, adSorted[ m_iCount - 1 ] / 1e6 );
+	debug( "%s: events polled every %.1f ms on average, %.1f ms worst (not included above).\n",
+		a_pcName, m_iNumPollIntervals ? m_dPollIntervalSumNs / m_iNumPollIntervals / 1e6 : 0.0,
+		m_dPollIntervalMaxNs / 1e6 );
+}
@@ -0,0 +1,63 @@
+/***************************************************************************
+                          InputLatency.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef INPUTLATENCY_H
+#define INPUTLATENCY_H
+
+
+#define INPUTLATENCY_MAXPENDING	32		///< Keys applied but not shown yet.
+#define INPUTLATENCY_WINDOW		512		///< The report covers this many keys.
+
+
+/**
+\ingroup GameLogic
+\brief Measures the time from a keypress to the first frame which shows
+its effect.
+
+Every SMortalEvent carries the time it was read from SDL. When a key is
+sent to the backend (CKeyQueue::DequeueKeys), KeyApplied() takes its time;
+the next scene read from the backend is the first one that can show the
+key, and FrameShown() is called when that scene is flipped to the screen.
+The difference is the latency of the key.
+
+SDL 1.2 events have no timestamps of their own, so the time a key spends
+in the queue of SDL before it is polled is not measured. Polled() keeps
+the intervals between polls: a key waits at most that long before it is
+read.
+*/
+
+class CInputLatency
+{
+public:
+	CInputLatency();
+
+	void				Reset();
+	void				Polled( double a_dNowNs );
+	void				KeyApplied( double a_dEventNs );
+	void				FrameShown( double a_dNowNs );
+	void				Report( const char* a_pcName ) const;
+
+protected:
+	double				m_adPendingNs[INPUTLATENCY_MAXPENDING];
+	int					m_iNumPending;
+
+	double				m_adLatencyNs[INPUTLATENCY_WINDOW];
+	int					m_iNext;
+	int					m_iCount;
+
+	double				m_dLastPollNs;			///< 0 before the first poll.
+	double				m_dPollIntervalSumNs;
+	double				m_dPollIntervalMaxNs;
+	int					m_iNumPollIntervals;
+};
+
+extern CInputLatency g_oInputLatency;
+
+
+#endif // INPUTLATENCY_H
@@ -0,0 +1,393 @@
+/***************************************************************************
+                          Mixer.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "Mixer.h"
+#include "common.h"
+#include "Tracer.h"
+
+#include "SDL_audio.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+CMixer::CMixer()
+{
+	memset( m_aoVoices, 0, sizeof(m_aoVoices) );
+	m_iNextSerial = 0;
+	m_bDeviceLocking = false;
+	m_poStats = NULL;
+	m_iNumStolen = m_iNumDropped = 0;
+}
+
+
+CMixer::~CMixer()
+{
+}
+
+
+/** Should be true while the mixer is installed in the audio callback. */
+void CMixer::SetDeviceLocking( bool a_bLocking )
+{
+	m_bDeviceLocking = a_bLocking;
+}
+
+
+/** Measures the callback and the latency of the voices. Set it before the
+mixer is installed. */
+void CMixer::SetStats( CAudioStats* a_poStats )
+{
+	m_poStats = a_poStats;
+}
+
+
+void CMixer::Lock()
+{
+	if ( m_bDeviceLocking )
+	{
+		SDL_LockAudio();
+	}
+}
+
+
+void CMixer::Unlock()
+{
+	if ( m_bDeviceLocking )
+	{
+		SDL_UnlockAudio();
+	}
+}
+
+
+/** Starts playing a sound.
+
+\param a_piData		Interleaved signed 16 bit stereo samples in the output
+					format. The data must stay valid while it is played.
+\param a_iNumFrames	The number of stereo frames in the data.
+\param a_iVolume	0 - 128.
+\param a_iPriority	Voices with higher priority are not stolen by lower ones.
+\param a_dEventNs	When the backend emitted the sound (GetNanoseconds), or 0 if now.
+\return The voice which plays the sound, or -1 if the sound was dropped.
+*/
+int CMixer::Play( const Sint16* a_piData, int a_iNumFrames, int a_iVolume, int a_iPriority, double a_dEventNs )
+{
+	if ( NULL == a_piData || a_iNumFrames <= 0 || a_iVolume <= 0 )
+	{
+		return -1;
+	}
+
+	SSoundTiming oTiming;
+	oTiming.m_dEventNs = oTiming.m_dPlayNs = oTiming.m_dMixNs = 0.0;
+	if ( m_poStats )
+	{
+		oTiming.m_dPlayNs = GetNanoseconds();
+		oTiming.m_dEventNs = a_dEventNs > 0.0 ? a_dEventNs : oTiming.m_dPlayNs;
+	}
+
+	Lock();
+
+	// Find a free voice, or the one to steal: the lowest priority, then
+	// the oldest.
+
+	int iVoice = -1;
+	for ( int i=0; i<MIXER_MAXVOICES; ++i )
+	{
+		const SVoice& roVoice = m_aoVoices[i];
+		if ( NULL == roVoice.m_piData )
+		{
+			iVoice = i;
+			break;
+		}
+		if ( iVoice < 0
+			|| roVoice.m_iPriority < m_aoVoices[iVoice].m_iPriority
+			|| ( roVoice.m_iPriority == m_aoVoices[iVoice].m_iPriority
+				&& (Sint32)(roVoice.m_iSerial - m_aoVoices[iVoice].m_iSerial) < 0 ) )
+		{
+			iVoice = i;
+		}
+	}
+
+	if ( m_aoVoices[iVoice].m_piData )
+	{
+		if ( m_aoVoices[iVoice].m_iPriority > a_iPriority )
+		{
+			++m_iNumDropped;
+			Unlock();
+			return -1;
+		}
+		++m_iNumStolen;
+	}
+
+	SVoice& roVoice = m_aoVoices[iVoice];
+	roVoice.m_piData = a_piData;
+	roVoice.m_iNumFrames = a_iNumFrames;
+	roVoice.m_iPosition = 0;
+	roVoice.m_iVolume = a_iVolume > 128 ? 128 : a_iVolume;
+	roVoice.m_iPriority = a_iPriority;
+	roVoice.m_iSerial = m_iNextSerial++;
+	roVoice.m_oTiming = oTiming;
+
+	Unlock();
+	return iVoice;
+}
+
+
+/** Stops every voice that plays the given data. Must be called before
+the data is freed. */
+void CMixer::Stop( const Sint16* a_piData )
+{
+	Lock();
+	for ( int i=0; i<MIXER_MAXVOICES; ++i )
+	{
+		if ( m_aoVoices[i].m_piData == a_piData )
+		{
+			m_aoVoices[i].m_piData = NULL;
+		}
+	}
+	Unlock();
+}
+
+
+void CMixer::StopAll()
+{
+	Lock();
+	for ( int i=0; i<MIXER_MAXVOICES; ++i )
+	{
+		m_aoVoices[i].m_piData = NULL;
+	}
+	Unlock();
+}
+
+
+/** SDL_mixer post-mix callback. The stream already contains the music. */
+void CMixer::PostMix( void* a_pvMixer, Uint8* a_pcStream, int a_iLength )
+{
+	CMixer* poMixer = (CMixer*) a_pvMixer;
+	if ( poMixer->m_poStats )
+	{
+		poMixer->m_poStats->BeginCallback();
+	}
+
+	g_oTracer.SetThreadName( "audio" );
+	g_oTracer.Begin( "Mix" );
+	poMixer->Mix( (Sint16*) a_pcStream, a_iLength / 4 );
+	g_oTracer.End( "Mix" );
+
+	if ( poMixer->m_poStats )
+	{
+		poMixer->m_poStats->EndCallback( a_iLength / 4 );
+	}
+}
+
+
+/** Adds the voices to a signed 16 bit stereo stream. Runs in the audio
+callback, so it doesn't lock and doesn't allocate. */
+void CMixer::Mix( Sint16* a_piStream, int a_iNumFrames )
+{
+	while ( a_iNumFrames > 0 )
+	{
+		int iFrames = a_iNumFrames > MIXER_CHUNKFRAMES ? MIXER_CHUNKFRAMES : a_iNumFrames;
+		MixChunk( a_piStream, iFrames );
+		a_piStream += iFrames * 2;
+		a_iNumFrames -= iFrames;
+	}
+}
+
+
+void CMixer::MixChunk( Sint16* a_piStream, int a_iNumFrames )
+{
+	int i;
+	bool bAny = false;
+
+	for ( int iVoice=0; iVoice<MIXER_MAXVOICES; ++iVoice )
+	{
+		SVoice& roVoice = m_aoVoices[iVoice];
+		if ( NULL == roVoice.m_piData )
+		{
+			continue;
+		}
+
+		if ( !bAny )
+		{
+			// Start from what is already in the stream.
+			for ( i=0; i<a_iNumFrames*2; ++i )
+			{
+				m_aiAccumulator[i] = a_piStream[i];
+			}
+			bAny = true;
+		}
+
+		if ( 0 == roVoice.m_iPosition && m_poStats )
+		{
+			m_poStats->SoundStarted( roVoice.m_oTiming );
+		}
+
+		int iFrames = roVoice.m_iNumFrames - roVoice.m_iPosition;
+		if ( iFrames > a_iNumFrames )
+		{
+			iFrames = a_iNumFrames;
+		}
+
+		MixVoice( m_aiAccumulator, roVoice.m_piData + roVoice.m_iPosition * 2, iFrames * 2, roVoice.m_iVolume );
+
+		roVoice.m_iPosition += iFrames;
+		if ( roVoice.m_iPosition >= roVoice.m_iNumFrames )
+		{
+			roVoice.m_piData = NULL;
+		}
+	}
+
+	if ( bAny )
+	{
+		Saturate( a_piStream, m_aiAccumulator, a_iNumFrames * 2 );
+	}
+}
+
+
+void CMixer::MixVoice( Sint32* a_piAccumulator, const Sint16* a_piData, int a_iNumSamples, int a_iVolume )
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	// 16x16 bit products from mullo and mulhi, interleaved into 32 bits.
+	__m128i oVolume = _mm_set1_epi16( (short) a_iVolume );
+	for ( ; i + 8 <= a_iNumSamples; i += 8 )
+	{
+		__m128i oSamples = _mm_loadu_si128( (const __m128i*) (a_piData + i) );
+		__m128i oLow = _mm_mullo_epi16( oSamples, oVolume );
+		__m128i oHigh = _mm_mulhi_epi16( oSamples, oVolume );
+		__m128i oProduct0 = _mm_srai_epi32( _mm_unpacklo_epi16( oLow, oHigh ), 7 );
+		__m128i oProduct1 = _mm_srai_epi32( _mm_unpackhi_epi16( oLow, oHigh ), 7 );
+
+		__m128i* poAcc = (__m128i*) (a_piAccumulator + i);
+		_mm_storeu_si128( poAcc, _mm_add_epi32( _mm_loadu_si128( poAcc ), oProduct0 ) );
+		_mm_storeu_si128( poAcc + 1, _mm_add_epi32( _mm_loadu_si128( poAcc + 1 ), oProduct1 ) );
+	}
+#endif
+
+	for ( ; i < a_iNumSamples; ++i )
+	{
+		a_piAccumulator[i] += ( a_piData[i] * a_iVolume ) >> 7;
+	}
+}
+
+
+void CMixer::Saturate( Sint16* a_piStream, const Sint32* a_piAccumulator, int a_iNumSamples )
+{
+	int i = 0;
+
+#ifdef __SSE2__
+	for ( ; i + 8 <= a_iNumSamples; i += 8 )
+	{
+		__m128i oAcc0 = _mm_loadu_si128( (const __m128i*) (a_piAccumulator + i) );
+		__m128i oAcc1 = _mm_loadu_si128( (const __m128i*) (a_piAccumulator + i + 4) );
+		_mm_storeu_si128( (__m128i*) (a_piStream + i), _mm_packs_epi32( oAcc0, oAcc1 ) );
+	}
+#endif
+
+	for ( ; i < a_iNumSamples; ++i )
+	{
+		Sint32 iValue = a_piAccumulator[i];
+		a_piStream[i] = iValue > 32767 ? 32767 : ( iValue < -32768 ? -32768 : iValue );
+	}
+}
+
+
+int CMixer::GetNumberOfActiveVoices() const
+{
+	int iCount = 0;
+	for ( int i=0; i<MIXER_MAXVOICES; ++i )
+	{
+		if ( m_aoVoices[i].m_piData ) ++iCount;
+	}
+	return iCount;
+}
+
+
+int CMixer::GetNumberOfStolenVoices() const
+{
+	return m_iNumStolen;
+}
+
+
+int CMixer::GetNumberOfDroppedVoices() const
+{
+	return m_iNumDropped;
+}
+
+
+
+/*************************************************************************
+                           MIXER BENCHMARK
+*************************************************************************/
+
+
+/** Measures the cost of mixing, without an audio device. Prints the time
+per voice per frame for several voice counts and buffer sizes, and the
+share of the audio callback's time budget at 44.1 kHz. */
+int DoMixerBenchmark()
+{
+	const int iRate = 44100;
+	const int iSeconds = 4;
+	const int iTotalFrames = iRate * iSeconds;
+
+	// A sample longer than the benchmark, so no voice ever ends.
+	std::vector<Sint16> aiSample( (iTotalFrames + MIXER_CHUNKFRAMES) * 2 );
+	Uint32 iSeed = 1;
+	for ( unsigned int i=0; i<aiSample.size(); ++i )
+	{
+		iSeed = iSeed * 1103515245 + 12345;
+		aiSample[i] = (Sint16)( (iSeed >> 16) & 0xffff ) / 4;
+	}
+
+	static const int aiBufferSizes[] = { 128, 512, 2048 };
+	static const int aiVoiceCounts[] = { 1, 2, 4, 8, 16, 32 };
+	std::vector<Sint16> aiStream( 2048 * 2 );
+
+#ifdef __SSE2__
+	printf( "Mixer benchmark (SSE2), %d s of %d Hz stereo per measurement.\n", iSeconds, iRate );
+#else
+	printf( "Mixer benchmark (scalar), %d s of %d Hz stereo per measurement.\n", iSeconds, iRate );
+#endif
+	printf( "%8s %8s %14s %14s %10s\n", "buffer", "voices", "ns/frame", "ns/voice/frame", "% of time" );
+
+	for ( unsigned int b=0; b<sizeof(aiBufferSizes)/sizeof(int); ++b )
+	{
+		int iBufferFrames = aiBufferSizes[b];
+		for ( unsigned int v=0; v<sizeof(aiVoiceCounts)/sizeof(int); ++v )
+		{
+			int iNumVoices = aiVoiceCounts[v];
+			CMixer oMixer;
+			for ( int i=0; i<iNumVoices; ++i )
+			{
+				oMixer.Play( &aiSample[0], iTotalFrames + MIXER_CHUNKFRAMES, 100, 0 );
+			}
+
+			double dStart = GetNanoseconds();
+			for ( int iFrame=0; iFrame + iBufferFrames <= iTotalFrames; iFrame += iBufferFrames )
+			{
+				memset( &aiStream[0], 0, iBufferFrames * 4 );
+				oMixer.Mix( &aiStream[0], iBufferFrames );
+			}
+			double dNs = GetNanoseconds() - dStart;
+
+			double dPerFrame = dNs / iTotalFrames;
+			printf( "%8d %8d %14.2f %14.3f %9.3f%%\n", iBufferFrames, iNumVoices,
+				dPerFrame, dPerFrame / iNumVoices, dNs / (iSeconds * 1e9) * 100.0 );
+		}
+	}
+
+	return 0;
+}
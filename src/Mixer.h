@@ -0,0 +1,101 @@
+/***************************************************************************
+                          Mixer.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef MIXER_H
+#define MIXER_H
+
+
+#include "SDL_types.h"
+#include "AudioStats.h"
+
+
+#define MIXER_MAXVOICES		32
+#define MIXER_CHUNKFRAMES	512		///< Mix() works in chunks of this many frames.
+
+
+/**
+\ingroup Media
+\brief Sound effect mixer running on the audio callback.
+
+CMixer mixes up to MIXER_MAXVOICES sound effects into a signed 16 bit
+stereo stream. It is installed as the post-mix function of SDL_mixer
+(MszAudio does this), so the effects are added to the music in the same
+audio callback, and the latency of a sound is only the size of the audio
+buffer.
+
+Every voice has a volume and a priority. If all voices are busy when a new
+sound is started, the voice with the lowest priority is stolen; among
+voices of equal priority, the oldest one. If every voice has a higher
+priority than the new sound, the new sound is dropped. Both events are
+counted.
+
+The voices are added into a 32 bit accumulator, which is saturated to 16
+bits once at the end, so loud overlapping sounds clip instead of wrapping
+around. With SSE2 the voices are mixed eight samples at a time.
+
+If a CAudioStats is set, the post-mix callback is measured, and each
+voice carries the timestamps of its sound, so the latency from the backend
+to the output buffer can be reported.
+
+Play() and Stop() are called from the game thread. If the mixer is used by
+the audio device (SetDeviceLocking), they lock the audio device while
+changing the voices.
+*/
+
+class CMixer
+{
+public:
+	CMixer();
+	~CMixer();
+
+	void				SetDeviceLocking( bool a_bLocking );
+	void				SetStats( CAudioStats* a_poStats );
+
+	int					Play( const Sint16* a_piData, int a_iNumFrames, int a_iVolume, int a_iPriority, double a_dEventNs=0.0 );
+	void				Stop( const Sint16* a_piData );
+	void				StopAll();
+
+	void				Mix( Sint16* a_piStream, int a_iNumFrames );
+	static void			PostMix( void* a_pvMixer, Uint8* a_pcStream, int a_iLength );
+
+	int					GetNumberOfActiveVoices() const;
+	int					GetNumberOfStolenVoices() const;
+	int					GetNumberOfDroppedVoices() const;
+
+protected:
+	struct SVoice
+	{
+		const Sint16*	m_piData;		///< Interleaved stereo samples, or NULL if the voice is free.
+		int				m_iNumFrames;
+		int				m_iPosition;	///< The next frame to play.
+		int				m_iVolume;		///< 0 - 128
+		int				m_iPriority;
+		Uint32			m_iSerial;		///< Voices started later have higher serials.
+		SSoundTiming	m_oTiming;		///< Only set if there is a CAudioStats.
+	};
+
+	void				Lock();
+	void				Unlock();
+	void				MixChunk( Sint16* a_piStream, int a_iNumFrames );
+	static void			MixVoice( Sint32* a_piAccumulator, const Sint16* a_piData, int a_iNumSamples, int a_iVolume );
+	static void			Saturate( Sint16* a_piStream, const Sint32* a_piAccumulator, int a_iNumSamples );
+
+protected:
+	SVoice				m_aoVoices[MIXER_MAXVOICES];
+	Sint32				m_aiAccumulator[MIXER_CHUNKFRAMES*2];
+	Uint32				m_iNextSerial;
+	bool				m_bDeviceLocking;
+	CAudioStats*		m_poStats;
+
+	int					m_iNumStolen;
+	int					m_iNumDropped;
+};
+
+
+#endif // MIXER_H
@@ -0,0 +1,289 @@
+/***************************************************************************
+                          MortalAtlas.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+/**
+\file MortalAtlas.cpp
+\ingroup PlayerSelect
+
+Builds the portrait atlas (see CPortraitAtlas) from the *.icon.png files
+of a directory. It is run by "make install" on the installed characters,
+before mortalpack packs the data.
+
+Usage: mortalatlas <charactersdir> <atlas>
+
+The portraits are packed into shelves, tallest first, on sheets of at most
+PORTRAITATLAS_MAXSHEETSIZE pixels.
+*/
+
+
+#include "PortraitAtlas.h"
+
+#include "SDL.h"
+#include "SDL_image.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+struct SAtlasPortrait
+{
+	std::string		m_sName;
+	SDL_Surface*	m_poImage;
+	int				m_iSheet;
+	int				m_iX;
+	int				m_iY;
+};
+
+
+struct SAtlasSheet
+{
+	int				m_iWidth;
+	int				m_iHeight;
+};
+
+
+static bool IsTaller( const SAtlasPortrait& a_roFirst, const SAtlasPortrait& a_roSecond )
+{
+	if ( a_roFirst.m_poImage->h != a_roSecond.m_poImage->h )
+	{
+		return a_roFirst.m_poImage->h > a_roSecond.m_poImage->h;
+	}
+	return a_roFirst.m_sName < a_roSecond.m_sName;
+}
+
+
+static void WriteUint32( FILE* a_poFile, unsigned int a_iValue )
+{
+	unsigned char acBytes[4];
+	acBytes[0] = a_iValue & 0xff;
+	acBytes[1] = ( a_iValue >> 8 ) & 0xff;
+	acBytes[2] = ( a_iValue >> 16 ) & 0xff;
+	acBytes[3] = ( a_iValue >> 24 ) & 0xff;
+	fwrite( acBytes, 1, 4, a_poFile );
+}
+
+
+/** Loads the portraits in the directory, as 32 bit RGBA images. */
+
+static bool LoadPortraits( const std::string& a_rsDir, std::vector<SAtlasPortrait>& a_raoOutPortraits )
+{
+	DIR* poDir = opendir( a_rsDir.c_str() );
+	if ( NULL == poDir )
+	{
+		fprintf( stderr, "Can't open directory %s\n", a_rsDir.c_str() );
+		return false;
+	}
+
+	SDL_Surface* poFormat = SDL_CreateRGBSurface( SDL_SWSURFACE, 1, 1, 32,
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+		0xff000000, 0x00ff0000, 0x0000ff00, 0x000000ff );
+#else
+		0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 );
+#endif
+
+	struct dirent* poEntry;
+	while ( NULL != ( poEntry = readdir( poDir ) ) )
+	{
+		const char* pcName = poEntry->d_name;
+		int iLength = strlen( pcName );
+		if ( iLength < 9 || 0 != strcmp( pcName + iLength - 9, ".icon.png" ) )
+		{
+			continue;
+		}
+		if ( iLength >= PORTRAITATLAS_NAMELENGTH )
+		{
+			fprintf( stderr, "%s: the name is too long, skipped.\n", pcName );
+			continue;
+		}
+
+		SDL_Surface* poImage = IMG_Load( ( a_rsDir + "/" + pcName ).c_str() );
+		if ( NULL == poImage )
+		{
+			fprintf( stderr, "Can't load %s: %s\n", pcName, SDL_GetError() );
+			continue;
+		}
+		if ( poImage->w > PORTRAITATLAS_MAXSHEETSIZE || poImage->h > PORTRAITATLAS_MAXSHEETSIZE )
+		{
+			fprintf( stderr, "%s is too large, skipped.\n", pcName );
+			SDL_FreeSurface( poImage );
+			continue;
+		}
+
+		// Copy the alpha channel instead of blending it.
+		SDL_SetAlpha( poImage, 0, 0 );
+		SDL_SetColorKey( poImage, 0, 0 );
+		SDL_Surface* poConverted = SDL_ConvertSurface( poImage, poFormat->format, SDL_SWSURFACE );
+		SDL_FreeSurface( poImage );
+		if ( NULL == poConverted )
+		{
+			fprintf( stderr, "Can't convert %s\n", pcName );
+			continue;
+		}
+
+		SAtlasPortrait oPortrait;
+		oPortrait.m_sName = pcName;
+		oPortrait.m_poImage = poConverted;
+		oPortrait.m_iSheet = oPortrait.m_iX = oPortrait.m_iY = 0;
+		a_raoOutPortraits.push_back( oPortrait );
+	}
+
+	SDL_FreeSurface( poFormat );
+	closedir( poDir );
+	return true;
+}
+
+
+/** Places the portraits on shelves. A new shelf is started when the
+current one is full, a new sheet when the shelves don't fit. */
+
+static void Pack( std::vector<SAtlasPortrait>& a_raoPortraits, std::vector<SAtlasSheet>& a_raoOutSheets )
+{
+	std::sort( a_raoPortraits.begin(), a_raoPortraits.end(), IsTaller );
+
+	int iX = 0, iY = 0, iShelfHeight = 0;
+	for ( unsigned int i=0; i<a_raoPortraits.size(); ++i )
+	{
+		SAtlasPortrait& roPortrait = a_raoPortraits[i];
+		int w = roPortrait.m_poImage->w;
+		int h = roPortrait.m_poImage->h;
+
+		if ( iX + w > PORTRAITATLAS_MAXSHEETSIZE )
+		{
+			iX = 0;
+			iY += iShelfHeight;
+			iShelfHeight = 0;
+		}
+		if ( a_raoOutSheets.empty() || iY + h > PORTRAITATLAS_MAXSHEETSIZE )
+		{
+			SAtlasSheet oSheet;
+			oSheet.m_iWidth = oSheet.m_iHeight = 0;
+			a_raoOutSheets.push_back( oSheet );
+			iX = iY = iShelfHeight = 0;
+		}
+
+		SAtlasSheet& roSheet = a_raoOutSheets.back();
+		roPortrait.m_iSheet = a_raoOutSheets.size() - 1;
+		roPortrait.m_iX = iX;
+		roPortrait.m_iY = iY;
+		iX += w;
+		if ( h > iShelfHeight ) iShelfHeight = h;
+		if ( iX > roSheet.m_iWidth ) roSheet.m_iWidth = iX;
+		if ( iY + h > roSheet.m_iHeight ) roSheet.m_iHeight = iY + h;
+	}
+}
+
+
+int main( int argc, char* argv[] )
+{
+	if ( argc != 3 )
+	{
+		fprintf( stderr, "Usage: %s <charactersdir> <atlas>\n", argv[0] );
+		return 2;
+	}
+	const char* pcAtlas = argv[2];
+
+	// 1. LOAD AND PLACE THE PORTRAITS
+
+	std::vector<SAtlasPortrait> aoPortraits;
+	if ( !LoadPortraits( argv[1], aoPortraits ) )
+	{
+		return 1;
+	}
+	std::vector<SAtlasSheet> aoSheets;
+	Pack( aoPortraits, aoSheets );
+
+	FILE* poAtlas = fopen( pcAtlas, "wb" );
+	if ( NULL == poAtlas )
+	{
+		fprintf( stderr, "Can't create %s\n", pcAtlas );
+		return 1;
+	}
+
+	// 2. WRITE THE HEADER, THE SHEETS AND THE PORTRAITS
+
+	fwrite( "OMPA", 1, 4, poAtlas );
+	WriteUint32( poAtlas, PORTRAITATLAS_VERSION );
+	WriteUint32( poAtlas, aoSheets.size() );
+	WriteUint32( poAtlas, aoPortraits.size() );
+
+	unsigned int i;
+	long iOffset = PORTRAITATLAS_HEADERSIZE + aoSheets.size() * PORTRAITATLAS_SHEETSIZE
+		+ aoPortraits.size() * PORTRAITATLAS_ENTRYSIZE;
+	for ( i=0; i<aoSheets.size(); ++i )
+	{
+		WriteUint32( poAtlas, aoSheets[i].m_iWidth );
+		WriteUint32( poAtlas, aoSheets[i].m_iHeight );
+		WriteUint32( poAtlas, iOffset );
+		iOffset += aoSheets[i].m_iWidth * aoSheets[i].m_iHeight * 4;
+	}
+
+	for ( i=0; i<aoPortraits.size(); ++i )
+	{
+		const SAtlasPortrait& roPortrait = aoPortraits[i];
+		char acName[PORTRAITATLAS_NAMELENGTH];
+		memset( acName, 0, sizeof(acName) );
+		strcpy( acName, roPortrait.m_sName.c_str() );
+		fwrite( acName, 1, sizeof(acName), poAtlas );
+		WriteUint32( poAtlas, roPortrait.m_iSheet );
+		WriteUint32( poAtlas, roPortrait.m_iX );
+		WriteUint32( poAtlas, roPortrait.m_iY );
+		WriteUint32( poAtlas, roPortrait.m_poImage->w );
+		WriteUint32( poAtlas, roPortrait.m_poImage->h );
+	}
+
+	// 3. WRITE THE PIXELS OF THE SHEETS
+
+	for ( unsigned int iSheet=0; iSheet<aoSheets.size(); ++iSheet )
+	{
+		int iWidth = aoSheets[iSheet].m_iWidth;
+		int iHeight = aoSheets[iSheet].m_iHeight;
+		std::vector<unsigned char> acPixels( iWidth * iHeight * 4, 0 );
+
+		for ( i=0; i<aoPortraits.size(); ++i )
+		{
+			const SAtlasPortrait& roPortrait = aoPortraits[i];
+			if ( roPortrait.m_iSheet != (int) iSheet )
+			{
+				continue;
+			}
+			SDL_Surface* poImage = roPortrait.m_poImage;
+			SDL_LockSurface( poImage );
+			for ( int y=0; y<poImage->h; ++y )
+			{
+				memcpy( &acPixels[ ( ( roPortrait.m_iY + y ) * iWidth + roPortrait.m_iX ) * 4 ],
+					(const char*) poImage->pixels + y * poImage->pitch, poImage->w * 4 );
+			}
+			SDL_UnlockSurface( poImage );
+		}
+
+		if ( !acPixels.empty() )
+		{
+			fwrite( &acPixels[0], 1, acPixels.size(), poAtlas );
+		}
+	}
+
+	for ( i=0; i<aoPortraits.size(); ++i )
+	{
+		SDL_FreeSurface( aoPortraits[i].m_poImage );
+	}
+
+	if ( ferror( poAtlas ) | fclose( poAtlas ) )
+	{
+		fprintf( stderr, "Error writing %s\n", pcAtlas );
+		remove( pcAtlas );
+		return 1;
+	}
+
+	printf( "%s: %d portraits on %d sheets.\n", pcAtlas, (int) aoPortraits.size(), (int) aoSheets.size() );
+	return 0;
+}
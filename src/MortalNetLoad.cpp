@@ -0,0 +1,265 @@
+/***************************************************************************
+                          MortalNetLoad.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "MortalNetLoad.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+
+static const char* g_apcWords[] =
+{
+	"fight", "me", "you", "noob", "combo", "block", "jump", "kick", "punch", "again",
+	"lol", "gg", "who", "wants", "a", "round", "the", "lag", "is", "terrible",
+	"nice", "throw", "cheap", "move", "rematch", "zoli", "ulmar", "sirpi", "x", "!",
+};
+
+#define NUMWORDS ((int)(sizeof(g_apcWords)/sizeof(g_apcWords[0])))
+
+
+CMortalNetLoad::CMortalNetLoad()
+{
+	m_iRate = 0;
+	Restart();
+}
+
+
+CMortalNetLoad::~CMortalNetLoad()
+{
+}
+
+
+/** Loads a load script. See the class description for the format.
+\retval false if the file couldn't be read or has an invalid command. */
+bool CMortalNetLoad::Load( const char* a_pcFilename )
+{
+	FILE* poFile = fopen( a_pcFilename, "r" );
+	if ( NULL == poFile )
+	{
+		fprintf( stderr, "Can't open load script %s\n", a_pcFilename );
+		return false;
+	}
+
+	m_aoCommands.clear();
+	char acLine[1024];
+	int iLineNumber = 0;
+	bool bOk = true;
+
+	while ( fgets( acLine, sizeof(acLine), poFile ) )
+	{
+		++iLineNumber;
+		if ( !AddCommand( acLine ) )
+		{
+			fprintf( stderr, "%s:%d: invalid command: %s", a_pcFilename, iLineNumber, acLine );
+			bOk = false;
+			break;
+		}
+	}
+
+	fclose( poFile );
+	Restart();
+	return bOk;
+}
+
+
+/** Sets up a script that floods a lobby of 1000 users. */
+void CMortalNetLoad::LoadDefault()
+{
+	static const char* apcScript[] =
+	{
+		"rate 0", "join 1000", "status 10",
+		"rate 2000", "message 5000", "nick 200", "whois 200",
+		"rate 0", "message 5000", "part 500", "join 500", "message 2000",
+		"pause 1000", "part 1000",
+		NULL
+	};
+
+	m_aoCommands.clear();
+	for ( int i=0; apcScript[i]; ++i )
+	{
+		AddCommand( apcScript[i] );
+	}
+	Restart();
+}
+
+
+/** Starts the script again from the beginning, with an empty chat. */
+void CMortalNetLoad::Restart()
+{
+	m_iCommand = -1;
+	m_iRemaining = 0;
+	m_iRate = 0;
+	m_asUsers.clear();
+	m_iNextUser = 0;
+	m_iSeed = 12345;
+}
+
+
+bool CMortalNetLoad::AddCommand( const char* a_pcLine )
+{
+	char acCommand[32];
+	int iCount;
+
+	const char* pcComment = strchr( a_pcLine, '#' );
+	std::string sLine( a_pcLine, pcComment ? pcComment - a_pcLine : strlen(a_pcLine) );
+
+	if ( 1 > sscanf( sLine.c_str(), "%31s", acCommand ) )
+	{
+		return true;	// Empty line
+	}
+	if ( 1 != sscanf( sLine.c_str(), "%*s %d", &iCount ) || iCount < 0 )
+	{
+		return false;
+	}
+
+	SCommand oCommand;
+	oCommand.m_iCount = iCount;
+
+	if ( !strcmp( acCommand, "rate" ) )			oCommand.m_cType = 'r';
+	else if ( !strcmp( acCommand, "join" ) )	oCommand.m_cType = 'j';
+	else if ( !strcmp( acCommand, "part" ) )	oCommand.m_cType = 'p';
+	else if ( !strcmp( acCommand, "message" ) )	oCommand.m_cType = 'm';
+	else if ( !strcmp( acCommand, "nick" ) )	oCommand.m_cType = 'n';
+	else if ( !strcmp( acCommand, "whois" ) )	oCommand.m_cType = 'w';
+	else if ( !strcmp( acCommand, "status" ) )	oCommand.m_cType = 's';
+	else if ( !strcmp( acCommand, "pause" ) )	oCommand.m_cType = 'P';
+	else return false;
+
+	m_aoCommands.push_back( oCommand );
+	return true;
+}
+
+
+/** Returns the next line the server should send, without the trailing
+newline.
+
+\param a_rsOutLine		The line, or an empty string for a pause.
+\param a_riOutPauseMs	The length of the pause, or 0 if this is not a pause.
+\retval false if the script is over.
+*/
+bool CMortalNetLoad::GetNextLine( std::string& a_rsOutLine, int& a_riOutPauseMs )
+{
+	a_rsOutLine.clear();
+	a_riOutPauseMs = 0;
+
+	while ( m_iRemaining <= 0 )
+	{
+		if ( ++m_iCommand >= (int) m_aoCommands.size() )
+		{
+			return false;
+		}
+
+		const SCommand& roCommand = m_aoCommands[m_iCommand];
+		switch ( roCommand.m_cType )
+		{
+		case 'r':
+			m_iRate = roCommand.m_iCount;
+			break;
+		case 'P':
+			a_riOutPauseMs = roCommand.m_iCount;
+			return true;
+		default:
+			m_iRemaining = roCommand.m_iCount;
+		}
+	}
+
+	--m_iRemaining;
+	char cType = m_aoCommands[m_iCommand].m_cType;
+	char acIP[32];
+	sprintf( acIP, "10.%d.%d.%d", Random(256), Random(256), Random(254)+1 );
+
+	if ( m_asUsers.empty() && cType != 'j' && cType != 's' )
+	{
+		cType = 'j';		// Can't talk about users who aren't there.
+	}
+
+	switch ( cType )
+	{
+	case 'j':
+	{
+		std::string sNick = NewNick();
+		m_asUsers.push_back( sNick );
+		a_rsOutLine = "J" + sNick + " " + acIP;
+		break;
+	}
+	case 'p':
+	{
+		int iUser = Random( m_asUsers.size() );
+		a_rsOutLine = "L" + m_asUsers[iUser];
+		m_asUsers[iUser] = m_asUsers.back();
+		m_asUsers.pop_back();
+		break;
+	}
+	case 'm':
+		a_rsOutLine = "M<" + m_asUsers[ Random(m_asUsers.size()) ] + "> " + MakeText();
+		break;
+	case 'n':
+	{
+		int iUser = Random( m_asUsers.size() );
+		std::string sNick = NewNick();
+		a_rsOutLine = "N" + m_asUsers[iUser] + " " + sNick;
+		m_asUsers[iUser] = sNick;
+		break;
+	}
+	case 'w':
+		a_rsOutLine = "W" + m_asUsers[ Random(m_asUsers.size()) ] + " " + acIP;
+		break;
+	case 's':
+	{
+		char acStatus[128];
+		sprintf( acStatus, "S*** %d users are online. Be nice to each other.", (int) m_asUsers.size() );
+		a_rsOutLine = acStatus;
+		break;
+	}
+	}
+
+	return true;
+}
+
+
+int CMortalNetLoad::GetRate() const
+{
+	return m_iRate;
+}
+
+
+int CMortalNetLoad::GetNumberOfUsers() const
+{
+	return m_asUsers.size();
+}
+
+
+/** A small LCG, so the traffic is the same on every platform. */
+int CMortalNetLoad::Random( int a_iRange )
+{
+	m_iSeed = m_iSeed * 1103515245 + 12345;
+	return a_iRange > 0 ? (int)((m_iSeed >> 8) % a_iRange) : 0;
+}
+
+
+std::string CMortalNetLoad::NewNick()
+{
+	char acNick[32];
+	sprintf( acNick, "user%05d", m_iNextUser++ );
+	return acNick;
+}
+
+
+std::string CMortalNetLoad::MakeText()
+{
+	std::string sText;
+	int iNumWords = 2 + Random( 20 );
+	for ( int i=0; i<iNumWords; ++i )
+	{
+		if ( i ) sText += ' ';
+		sText += g_apcWords[ Random(NUMWORDS) ];
+	}
+	return sText;
+}
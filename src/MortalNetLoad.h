@@ -0,0 +1,79 @@
+/***************************************************************************
+                          MortalNetLoad.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef MORTALNETLOAD_H
+#define MORTALNETLOAD_H
+
+
+#include <string>
+#include <vector>
+
+
+/**
+\ingroup Network
+\brief Generates scripted MortalNet server traffic for load testing.
+
+The load script is a text file with one command per line. Everything
+after a '#' is a comment. The commands are:
+
+\li rate <n> - Send n lines per second from now on (0: as fast as possible).
+\li join <n> - n new users join the chat.
+\li part <n> - n random users leave.
+\li message <n> - n public messages from random users.
+\li nick <n> - n random users change their nick.
+\li whois <n> - n whois responses about random users.
+\li status <n> - n server messages.
+\li pause <ms> - Send nothing for a while.
+
+The lines are generated in the format COnlineChat expects from the server,
+and are deterministic: the same script always produces the same traffic.
+The class has no dependencies other than the C++ library. It is only
+built into the stand-in server (mortalnetserver); the game connects to it
+like to any MortalNet server.
+*/
+
+class CMortalNetLoad
+{
+public:
+	CMortalNetLoad();
+	~CMortalNetLoad();
+
+	bool				Load( const char* a_pcFilename );
+	void				LoadDefault();
+	void				Restart();
+
+	bool				GetNextLine( std::string& a_rsOutLine, int& a_riOutPauseMs );
+	int					GetRate() const;
+	int					GetNumberOfUsers() const;
+
+protected:
+	struct SCommand
+	{
+		char			m_cType;		///< 'r'ate, 'j'oin, 'p'art, 'm'essage, 'n'ick, 'w'hois, 's'tatus, 'P'ause
+		int				m_iCount;
+	};
+
+	bool				AddCommand( const char* a_pcLine );
+	int					Random( int a_iRange );
+	std::string			NewNick();
+	std::string			MakeText();
+
+protected:
+	std::vector<SCommand>	m_aoCommands;
+	int					m_iCommand;			///< The index of the current command.
+	int					m_iRemaining;		///< Lines left from the current command.
+	int					m_iRate;
+
+	std::vector<std::string>	m_asUsers;	///< The users in the chat right now.
+	int					m_iNextUser;
+	unsigned int		m_iSeed;
+};
+
+
+#endif // MORTALNETLOAD_H
@@ -0,0 +1,244 @@
+/***************************************************************************
+                          MortalNetServer.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+/**
+\file MortalNetServer.cpp
+\ingroup Network
+
+A local stand-in for the MortalNet server, for load testing the chat
+client. It accepts one client at a time, answers its nick, and then plays
+a CMortalNetLoad script at it. Run the game with
+"-mortalnet localhost" to connect to it; the client reports its own
+statistics when it disconnects.
+
+Usage: mortalnetserver [-port <n>] [-loop] [script]
+*/
+
+
+#include "MortalNetLoad.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+
+#define MORTALNETWORKPORT	0x3A23
+
+
+static double GetMilliseconds()
+{
+	struct timeval oTime;
+	gettimeofday( &oTime, NULL );
+	return oTime.tv_sec * 1000.0 + oTime.tv_usec / 1000.0;
+}
+
+
+static void SleepMilliseconds( double a_dMs )
+{
+	if ( a_dMs > 0 )
+	{
+		usleep( (useconds_t) (a_dMs * 1000) );
+	}
+}
+
+
+/** Sends the whole buffer. \retval false if the client is gone. */
+static bool SendAll( int a_iSocket, const char* a_pcData, int a_iLength )
+{
+	while ( a_iLength > 0 )
+	{
+		int iSent = send( a_iSocket, a_pcData, a_iLength, 0 );
+		if ( iSent < 0 && EINTR == errno ) continue;
+		if ( iSent <= 0 ) return false;
+		a_pcData += iSent;
+		a_iLength -= iSent;
+	}
+	return true;
+}
+
+
+/** Reads the client's first line, which should be "N<nick>". */
+static std::string ReadNick( int a_iSocket )
+{
+	std::string sLine;
+	char c;
+	while ( recv( a_iSocket, &c, 1, 0 ) == 1 && c != '\n' )
+	{
+		sLine += c;
+	}
+	if ( sLine.size() > 1 && sLine[0] == 'N' )
+	{
+		return sLine.substr( 1 );
+	}
+	return "tester";
+}
+
+
+/** Plays the script to one client.
+
+The lines are sent in batches every millisecond, so that the average rate
+is correct even though the rate is much higher than the timer resolution.
+If the client reads slower than the script is sent, send() blocks, and the
+achieved rate tells how fast the client can consume the traffic. */
+static void ServeClient( int a_iSocket, CMortalNetLoad& a_roLoad )
+{
+	std::string sNick = ReadNick( a_iSocket );
+	printf( "Client connected as %s.\n", sNick.c_str() );
+
+	a_roLoad.Restart();
+	std::string sGreeting = "Y" + sNick + "\nSWelcome to the MortalNet stand-in server.\n";
+	if ( !SendAll( a_iSocket, sGreeting.c_str(), sGreeting.size() ) )
+	{
+		return;
+	}
+
+	std::string sLine, sBatch;
+	int iPauseMs;
+	int iNumLines = 0;
+	long iNumBytes = 0;
+	double dStart = GetMilliseconds();
+	double dPaused = 0.0;		// Time spent in pauses, not counted for the rate.
+	double dRateStart = dStart;
+	int iRateLines = 0;
+	int iRate = -1;
+
+	while ( a_roLoad.GetNextLine( sLine, iPauseMs ) )
+	{
+		if ( iPauseMs )
+		{
+			if ( !SendAll( a_iSocket, sBatch.c_str(), sBatch.size() ) ) break;
+			sBatch.clear();
+			SleepMilliseconds( iPauseMs );
+			dPaused += iPauseMs;
+			dRateStart = GetMilliseconds();
+			iRateLines = 0;
+			continue;
+		}
+
+		if ( a_roLoad.GetRate() != iRate )
+		{
+			iRate = a_roLoad.GetRate();
+			dRateStart = GetMilliseconds();
+			iRateLines = 0;
+		}
+
+		sBatch += sLine;
+		sBatch += '\n';
+		++iNumLines;
+		++iRateLines;
+		iNumBytes += sLine.size() + 1;
+
+		if ( iRate > 0 )
+		{
+			// Send the batch if it is time for the next line.
+			double dDue = dRateStart + iRateLines * 1000.0 / iRate;
+			double dNow = GetMilliseconds();
+			if ( dDue > dNow )
+			{
+				if ( !SendAll( a_iSocket, sBatch.c_str(), sBatch.size() ) ) break;
+				sBatch.clear();
+				SleepMilliseconds( dDue - dNow );
+			}
+		}
+		else if ( sBatch.size() >= 16384 )
+		{
+			if ( !SendAll( a_iSocket, sBatch.c_str(), sBatch.size() ) ) break;
+			sBatch.clear();
+		}
+	}
+	SendAll( a_iSocket, sBatch.c_str(), sBatch.size() );
+
+	double dSeconds = ( GetMilliseconds() - dStart - dPaused ) / 1000.0;
+	printf( "Sent %d lines, %ld bytes in %.2f s (%.0f lines/s, %.1f kB/s), %d users remain.\n",
+		iNumLines, iNumBytes, dSeconds,
+		dSeconds > 0 ? iNumLines / dSeconds : 0.0,
+		dSeconds > 0 ? iNumBytes / dSeconds / 1024.0 : 0.0,
+		a_roLoad.GetNumberOfUsers() );
+
+	// Keep the connection until the client leaves, so that it can be
+	// measured while idle with a full lobby.
+
+	char acBuffer[1024];
+	while ( recv( a_iSocket, acBuffer, sizeof(acBuffer), 0 ) > 0 ) {}
+	printf( "Client disconnected.\n" );
+}
+
+
+int main( int argc, char* argv[] )
+{
+	int iPort = MORTALNETWORKPORT;
+	bool bLoop = false;
+	CMortalNetLoad oLoad;
+	oLoad.LoadDefault();
+
+	for ( int i=1; i<argc; ++i )
+	{
+		if ( !strcmp( argv[i], "-port" ) && i+1 < argc )
+		{
+			iPort = atoi( argv[++i] );
+		}
+		else if ( !strcmp( argv[i], "-loop" ) )
+		{
+			bLoop = true;
+		}
+		else if ( argv[i][0] != '-' )
+		{
+			if ( !oLoad.Load( argv[i] ) ) return 1;
+		}
+		else
+		{
+			printf( "Usage: %s [-port <n>] [-loop] [script]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	signal( SIGPIPE, SIG_IGN );
+
+	int iListener = socket( AF_INET, SOCK_STREAM, 0 );
+	int iYes = 1;
+	setsockopt( iListener, SOL_SOCKET, SO_REUSEADDR, (const char*) &iYes, sizeof(iYes) );
+
+	struct sockaddr_in oAddress;
+	memset( &oAddress, 0, sizeof(oAddress) );
+	oAddress.sin_family = AF_INET;
+	oAddress.sin_addr.s_addr = htonl( INADDR_ANY );
+	oAddress.sin_port = htons( iPort );
+
+	if ( bind( iListener, (struct sockaddr*) &oAddress, sizeof(oAddress) )
+		|| listen( iListener, 1 ) )
+	{
+		fprintf( stderr, "Can't listen on port %d: %s\n", iPort, strerror(errno) );
+		return 1;
+	}
+	printf( "MortalNet stand-in server listening on port %d.\n", iPort );
+
+	do
+	{
+		int iSocket = accept( iListener, NULL, NULL );
+		if ( iSocket < 0 )
+		{
+			if ( EINTR == errno ) continue;
+			fprintf( stderr, "accept: %s\n", strerror(errno) );
+			break;
+		}
+		setsockopt( iSocket, IPPROTO_TCP, TCP_NODELAY, (const char*) &iYes, sizeof(iYes) );
+		ServeClient( iSocket, oLoad );
+		close( iSocket );
+	} while ( bLoop );
+
+	close( iListener );
+	return 0;
+}
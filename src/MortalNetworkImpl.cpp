@@ -10,6 +10,7 @@
 #include "State.h"
 #include "PlayerSelect.h"
 #include "common.h"
+#include "Tracer.h"
 #include "config.h"
 
 
@@ -281,6 +282,7 @@ bool CMortalNetworkImpl::IsConnectionAlive()
 void CMortalNetworkImpl::Update()
 {
 	CHECKCONNECTION;
+	CTraceScope oTrace( "NetworkUpdate" );
 
 	// 1. CHECK FOR STUFF TO READ
 	
@@ -300,6 +302,7 @@ void CMortalNetworkImpl::Update()
 		return;
 	}
 	m_iIncomingBufferSize += iRetval;
+	g_oTracer.Instant( "NetworkReceived" );
 
 	// 3. CONSUME THE INCOMING BUFFER.
 	// We always make sure the incoming buffer starts with a package header.
@@ -419,6 +422,7 @@ This is followed by as many bytes as the Length is.
 */
 void CMortalNetworkImpl::SendRawData( char a_cID, const void* a_pData, int a_iLength )
 {
+	g_oTracer.Instant( "NetworkSend" );
 	CHECKCONNECTION;
 
 	int iPacketLength = a_iLength + 4;
@@ -0,0 +1,308 @@
+/***************************************************************************
+                          MortalPack.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+/**
+\file MortalPack.cpp
+\ingroup Media
+
+Builds the data archive (see CDataArchive) from a data directory. It is
+run by "make install" on the installed data.
+
+The Perl scripts and the music are not packed: Perl and the music players
+read them from the disk by name.
+
+Usage: mortalpack [-lz4] <datadir> <archive>
+
+With -lz4, the entries which get at least 1/8 smaller are compressed
+(only if mortalpack was built with liblz4).
+*/
+
+
+#include "config.h"
+#include "DataArchive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef HAVE_LIBLZ4
+#include <lz4.h>
+#endif
+
+
+static const char* g_apcSkippedExtensions[] =
+{
+	".pl", ".pm", ".mod", ".s3m", ".xm", ".it", ".mid", NULL
+};
+
+
+struct SPackEntry
+{
+	std::string		m_sName;
+	unsigned int	m_iDataOffset;
+	unsigned int	m_iStoredSize;
+	unsigned int	m_iSize;
+	unsigned int	m_iFlags;
+};
+
+
+static struct stat g_oArchiveStat;
+static bool g_bArchiveExists = false;
+
+
+static void WriteUint32( unsigned char* a_pcOut, unsigned int a_iValue )
+{
+	a_pcOut[0] = a_iValue & 0xff;
+	a_pcOut[1] = ( a_iValue >> 8 ) & 0xff;
+	a_pcOut[2] = ( a_iValue >> 16 ) & 0xff;
+	a_pcOut[3] = ( a_iValue >> 24 ) & 0xff;
+}
+
+
+static bool IsSkipped( const char* a_pcName )
+{
+	if ( '.' == a_pcName[0]
+		|| 0 == strncmp( a_pcName, "Makefile", 8 )
+		|| 0 == strcmp( a_pcName, "CVS" ) )
+	{
+		return true;
+	}
+
+	const char* pcExtension = strrchr( a_pcName, '.' );
+	if ( NULL == pcExtension )
+	{
+		return false;
+	}
+	for ( int i=0; g_apcSkippedExtensions[i]; ++i )
+	{
+		if ( 0 == strcmp( pcExtension, g_apcSkippedExtensions[i] ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/** Collects the files under a_rsDir recursively, with their names relative
+to the data directory. */
+
+static bool CollectFiles( const std::string& a_rsRoot, const std::string& a_rsDir,
+	std::vector<std::string>& a_rasOutNames )
+{
+	std::string sPath = a_rsDir.empty() ? a_rsRoot : a_rsRoot + "/" + a_rsDir;
+	DIR* poDir = opendir( sPath.c_str() );
+	if ( NULL == poDir )
+	{
+		fprintf( stderr, "Can't open directory %s\n", sPath.c_str() );
+		return false;
+	}
+
+	struct dirent* poEntry;
+	while ( NULL != ( poEntry = readdir( poDir ) ) )
+	{
+		if ( IsSkipped( poEntry->d_name ) )
+		{
+			continue;
+		}
+
+		std::string sName = a_rsDir.empty() ? poEntry->d_name : a_rsDir + "/" + poEntry->d_name;
+		struct stat oStat;
+		if ( stat( ( a_rsRoot + "/" + sName ).c_str(), &oStat ) < 0 )
+		{
+			continue;
+		}
+		if ( S_ISDIR( oStat.st_mode ) )
+		{
+			if ( !CollectFiles( a_rsRoot, sName, a_rasOutNames ) )
+			{
+				closedir( poDir );
+				return false;
+			}
+		}
+		else if ( S_ISREG( oStat.st_mode ) )
+		{
+			if ( g_bArchiveExists && oStat.st_dev == g_oArchiveStat.st_dev
+				&& oStat.st_ino == g_oArchiveStat.st_ino )
+			{
+				// Don't pack the archive into itself.
+				continue;
+			}
+			a_rasOutNames.push_back( sName );
+		}
+	}
+
+	closedir( poDir );
+	return true;
+}
+
+
+static bool ReadFile( const std::string& a_rsPath, std::vector<char>& a_racOutData )
+{
+	FILE* poFile = fopen( a_rsPath.c_str(), "rb" );
+	if ( NULL == poFile )
+	{
+		return false;
+	}
+	fseek( poFile, 0, SEEK_END );
+	long iSize = ftell( poFile );
+	fseek( poFile, 0, SEEK_SET );
+	a_racOutData.resize( iSize );
+	bool bOk = iSize == 0 || (long) fread( &a_racOutData[0], 1, iSize, poFile ) == iSize;
+	fclose( poFile );
+	return bOk;
+}
+
+
+static void Pad( FILE* a_poFile, long& a_riOffset )
+{
+	static const char acZeros[DATAARCHIVE_ALIGN] = { 0 };
+	int iPadding = ( DATAARCHIVE_ALIGN - a_riOffset % DATAARCHIVE_ALIGN ) % DATAARCHIVE_ALIGN;
+	fwrite( acZeros, 1, iPadding, a_poFile );
+	a_riOffset += iPadding;
+}
+
+
+int main( int argc, char* argv[] )
+{
+	bool bCompress = false;
+	int iArg = 1;
+	if ( iArg < argc && 0 == strcmp( argv[iArg], "-lz4" ) )
+	{
+		bCompress = true;
+		++iArg;
+	}
+	if ( argc - iArg != 2 )
+	{
+		fprintf( stderr, "Usage: %s [-lz4] <datadir> <archive>\n", argv[0] );
+		return 2;
+	}
+	std::string sRoot = argv[iArg];
+	const char* pcArchive = argv[iArg+1];
+
+#ifndef HAVE_LIBLZ4
+	if ( bCompress )
+	{
+		fprintf( stderr, "%s: built without liblz4, the archive won't be compressed.\n", argv[0] );
+		bCompress = false;
+	}
+#endif
+
+	g_bArchiveExists = 0 == stat( pcArchive, &g_oArchiveStat );
+
+	std::vector<std::string> asNames;
+	if ( !CollectFiles( sRoot, "", asNames ) )
+	{
+		return 1;
+	}
+	std::sort( asNames.begin(), asNames.end() );
+
+	FILE* poArchive = fopen( pcArchive, "wb" );
+	if ( NULL == poArchive )
+	{
+		fprintf( stderr, "Can't create %s\n", pcArchive );
+		return 1;
+	}
+
+	// 1. THE INDEX IS WRITTEN LAST; SKIP IT, AND WRITE THE NAMES
+
+	int iNumEntries = asNames.size();
+	long iOffset = DATAARCHIVE_HEADERSIZE + iNumEntries * DATAARCHIVE_ENTRYSIZE;
+	std::vector<unsigned char> acIndex( iOffset, 0 );
+	fwrite( &acIndex[0], 1, iOffset, poArchive );
+
+	std::vector<unsigned int> aiNameOffsets;
+	for ( int i=0; i<iNumEntries; ++i )
+	{
+		aiNameOffsets.push_back( iOffset );
+		fwrite( asNames[i].c_str(), 1, asNames[i].size() + 1, poArchive );
+		iOffset += asNames[i].size() + 1;
+	}
+
+	// 2. WRITE THE DATA
+
+	std::vector<SPackEntry> aoEntries;
+	std::vector<char> acData;
+	std::vector<char> acCompressed;
+	long iTotalSize = 0;
+
+	for ( int i=0; i<iNumEntries; ++i )
+	{
+		if ( !ReadFile( sRoot + "/" + asNames[i], acData ) )
+		{
+			fprintf( stderr, "Can't read %s\n", asNames[i].c_str() );
+			fclose( poArchive );
+			remove( pcArchive );
+			return 1;
+		}
+
+		SPackEntry oEntry;
+		oEntry.m_sName = asNames[i];
+		oEntry.m_iSize = acData.size();
+		oEntry.m_iStoredSize = acData.size();
+		oEntry.m_iFlags = 0;
+		const char* pcStored = acData.empty() ? "" : &acData[0];
+
+#ifdef HAVE_LIBLZ4
+		if ( bCompress && !acData.empty() )
+		{
+			acCompressed.resize( LZ4_compressBound( acData.size() ) );
+			int iCompressed = LZ4_compress_default( &acData[0], &acCompressed[0],
+				acData.size(), acCompressed.size() );
+			if ( iCompressed > 0 && iCompressed <= (int) ( acData.size() - acData.size() / 8 ) )
+			{
+				oEntry.m_iStoredSize = iCompressed;
+				oEntry.m_iFlags = DATAARCHIVE_LZ4;
+				pcStored = &acCompressed[0];
+			}
+		}
+#endif
+
+		Pad( poArchive, iOffset );
+		oEntry.m_iDataOffset = iOffset;
+		fwrite( pcStored, 1, oEntry.m_iStoredSize, poArchive );
+		iOffset += oEntry.m_iStoredSize;
+		iTotalSize += oEntry.m_iSize;
+		aoEntries.push_back( oEntry );
+	}
+
+	// 3. WRITE THE HEADER AND THE INDEX
+
+	memcpy( &acIndex[0], "OMDA", 4 );
+	WriteUint32( &acIndex[4], DATAARCHIVE_VERSION );
+	WriteUint32( &acIndex[8], iNumEntries );
+	for ( int i=0; i<iNumEntries; ++i )
+	{
+		unsigned char* pcEntry = &acIndex[ DATAARCHIVE_HEADERSIZE + i * DATAARCHIVE_ENTRYSIZE ];
+		WriteUint32( pcEntry, aiNameOffsets[i] );
+		WriteUint32( pcEntry + 4, aoEntries[i].m_sName.size() );
+		WriteUint32( pcEntry + 8, aoEntries[i].m_iDataOffset );
+		WriteUint32( pcEntry + 12, aoEntries[i].m_iStoredSize );
+		WriteUint32( pcEntry + 16, aoEntries[i].m_iSize );
+		WriteUint32( pcEntry + 20, aoEntries[i].m_iFlags );
+	}
+	fseek( poArchive, 0, SEEK_SET );
+	fwrite( &acIndex[0], 1, acIndex.size(), poArchive );
+
+	if ( ferror( poArchive ) | fclose( poArchive ) )
+	{
+		fprintf( stderr, "Error writing %s\n", pcArchive );
+		remove( pcArchive );
+		return 1;
+	}
+
+	printf( "%s: %d files, %ld bytes packed into %ld.\n", pcArchive, iNumEntries, iTotalSize, iOffset );
+	return 0;
+}
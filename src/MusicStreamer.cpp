@@ -0,0 +1,495 @@
+/***************************************************************************
+                          MusicStreamer.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "config.h"
+
+#include "MusicStreamer.h"
+#include "common.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include <string.h>
+
+#ifdef HAVE_LIBMIKMOD
+#include <mikmod.h>
+#endif
+
+
+typedef std::map<std::string,MODULE*>	ModuleMap;
+typedef ModuleMap::iterator				ModuleMapIterator;
+
+
+
+CMusicStreamer::CMusicStreamer()
+{
+	for ( int i=0; i<2; ++i )
+	{
+		SStream& roStream = m_aoStreams[i];
+		roStream.m_iWrite = roStream.m_iRead = 0;
+		roStream.m_bActive = roStream.m_bEnding = false;
+		roStream.m_iGain = roStream.m_iTargetGain = MUSIC_UNITGAIN;
+		roStream.m_iGainStep = 0;
+	}
+	m_iCurrent = -1;
+	m_iFrequency = 0;
+	m_poThread = NULL;
+	m_bPlaying = false;
+	m_iVolume = 128;
+	m_iNumUnderruns = 0;
+}
+
+
+CMusicStreamer::~CMusicStreamer()
+{
+	Shutdown();
+}
+
+
+
+/*************************************************************************
+                           UI THREAD
+*************************************************************************/
+
+
+/** Initializes the decoder for the given output frequency and starts the
+decoder thread.
+
+\retval false if the music can't be streamed; SDL_mixer should play it
+instead. */
+bool CMusicStreamer::Start( int a_iFrequency )
+{
+#ifdef HAVE_LIBMIKMOD
+	m_iFrequency = a_iFrequency;
+
+	// MikMod renders into our buffer, not to a device.
+	md_mixfreq = a_iFrequency;
+	md_mode = DMODE_16BITS | DMODE_STEREO | DMODE_SOFT_MUSIC | DMODE_INTERP;
+	md_musicvolume = 128;
+	md_pansep = 128;
+	md_reverb = 0;
+	MikMod_RegisterDriver( &drv_nos );
+	MikMod_RegisterAllLoaders();
+	md_device = MikMod_DriverFromAlias( (CHAR*) "nosound" );
+
+	if ( MikMod_Init( (CHAR*) "" ) )
+	{
+		debug( "MikMod_Init: %s\n", MikMod_strerror( MikMod_errno ) );
+		return false;
+	}
+
+	m_poThread = SDL_CreateThread( DecoderThread, this );
+	if ( NULL == m_poThread )
+	{
+		MikMod_Exit();
+		return false;
+	}
+	return true;
+#else
+	debug( "CMusicStreamer: built without libmikmod.\n" );
+	return false;
+#endif
+}
+
+
+/** Stops the decoder thread. The streamer must be unhooked from the audio
+callback before it is deleted. */
+void CMusicStreamer::Shutdown()
+{
+	if ( NULL == m_poThread )
+	{
+		return;
+	}
+
+	SendCommand( Cmd_Quit, NULL, 0 );
+	SDL_WaitThread( m_poThread, NULL );
+	m_poThread = NULL;
+
+	debug( "CMusicStreamer: %d underruns.\n", m_iNumUnderruns );
+}
+
+
+void CMusicStreamer::SendCommand( TCommandEnum a_enCommand, const char* a_pcFilename, int a_iMilliSec )
+{
+	SCommand oCommand;
+	oCommand.m_enCommand = a_enCommand;
+	oCommand.m_iMilliSec = a_iMilliSec;
+	strncpy( oCommand.m_acFilename, a_pcFilename ? a_pcFilename : "", sizeof(oCommand.m_acFilename) - 1 );
+	oCommand.m_acFilename[ sizeof(oCommand.m_acFilename) - 1 ] = 0;
+
+	// The decoder empties the queue every few milliseconds; it can only
+	// be full if the decoder is stuck.
+	while ( !m_oCommands.Push( oCommand ) )
+	{
+		SDL_Delay( 1 );
+	}
+}
+
+
+/** Loads a track in the background, so that Play() can start it at once. */
+void CMusicStreamer::Prefetch( const char* a_pcFilename )
+{
+	SendCommand( Cmd_Prefetch, a_pcFilename, 0 );
+}
+
+
+void CMusicStreamer::Unload( const char* a_pcFilename )
+{
+	SendCommand( Cmd_Unload, a_pcFilename, 0 );
+}
+
+
+/** Starts a track (looped), crossfading from the current one. */
+void CMusicStreamer::Play( const char* a_pcFilename, int a_iCrossfadeMs )
+{
+	m_bPlaying = true;
+	SendCommand( Cmd_Play, a_pcFilename, a_iCrossfadeMs );
+}
+
+
+void CMusicStreamer::FadeOut( int a_iMilliSec )
+{
+	m_bPlaying = false;
+	SendCommand( Cmd_FadeOut, NULL, a_iMilliSec );
+}
+
+
+void CMusicStreamer::Halt()
+{
+	m_bPlaying = false;
+	SendCommand( Cmd_Halt, NULL, 0 );
+}
+
+
+/** \param a_iVolume 0 - 128 */
+void CMusicStreamer::SetVolume( int a_iVolume )
+{
+	m_iVolume = a_iVolume < 0 ? 0 : ( a_iVolume > 128 ? 128 : a_iVolume );
+}
+
+
+bool CMusicStreamer::IsPlaying() const
+{
+	return m_bPlaying;
+}
+
+
+
+/*************************************************************************
+                           AUDIO CALLBACK
+*************************************************************************/
+
+
+/** SDL_mixer music hook. The stream is silent when this is called. */
+void CMusicStreamer::HookMusic( void* a_pvStreamer, Uint8* a_pcStream, int a_iLength )
+{
+	((CMusicStreamer*)a_pvStreamer)->Mix( (Sint16*) a_pcStream, a_iLength / 4 );
+}
+
+
+/** Adds the active streams to the output, applying the fades. Only
+copies from the rings; never waits for the decoder. */
+void CMusicStreamer::Mix( Sint16* a_piStream, int a_iNumFrames )
+{
+	int iVolume = m_iVolume;
+
+	for ( int iStream=0; iStream<2; ++iStream )
+	{
+		SStream& roStream = m_aoStreams[iStream];
+		if ( !roStream.m_bActive )
+		{
+			continue;
+		}
+
+		unsigned int iRead = roStream.m_iRead;
+		int iFrames = roStream.m_iWrite - iRead;
+		SPSC_BARRIER();
+
+		if ( iFrames < a_iNumFrames )
+		{
+			if ( !roStream.m_bEnding )
+			{
+				++m_iNumUnderruns;
+			}
+		}
+		else
+		{
+			iFrames = a_iNumFrames;
+		}
+
+		Sint16* piOut = a_piStream;
+		for ( int i=0; i<iFrames; ++i, ++iRead )
+		{
+			if ( roStream.m_iGain != roStream.m_iTargetGain )
+			{
+				roStream.m_iGain += roStream.m_iGainStep;
+				if ( ( roStream.m_iGainStep > 0 && roStream.m_iGain > roStream.m_iTargetGain )
+					|| ( roStream.m_iGainStep < 0 && roStream.m_iGain < roStream.m_iTargetGain ) )
+				{
+					roStream.m_iGain = roStream.m_iTargetGain;
+				}
+			}
+
+			int iScale = ( roStream.m_iGain * iVolume ) >> 7;
+			const Sint16* piIn = roStream.m_aiRing + ( iRead & (MUSIC_RINGFRAMES-1) ) * 2;
+			for ( int j=0; j<2; ++j )
+			{
+				int iValue = *piOut + ( ( piIn[j] * iScale ) >> 15 );
+				*piOut++ = iValue > 32767 ? 32767 : ( iValue < -32768 ? -32768 : iValue );
+			}
+		}
+
+		SPSC_BARRIER();
+		roStream.m_iRead = iRead;
+
+		if ( roStream.m_bEnding
+			&& ( 0 == roStream.m_iGain || roStream.m_iRead == roStream.m_iWrite ) )
+		{
+			roStream.m_bActive = false;
+		}
+	}
+}
+
+
+
+/*************************************************************************
+                           DECODER THREAD
+*************************************************************************/
+
+
+#ifdef HAVE_LIBMIKMOD
+
+
+int CMusicStreamer::DecoderThread( void* a_pvStreamer )
+{
+	((CMusicStreamer*)a_pvStreamer)->RunDecoder();
+	return 0;
+}
+
+
+void CMusicStreamer::RunDecoder()
+{
+	SCommand oCommand;
+
+	while ( 1 )
+	{
+		while ( m_oCommands.Pop( oCommand ) )
+		{
+			std::string sFilename( oCommand.m_acFilename );
+			switch ( oCommand.m_enCommand )
+			{
+			case Cmd_Prefetch:	GetModule( sFilename ); break;
+			case Cmd_Unload:	DoUnload( sFilename ); break;
+			case Cmd_Play:		DoPlay( sFilename, oCommand.m_iMilliSec ); break;
+			case Cmd_FadeOut:	DoFadeOut( oCommand.m_iMilliSec ); break;
+			case Cmd_Halt:		DoHalt(); break;
+			case Cmd_Quit:
+			{
+				DoHalt();
+				for ( ModuleMapIterator it = m_oModules.begin(); it != m_oModules.end(); ++it )
+				{
+					Player_Free( (*it).second );
+				}
+				m_oModules.clear();
+				MikMod_Exit();
+				return;
+			}
+			}
+		}
+
+		if ( m_iCurrent >= 0 && !Decode( m_aoStreams[m_iCurrent] ) )
+		{
+			// The track ended; it plays out from the ring.
+			Player_Stop();
+			m_iCurrent = -1;
+			m_sCurrentFilename = "";
+		}
+
+		SDL_Delay( 10 );
+	}
+}
+
+
+/** Returns the loaded module of a file in the sound directory, loading it
+if needed. Returns NULL if it can't be loaded. */
+MODULE* CMusicStreamer::GetModule( const std::string& a_rsFilename )
+{
+	ModuleMapIterator it = m_oModules.find( a_rsFilename );
+	if ( m_oModules.end() != it )
+	{
+		return (*it).second;
+	}
+
+	std::string sPath = DATADIR;
+	sPath += "/sound/";
+	sPath += a_rsFilename;
+
+	MODULE* poModule = Player_Load( (CHAR*) sPath.c_str(), 64, 0 );
+	if ( NULL == poModule )
+	{
+		debug( "Player_Load %s: %s\n", sPath.c_str(), MikMod_strerror( MikMod_errno ) );
+		return NULL;
+	}
+
+	poModule->wrap = 1;
+	poModule->loop = 1;
+	m_oModules[ a_rsFilename ] = poModule;
+	return poModule;
+}
+
+
+void CMusicStreamer::DoUnload( const std::string& a_rsFilename )
+{
+	ModuleMapIterator it = m_oModules.find( a_rsFilename );
+	if ( m_oModules.end() == it )
+	{
+		return;
+	}
+
+	if ( m_sCurrentFilename == a_rsFilename )
+	{
+		DoHalt();
+	}
+	Player_Free( (*it).second );
+	m_oModules.erase( it );
+}
+
+
+/** Fills the ring of the new track first, then starts the crossfade. */
+void CMusicStreamer::DoPlay( const std::string& a_rsFilename, int a_iCrossfadeMs )
+{
+	MODULE* poModule = GetModule( a_rsFilename );
+	if ( NULL == poModule )
+	{
+		return;
+	}
+
+	int iNew = m_iCurrent < 0 ? 0 : 1 - m_iCurrent;
+	SStream& roNew = m_aoStreams[iNew];
+
+	// The new stream may still be fading out from an earlier change.
+	SDL_LockAudio();
+	roNew.m_bActive = false;
+	SDL_UnlockAudio();
+
+	roNew.m_iWrite = roNew.m_iRead = 0;
+	roNew.m_bEnding = false;
+
+	Player_Stop();
+	Player_Start( poModule );
+	Player_SetPosition( 0 );
+	Decode( roNew );
+
+	int iFadeFrames = (int)( (double) a_iCrossfadeMs * m_iFrequency / 1000 );
+
+	SDL_LockAudio();
+	if ( m_iCurrent >= 0 )
+	{
+		SStream& roOld = m_aoStreams[m_iCurrent];
+		int iBuffered = roOld.m_iWrite - roOld.m_iRead;
+		roOld.m_bEnding = true;
+		SetFade( roOld, 0, iFadeFrames < iBuffered ? iFadeFrames : iBuffered );
+		if ( 0 == iFadeFrames )
+		{
+			roOld.m_bActive = false;
+		}
+	}
+	roNew.m_iGain = 0;
+	SetFade( roNew, MUSIC_UNITGAIN, iFadeFrames );
+	roNew.m_bActive = true;
+	SDL_UnlockAudio();
+
+	m_iCurrent = iNew;
+	m_sCurrentFilename = a_rsFilename;
+}
+
+
+/** Lets the current track fade out from the ring, and stops decoding. */
+void CMusicStreamer::DoFadeOut( int a_iMilliSec )
+{
+	if ( m_iCurrent < 0 )
+	{
+		return;
+	}
+
+	SStream& roStream = m_aoStreams[m_iCurrent];
+	int iFadeFrames = (int)( (double) a_iMilliSec * m_iFrequency / 1000 );
+
+	SDL_LockAudio();
+	int iBuffered = roStream.m_iWrite - roStream.m_iRead;
+	roStream.m_bEnding = true;
+	SetFade( roStream, 0, iFadeFrames < iBuffered ? iFadeFrames : iBuffered );
+	SDL_UnlockAudio();
+
+	Player_Stop();
+	m_iCurrent = -1;
+	m_sCurrentFilename = "";
+}
+
+
+void CMusicStreamer::DoHalt()
+{
+	SDL_LockAudio();
+	m_aoStreams[0].m_bActive = m_aoStreams[1].m_bActive = false;
+	SDL_UnlockAudio();
+
+	Player_Stop();
+	m_iCurrent = -1;
+	m_sCurrentFilename = "";
+}
+
+
+/** Decodes the current module until the ring is full.
+\retval false if the module has ended. */
+bool CMusicStreamer::Decode( SStream& a_roStream )
+{
+	// MUSIC_RINGFRAMES is a multiple of MUSIC_DECODEFRAMES, so a block
+	// never wraps around the end of the ring.
+
+	while ( MUSIC_RINGFRAMES - ( a_roStream.m_iWrite - a_roStream.m_iRead ) >= MUSIC_DECODEFRAMES )
+	{
+		if ( !Player_Active() )
+		{
+			SDL_LockAudio();
+			a_roStream.m_bEnding = true;
+			SDL_UnlockAudio();
+			return false;
+		}
+
+		Sint16* piBlock = a_roStream.m_aiRing + ( a_roStream.m_iWrite & (MUSIC_RINGFRAMES-1) ) * 2;
+		VC_WriteBytes( (SBYTE*) piBlock, MUSIC_DECODEFRAMES * 4 );
+		SPSC_BARRIER();
+		a_roStream.m_iWrite += MUSIC_DECODEFRAMES;
+	}
+	return true;
+}
+
+
+#endif // HAVE_LIBMIKMOD
+
+
+/** Sets up a linear fade to the target gain over the given number of
+frames. Must be called with the audio device locked. */
+void CMusicStreamer::SetFade( SStream& a_roStream, int a_iTargetGain, int a_iNumFrames )
+{
+	a_roStream.m_iTargetGain = a_iTargetGain;
+	if ( a_iNumFrames <= 0 )
+	{
+		a_roStream.m_iGain = a_iTargetGain;
+		a_roStream.m_iGainStep = 0;
+		return;
+	}
+
+	int iDelta = a_iTargetGain - a_roStream.m_iGain;
+	a_roStream.m_iGainStep = iDelta / a_iNumFrames;
+	if ( 0 == a_roStream.m_iGainStep && iDelta )
+	{
+		a_roStream.m_iGainStep = iDelta > 0 ? 1 : -1;
+	}
+}
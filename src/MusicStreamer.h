@@ -0,0 +1,135 @@
+/***************************************************************************
+                          MusicStreamer.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef MUSICSTREAMER_H
+#define MUSICSTREAMER_H
+
+
+#include "SpscQueue.h"
+#include "SDL_types.h"
+
+#include <string>
+#include <map>
+
+
+#define MUSIC_RINGFRAMES	65536	///< Read-ahead per stream; about 3 s at 22 kHz. Power of two.
+#define MUSIC_DECODEFRAMES	1024	///< The decoder writes the ring in blocks of this many frames.
+#define MUSIC_CROSSFADEMS	1000	///< Default crossfade between tracks.
+#define MUSIC_UNITGAIN		32768
+
+
+struct SDL_Thread;
+struct MODULE;
+
+
+/**
+\ingroup Media
+\brief Plays the music from a decoder thread, with crossfading.
+
+The music is decoded with libmikmod on a thread of its own, into a ring
+buffer of signed 16 bit stereo frames that is kept full
+(MUSIC_RINGFRAMES). The audio callback only copies from the ring
+(SDL_mixer calls HookMusic() in place of its own music player), so
+opening, loading and starting a track never happens on the UI thread or
+on the audio callback.
+
+There are two streams, so that a new track can fade in while the old one
+fades out. When a track is changed, the old stream is no longer decoded;
+it fades out from what is already in its ring, which is why the crossfade
+can't be longer than the read-ahead. The new track's ring is filled
+before its fade starts.
+
+Modules are loaded by Prefetch() in the background and kept until
+Unload(), so switching to a prefetched track never touches the disk.
+
+The UI thread talks to the decoder through a lock-free command queue; the
+decoder locks the audio device only for the few instructions that switch
+the streams.
+*/
+
+class CMusicStreamer
+{
+public:
+	CMusicStreamer();
+	~CMusicStreamer();
+
+	bool				Start( int a_iFrequency );
+	void				Shutdown();
+
+	void				Prefetch( const char* a_pcFilename );
+	void				Unload( const char* a_pcFilename );
+	void				Play( const char* a_pcFilename, int a_iCrossfadeMs );
+	void				FadeOut( int a_iMilliSec );
+	void				Halt();
+	void				SetVolume( int a_iVolume );
+	bool				IsPlaying() const;
+
+	static void			HookMusic( void* a_pvStreamer, Uint8* a_pcStream, int a_iLength );
+	void				Mix( Sint16* a_piStream, int a_iNumFrames );
+
+protected:
+	enum TCommandEnum
+	{
+		Cmd_Prefetch,
+		Cmd_Unload,
+		Cmd_Play,
+		Cmd_FadeOut,
+		Cmd_Halt,
+		Cmd_Quit,
+	};
+
+	struct SCommand
+	{
+		TCommandEnum	m_enCommand;
+		int				m_iMilliSec;
+		char			m_acFilename[256];
+	};
+
+	/** One track being played. The ring is written by the decoder and
+	read by the audio callback; the rest is changed by the decoder with
+	the audio device locked. */
+	struct SStream
+	{
+		Sint16			m_aiRing[MUSIC_RINGFRAMES*2];
+		volatile unsigned int	m_iWrite;	///< Frames written; written by the decoder.
+		volatile unsigned int	m_iRead;	///< Frames played; written by the audio callback.
+		bool			m_bActive;
+		bool			m_bEnding;		///< Nothing more will be decoded; stop when the ring is empty.
+		int				m_iGain;		///< 0 - MUSIC_UNITGAIN
+		int				m_iTargetGain;
+		int				m_iGainStep;	///< Gain change per frame.
+	};
+
+	void				SendCommand( TCommandEnum a_enCommand, const char* a_pcFilename, int a_iMilliSec );
+	static int			DecoderThread( void* a_pvStreamer );
+	void				RunDecoder();
+	void				DoPlay( const std::string& a_rsFilename, int a_iCrossfadeMs );
+	void				DoFadeOut( int a_iMilliSec );
+	void				DoHalt();
+	void				DoUnload( const std::string& a_rsFilename );
+	MODULE*				GetModule( const std::string& a_rsFilename );
+	bool				Decode( SStream& a_roStream );
+	void				SetFade( SStream& a_roStream, int a_iTargetGain, int a_iNumFrames );
+
+protected:
+	CSpscQueue<SCommand,32>	m_oCommands;		///< UI thread -> decoder
+	SStream				m_aoStreams[2];
+	int					m_iCurrent;				///< The stream being decoded, or -1. Decoder only.
+	std::string			m_sCurrentFilename;		///< The track being decoded. Decoder only.
+	int					m_iFrequency;
+	SDL_Thread*			m_poThread;
+	std::map<std::string,MODULE*>	m_oModules;	///< Loaded modules by filename. Decoder only.
+
+	bool				m_bPlaying;				///< As the UI thread last asked.
+	volatile int		m_iVolume;				///< 0 - 128
+	volatile int		m_iNumUnderruns;
+};
+
+
+#endif // MUSICSTREAMER_H
@@ -17,6 +17,14 @@
 #include "common.h"
 #include "config.h"
 #include "Event.h"
+#include "Tracer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#ifdef __linux__
+#include <unistd.h>
+#endif
 
 //#include "SDL_video.h"
 
@@ -24,6 +32,12 @@
 #define MORTALNETSERVER		"apocalypse.game-host.org"
 #define MORTALNETWORKPORT	0x3A23
 
+#define CHAT_SLOWFRAME_MS	20
+#define CHAT_MAXREADPERFRAME	65536
+
+static std::string g_sMortalNetServer = MORTALNETSERVER;
+static int g_iMortalNetPort = MORTALNETWORKPORT;
+
 // Layout
 
 #define READLINE_Y			440
@@ -36,6 +50,215 @@ bool MortalNetworkCheckKey();
 
 
 
+/*************************************************************************
+                             USER INDEX
+*************************************************************************/
+
+
+CChatUsers::CChatUsers()
+{
+	Clear();
+}
+
+
+CChatUsers::~CChatUsers()
+{
+}
+
+
+void CChatUsers::Clear()
+{
+	m_aoUsers.clear();
+	m_aiBuckets.assign( 64, -1 );
+	m_aiSorted.clear();
+	m_bSorted = true;
+}
+
+
+/** FNV-1a */
+unsigned int CChatUsers::Hash( const std::string& a_rsNick )
+{
+	unsigned int iHash = 2166136261u;
+	for ( std::string::size_type i=0; i<a_rsNick.size(); ++i )
+	{
+		iHash ^= (unsigned char) a_rsNick[i];
+		iHash *= 16777619u;
+	}
+	return iHash;
+}
+
+
+/** Returns the bucket of the user, or -1 if there is no such user. */
+int CChatUsers::FindIndex( const std::string& a_rsNick ) const
+{
+	int iMask = m_aiBuckets.size() - 1;
+	for ( int i = Hash( a_rsNick ) & iMask; m_aiBuckets[i] >= 0; i = (i+1) & iMask )
+	{
+		if ( m_aoUsers[ m_aiBuckets[i] ].m_sNick == a_rsNick )
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+void CChatUsers::Rehash( int a_iNumBuckets )
+{
+	m_aiBuckets.assign( a_iNumBuckets, -1 );
+	int iMask = a_iNumBuckets - 1;
+	for ( int iUser = 0; iUser < (int) m_aoUsers.size(); ++iUser )
+	{
+		int i = Hash( m_aoUsers[iUser].m_sNick ) & iMask;
+		while ( m_aiBuckets[i] >= 0 ) i = (i+1) & iMask;
+		m_aiBuckets[i] = iUser;
+	}
+}
+
+
+const CChatUsers::SUser* CChatUsers::Find( const std::string& a_rsNick ) const
+{
+	int iBucket = FindIndex( a_rsNick );
+	return iBucket < 0 ? NULL : &m_aoUsers[ m_aiBuckets[iBucket] ];
+}
+
+
+/** Adds a user, or changes the host of the user if it is already known. */
+void CChatUsers::Set( const std::string& a_rsNick, const std::string& a_rsHost )
+{
+	int iBucket = FindIndex( a_rsNick );
+	if ( iBucket >= 0 )
+	{
+		m_aoUsers[ m_aiBuckets[iBucket] ].m_sHost = a_rsHost;
+		return;
+	}
+	
+	SUser oUser;
+	oUser.m_sNick = a_rsNick;
+	oUser.m_sHost = a_rsHost;
+	m_aoUsers.push_back( oUser );
+	m_bSorted = false;
+	
+	if ( m_aoUsers.size() * 2 > m_aiBuckets.size() )
+	{
+		Rehash( m_aiBuckets.size() * 2 );
+		return;
+	}
+	
+	int iMask = m_aiBuckets.size() - 1;
+	int i = Hash( a_rsNick ) & iMask;
+	while ( m_aiBuckets[i] >= 0 ) i = (i+1) & iMask;
+	m_aiBuckets[i] = m_aoUsers.size() - 1;
+}
+
+
+/** Removes a user. \retval false if there was no such user. */
+bool CChatUsers::Remove( const std::string& a_rsNick )
+{
+	int iBucket = FindIndex( a_rsNick );
+	if ( iBucket < 0 )
+	{
+		return false;
+	}
+	int iUser = m_aiBuckets[iBucket];
+	
+	// 1. Remove the bucket, and move back the entries that probed past it.
+	
+	int iMask = m_aiBuckets.size() - 1;
+	int i = iBucket;
+	for ( int j = (i+1) & iMask; m_aiBuckets[j] >= 0; j = (j+1) & iMask )
+	{
+		int k = Hash( m_aoUsers[ m_aiBuckets[j] ].m_sNick ) & iMask;
+		bool bStays = ( i <= j ) ? ( i < k && k <= j ) : ( i < k || k <= j );
+		if ( !bStays )
+		{
+			m_aiBuckets[i] = m_aiBuckets[j];
+			i = j;
+		}
+	}
+	m_aiBuckets[i] = -1;
+	
+	// 2. Move the last user into the hole.
+	
+	int iLast = m_aoUsers.size() - 1;
+	if ( iUser != iLast )
+	{
+		m_aiBuckets[ FindIndex( m_aoUsers[iLast].m_sNick ) ] = iUser;
+		m_aoUsers[iUser].m_sNick.swap( m_aoUsers[iLast].m_sNick );
+		m_aoUsers[iUser].m_sHost.swap( m_aoUsers[iLast].m_sHost );
+	}
+	m_aoUsers.pop_back();
+	m_bSorted = false;
+	return true;
+}
+
+
+void CChatUsers::Rename( const std::string& a_rsOldNick, const std::string& a_rsNewNick )
+{
+	const SUser* poUser = Find( a_rsOldNick );
+	std::string sHost = poUser ? poUser->m_sHost : "";
+	Remove( a_rsOldNick );
+	Set( a_rsNewNick, sHost );
+}
+
+
+int CChatUsers::GetNumberOfUsers() const
+{
+	return m_aoUsers.size();
+}
+
+
+const CChatUsers::SUser& CChatUsers::GetUser( int a_iIndex ) const
+{
+	return m_aoUsers[a_iIndex];
+}
+
+
+struct SNickLess
+{
+	const std::vector<CChatUsers::SUser>* m_poUsers;
+	bool operator()( int a, int b ) const
+	{
+		return (*m_poUsers)[a].m_sNick < (*m_poUsers)[b].m_sNick;
+	}
+};
+
+
+/** Returns the indexes of the users, in alphabetical order of the nicks.
+The indexes are only valid until the users are changed. */
+const std::vector<int>& CChatUsers::GetSortedIndexes()
+{
+	if ( !m_bSorted )
+	{
+		m_aiSorted.resize( m_aoUsers.size() );
+		for ( int i=0; i<(int) m_aiSorted.size(); ++i )
+		{
+			m_aiSorted[i] = i;
+		}
+		SNickLess oLess;
+		oLess.m_poUsers = &m_aoUsers;
+		std::sort( m_aiSorted.begin(), m_aiSorted.end(), oLess );
+		m_bSorted = true;
+	}
+	return m_aiSorted;
+}
+
+
+/** Returns the approximate number of bytes used by the user index. */
+long CChatUsers::GetMemoryUsage() const
+{
+	long iBytes = m_aoUsers.capacity() * sizeof(SUser)
+		+ ( m_aiBuckets.capacity() + m_aiSorted.capacity() ) * sizeof(int);
+	for ( std::vector<SUser>::const_iterator it = m_aoUsers.begin(); it != m_aoUsers.end(); ++it )
+	{
+		iBytes += it->m_sNick.capacity() + it->m_sHost.capacity();
+	}
+	return iBytes;
+}
+
+
+
+
 /*************************************************************************
                        CHAT / CHALLENGE MENUS
 *************************************************************************/
@@ -110,23 +333,25 @@ connected to MortalNet. The Chat menu has a different set of operations.
 class CChatMenu: public Menu
 {
 public:
-	CChatMenu( const TNickMap& a_roNicks )
+	CChatMenu( CChatUsers& a_roUsers )
 	: Menu( "MortalNet Menu" ),
-	m_roNicks( a_roNicks )
+	m_roUsers( a_roUsers )
 	{
 		int i=0;
-		TNickMap::const_iterator it;
-		for ( it=m_roNicks.begin();
-			it != m_roNicks.end() && i < 1023;
-			++it, ++i )
+		const std::vector<int>& raiSorted = m_roUsers.GetSortedIndexes();
+		std::vector<int>::const_iterator it;
+		for ( it=raiSorted.begin();
+			it != raiSorted.end() && i < 1023;
+			++it )
 		{
-			if ( it->first == g_oState.m_acNick )
+			const std::string& rsNick = m_roUsers.GetUser( *it ).m_sNick;
+			if ( rsNick == g_oState.m_acNick )
 			{
-				--i;
 				continue;
 			}
-			m_apcNicks[i] = (it->first).c_str();
+			m_apcNicks[i] = rsNick.c_str();
 			m_aiNicks[i] = i;
+			++i;
 		}
 		m_apcNicks[i] = NULL;
 		m_sNick = g_oState.m_acNick;
@@ -197,7 +422,7 @@ protected:
 	std::string		m_sChallengedNick;
 	std::string		m_sNick;
 	
-	const TNickMap&	m_roNicks;
+	CChatUsers&		m_roUsers;
 	const char*		m_apcNicks[1024];
 	int				m_aiNicks[1024];
 	TextMenuItem*	m_poNickMenuItem;
@@ -217,24 +442,20 @@ protected:
 COnlineChat::COnlineChat()
 {
 	m_poScreen = gamescreen;
-	m_poBackground = NULL;
 	m_poSocket = NULL;
 	m_poSocketSet = NULL;
 	m_iIncomingBufferSize = 0;
 	m_poReadline = NULL;
 	m_poTextArea = NULL;
+	m_bMyNickIsOk = false;
+	m_bUsersChanged = m_bTextChanged = false;
+	m_dStatStartNs = 0.0;
 }
 
 
 COnlineChat::~COnlineChat()
 {
 	Stop();
-	
-	if ( m_poBackground )
-	{
-		SDL_FreeSurface( m_poBackground );
-		m_poBackground = NULL;
-	}
 }
 
 
@@ -261,20 +482,20 @@ bool COnlineChat::Start()
 		debug( "%s\n", m_sLastError.c_str() );		\
 		return false; }
 
-	m_poBackground = LoadBackground( "FighterStats.jpg", 64 );
-	if ( NULL == m_poBackground )
+	m_oBackground = g_oAssetCache.GetBackground( "FighterStats.jpg", 64 );
+	if ( NULL == m_oBackground.Get() )
 	{
 		return false;	// Should carp
 	}
 
-	SDL_BlitSurface( m_poBackground, NULL, m_poScreen, NULL );
+	SDL_BlitSurface( m_oBackground.Get(), NULL, m_poScreen, NULL );
 	SDL_Flip( m_poScreen );
 
 	MortalNetworkResetMessages( false );
-	MortalNetworkMessage( Translate("Resolving hostname (%s)..."), MORTALNETSERVER );
+	MortalNetworkMessage( Translate("Resolving hostname (%s)..."), g_sMortalNetServer.c_str() );
 	
 	IPaddress oAddress;
-	int iResult = SDLNet_ResolveHost( &oAddress, MORTALNETSERVER, MORTALNETWORKPORT );
+	int iResult = SDLNet_ResolveHost( &oAddress, g_sMortalNetServer.c_str(), g_iMortalNetPort );
 	if ( iResult )
 	{
 		m_sLastError = Translate( "Couldn't resolve host." );
@@ -309,7 +530,9 @@ bool COnlineChat::Start()
 
 	m_iIncomingBufferSize = 0;
 	m_bMyNickIsOk = false;
-	m_asNicks.clear();
+	m_oUsers.Clear();
+	m_bUsersChanged = m_bTextChanged = false;
+	ResetStatistics();
 	
 	SendRawData( 'N', g_oState.m_acNick );
 	
@@ -320,6 +543,8 @@ bool COnlineChat::Start()
 
 void COnlineChat::Stop()
 {
+	ReportStatistics();
+	
 	if ( m_poSocketSet )
 	{
 		SDLNet_FreeSocketSet( m_poSocketSet );
@@ -331,7 +556,7 @@ void COnlineChat::Stop()
 		m_poSocket = NULL;
 	}
 	m_bMyNickIsOk = false;
-	m_asNicks.clear();
+	m_oUsers.Clear();
 	
 	if ( g_oState.m_enGameMode == SState::IN_CHAT )
 	{
@@ -366,93 +591,97 @@ void COnlineChat::SendRawData( char a_cID, const std::string& a_rsData )
 void COnlineChat::Update()
 {
 	CHECKCONNECTION;
+	CTraceScope oTrace( "ChatUpdate" );
 	
-	// 1. CHECK FOR STUFF TO READ
-	
-	int iRetval = SDLNet_CheckSockets( m_poSocketSet, 0 );
-	if ( iRetval <= 0 )
-	{
-		return;
-	}
+	double dParseStart = GetNanoseconds();
+	int iBytesThisFrame = 0;
 	
-	// 2. APPEND AT MOST 1024 bytes TO THE END OF THE INCOMING BUFFER
-
-	// CHECK FOR BUFFER OVERFLOW HERE.
-	if ( m_iIncomingBufferSize >= 1024*3 )
+	while ( iBytesThisFrame < CHAT_MAXREADPERFRAME )
 	{
-		m_acIncomingBuffer[m_iIncomingBufferSize] = '\n';
-		m_acIncomingBuffer[m_iIncomingBufferSize+1] = 'x';
-		m_iIncomingBufferSize += 1;
-	}
-	else
-	{
-		iRetval = SDLNet_TCP_Recv( m_poSocket, m_acIncomingBuffer + m_iIncomingBufferSize, 1024 );
+		// 1. CHECK FOR STUFF TO READ
+		
+		int iRetval = SDLNet_CheckSockets( m_poSocketSet, 0 );
 		if ( iRetval <= 0 )
 		{
-			m_sLastError = SDLNet_GetError();
-			Stop();
-			return;
+			break;
 		}
-		m_iIncomingBufferSize += iRetval;
-	}
-	
-	// 3. CONSUME THE INCOMING BUFFER.
-	// We always make sure the incoming buffer starts with a package header.
-
-	int iOffset = 0;
-	m_acIncomingBuffer[ m_iIncomingBufferSize ] = 0;
-	bool bRedraw = false;
-	
-	while ( iOffset < m_iIncomingBufferSize )
-	{
-		// 3.1. Find the end of the line.
 		
-		char* pcLineEnd = strchr( m_acIncomingBuffer + iOffset, '\n' );
-		if ( NULL == pcLineEnd )
+		// 2. APPEND AT MOST 1024 bytes TO THE END OF THE INCOMING BUFFER
+	
+		// CHECK FOR BUFFER OVERFLOW HERE.
+		if ( m_iIncomingBufferSize >= 1024*3 )
 		{
-			// The buffer doesn't have the end of the line (yet)
-			debug( "Buffer doesn't have the NL (%d buffer, %d offset)\n", m_iIncomingBufferSize, iOffset );
-			break;
+			m_acIncomingBuffer[m_iIncomingBufferSize] = '\n';
+			m_acIncomingBuffer[m_iIncomingBufferSize+1] = 'x';
+			m_iIncomingBufferSize += 1;
+		}
+		else
+		{
+			iRetval = SDLNet_TCP_Recv( m_poSocket, m_acIncomingBuffer + m_iIncomingBufferSize, 1024 );
+			if ( iRetval <= 0 )
+			{
+				m_sLastError = SDLNet_GetError();
+				Stop();
+				return;
+			}
+			m_iIncomingBufferSize += iRetval;
+			m_iStatBytes += iRetval;
+			iBytesThisFrame += iRetval;
 		}
 		
-		*pcLineEnd = 0;
-
-		debug( "Receiving message: %d ('%c') type, %d length, %d offset, %d in buffer.\n",
-			m_acIncomingBuffer[iOffset], m_acIncomingBuffer[iOffset],
-			pcLineEnd - m_acIncomingBuffer - iOffset, iOffset, m_iIncomingBufferSize );
-		
-		// 3.2. Receive the data.
+		// 3. CONSUME THE INCOMING BUFFER.
+		// We always make sure the incoming buffer starts with a package header.
+	
+		int iOffset = 0;
+		m_acIncomingBuffer[ m_iIncomingBufferSize ] = 0;
 		
-		switch ( m_acIncomingBuffer[iOffset] )
+		while ( iOffset < m_iIncomingBufferSize )
 		{
-			case 'M':
-			case 'S':
-				ReceiveMsg( m_acIncomingBuffer[iOffset], m_acIncomingBuffer + iOffset + 1 ); bRedraw = true; break;
-			case 'J':
-			case 'L':
-			case 'N':
-			case 'Y':
-			case 'W':
-			case 'C':
-				ReceiveUser( m_acIncomingBuffer[iOffset], m_acIncomingBuffer + iOffset + 1 ); bRedraw = true; break;
+			// 3.1. Find the end of the line.
+			
+			char* pcLineEnd = strchr( m_acIncomingBuffer + iOffset, '\n' );
+			if ( NULL == pcLineEnd )
+			{
+				// The buffer doesn't have the end of the line (yet)
+				break;
+			}
+			
+			*pcLineEnd = 0;
+			++m_iStatLines;
+			
+			// 3.2. Receive the data.
+			
+			switch ( m_acIncomingBuffer[iOffset] )
+			{
+				case 'M':
+				case 'S':
+					ReceiveMsg( m_acIncomingBuffer[iOffset], m_acIncomingBuffer + iOffset + 1 ); break;
+				case 'J':
+				case 'L':
+				case 'N':
+				case 'Y':
+				case 'W':
+				case 'C':
+					ReceiveUser( m_acIncomingBuffer[iOffset], m_acIncomingBuffer + iOffset + 1 ); break;
+			}
+			
+			CHECKCONNECTION;
+			
+			iOffset = pcLineEnd - m_acIncomingBuffer + 1;
 		}
 		
-		CHECKCONNECTION;
+		// 4. MOVE LEFTOVER DATA TO THE BEGINNING OF THE INCOMING BUFFER
+		// The leftover data starts at iOffset, and is (m_iIncomingBufferSize-iOffset) long.
 		
-		iOffset = pcLineEnd - m_acIncomingBuffer + 1;
+		memmove( m_acIncomingBuffer, m_acIncomingBuffer + iOffset, m_iIncomingBufferSize-iOffset );
+		m_iIncomingBufferSize -= iOffset;
 	}
 	
-	// 4. MOVE LEFTOVER DATA TO THE BEGINNING OF THE INCOMING BUFFER
-	// The leftover data starts at iOffset, and is (m_iIncomingBufferSize-iOffset) long.
+	// 5. SHOW EVERYTHING THAT CHANGED IN THIS FRAME AT ONCE.
 	
-	memmove( m_acIncomingBuffer, m_acIncomingBuffer + iOffset, m_iIncomingBufferSize-iOffset );
-	m_iIncomingBufferSize -= iOffset;
-
-	if ( bRedraw && m_poTextArea )
-	{
-		Audio->PlaySample( "NETWORK_MESSAGE" );
-		m_poTextArea->Redraw();
-	}
+	DrawChanges();
+	
+	m_dStatParseNs += GetNanoseconds() - dParseStart;
 }
 
 
@@ -464,27 +693,28 @@ void COnlineChat::Update()
 
 void COnlineChat::ReceiveMsg( char a_cID, char* a_pcData )
 {
-	debug( "Received message %c, content is '%s'\n", a_cID, a_pcData );
 	if ( m_poTextArea )
 	{
 		m_poTextArea->AddString( a_pcData, a_cID == 'M' ? C_YELLOW : C_WHITE );
+		m_bTextChanged = true;
 	}
 }
 
 
 void COnlineChat::ReceiveUser( char a_cID, char* a_pcData )
 {
-	debug( "Received user %c, content is '%s'\n", a_cID, a_pcData );
 	// Split up the data.
-	int iNumWords = 1;
 	char* pcFirstWord = a_pcData;
 	char* pcSecondWord = strchr( a_pcData, ' ' );
 	if ( pcSecondWord )
 	{
-		iNumWords = 2;
 		*pcSecondWord =  0;
 		++pcSecondWord;
 	}
+	else
+	{
+		pcSecondWord = (char*) "";
+	}
 
 	int iColor = C_WHITE;
 	char acMsg[1024];
@@ -496,24 +726,21 @@ void COnlineChat::ReceiveUser( char a_cID, char* a_pcData )
 		sprintf( acMsg, "*** %s has joined MortalChat from %s.", pcFirstWord, pcSecondWord );
 		if ( strcmp( pcFirstWord, g_oState.m_acNick ) != 0 )
 		{
-			m_asNicks[ pcFirstWord ] = pcSecondWord;
+			m_oUsers.Set( pcFirstWord, pcSecondWord );
 		}
 		break;
 	case 'L':
 	{
 		sprintf( acMsg, "*** %s has left MortalChat.", pcFirstWord );
 		iColor = C_LIGHTRED;
-		m_asNicks.erase( pcFirstWord );
-		debug( "# of Nicks: %d\n", m_asNicks.size() );
+		m_oUsers.Remove( pcFirstWord );
 		break;
 	}
 	case 'N':
 	{
 		sprintf( acMsg, "%s is now known as %s", pcFirstWord, pcSecondWord );
 		iColor = C_LIGHTGRAY;
-		std::string sHost = m_asNicks[pcFirstWord];
-		m_asNicks.erase( pcFirstWord );
-		m_asNicks[ pcSecondWord ] = sHost;
+		m_oUsers.Rename( pcFirstWord, pcSecondWord );
 		break;
 	}
 	case 'Y':
@@ -521,8 +748,8 @@ void COnlineChat::ReceiveUser( char a_cID, char* a_pcData )
 		iColor = C_LIGHTCYAN;
 
 		m_bMyNickIsOk = true;
-		m_asNicks.erase( g_oState.m_acNick );
-		m_asNicks[ pcFirstWord ] = "";
+		m_oUsers.Remove( g_oState.m_acNick );
+		m_oUsers.Set( pcFirstWord, "" );
 		
 		strncpy( g_oState.m_acNick, pcFirstWord, 127 );
 		g_oState.m_acNick[127] = 0;
@@ -530,7 +757,7 @@ void COnlineChat::ReceiveUser( char a_cID, char* a_pcData )
 	case 'W':
 		sprintf( acMsg, "%s is hailing from %s", pcFirstWord, pcSecondWord );
 		iColor = C_LIGHTGRAY;
-		m_asNicks[ pcFirstWord ] = pcSecondWord;
+		m_oUsers.Set( pcFirstWord, pcSecondWord );
 		break;
 	case 'C':
 		CChallengeMenu oMenu( pcFirstWord );
@@ -538,7 +765,8 @@ void COnlineChat::ReceiveUser( char a_cID, char* a_pcData )
 		if ( oMenu.GetAccepted() )
 		{
 			MortalNetworkResetMessages( true );
-			Connect( m_asNicks[pcFirstWord].c_str() );
+			const CChatUsers::SUser* poUser = m_oUsers.Find( pcFirstWord );
+			Connect( poUser ? poUser->m_sHost.c_str() : "" );
 		}
 		Redraw();
 		break;
@@ -547,7 +775,7 @@ void COnlineChat::ReceiveUser( char a_cID, char* a_pcData )
 	if ( m_poTextArea && m_bMyNickIsOk )
 	{
 		m_poTextArea->AddString( acMsg, iColor );
-		DrawNickList();
+		m_bTextChanged = m_bUsersChanged = true;
 	}
 }
 
@@ -561,11 +789,31 @@ void COnlineChat::ReceiveUser( char a_cID, char* a_pcData )
 
 void COnlineChat::Redraw()
 {
-	SDL_BlitSurface( m_poBackground, NULL, m_poScreen, NULL );
+	SDL_BlitSurface( m_oBackground.Get(), NULL, m_poScreen, NULL );
 	m_poReadline->Redraw();
 	m_poTextArea->Redraw();
 	DrawNickList();
 	SDL_Flip( m_poScreen );
+	m_bTextChanged = m_bUsersChanged = false;
+}
+
+
+
+/** Redraws the text area and the nick list if they changed since the last
+call. This is called once per frame, so any number of received lines
+cost at most one redraw of each. */
+void COnlineChat::DrawChanges()
+{
+	if ( m_bTextChanged && m_poTextArea )
+	{
+		Audio->PlaySample( "NETWORK_MESSAGE" );
+		m_poTextArea->Redraw();
+	}
+	if ( m_bUsersChanged && m_poTextArea )
+	{
+		DrawNickList();
+	}
+	m_bTextChanged = m_bUsersChanged = false;
 }
 
 
@@ -582,18 +830,20 @@ void COnlineChat::DrawNickList()
 	SDL_GetClipRect( m_poScreen, &oOldClipRect );
 	SDL_SetClipRect( m_poScreen, &oNickListRect );
 	
-	SDL_BlitSurface( m_poBackground, &oNickListRect, m_poScreen, &oNickListRect );
+	SDL_BlitSurface( m_oBackground.Get(), &oNickListRect, m_poScreen, &oNickListRect );
 	int y = oNickListRect.y + sge_TTF_FontAscent( chatFont );
 	int yEnd = oNickListRect.y + oNickListRect.h - sge_TTF_FontDescent( chatFont );
 	
 	
-	TNickMap::const_iterator it;
-	for ( it = m_asNicks.begin();
-		it != m_asNicks.end() && y <= yEnd;
+	const std::vector<int>& raiSorted = m_oUsers.GetSortedIndexes();
+	std::vector<int>::const_iterator it;
+	for ( it = raiSorted.begin();
+		it != raiSorted.end() && y <= yEnd;
 		++it , y += sge_TTF_FontHeight( chatFont ) )
 	{
-		int iColor = (it->first) == g_oState.m_acNick ? C_LIGHTCYAN : C_WHITE;
-		sge_tt_textout( m_poScreen, chatFont, (it->first).c_str(), oNickListRect.x, y, iColor, C_BLACK, 255 );
+		const std::string& rsNick = m_oUsers.GetUser( *it ).m_sNick;
+		int iColor = rsNick == g_oState.m_acNick ? C_LIGHTCYAN : C_WHITE;
+		sge_tt_textout( m_poScreen, chatFont, rsNick.c_str(), oNickListRect.x, y, iColor, C_BLACK, 255 );
 	}
 
 	SDL_UpdateRect( m_poScreen, oNickListRect.x, oNickListRect.y, oNickListRect.w, oNickListRect.h );
@@ -621,7 +871,7 @@ void COnlineChat::DoOnlineChat()
 	char		acMsg[256];
 	SDL_Event	event;
 
-	SDL_BlitSurface( m_poBackground, NULL, m_poScreen, NULL );
+	SDL_BlitSurface( m_oBackground.Get(), NULL, m_poScreen, NULL );
 	SDL_Flip( m_poScreen );
 
 	m_poTextArea = new CTextArea( m_poScreen, chatFont, 10, 10, NICKLIST_X-20, READLINE_Y-20 );
@@ -630,13 +880,25 @@ void COnlineChat::DoOnlineChat()
 		acMsg, 0, 255,
 		10, READLINE_Y + sge_TTF_FontAscent(chatFont), 620, C_LIGHTCYAN, C_BLACK, 255 );
 
+	double dFrameStart = 0.0;
 	while (1)
 	{
+		if ( dFrameStart > 0.0 )
+		{
+			double dFrameNs = GetNanoseconds() - dFrameStart;
+			++m_iStatFrames;
+			m_dStatFrameNs += dFrameNs;
+			m_dStatMaxFrameNs = MAX( m_dStatMaxFrameNs, dFrameNs );
+			if ( dFrameNs > CHAT_SLOWFRAME_MS * 1e6 ) ++m_iStatSlowFrames;
+		}
+		
 		if ( g_oState.m_enGameMode != SState::IN_CHAT ) break;
 		if ( NULL == m_poSocket ) break;
+		SDL_Delay( 10 );
+		
+		dFrameStart = GetNanoseconds();
 		Update();
 		if ( NULL == m_poSocket ) break;
-		SDL_Delay( 10 );
 
 		if ( g_oState.m_bQuitFlag ) break;
 
@@ -722,7 +984,7 @@ void COnlineChat::DoOnlineChat()
 
 void COnlineChat::Menu()
 {
-	CChatMenu oMenu( m_asNicks );
+	CChatMenu oMenu( m_oUsers );
 	DoMenu( oMenu );
 	if ( !g_oState.m_bQuitFlag )
 	{
@@ -743,6 +1005,83 @@ void COnlineChat::Menu()
 
 
 
+/*************************************************************************
+                          LOAD STATISTICS
+*************************************************************************/
+
+
+void COnlineChat::ResetStatistics()
+{
+	m_dStatStartNs = GetNanoseconds();
+	m_iStatLines = 0;
+	m_iStatBytes = 0;
+	m_dStatParseNs = 0.0;
+	m_iStatFrames = 0;
+	m_dStatFrameNs = 0.0;
+	m_dStatMaxFrameNs = 0.0;
+	m_iStatSlowFrames = 0;
+}
+
+
+/** Reports the traffic the client received, how long processing it took,
+the frame times of the chat loop and the memory use. This is mostly useful
+together with the stand-in server (see MortalNetServer.cpp). */
+void COnlineChat::ReportStatistics()
+{
+	if ( m_dStatStartNs <= 0.0 )
+	{
+		return;
+	}
+	
+	double dSeconds = ( GetNanoseconds() - m_dStatStartNs ) / 1e9;
+	double dParseSeconds = m_dStatParseNs / 1e9;
+	
+	debug( "MortalNet: %d lines, %ld bytes in %.1f s (%.0f lines/s received).\n",
+		m_iStatLines, m_iStatBytes, dSeconds, dSeconds > 0 ? m_iStatLines / dSeconds : 0.0 );
+	debug( "MortalNet: processing took %.3f s, %.1f us/line, %.0f lines/s.\n",
+		dParseSeconds, m_iStatLines ? m_dStatParseNs / 1e3 / m_iStatLines : 0.0,
+		dParseSeconds > 0 ? m_iStatLines / dParseSeconds : 0.0 );
+	debug( "MortalNet: %d frames, %.2f ms average, %.2f ms max, %d over %d ms.\n",
+		m_iStatFrames, m_iStatFrames ? m_dStatFrameNs / 1e6 / m_iStatFrames : 0.0,
+		m_dStatMaxFrameNs / 1e6, m_iStatSlowFrames, CHAT_SLOWFRAME_MS );
+	
+	long iResidentKb = -1;
+#ifdef __linux__
+	FILE* poStatm = fopen( "/proc/self/statm", "r" );
+	if ( poStatm )
+	{
+		long iSize, iResident;
+		if ( 2 == fscanf( poStatm, "%ld %ld", &iSize, &iResident ) )
+		{
+			iResidentKb = iResident * ( sysconf(_SC_PAGESIZE) / 1024 );
+		}
+		fclose( poStatm );
+	}
+#endif
+	debug( "MortalNet: %d users (about %ld kB), resident memory %ld kB.\n",
+		m_oUsers.GetNumberOfUsers(), m_oUsers.GetMemoryUsage() / 1024, iResidentKb );
+	
+	m_dStatStartNs = 0.0;
+}
+
+
+
+/** Sets the address of the MortalNet server, in the form host[:port]. */
+void SetMortalNetServer( const char* a_pcServer )
+{
+	g_sMortalNetServer = a_pcServer;
+	g_iMortalNetPort = MORTALNETWORKPORT;
+	
+	std::string::size_type iColon = g_sMortalNetServer.find( ':' );
+	if ( iColon != std::string::npos )
+	{
+		g_iMortalNetPort = atoi( g_sMortalNetServer.c_str() + iColon + 1 );
+		g_sMortalNetServer.erase( iColon );
+	}
+}
+
+
+
 /** Static global entry point for chatting. */
 void DoOnlineChat()
 {
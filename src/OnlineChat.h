@@ -41,15 +41,64 @@ Client: C <user>			- Challenge a user
 
 
 #include "SDL_net.h"
+#include "AssetCache.h"
 #include <string>
-#include <map>
+#include <vector>
 
 
 class CReadline;
 class CTextArea;
 struct SDL_Surface;
 
-typedef std::map<std::string,std::string> TNickMap;
+
+/**
+\ingroup Network
+\brief The users in the MortalNet lobby, indexed by nick.
+
+The users are stored in a dense array, and a hash table maps the nicks
+to array positions, so finding, adding and removing a user takes constant
+time regardless of the size of the lobby. Removing a user moves the last
+user into its place.
+
+The nick list on the screen is alphabetical. The sorted order is only
+built when it is asked for, and only if the users changed since the last
+time, so a flood of joins and parts costs one sort per frame at most.
+*/
+
+class CChatUsers
+{
+public:
+	struct SUser
+	{
+		std::string		m_sNick;
+		std::string		m_sHost;
+	};
+
+	CChatUsers();
+	~CChatUsers();
+
+	void					Clear();
+	const SUser*			Find( const std::string& a_rsNick ) const;
+	void					Set( const std::string& a_rsNick, const std::string& a_rsHost );
+	bool					Remove( const std::string& a_rsNick );
+	void					Rename( const std::string& a_rsOldNick, const std::string& a_rsNewNick );
+
+	int						GetNumberOfUsers() const;
+	const SUser&			GetUser( int a_iIndex ) const;
+	const std::vector<int>&	GetSortedIndexes();
+	long					GetMemoryUsage() const;
+
+protected:
+	static unsigned int		Hash( const std::string& a_rsNick );
+	int						FindIndex( const std::string& a_rsNick ) const;
+	void					Rehash( int a_iNumBuckets );
+
+protected:
+	std::vector<SUser>		m_aoUsers;
+	std::vector<int>		m_aiBuckets;	///< Open addressing: user index, or -1 for empty.
+	std::vector<int>		m_aiSorted;		///< User indexes in alphabetical order.
+	bool					m_bSorted;		///< Is m_aiSorted up to date?
+};
 
 
 class COnlineChat
@@ -71,8 +120,12 @@ protected:
 	void					ReceiveUser( char a_cID, char* a_pcData );
 
 	void					DrawNickList();
+	void					DrawChanges();
 	void					Menu();
 
+	void					ResetStatistics();
+	void					ReportStatistics();
+
 
 protected:
 	TCPsocket				m_poSocket;					///< The TCP/IP network socket.
@@ -84,12 +137,24 @@ protected:
 	std::string				m_sLastError;				///< The last error message from SDLNet
 
 	SDL_Surface*			m_poScreen;
-	SDL_Surface*			m_poBackground;
+	CSurfaceHandle			m_oBackground;				///< Shared with the other screens; only blitted.
 	CReadline*				m_poReadline;
 	CTextArea*				m_poTextArea;
 	
 	bool					m_bMyNickIsOk;
-	TNickMap				m_asNicks;
+	CChatUsers				m_oUsers;
+	bool					m_bUsersChanged;			///< The nick list needs to be redrawn.
+	bool					m_bTextChanged;				///< The text area needs to be redrawn.
+	
+	// Load statistics, reported when the chat stops.
+	double					m_dStatStartNs;				///< 0 if there is nothing to report.
+	int						m_iStatLines;				///< Lines received.
+	long					m_iStatBytes;				///< Bytes received.
+	double					m_dStatParseNs;				///< Time spent processing the received lines.
+	int						m_iStatFrames;
+	double					m_dStatFrameNs;				///< Total time of the frames, not counting the sleep.
+	double					m_dStatMaxFrameNs;
+	int						m_iStatSlowFrames;			///< Frames longer than CHAT_SLOWFRAME_MS.
 };
 
 #endif // ONLINECHAT_H
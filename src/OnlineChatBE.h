@@ -122,6 +122,12 @@ extern IOnlineChatBE*	g_poChatBE;
 /** IBackendEventSink is an interface for receiving events from IOnlineChatBE.
 Every backend event sink which is registered to g_poChatBE will be notified of
 chat events as they occur. This is done with the receiveEvent() method.
+
+The events come from the communication thread of the backend, which must
+not call into perl. So the message of connectionStateChange() is in
+English: the sink passes it to Translate() on the main thread, and appends
+the detail (a host name, an address or a system error), which is not
+translated.
 */
 
 class IOnlineEventSink
@@ -133,7 +139,8 @@ public:
 	virtual void		receiveEvent( const IOnlineChatBE::SChatEvent& a_roEvent ) = 0;
 	virtual void		connectionStateChange( IOnlineChatBE::ConnectionStateEnum a_enOldState, 
 											   IOnlineChatBE::ConnectionStateEnum a_enNewState,
-											   const std::string& a_rsMessage ) = 0;
+											   const std::string& a_rsMessage,
+											   const std::string& a_rsDetail ) = 0;
 };
 
 
@@ -10,12 +10,27 @@
 //
 //
 
+// The communication thread waits with poll() on the socket and a wakeup
+// pipe, which Win32 doesn't have; the chat uses COnlineChat there.
+#ifndef _WIN32
+
 #include "OnlineChatBEImpl.h"
 #include "common.h"
+#include "Tracer.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 
 #define MORTALNETSERVER		"apocalypse.game-host.org"
 #define MORTALNETWORKPORT	0x3A23
+#define CONNECTTIMEOUT		10000		///< Milliseconds to wait for one connection attempt.
 
 IOnlineChatBE* g_poChatBE = NULL;
 
@@ -41,8 +56,7 @@ COnlineChatBEImpl::COnlineChatBEImpl()
 	m_enConnectionState = m_enNotifiedState = CS_Disconnected;
 	m_enClientMode = CM_Chatroom;
 	
-	m_poSocket = NULL;
-	m_poSocketSet = NULL;
+	m_iSocket = -1;
 	m_iIncomingBufferSize = 0;
 	
 	
@@ -51,11 +65,45 @@ COnlineChatBEImpl::COnlineChatBEImpl()
 	m_apoUsers.push_front( poMyInfo );			// The first user is always "me"
 	
 	m_poLock = SDL_CreateMutex();
+	
+	// The wakeup pipe must never block the writer or the draining reader.
+	m_bShutdown = false;
+	m_poThread = NULL;
+	if ( 0 == pipe( m_aiWakeupPipe ) )
+	{
+		fcntl( m_aiWakeupPipe[0], F_SETFL, O_NONBLOCK );
+		fcntl( m_aiWakeupPipe[1], F_SETFL, O_NONBLOCK );
+		m_poThread = SDL_CreateThread( threadStarter, this );
+	}
+	else
+	{
+		m_aiWakeupPipe[0] = m_aiWakeupPipe[1] = -1;
+		debug( "COnlineChatBEImpl: can't create the wakeup pipe: %s\n", strerror(errno) );
+	}
 }
 
 
 COnlineChatBEImpl::~COnlineChatBEImpl()
 {
+	if ( m_poThread )
+	{
+		m_bShutdown = true;
+		wakeup();
+		SDL_WaitThread( m_poThread, NULL );
+		m_poThread = NULL;
+	}
+	
+	if ( m_iSocket >= 0 )
+	{
+		close( m_iSocket );
+		m_iSocket = -1;
+	}
+	if ( m_aiWakeupPipe[0] >= 0 )
+	{
+		close( m_aiWakeupPipe[0] );
+		close( m_aiWakeupPipe[1] );
+	}
+	
 	SDL_DestroyMutex( m_poLock );
 	m_poLock = NULL;
 }
@@ -66,9 +114,37 @@ COnlineChatBEImpl::~COnlineChatBEImpl()
 ///////////////////////////////////////////////////////////////////////////
 
 
+/** Sleeps until wakeup() is called, or the timeout (in milliseconds)
+expires. A negative timeout means no timeout.
+
+\retval true if the thread was woken up.
+*/
+bool COnlineChatBEImpl::waitForWakeup( int a_iTimeoutMs )
+{
+	struct pollfd oPoll;
+	oPoll.fd = m_aiWakeupPipe[0];
+	oPoll.events = POLLIN;
+	oPoll.revents = 0;
+	
+	if ( poll( &oPoll, 1, a_iTimeoutMs ) > 0 )
+	{
+		drainWakeupPipe();
+		return true;
+	}
+	return false;
+}
+
+
+void COnlineChatBEImpl::drainWakeupPipe()
+{
+	char acBuffer[64];
+	while ( read( m_aiWakeupPipe[0], acBuffer, sizeof(acBuffer) ) > 0 ) {}
+}
+
+
 /** internalConnect establishes the connection to the server. It is 
 assumed that the client is NOT connected before this method is called.
-Successful execution sets the m_poSocket and other connection related
+Successful execution sets the m_iSocket and other connection related
 attributes, and the m_enConnectionState to CS_Connected
 */
 
@@ -78,42 +154,114 @@ void COnlineChatBEImpl::internalConnect()
 	
 	// 1. RESOLVE MORTALNETSERVER
 	
-	notifyConnectionState( std::string(Translate("Resolving host: ")) + MORTALNETSERVER );
+	notifyConnectionState( "Resolving host:", MORTALNETSERVER );
 	
 	IPaddress oAddress;
 	int iResult = SDLNet_ResolveHost( &oAddress, MORTALNETSERVER, MORTALNETWORKPORT );
 	if ( iResult )
 	{
-		notifyConnectionState( Translate("Couldn't resolve host.") );
+		notifyConnectionState( "Couldn't resolve host." );
 		return;
 	}
 	debug( "IP Address of server is 0x%x\n", oAddress.host );
 
 	Uint32 ipaddr=SDL_SwapBE32(oAddress.host);
 	
-	char acMessage[128];
-	sprintf( acMessage, "%s %d.%d.%d.%d port %d", Translate("Connecting to"),
-		ipaddr>>24, (ipaddr>>16)&0xff, (ipaddr>>8)&0xff, ipaddr&0xff, oAddress.port);
-	notifyConnectionState( acMessage );
-	notifyConnectionState( Translate("Waiting for connection...") );
+	char acAddress[128];
+	sprintf( acAddress, "%d.%d.%d.%d port %d",
+		ipaddr>>24, (ipaddr>>16)&0xff, (ipaddr>>8)&0xff, ipaddr&0xff, SDL_SwapBE16(oAddress.port));
+	notifyConnectionState( "Connecting to", acAddress );
+	notifyConnectionState( "Waiting for connection..." );
 	
 	// 2. ESTABLISH CONNECTION
+	// SDL_net doesn't give access to the socket's descriptor, which we
+	// need for poll(), so the socket is created directly.
+	
+	struct sockaddr_in oSockAddr;
+	memset( &oSockAddr, 0, sizeof(oSockAddr) );
+	oSockAddr.sin_family = AF_INET;
+	oSockAddr.sin_addr.s_addr = oAddress.host;		// Both are in network byte order
+	oSockAddr.sin_port = oAddress.port;
 	
+	int iSocket;
 	while (1)
 	{
-		if ( m_enConnectionState != CS_Connecting )
+		if ( m_enConnectionState != CS_Connecting || m_bShutdown )
 		{	// Operation was canceled by disconnect()
 			return;
 		}
 		
-		m_poSocket = SDLNet_TCP_Open( &oAddress );
-		if ( m_poSocket ) break;
-		SDL_Delay( 100 );
+		iSocket = socket( AF_INET, SOCK_STREAM, 0 );
+		if ( iSocket >= 0 )
+		{
+			// The connect is non-blocking and waited for with poll(), so
+			// disconnect() can wake us up in the middle of it.
+			int iFlags = fcntl( iSocket, F_GETFL );
+			fcntl( iSocket, F_SETFL, iFlags | O_NONBLOCK );
+			
+			int iResult = ::connect( iSocket, (struct sockaddr*) &oSockAddr, sizeof(oSockAddr) );
+			if ( iResult < 0 && EINPROGRESS == errno )
+			{
+				struct pollfd aoPoll[2];
+				aoPoll[0].fd = iSocket;
+				aoPoll[0].events = POLLOUT;
+				aoPoll[1].fd = m_aiWakeupPipe[0];
+				aoPoll[1].events = POLLIN;
+				
+				Uint32 iDeadline = SDL_GetTicks() + CONNECTTIMEOUT;
+				iResult = -1;
+				while (1)
+				{
+					int iTimeout = (int) ( iDeadline - SDL_GetTicks() );
+					if ( iTimeout <= 0 )
+					{
+						break;		// Timed out
+					}
+					
+					aoPoll[0].revents = aoPoll[1].revents = 0;
+					if ( poll( aoPoll, 2, iTimeout ) < 0 && EINTR != errno )
+					{
+						break;
+					}
+					
+					if ( aoPoll[1].revents )
+					{
+						// Lines queued by sendRawData() wake us up too;
+						// only disconnect() cancels the connect.
+						drainWakeupPipe();
+						if ( m_enConnectionState != CS_Connecting || m_bShutdown )
+						{
+							close( iSocket );
+							return;
+						}
+					}
+					
+					if ( aoPoll[0].revents )
+					{
+						int iError = 0;
+						socklen_t iLength = sizeof(iError);
+						getsockopt( iSocket, SOL_SOCKET, SO_ERROR, &iError, &iLength );
+						iResult = iError ? -1 : 0;
+						break;
+					}
+				}
+			}
+			
+			if ( 0 == iResult )
+			{
+				fcntl( iSocket, F_SETFL, iFlags );
+				break;
+			}
+			close( iSocket );
+		}
+		
+		// Retry in a second, unless we are woken up by disconnect().
+		waitForWakeup( 1000 );
 	}
 	
 	// CONNECTION ESTABLISHED. SEND INTRO PACKETS
 	
-	notifyConnectionState( Translate("Connection established.") );
+	notifyConnectionState( "Connection established." );
 	
 	// Guarded section follows
 	{
@@ -121,14 +269,11 @@ void COnlineChatBEImpl::internalConnect()
 		
 		if ( m_enConnectionState != CS_Connecting )
 		{	// Operation was canceled
-			SDLNet_TCP_Close( m_poSocket );
-			m_poSocket = NULL;
+			close( iSocket );
 			return;
 		}
 		
-		m_poSocketSet = SDLNet_AllocSocketSet( 1 );
-		SDLNet_TCP_AddSocket( m_poSocketSet, m_poSocket );	// Check for errors?
-		
+		m_iSocket = iSocket;
 		m_iIncomingBufferSize = 0;
 		m_apoUsers.resize(1);
 		m_enConnectionState = CS_Connected;
@@ -146,26 +291,24 @@ void COnlineChatBEImpl::internalDisconnect()
 	Guard oGuard( m_poLock );
 	m_enConnectionState = CS_Disconnecting;
 	
-	if ( m_poSocketSet )
+	if ( m_iSocket >= 0 )
 	{
-		SDLNet_FreeSocketSet( m_poSocketSet );
-		m_poSocketSet = NULL;
-	}
-	if ( m_poSocket )
-	{
-		SDLNet_TCP_Close( m_poSocket );
-		m_poSocket = NULL;
+		close( m_iSocket );
+		m_iSocket = -1;
 	}
 	
 	m_apoUsers.resize(1);
+	m_asOutgoing.clear();
 	
 	m_enConnectionState = CS_Disconnected;
 	
-	notifyConnectionState( Translate( "Disconnected from MortalNet." ) );
+	notifyConnectionState( "Disconnected from MortalNet." );
 }
 
 
-/** Reads one message from the server and processes it. */
+/** Waits for data from the server or a wakeup, and processes whichever
+arrived. The wait has no timeout; disconnect() and the destructor wake
+the thread up through the pipe. */
 void COnlineChatBEImpl::internalProcessMessage()
 {
 	if ( m_enConnectionState != CS_Connected )
@@ -173,16 +316,44 @@ void COnlineChatBEImpl::internalProcessMessage()
 		return;
 	}
 	
-	// 1. CHECK FOR STUFF TO READ
+	// 1. WAIT FOR THE SOCKET OR THE WAKEUP PIPE
+	
+	struct pollfd aoPoll[2];
+	aoPoll[0].fd = m_iSocket;
+	aoPoll[0].events = POLLIN;
+	aoPoll[0].revents = 0;
+	aoPoll[1].fd = m_aiWakeupPipe[0];
+	aoPoll[1].events = POLLIN;
+	aoPoll[1].revents = 0;
 	
-	int iRetval = SDLNet_CheckSockets( m_poSocketSet, 0 );
-	if ( iRetval <= 0 )
+	int iRetval = poll( aoPoll, 2, -1 );
+	if ( iRetval < 0 )
 	{
-		SDL_Delay( 100 );
+		if ( EINTR != errno )
+		{
+			notifyConnectionState( "Connection error:", strerror(errno) );
+			internalDisconnect();
+		}
 		return;
 	}
 	
-	// 2. APPEND AT MOST 1024 bytes TO THE END OF THE INCOMING BUFFER
+	CTraceScope oTrace( "ChatProcess" );
+	if ( aoPoll[1].revents )
+	{
+		drainWakeupPipe();
+	}
+	
+	// 2. SEND WHATEVER WAS QUEUED
+	
+	internalSendQueued();
+	
+	if ( 0 == aoPoll[0].revents
+		|| m_enConnectionState != CS_Connected )
+	{
+		return;
+	}
+	
+	// 3. APPEND AT MOST 1024 bytes TO THE END OF THE INCOMING BUFFER
 
 	// CHECK FOR BUFFER OVERFLOW HERE.
 	if ( m_iIncomingBufferSize >= 1024*3 )
@@ -193,10 +364,17 @@ void COnlineChatBEImpl::internalProcessMessage()
 	}
 	else
 	{
-		iRetval = SDLNet_TCP_Recv( m_poSocket, m_acIncomingBuffer + m_iIncomingBufferSize, 1024 );
+		iRetval = recv( m_iSocket, m_acIncomingBuffer + m_iIncomingBufferSize, 1024, 0 );
 		if ( iRetval <= 0 )
 		{
-			notifyConnectionState( std::string(Translate("Connection error: ")) + SDLNet_GetError() );
+			if ( iRetval )
+			{
+				notifyConnectionState( "Connection error:", strerror(errno) );
+			}
+			else
+			{
+				notifyConnectionState( "The server closed the connection." );
+			}
 			internalDisconnect();
 			return;
 		}
@@ -207,24 +385,68 @@ void COnlineChatBEImpl::internalProcessMessage()
 }
 
 
+/** Sends every queued outgoing message. The queue is swapped out under
+the lock, so the senders are never blocked by the network. */
+void COnlineChatBEImpl::internalSendQueued()
+{
+	MessageList asMessages;
+	{
+		Guard oGuard( m_poLock );
+		asMessages.swap( m_asOutgoing );
+	}
+	
+	for ( MessageList::const_iterator it = asMessages.begin(); it != asMessages.end(); ++it )
+	{
+		const char* pcData = it->c_str();
+		int iRemaining = it->size();
+		while ( iRemaining > 0 )
+		{
+			int iSent = send( m_iSocket, pcData, iRemaining, 0 );
+			if ( iSent <= 0 )
+			{
+				if ( iSent < 0 && EINTR == errno ) continue;
+				notifyConnectionState( "Connection error:", strerror(errno) );
+				internalDisconnect();
+				return;
+			}
+			pcData += iSent;
+			iRemaining -= iSent;
+		}
+	}
+}
+
+
+int COnlineChatBEImpl::threadStarter( void* a_pvBackend )
+{
+	((COnlineChatBEImpl*)a_pvBackend)->threadFunction();
+	return 0;
+}
+
 
 void COnlineChatBEImpl::threadFunction()
 {
-	while (1)
+	g_oTracer.SetThreadName( "chat" );
+	while ( !m_bShutdown )
 	{
 		// Wait until connection is initiated by connect()
-		while ( m_enConnectionState == CS_Disconnected ) {
-			SDL_Delay( 100 );
+		if ( m_enConnectionState == CS_Disconnected )
+		{
+			waitForWakeup( -1 );
+			continue;
 		}
 		
 		// Start to connect
-		internalConnect();
+		if ( m_enConnectionState == CS_Connecting )
+		{
+			internalConnect();
+		}
 		
-		while ( m_enConnectionState == CS_Connected ) {
+		while ( m_enConnectionState == CS_Connected && !m_bShutdown ) {
 			internalProcessMessage();
 		}
 		
-		if ( m_enConnectionState == CS_Disconnecting )
+		if ( m_enConnectionState == CS_Disconnecting
+			|| ( m_bShutdown && m_enConnectionState != CS_Disconnected ) )
 		{
 			internalDisconnect();
 		}
@@ -232,28 +454,44 @@ void COnlineChatBEImpl::threadFunction()
 }
 
 
+/** Wakes up the communication thread. Can be called from any thread. */
+void COnlineChatBEImpl::wakeup()
+{
+	char cByte = 0;
+	// If the pipe is full, the thread has a wakeup pending anyway.
+	if ( write( m_aiWakeupPipe[1], &cByte, 1 ) < 0 && EAGAIN != errno )
+	{
+		debug( "COnlineChatBEImpl::wakeup: %s\n", strerror(errno) );
+	}
+}
+
+
 void COnlineChatBEImpl::sendNick()
 {
 	sendRawData( 'N', m_sMyNick.c_str() );
 }
 
 
+/** Queues a line for sending. The communication thread is woken up and
+sends it right away. */
 void COnlineChatBEImpl::sendRawData( char a_cPrefix, const char* a_pcMessage )
 {
-	if ( m_enConnectionState == CS_Disconnected
-		|| m_poSocket == NULL )
+	if ( m_enConnectionState == CS_Disconnected )
 	{
 		debug( "COnlineChatBEImpl::sendRawMessage: Cannot send %c %s: disconnected\n",
 			a_cPrefix, a_pcMessage );
 		return;
 	}
 	
-	// TODO This could be more efficient, send with one SDLNet_TCP_Send
-	SDLNet_TCP_Send( m_poSocket, &a_cPrefix, 1 );
-	SDLNet_TCP_Send( m_poSocket, (void*) a_pcMessage, strlen(a_pcMessage) );
-
-	char cNL = '\n';
-	SDLNet_TCP_Send( m_poSocket, &cNL, 1 );
+	std::string sLine( 1, a_cPrefix );
+	sLine += a_pcMessage;
+	sLine += '\n';
+	
+	{
+		Guard oGuard( m_poLock );
+		m_asOutgoing.push_back( sLine );
+	}
+	wakeup();
 }
 
 
@@ -267,14 +505,17 @@ void COnlineChatBEImpl::connect( std::string a_sNick )
 {
 	if ( m_enConnectionState != CS_Disconnected )
 	{
-		notifyConnectionState( m_enConnectionState, m_enConnectionState, "Cannot connect: already connected." );
+		notifyConnectionState( m_enConnectionState, m_enConnectionState, "Cannot connect: already connected.", "" );
 		return;
 	}
 	
-	Guard oGuard(m_poLock);
-	
-	m_sMyNick = a_sNick;
-	m_enConnectionState = CS_Connecting;
+	{
+		Guard oGuard(m_poLock);
+		
+		m_sMyNick = a_sNick;
+		m_enConnectionState = CS_Connecting;
+	}
+	wakeup();
 }
 
 
@@ -282,13 +523,16 @@ void COnlineChatBEImpl::disconnect()
 {
 	if ( m_enConnectionState == CS_Disconnected )
 	{
-		notifyConnectionState( m_enConnectionState, m_enConnectionState, "Cannot disconnect: already disconnected." );
+		notifyConnectionState( m_enConnectionState, m_enConnectionState, "Cannot disconnect: already disconnected.", "" );
 		return;
 	}
 	
-	Guard oGuard(m_poLock);
-	
-	m_enConnectionState = CS_Disconnecting;
+	{
+		Guard oGuard(m_poLock);
+		
+		m_enConnectionState = CS_Disconnecting;
+	}
+	wakeup();
 }
 
 
@@ -434,22 +678,27 @@ void COnlineChatBEImpl::notifyEvent( const IOnlineChatBE::SChatEvent& a_roEvent
 }
 
 
+/** Notifies the event sinks. The message is not translated here: this
+is called from the communication thread, and Translate() uses the perl
+interpreter of the main thread. The sinks translate it, see
+IOnlineEventSink. */
 void COnlineChatBEImpl::notifyConnectionState( IOnlineChatBE::ConnectionStateEnum a_enOldState, 
-	IOnlineChatBE::ConnectionStateEnum a_enNewState, const std::string& a_rsMessage )
+	IOnlineChatBE::ConnectionStateEnum a_enNewState, const std::string& a_rsMessage,
+	const std::string& a_rsDetail )
 {
 	EventSinkList::const_iterator it;
 	for ( it = m_apoSinks.begin(); it != m_apoSinks.end(); ++it )
 	{
-		(*it)->connectionStateChange( a_enOldState, a_enNewState, a_rsMessage );
+		(*it)->connectionStateChange( a_enOldState, a_enNewState, a_rsMessage, a_rsDetail );
 	}
 	
 	m_enNotifiedState = a_enNewState;
 }
 
 
-void COnlineChatBEImpl::notifyConnectionState( const std::string& a_rsMessage )
+void COnlineChatBEImpl::notifyConnectionState( const std::string& a_rsMessage, const std::string& a_rsDetail )
 {
-	notifyConnectionState( m_enNotifiedState, m_enConnectionState, a_rsMessage );
+	notifyConnectionState( m_enNotifiedState, m_enConnectionState, a_rsMessage, a_rsDetail );
 }
 
 
@@ -479,3 +728,5 @@ IOnlineChatBE::UserInfo& IOnlineChatBE::UserInfo::operator=( const UserInfo& a_r
 	return *this;
 }
 
+
+#endif // _WIN32
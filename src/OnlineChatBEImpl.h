@@ -20,6 +20,12 @@
 
 /**
 Implementation of the COnlineChatBE interface
+
+The communication runs in a thread of its own, which sleeps in poll() on
+the server socket and on a wakeup pipe. Outgoing messages are queued and
+signalled through the pipe, as are connect, disconnect and shutdown
+requests, so traffic in either direction is handled as soon as it arrives,
+and the thread uses no CPU while idle.
 \ingroup Network
 \author upi
 */
@@ -63,13 +69,18 @@ protected:
 	void						notifyEvent( const IOnlineChatBE::SChatEvent& a_roEvent );
 	void						notifyConnectionState( IOnlineChatBE::ConnectionStateEnum a_enOldState, 
 													   IOnlineChatBE::ConnectionStateEnum a_enNewState,
-													   const std::string& a_rsMessage );
-	void						notifyConnectionState( const std::string& a_rsMessage );
+													   const std::string& a_rsMessage, const std::string& a_rsDetail );
+	void						notifyConnectionState( const std::string& a_rsMessage, const std::string& a_rsDetail = "" );
 													   
+	static int					threadStarter( void* a_pvBackend );
 	void						threadFunction();
 	void						internalConnect();
 	void						internalDisconnect();
 	void						internalProcessMessage();
+	void						internalSendQueued();
+	bool						waitForWakeup( int a_iTimeoutMs );
+	void						drainWakeupPipe();
+	void						wakeup();
 	void						sendNick();
 	void						sendRawData( char a_cPrefix, const char* a_pcMessage );
 
@@ -77,6 +88,7 @@ protected:
 	// typedef
 	typedef std::list<IOnlineEventSink*> EventSinkList;
 	typedef std::list<UserInfo*> UserInfoList;
+	typedef std::list<std::string> MessageList;
 	
 	// Internal state
 	ConnectionStateEnum			m_enConnectionState;		// The current state of the connection to the server
@@ -87,10 +99,15 @@ protected:
 	UserInfoList				m_apoUsers;					// User list from the server
 	
 	// Connection to the server
-	TCPsocket					m_poSocket;					// The TCP/IP network socket.
-	SDLNet_SocketSet			m_poSocketSet;				// SDLNet construct for watching the socket.
+	int							m_iSocket;					///< The TCP/IP network socket, or -1.
 	char						m_acIncomingBuffer[4096];	///< Received data goes here.
 	int							m_iIncomingBufferSize;		///< How much of the buffer is filled?
+	MessageList					m_asOutgoing;				///< Complete lines waiting to be sent by the thread.
+	
+	// Thread control
+	SDL_Thread*					m_poThread;					///< The communication thread.
+	int							m_aiWakeupPipe[2];			///< Writing a byte to [1] wakes up the thread's poll().
+	volatile bool				m_bShutdown;				///< Set by the destructor to stop the thread.
 	
 	SDL_mutex*					m_poLock;
 };
@@ -21,6 +21,8 @@
 #include "Audio.h"
 #include "sge_bm_text.h"
 #include "gfx.h"
+#include "AssetCache.h"
+#include "FighterCache.h"
 #include "RlePack.h"
 #include "Backend.h"
 #include "State.h"
@@ -57,6 +59,7 @@ PlayerSelect::PlayerSelect()
 		m_aoPlayers[i].m_enFighter = UNKNOWN;
 		m_aoPlayers[i].m_enTint = NO_TINT;
 		m_aoPlayers[i].m_poPack = NULL;
+		m_abLoading[i] = false;
 	}
 }
 
@@ -153,49 +156,25 @@ bool PlayerSelect::IsFighterInTeam( FighterEnum a_enFighter )
 
 
 
-/** LoadFighter simply looks up the filename associated with the given
-fighter, loads it, and returns the RlePack.
+/** SetPlayer sets the given fighter for the given player.
 
-\return The freshly loaded RlePack, or NULL if it could not be loaded.
-*/
+The RlePack comes from the CFighterCache. If a_bWait is false and the
+fighter is not loaded yet, the player has no RlePack until Update() picks
+it up; the name of the fighter and the perl backend are set right away.
+The tint and palette of both players are set. */
 
-RlePack* PlayerSelect::LoadFighter( FighterEnum m_enFighter )		// static
+void PlayerSelect::SetPlayer( int a_iPlayer, FighterEnum a_enFighter, bool a_bWait )
 {
-	char a_pcFilename[FILENAME_MAX+1];
-	const char* s;
-
-	g_oBackend.PerlEvalF( "GetFighterStats(%d);", m_enFighter );
-	s = g_oBackend.GetPerlString( "Datafile" );
-
-	strcpy( a_pcFilename, DATADIR );
-	strcat( a_pcFilename, "/characters/" );
-	strcat( a_pcFilename, s );
-
-	RlePack* pack = new RlePack( a_pcFilename, COLORSPERPLAYER );
-	if ( pack->Count() <= 0 )
+	PlayerInfo& roPlayer = m_aoPlayers[a_iPlayer];
+	if ( roPlayer.m_enFighter == a_enFighter )
 	{
-		debug( "Couldn't load RlePack: '%s'\n", a_pcFilename );
-		delete pack;
-		return NULL;
-	}
-
-	return pack;
-}
-
-
-
-/** SetPlayer loads the given fighter for the given player.
-
-The RlePack is loaded first. If that succeeds, then the perl backend is
-set too. The tint and palette of both players are set. */
-
-void PlayerSelect::SetPlayer( int a_iPlayer, FighterEnum a_enFighter )
-{
-	if ( m_aoPlayers[a_iPlayer].m_enFighter == a_enFighter )
-	{
-		if ( m_aoPlayers[a_iPlayer].m_poPack )
+		if ( a_bWait && m_abLoading[a_iPlayer] )
+		{
+			FinishLoading();
+		}
+		if ( roPlayer.m_poPack )
 		{
-			m_aoPlayers[a_iPlayer].m_poPack->ApplyPalette();
+			roPlayer.m_poPack->ApplyPalette();
 		}
 		return;
 	}
@@ -204,22 +183,25 @@ void PlayerSelect::SetPlayer( int a_iPlayer, FighterEnum a_enFighter )
 		return;
 	}
 
-	int iOffset = COLOROFFSETPLAYER1 + a_iPlayer*64;
-	RlePack* poPack = LoadFighter( a_enFighter );
-	poPack->OffsetSprites( iOffset );
-
-	if ( NULL == poPack )
+	RlePack* poPack = g_oFighterCache.Acquire( a_enFighter, a_bWait );
+	if ( NULL == poPack && !g_oFighterCache.IsLoading( a_enFighter ) )
 	{
 		debug( "SetPlayer(%d,%d): Couldn't load RlePack\n", a_iPlayer, a_enFighter );
 		return;
 	}
 
-	delete m_aoPlayers[a_iPlayer].m_poPack;
-	m_aoPlayers[a_iPlayer].m_poPack = poPack;
-	m_aoPlayers[a_iPlayer].m_enFighter = a_enFighter;
+	g_oFighterCache.Release( roPlayer.m_enFighter, roPlayer.m_poPack );
+	roPlayer.m_poPack = NULL;
+	roPlayer.m_enFighter = a_enFighter;
+	roPlayer.m_enTint = NO_TINT;
+	m_abLoading[a_iPlayer] = NULL == poPack;
+	if ( poPack )
+	{
+		AttachPack( a_iPlayer, poPack );
+	}
 
 	g_oBackend.PerlEvalF( "SetPlayerNumber(%d,%d);", a_iPlayer, a_enFighter );
-	m_aoPlayers[a_iPlayer].m_sFighterName = g_oBackend.GetPerlString( "PlayerName" );
+	roPlayer.m_sFighterName = g_oBackend.GetPerlString( "PlayerName" );
 	m_aiFighterNameWidth[a_iPlayer] = sge_BF_TextSize( fastFont, GetFighterName(a_iPlayer) ).w;
 
 	TintEnum enTint = NO_TINT;
@@ -230,7 +212,101 @@ void PlayerSelect::SetPlayer( int a_iPlayer, FighterEnum a_enFighter )
 		enTint = TintEnum( (rand() % 4) + 1 );
 	}
 	SetTint( 1, enTint );
-	m_aoPlayers[a_iPlayer].m_poPack->ApplyPalette();
+	if ( roPlayer.m_poPack )
+	{
+		roPlayer.m_poPack->ApplyPalette();
+	}
+}
+
+
+/** Gives the players the RlePacks that were loaded since the last call.
+Call this regularly while SetPlayer() is used without waiting.
+
+A player stays loading until it has its pack. If both players picked the
+same fighter, the first one takes the loaded pack and the cache starts
+loading another copy for the second one. */
+
+void PlayerSelect::Update()
+{
+	for ( int i=0; i<MAXPLAYERS; ++i )
+	{
+		if ( !m_abLoading[i] || g_oFighterCache.IsLoading( m_aoPlayers[i].m_enFighter ) )
+		{
+			continue;
+		}
+		RlePack* poPack = g_oFighterCache.Acquire( m_aoPlayers[i].m_enFighter, false );
+		if ( poPack )
+		{
+			m_abLoading[i] = false;
+			AttachPack( i, poPack );
+		}
+		else if ( !g_oFighterCache.IsLoading( m_aoPlayers[i].m_enFighter ) )
+		{
+			SetLoadableFighter( i );
+		}
+	}
+}
+
+
+/** Waits until every player has its RlePack. Must be called before the
+RlePacks are used outside the fighter selection; afterwards every player
+that has a fighter has a pack. */
+
+void PlayerSelect::FinishLoading()
+{
+	for ( int i=0; i<MAXPLAYERS; ++i )
+	{
+		if ( !m_abLoading[i] )
+		{
+			continue;
+		}
+		RlePack* poPack = g_oFighterCache.Acquire( m_aoPlayers[i].m_enFighter, true );
+		if ( poPack )
+		{
+			m_abLoading[i] = false;
+			AttachPack( i, poPack );
+		}
+		else
+		{
+			SetLoadableFighter( i );
+		}
+	}
+}
+
+
+/** The player's fighter couldn't be loaded; this gives the player the
+first available fighter that loads instead, so the game always has a
+RlePack to draw. */
+
+void PlayerSelect::SetLoadableFighter( int a_iPlayer )
+{
+	FighterEnum enBroken = m_aoPlayers[a_iPlayer].m_enFighter;
+	debug( "SetLoadableFighter(%d): Couldn't load RlePack of fighter %d\n", a_iPlayer, enBroken );
+	m_abLoading[a_iPlayer] = false;
+
+	for ( int i=UNKNOWN+1; i<LASTFIGHTER && NULL == m_aoPlayers[a_iPlayer].m_poPack; ++i )
+	{
+		if ( i != enBroken )
+		{
+			SetPlayer( a_iPlayer, FighterEnum(i), true );
+		}
+	}
+}
+
+
+/** Returns true if the player's fighter is still being loaded. */
+bool PlayerSelect::IsLoading( int a_iPlayer )
+{
+	return m_abLoading[a_iPlayer];
+}
+
+
+/** Sets up a freshly acquired RlePack with the player's colors. */
+void PlayerSelect::AttachPack( int a_iPlayer, RlePack* a_poPack )
+{
+	m_aoPlayers[a_iPlayer].m_poPack = a_poPack;
+	a_poPack->OffsetSprites( COLOROFFSETPLAYER1 + a_iPlayer*64 );
+	SetTint( a_iPlayer, m_aoPlayers[a_iPlayer].m_enTint );
 }
 
 
@@ -479,7 +555,7 @@ void PlayerSelect::DoPlayerSelect()
 	SDL_FillRect( gamescreen, NULL, C_BLACK );
 	SDL_Flip( gamescreen );
 
-	SDL_Surface* poBackground = LoadBackground( bNetworkMode ? "PlayerSelect_chat.png" : "PlayerSelect.png", 111 );
+	SDL_Surface* poBackground = g_oAssetCache.CopyBackground( bNetworkMode ? "PlayerSelect_chat.png" : "PlayerSelect.png", 111 );
 
 	if ( !bNetworkMode )
 	{
@@ -79,7 +79,10 @@ public:
 	int GetFighterNameWidth( int a_iPlayer );
 	
 	void DoPlayerSelect();
-	void SetPlayer( int a_iPlayer, FighterEnum a_enFighter );
+	void SetPlayer( int a_iPlayer, FighterEnum a_enFighter, bool a_bWait = true );
+	void Update();
+	void FinishLoading();
+	bool IsLoading( int a_iPlayer );
 	void SetTint( int a_iPlayer, TintEnum a_enFighter );
 	bool IsFighterAvailable( FighterEnum a_enFighter );
 	bool IsLocalFighterAvailable( FighterEnum a_enFighter );
@@ -92,13 +95,15 @@ protected:
 //	void HandleNetwork();
 //	void DrawRect( int a_iPos, int a_iColor );
 //	void CheckPlayer( SDL_Surface* a_poBackground, int a_iRow, int a_iCol, int a_iColor );
-	static RlePack* LoadFighter( FighterEnum m_enFighter );
+	void AttachPack( int a_iPlayer, RlePack* a_poPack );
+	void SetLoadableFighter( int a_iPlayer );
 //	bool IsNetworkGame();
 //	FighterEnum GetFighterCell( int a_iIndex );
 
 protected:
 	PlayerInfo	m_aoPlayers[MAXPLAYERS];
 	int			m_aiFighterNameWidth[MAXPLAYERS];
+	bool		m_abLoading[MAXPLAYERS];		///< The player's RlePack is in the CFighterCache, still loading.
 };
 
 
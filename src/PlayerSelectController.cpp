@@ -1,6 +1,7 @@
 #include "PlayerSelectController.h"
 #include "PlayerSelectView.h"
 #include "PlayerSelect.h"
+#include "FighterCache.h"
 #include "Chooser.h"
 #include "MortalNetwork.h"
 #include "State.h"
@@ -34,26 +35,6 @@ CPlayerSelectController::~CPlayerSelectController()
 
 
 
-void CPlayerSelectController::GetThisTick()
-{
-	m_iLastTick = m_iThisTick;
-
-	while (1)
-	{
-		m_iThisTick = SDL_GetTicks() / m_iGameSpeed;
-		if ( m_iThisTick==m_iLastTick )
-		{
-			SDL_Delay(1);
-		}
-		else
-		{
-			break;
-		}
-	}
-}
-
-
-
 bool CPlayerSelectController::HandleChatKey( SDL_Event& a_roEvent )
 {
 	if ( !m_bNetworkGame )
@@ -221,8 +202,9 @@ void CPlayerSelectController::HandleKey( int a_iPlayer, int a_iKey )
 					g_poNetwork->SendFighter( enNewFighter );
 				}
 
-				g_oPlayerSelect.SetPlayer( iSetPlayer, enNewFighter );
+				g_oPlayerSelect.SetPlayer( iSetPlayer, enNewFighter, false );
 			}
+			PrefetchNeighbors( enNewFighter );
 		}
 		return;
 	}
@@ -315,7 +297,7 @@ void CPlayerSelectController::HandleNetwork()
 		&& enRemoteFighter != UNKNOWN )
 	{
 		Audio->PlaySample("PLAYER_SELECTION_CHANGES");
-		g_oPlayerSelect.SetPlayer( iPlayer, enRemoteFighter );
+		g_oPlayerSelect.SetPlayer( iPlayer, enRemoteFighter, false );
 		g_oChooser.SetRectangle( iPlayer, enRemoteFighter );
 	}
 
@@ -431,6 +413,24 @@ bool CPlayerSelectController::IsFighterSelectable( FighterEnum a_enFighter )
 }
 
 
+/** Starts loading the fighters around a_enFighter in the background, so
+they are ready by the time the cursor gets there. */
+
+void CPlayerSelectController::PrefetchNeighbors( FighterEnum a_enFighter )
+{
+	static const int aiDirections[4] = { Mk_UP, Mk_DOWN, Mk_LEFT, Mk_RIGHT };
+
+	for ( int i=0; i<4; ++i )
+	{
+		FighterEnum enNeighbor = g_oChooser.GetNeighbor( a_enFighter, aiDirections[i] );
+		if ( IsFighterSelectable( enNeighbor ) )
+		{
+			g_oFighterCache.Prefetch( enNeighbor );
+		}
+	}
+}
+
+
 
 void CPlayerSelectController::DoPlayerSelect()
 {
@@ -451,6 +451,10 @@ void CPlayerSelectController::DoPlayerSelect()
 	}
 	m_iNumberOfSelectableFighters = g_oBackend.GetNumberOfAvailableFighters();
 	MarkFighters();
+	for ( i=0; i<g_oState.m_iNumPlayers; ++i )
+	{
+		PrefetchNeighbors( g_oChooser.GetCurrentFighter(i) );
+	}
 
 	if ( m_bTeamMode )
 	{
@@ -469,17 +473,14 @@ void CPlayerSelectController::DoPlayerSelect()
 
 	m_bChatActive = false;
 
-	m_iGameSpeed = 12 ;
-	m_iThisTick = SDL_GetTicks() / m_iGameSpeed;
-	m_iLastTick = m_iThisTick - 1;
+	m_oFramePacer.Start( 12 );
 
 	// 2. RUN THE PLAYER SELECTION LOOP
 
 	while (1)
 	{
-		// 2.1. Wait for the next tick (on extremely fast machines..)
-		GetThisTick();
-		int iAdvance = m_iThisTick - m_iLastTick;
+		// 2.1. Wait for the next tick
+		int iAdvance = m_oFramePacer.WaitForNextTick();
 		if ( iAdvance > 5 )
 			iAdvance = 5;
 
@@ -491,6 +492,7 @@ void CPlayerSelectController::DoPlayerSelect()
 		}
 
 		// 2.3. Update the view
+		g_oPlayerSelect.Update();
 		m_poView->Advance( iAdvance );
 		m_poView->Draw();
 
@@ -502,4 +504,6 @@ void CPlayerSelectController::DoPlayerSelect()
 		if ( !m_abPlayerActive[0] && !m_abPlayerActive[1] && m_poView->IsOver() )
 			break;
 	}
+
+	g_oPlayerSelect.FinishLoading();
 }
@@ -4,6 +4,7 @@
 #include "SDL.h"
 #include "FighterEnum.h"
 #include "common.h"
+#include "FramePacer.h"
 
 class CPlayerSelectView;
 
@@ -25,7 +26,6 @@ protected:
 	void				HandleKey( int a_iPlayer, int a_iKey );
 	bool				HandleChatKey( SDL_Event& a_roEvent );
 	void				HandleNetwork();
-	void				GetThisTick();
 	void				MarkFighters();
 
 	void				SetPlayerActive( int a_iPlayer, bool a_bActive );
@@ -33,6 +33,7 @@ protected:
 	int					GetTeamSize( int a_iPlayer );
 
 	bool				IsFighterSelectable( FighterEnum a_enFighter );
+	void				PrefetchNeighbors( FighterEnum a_enFighter );
 
 
 protected:
@@ -45,9 +46,7 @@ protected:
 
 	bool				m_abPlayerActive[MAXPLAYERS];
 
-	int					m_iGameSpeed;
-	int					m_iThisTick;
-	int					m_iLastTick;
+	CFramePacer			m_oFramePacer;
 };
 
 
@@ -8,6 +8,7 @@
 
 #include "Chooser.h"
 #include "TextArea.h"
+#include "AssetCache.h"
 #include "Backend.h"
 #include "State.h"
 #include "gfx.h"
@@ -382,7 +383,7 @@ CPlayerSelectView::CPlayerSelectView( bool a_bNetworkGame, bool a_bTeamMode )
 
 	SDL_FillRect( gamescreen, NULL, C_BLACK );
 	SDL_Flip( gamescreen );
-	m_poBackground = LoadBackground( "FighterStats.jpg", 64 ); //m_bNetworkGame ? "PlayerSelect_chat.png" : "PlayerSelect.png", 111 );
+	m_poBackground = g_oAssetCache.CopyBackground( "FighterStats.jpg", 64 ); //m_bNetworkGame ? "PlayerSelect_chat.png" : "PlayerSelect.png", 111 );
 	if ( m_poBackground ) SDL_SetColorKey( m_poBackground, 0, 0 );
 
 	new CCourtainViewElement(this);
@@ -533,7 +534,11 @@ void CPlayerSelectView::Draw()
 		const PlayerInfo& roPlayerInfo = g_oPlayerSelect.GetPlayerInfo( i );
 		int iPlayerNameWidth = g_oPlayerSelect.GetFighterNameWidth( i );
 
-		if ( g_oBackend.m_aoPlayers[i].m_iFrame )
+		if ( NULL == roPlayerInfo.m_poPack )
+		{
+			DrawPlaceholder( i );
+		}
+		else if ( g_oBackend.m_aoPlayers[i].m_iFrame )
 		{
 			roPlayerInfo.m_poPack->Draw(
 				ABS(g_oBackend.m_aoPlayers[i].m_iFrame)-1,
@@ -552,6 +557,27 @@ void CPlayerSelectView::Draw()
 }
 
 
+/** Draws the portrait of the player's fighter above its name, while the
+fighter is being loaded. */
+
+void CPlayerSelectView::DrawPlaceholder( int a_iPlayer )
+{
+	SDL_Rect oSrc;
+	SDL_Surface* poPortrait = g_oChooser.GetPortrait( g_oPlayerSelect.GetPlayerInfo( a_iPlayer ).m_enFighter, oSrc );
+	if ( NULL == poPortrait )
+	{
+		return;
+	}
+
+	SDL_Rect oDst;
+	oDst.x = ( m_iChooserLeft - oSrc.w ) / 2;
+	if ( oDst.x < 10 ) oDst.x = 10;
+	if ( a_iPlayer ) oDst.x = gamescreen->w - oDst.x - oSrc.w;
+	oDst.y = gamescreen->h - 50 + m_iFighterNameYOffset - oSrc.h;
+	SDL_BlitSurface( poPortrait, &oSrc, gamescreen, &oDst );
+}
+
+
 CReadline* CPlayerSelectView::GetReadline()
 {
 	return m_poReadline;
@@ -57,6 +57,9 @@ public:
 
 	CTeamDisplay*	GetTeamDisplay( int a_iPlayer );
 
+protected:
+	void			DrawPlaceholder( int a_iPlayer );
+
 protected:
 	bool			m_bTeamMode;
 	bool			m_bTeamMultiselect;
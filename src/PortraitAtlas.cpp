@@ -0,0 +1,204 @@
+/***************************************************************************
+                          PortraitAtlas.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "PortraitAtlas.h"
+#include "DataArchive.h"
+#include "gfx.h"
+#include "common.h"
+
+#include "SDL.h"
+#include "SDL_endian.h"
+
+#include <string.h>
+
+
+static inline Uint32 ReadUint32( const unsigned char* a_pcData )
+{
+	return a_pcData[0] | ( a_pcData[1] << 8 ) | ( a_pcData[2] << 16 ) | ( (Uint32) a_pcData[3] << 24 );
+}
+
+
+CPortraitAtlas::CPortraitAtlas()
+{
+}
+
+
+CPortraitAtlas::~CPortraitAtlas()
+{
+	Clear();
+}
+
+
+/** Loads the atlas, and converts its sheets for fast blitting.
+\retval false if the atlas is missing or broken. The portraits must be
+loaded one by one then. */
+
+bool CPortraitAtlas::Load( const char* a_pcFilename )
+{
+	Clear();
+
+	CDataFile oFile;
+	if ( !oFile.Open( a_pcFilename ) )
+	{
+		return false;
+	}
+
+	const unsigned char* pcData = (const unsigned char*) oFile.GetData();
+	unsigned int iSize = oFile.GetSize();
+	if ( iSize < PORTRAITATLAS_HEADERSIZE
+		|| 0 != memcmp( pcData, "OMPA", 4 )
+		|| PORTRAITATLAS_VERSION != ReadUint32( pcData + 4 ) )
+	{
+		debug( "%s is not a portrait atlas.\n", a_pcFilename );
+		return false;
+	}
+
+	unsigned int iNumSheets = ReadUint32( pcData + 8 );
+	unsigned int iNumPortraits = ReadUint32( pcData + 12 );
+	unsigned int iPortraitsOffset = PORTRAITATLAS_HEADERSIZE + iNumSheets * PORTRAITATLAS_SHEETSIZE;
+	if ( iNumSheets > 100 || iNumPortraits > 1000
+		|| iPortraitsOffset + iNumPortraits * PORTRAITATLAS_ENTRYSIZE > iSize )
+	{
+		debug( "%s is broken.\n", a_pcFilename );
+		return false;
+	}
+
+	// 1. CONVERT THE SHEETS
+
+	unsigned int i;
+	for ( i=0; i<iNumSheets; ++i )
+	{
+		const unsigned char* pcSheet = pcData + PORTRAITATLAS_HEADERSIZE + i * PORTRAITATLAS_SHEETSIZE;
+		unsigned int iWidth = ReadUint32( pcSheet );
+		unsigned int iHeight = ReadUint32( pcSheet + 4 );
+		unsigned int iOffset = ReadUint32( pcSheet + 8 );
+		if ( iWidth > PORTRAITATLAS_MAXSHEETSIZE || iHeight > PORTRAITATLAS_MAXSHEETSIZE
+			|| iOffset > iSize || iWidth * iHeight * 4 > iSize - iOffset )
+		{
+			debug( "%s is broken.\n", a_pcFilename );
+			Clear();
+			return false;
+		}
+
+		// The pixels are R, G, B, A bytes. The surface only reads them.
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+		SDL_Surface* poSheet = SDL_CreateRGBSurfaceFrom( (void*) ( pcData + iOffset ), iWidth, iHeight,
+			32, iWidth * 4, 0xff000000, 0x00ff0000, 0x0000ff00, 0x000000ff );
+#else
+		SDL_Surface* poSheet = SDL_CreateRGBSurfaceFrom( (void*) ( pcData + iOffset ), iWidth, iHeight,
+			32, iWidth * 4, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000 );
+#endif
+		SDL_Surface* poConverted = poSheet ? ConvertSheet( poSheet ) : NULL;
+		if ( poSheet )
+		{
+			SDL_FreeSurface( poSheet );
+		}
+		if ( NULL == poConverted )
+		{
+			debug( "Can't convert sheet %d of %s.\n", i, a_pcFilename );
+			Clear();
+			return false;
+		}
+		m_apoSheets.push_back( poConverted );
+	}
+
+	// 2. READ THE PORTRAITS
+
+	for ( i=0; i<iNumPortraits; ++i )
+	{
+		const unsigned char* pcEntry = pcData + iPortraitsOffset + i * PORTRAITATLAS_ENTRYSIZE;
+		const unsigned char* pcRect = pcEntry + PORTRAITATLAS_NAMELENGTH;
+
+		SPortrait oPortrait;
+		oPortrait.m_iSheet = ReadUint32( pcRect );
+		oPortrait.m_oRect.x = ReadUint32( pcRect + 4 );
+		oPortrait.m_oRect.y = ReadUint32( pcRect + 8 );
+		oPortrait.m_oRect.w = ReadUint32( pcRect + 12 );
+		oPortrait.m_oRect.h = ReadUint32( pcRect + 16 );
+		if ( oPortrait.m_iSheet < 0 || oPortrait.m_iSheet >= (int) iNumSheets
+			|| oPortrait.m_oRect.x + oPortrait.m_oRect.w > m_apoSheets[oPortrait.m_iSheet]->w
+			|| oPortrait.m_oRect.y + oPortrait.m_oRect.h > m_apoSheets[oPortrait.m_iSheet]->h )
+		{
+			continue;
+		}
+
+		char acName[PORTRAITATLAS_NAMELENGTH+1];
+		memcpy( acName, pcEntry, PORTRAITATLAS_NAMELENGTH );
+		acName[PORTRAITATLAS_NAMELENGTH] = 0;
+		m_oPortraits[ acName ] = oPortrait;
+	}
+
+	debug( "Portrait atlas: %d portraits on %d sheets.\n", (int) m_oPortraits.size(), (int) m_apoSheets.size() );
+	return true;
+}
+
+
+void CPortraitAtlas::Clear()
+{
+	for ( unsigned int i=0; i<m_apoSheets.size(); ++i )
+	{
+		SDL_FreeSurface( m_apoSheets[i] );
+	}
+	m_apoSheets.clear();
+	m_oPortraits.clear();
+}
+
+
+/** Returns the sheet which has the portrait with the given file name, and
+its place on the sheet in a_roOutRect, or NULL if it is not in the atlas. */
+
+SDL_Surface* CPortraitAtlas::Find( const char* a_pcName, SDL_Rect& a_roOutRect ) const
+{
+	std::map<std::string,SPortrait>::const_iterator it = m_oPortraits.find( a_pcName );
+	if ( it == m_oPortraits.end() )
+	{
+		return NULL;
+	}
+	a_roOutRect = it->second.m_oRect;
+	return m_apoSheets[ it->second.m_iSheet ];
+}
+
+
+/** Converts an image with an alpha channel to the format which
+SDL_DisplayFormatAlpha() would choose for the screen, but in a software
+surface, so this can be called from a worker thread. The image is not
+freed. */
+
+SDL_Surface* CPortraitAtlas::ConvertSheet( SDL_Surface* a_poSheet )
+{
+	SDL_PixelFormat* poScreen = gamescreen->format;
+	Uint32 iRmask = 0x00ff0000, iGmask = 0x0000ff00, iBmask = 0x000000ff;
+	if ( 4 == poScreen->BytesPerPixel
+		&& 0x000000ff == poScreen->Rmask && 0x00ff0000 == poScreen->Bmask )
+	{
+		iRmask = 0x000000ff;
+		iBmask = 0x00ff0000;
+	}
+
+	SDL_Surface* poFormat = SDL_CreateRGBSurface( SDL_SWSURFACE, 1, 1, 32,
+		iRmask, iGmask, iBmask, 0xff000000 );
+	if ( NULL == poFormat )
+	{
+		return NULL;
+	}
+
+	// The alpha channel is copied, not blended, if SDL_SRCALPHA is off.
+	Uint32 iFlags = a_poSheet->flags & ( SDL_SRCALPHA | SDL_RLEACCEL );
+	Uint8 iAlpha = a_poSheet->format->alpha;
+	SDL_SetAlpha( a_poSheet, 0, 0 );
+	SDL_Surface* poRetval = SDL_ConvertSurface( a_poSheet, poFormat->format, SDL_SWSURFACE );
+	SDL_SetAlpha( a_poSheet, iFlags, iAlpha );
+	SDL_FreeSurface( poFormat );
+
+	if ( poRetval )
+	{
+		SDL_SetAlpha( poRetval, SDL_SRCALPHA, SDL_ALPHA_OPAQUE );
+	}
+	return poRetval;
+}
@@ -0,0 +1,73 @@
+/***************************************************************************
+                          PortraitAtlas.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef PORTRAITATLAS_H
+#define PORTRAITATLAS_H
+
+
+#include "SDL_video.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+#define PORTRAITATLAS_NAME			"characters/portraits.atlas"	///< The atlas in DATADIR.
+#define PORTRAITATLAS_VERSION		1
+#define PORTRAITATLAS_HEADERSIZE	16
+#define PORTRAITATLAS_SHEETSIZE		12
+#define PORTRAITATLAS_NAMELENGTH	48
+#define PORTRAITATLAS_ENTRYSIZE		(PORTRAITATLAS_NAMELENGTH+20)
+#define PORTRAITATLAS_MAXSHEETSIZE	512				///< The maximum width and height of a sheet.
+
+
+/**
+\ingroup PlayerSelect
+\brief The portraits of the fighters, packed into a few sheets.
+
+The atlas is built by mortalatlas from the *.icon.png files when the game
+is installed, and it is usually read from the data archive. Its layout is
+(every number is a little endian 32 bit integer):
+
+\li Header: "OMPA", version, number of sheets, number of portraits.
+\li Sheets: width, height and data offset of each sheet. The data is
+width*height RGBA pixels, 4 bytes each.
+\li Portraits: the file name (PORTRAITATLAS_NAMELENGTH bytes, zero padded),
+the sheet, and the x, y, w, h of the portrait on the sheet.
+
+Load() converts the sheets to the pixel format that SDL_DisplayFormatAlpha()
+would make, without touching the screen, so it can run on a worker thread.
+Drawing a portrait is a blit from a part of its sheet, see CChooser.
+*/
+
+class CPortraitAtlas
+{
+public:
+	CPortraitAtlas();
+	~CPortraitAtlas();
+
+	bool				Load( const char* a_pcFilename );
+	void				Clear();
+	SDL_Surface*		Find( const char* a_pcName, SDL_Rect& a_roOutRect ) const;
+
+	static SDL_Surface*	ConvertSheet( SDL_Surface* a_poSheet );
+
+protected:
+	struct SPortrait
+	{
+		int				m_iSheet;
+		SDL_Rect		m_oRect;
+	};
+
+	std::vector<SDL_Surface*>	m_apoSheets;
+	std::map<std::string,SPortrait>	m_oPortraits;
+};
+
+
+#endif // PORTRAITATLAS_H
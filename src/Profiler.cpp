@@ -0,0 +1,273 @@
+/***************************************************************************
+                          Profiler.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "SDL.h"
+#include "sge_primitives.h"
+#include "sge_bm_text.h"
+
+#include "Profiler.h"
+#include "State.h"
+#include "gfx.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+
+CProfiler g_oProfiler;
+
+
+static const char* g_apcPhaseNames[Pp_LAST+1] =
+{
+	"input", "advance", "read", "background", "sprites", "hud", "flip", "wait", "frame"
+};
+
+
+
+CProfiler::CProfiler()
+{
+	m_bOverlay = false;
+	m_dFrameStartNs = 0.0;
+	m_iNext = m_iCount = 0;
+	m_poLog = NULL;
+	m_bLogFailed = false;
+	m_iFrame = 0;
+	memset( m_adPhaseNs, 0, sizeof(m_adPhaseNs) );
+	memset( m_aiPhaseAllocations, 0, sizeof(m_aiPhaseAllocations) );
+	m_iFrameStartAllocations = 0;
+}
+
+
+CProfiler::~CProfiler()
+{
+	CloseLog();
+}
+
+
+/** Starts timing a new frame, and stores the previous one. */
+
+void CProfiler::BeginFrame()
+{
+	double dNowNs = GetNanoseconds();
+	if ( m_dFrameStartNs > 0.0 )
+	{
+		EndFrame( dNowNs );
+	}
+	memset( m_adPhaseNs, 0, sizeof(m_adPhaseNs) );
+	memset( m_aiPhaseAllocations, 0, sizeof(m_aiPhaseAllocations) );
+	m_dFrameStartNs = dNowNs;
+	m_iFrameStartAllocations = GetNumberOfAllocations();
+}
+
+
+/** Stores the last frame, and stops timing until the next BeginFrame().
+Called when the game loop ends, so the pause after it is not counted as
+a frame. */
+
+void CProfiler::Stop()
+{
+	if ( m_dFrameStartNs > 0.0 )
+	{
+		EndFrame( GetNanoseconds() );
+	}
+	m_dFrameStartNs = 0.0;
+}
+
+
+void CProfiler::Add( TProfilePhaseEnum a_enPhase, double a_dNs, long a_iAllocations )
+{
+	m_adPhaseNs[a_enPhase] += a_dNs;
+	m_aiPhaseAllocations[a_enPhase] += a_iAllocations;
+}
+
+
+void CProfiler::EndFrame( double a_dNowNs )
+{
+	double* pdMs = m_aadHistoryMs[m_iNext];
+	long* piAllocations = m_aaiHistoryAllocations[m_iNext];
+	for ( int i=0; i<Pp_LAST; ++i )
+	{
+		pdMs[i] = m_adPhaseNs[i] / 1e6;
+		piAllocations[i] = m_aiPhaseAllocations[i];
+	}
+	pdMs[Pp_LAST] = ( a_dNowNs - m_dFrameStartNs ) / 1e6;
+	piAllocations[Pp_LAST] = GetNumberOfAllocations() - m_iFrameStartAllocations;
+
+	m_iNext = ( m_iNext + 1 ) % PROFILER_WINDOW;
+	if ( m_iCount < PROFILER_WINDOW )
+	{
+		++m_iCount;
+	}
+	++m_iFrame;
+
+	if ( g_oState.m_bProfileLog )
+	{
+		WriteLog( pdMs, piAllocations );
+	}
+}
+
+
+
+/*************************************************************************
+                           CSV LOG
+*************************************************************************/
+
+
+/** Returns the name of the CSV file for this run of the game. The name has
+the time of the call in it, so call it only once. */
+
+std::string CProfiler::GetLogFilename()
+{
+	char acTime[32];
+	time_t iNow = time( NULL );
+	strftime( acTime, sizeof(acTime), "%Y%m%d-%H%M%S", localtime( &iNow ) );
+
+#if defined(_WIN32) || defined(WIN32) || defined(_WINDOWS)
+	return std::string( "profile-" ) + acTime + ".csv";
+#else
+	return std::string( getenv("HOME") ) + "/.openmortal-profile-" + acTime + ".csv";
+#endif
+}
+
+
+/** Writes a line for the frame. The file is created for the first frame. */
+
+void CProfiler::WriteLog( const double* a_pdMs, const long* a_piAllocations )
+{
+	if ( NULL == m_poLog )
+	{
+		if ( m_bLogFailed )
+		{
+			return;
+		}
+		std::string sFilename = GetLogFilename();
+		m_poLog = fopen( sFilename.c_str(), "w" );
+		if ( NULL == m_poLog )
+		{
+			debug( "Can't create the profile log %s\n", sFilename.c_str() );
+			m_bLogFailed = true;
+			return;
+		}
+		debug( "Writing the frame times to %s\n", sFilename.c_str() );
+
+		fprintf( m_poLog, "frame" );
+		for ( int i=0; i<=Pp_LAST; ++i )
+		{
+			fprintf( m_poLog, ",%s_ms", g_apcPhaseNames[i] );
+		}
+		for ( int i=0; i<=Pp_LAST; ++i )
+		{
+			fprintf( m_poLog, ",%s_allocs", g_apcPhaseNames[i] );
+		}
+		fprintf( m_poLog, "\n" );
+	}
+
+	fprintf( m_poLog, "%d", m_iFrame );
+	for ( int i=0; i<=Pp_LAST; ++i )
+	{
+		fprintf( m_poLog, ",%.3f", a_pdMs[i] );
+	}
+	for ( int i=0; i<=Pp_LAST; ++i )
+	{
+		fprintf( m_poLog, ",%ld", a_piAllocations[i] );
+	}
+	fprintf( m_poLog, "\n" );
+}
+
+
+void CProfiler::CloseLog()
+{
+	if ( m_poLog )
+	{
+		fclose( m_poLog );
+		m_poLog = NULL;
+	}
+}
+
+
+
+/*************************************************************************
+                           OVERLAY
+*************************************************************************/
+
+
+void CProfiler::ToggleOverlay()
+{
+	m_bOverlay = !m_bOverlay;
+}
+
+
+bool CProfiler::IsOverlayOn() const
+{
+	return m_bOverlay;
+}
+
+
+/** Draws a row for each phase, and one for the whole frame: the graph of
+the last PROFILER_WINDOW frames, the p50, p95 and max times in
+milliseconds, and the average allocations per frame. A full bar is a game
+tick for the phases (yellow above a quarter tick, red above half), and two
+ticks for the whole frame (red if it missed a tick). */
+
+void CProfiler::DrawOverlay( SDL_Surface* a_poScreen, int a_iX, int a_iY ) const
+{
+	const int iRowHeight = 18;
+	const int iGraphX = a_iX + 70;
+	const int iTextX = iGraphX + PROFILER_WINDOW + 8;
+	double dTickMs = g_oState.m_iGameSpeed > 0 ? g_oState.m_iGameSpeed : 12;
+
+	sge_FilledRectAlpha( a_poScreen, a_iX - 4, a_iY - 4, iTextX + 170,
+		a_iY + ( Pp_LAST + 2 ) * iRowHeight, C_BLACK, 160 );
+	sge_BF_textoutf( a_poScreen, fastFont, iGraphX, a_iY, "last %d frames", m_iCount );
+	sge_BF_textout( a_poScreen, fastFont, "  p50   p95   max  alloc", iTextX, a_iY );
+
+	double adSorted[PROFILER_WINDOW];
+	for ( int iPhase=0; iPhase<=Pp_LAST; ++iPhase )
+	{
+		int y = a_iY + ( iPhase + 1 ) * iRowHeight;
+		sge_BF_textout( a_poScreen, fastFont, g_apcPhaseNames[iPhase], a_iX, y );
+		if ( 0 == m_iCount )
+		{
+			continue;
+		}
+
+		// The graph, oldest frame on the left.
+		int iFirst = ( m_iNext - m_iCount + PROFILER_WINDOW ) % PROFILER_WINDOW;
+		long iAllocations = 0;
+		for ( int i=0; i<m_iCount; ++i )
+		{
+			double dMs = m_aadHistoryMs[ ( iFirst + i ) % PROFILER_WINDOW ][iPhase];
+			adSorted[i] = dMs;
+			iAllocations += m_aaiHistoryAllocations[ ( iFirst + i ) % PROFILER_WINDOW ][iPhase];
+			Uint32 iColor;
+			int h;
+			if ( Pp_LAST == iPhase )
+			{
+				// A whole frame is a tick long, unless it missed one.
+				h = (int) ( dMs / dTickMs / 2 * ( iRowHeight - 2 ) );
+				iColor = dMs > dTickMs * 1.5 ? C_LIGHTRED : C_LIGHTGREEN;
+			}
+			else
+			{
+				h = (int) ( dMs / dTickMs * ( iRowHeight - 2 ) );
+				iColor = dMs > dTickMs / 2 ? C_LIGHTRED : ( dMs > dTickMs / 4 ? C_YELLOW : C_LIGHTGREEN );
+			}
+			if ( h <= 0 ) continue;
+			if ( h > iRowHeight - 2 ) h = iRowHeight - 2;
+			int iBottom = y + iRowHeight - 3;
+			sge_FilledRect( a_poScreen, iGraphX + i, iBottom - h + 1, iGraphX + i, iBottom, iColor );
+		}
+
+		std::sort( adSorted, adSorted + m_iCount );
+		sge_BF_textoutf( a_poScreen, fastFont, iTextX, y, "%5.2f %5.2f %5.2f %6.1f",
+			adSorted[ m_iCount * 50 / 100 ], adSorted[ m_iCount * 95 / 100 ], adSorted[ m_iCount - 1 ],
+			(double) iAllocations / m_iCount );
+	}
+}
@@ -0,0 +1,126 @@
+/***************************************************************************
+                          Profiler.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+
+#include "common.h"
+#include "AllocCounter.h"
+
+#include <stdio.h>
+#include <string>
+
+
+#define PROFILER_WINDOW		128		///< The overlay shows this many frames.
+
+
+/** The phases of a game frame which are timed. */
+enum TProfilePhaseEnum
+{
+	Pp_INPUT,			///< Events and the key queue
+	Pp_ADVANCE,			///< GameAdvance() in the perl backend
+	Pp_READ,			///< Backend::ReadFromPerl()
+	Pp_BACKGROUND,
+	Pp_SPRITES,			///< Shadows, fighters and doodads
+	Pp_HUD,				///< Hit points, texts
+	Pp_FLIP,			///< SDL_Flip()
+	Pp_WAIT,			///< Waiting for the next tick (CFramePacer)
+
+	Pp_LAST
+};
+
+
+/**
+\ingroup GameLogic
+\brief Times the phases of the game frames.
+
+The game loop calls BeginFrame() at the start of every frame; the phases
+are measured with CProfileScope objects in between. A phase can be timed
+more than once in a frame, the times are added up. The allocations of the
+main thread are counted the same way (see GetNumberOfAllocations()).
+
+The times of the last PROFILER_WINDOW frames are kept for the overlay,
+which is toggled with F12 and shows a bar graph and the percentiles of
+each phase, and its average allocations per frame. If PROFILELOG is set,
+every frame is also written to a CSV file, a new one for every run of the
+game (see GetLogFilename()), so the slow frames can be looked at later.
+*/
+
+class CProfiler
+{
+public:
+	CProfiler();
+	~CProfiler();
+
+	void				BeginFrame();
+	void				Stop();
+	void				Add( TProfilePhaseEnum a_enPhase, double a_dNs, long a_iAllocations );
+
+	void				ToggleOverlay();
+	bool				IsOverlayOn() const;
+	void				DrawOverlay( SDL_Surface* a_poScreen, int a_iX, int a_iY ) const;
+
+	void				CloseLog();
+	static std::string	GetLogFilename();
+
+protected:
+	void				EndFrame( double a_dNowNs );
+	void				WriteLog( const double* a_pdMs, const long* a_piAllocations );
+
+protected:
+	bool				m_bOverlay;
+	double				m_dFrameStartNs;			///< 0 before the first frame.
+	double				m_adPhaseNs[Pp_LAST];		///< The current frame.
+	long				m_aiPhaseAllocations[Pp_LAST];
+	long				m_iFrameStartAllocations;
+
+	double				m_aadHistoryMs[PROFILER_WINDOW][Pp_LAST+1];	///< The phases, and the whole frame.
+	long				m_aaiHistoryAllocations[PROFILER_WINDOW][Pp_LAST+1];
+	int					m_iNext;
+	int					m_iCount;
+
+	FILE*				m_poLog;
+	bool				m_bLogFailed;
+	int					m_iFrame;
+};
+
+extern CProfiler g_oProfiler;
+
+
+/**
+\ingroup GameLogic
+\brief Adds the time and the allocations from its construction to its
+destruction to a phase.
+*/
+
+class CProfileScope
+{
+public:
+	CProfileScope( TProfilePhaseEnum a_enPhase )
+	{
+		m_enPhase = a_enPhase;
+		m_dStartNs = GetNanoseconds();
+		m_iStartAllocations = GetNumberOfAllocations();
+	}
+
+	~CProfileScope()
+	{
+		g_oProfiler.Add( m_enPhase, GetNanoseconds() - m_dStartNs,
+			GetNumberOfAllocations() - m_iStartAllocations );
+	}
+
+protected:
+	TProfilePhaseEnum	m_enPhase;
+	double				m_dStartNs;
+	long				m_iStartAllocations;
+};
+
+
+#endif // PROFILER_H
@@ -0,0 +1,416 @@
+/***************************************************************************
+                          ReplayCheck.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+/**
+\file ReplayCheck.cpp
+
+Batch validation of recorded replays. Every replay file in a directory is
+simulated again from its recorded inputs (see Game::SaveReplay()), and the
+resulting scenes are compared to the recorded ones tick by tick. This
+catches determinism regressions in the perl backend and in the replay
+format before they ruin someone's saved games.
+
+The replays are distributed among worker processes. The workers are forked
+after the backend has loaded every fighter, so each worker has its own
+private copy of the fully initialized perl interpreter.
+*/
+
+#include "common.h"
+#include "Backend.h"
+#include "State.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+
+#include <dirent.h>
+#include <time.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+
+/***************************************************************************
+                     PRIVATE TYPES AND HELPERS
+***************************************************************************/
+
+
+/** One recorded input of a replay: a key event ('K') or a team member
+change ('T'). */
+struct SReplayInput
+{
+	char	cType;
+	int		iTick;
+	int		iPlayer;
+	int		iValue;		///< The key for 'K', the new fighter for 'T'.
+	int		iDown;
+};
+
+
+enum ReplayCheckResultEnum
+{
+	Rc_PASS,
+	Rc_FAIL,
+	Rc_SKIP,
+};
+
+
+static const char* g_acResultNames[] = { "PASS", "FAIL", "SKIP" };
+
+
+static double GetWallSeconds()
+{
+#ifndef _WIN32
+	struct timeval oTime;
+	gettimeofday( &oTime, NULL );
+	return oTime.tv_sec + oTime.tv_usec / 1000000.0;
+#else
+	return clock() / (double) CLOCKS_PER_SEC;
+#endif
+}
+
+
+/** Sends the recorded inputs which are due at the current game tick to
+the backend, in the order they were recorded.
+
+\param a_bTeamOnly Stop at the first "K" line: only the "T" lines recorded
+right after a tick are applied.
+*/
+static void ApplyInputs( const std::vector<SReplayInput>& a_raoInputs,
+	unsigned int& a_riNextInput, bool a_bTeamOnly )
+{
+	while ( a_riNextInput < a_raoInputs.size()
+		&& a_raoInputs[a_riNextInput].iTick <= g_oBackend.m_iGameTick )
+	{
+		const SReplayInput& roInput = a_raoInputs[a_riNextInput];
+		if ( 'K' == roInput.cType )
+		{
+			if ( a_bTeamOnly )
+			{
+				break;
+			}
+			g_oBackend.PerlEvalF( roInput.iDown ? "KeyDown(%d,%d);" : "KeyUp(%d,%d);",
+				roInput.iPlayer, roInput.iValue );
+		}
+		else
+		{
+			g_oBackend.PerlEvalF( "NextTeamMember(%d,%d);", roInput.iPlayer, roInput.iValue );
+		}
+		++a_riNextInput;
+	}
+}
+
+
+/** Simulates a single replay file and compares it to the recorded scenes.
+
+\param a_riOutTicks The number of ticks simulated.
+\param a_rsOutMessage Explanation of a FAIL or SKIP result.
+*/
+static ReplayCheckResultEnum CheckReplay( const char* a_pcFilename,
+	int& a_riOutTicks, std::string& a_rsOutMessage )
+{
+	a_riOutTicks = 0;
+
+	std::ifstream oInput( a_pcFilename );
+	std::string sLine;
+	if ( !std::getline( oInput, sLine ) )
+	{
+		a_rsOutMessage = "can't read the file";
+		return Rc_FAIL;
+	}
+
+	int aiFighters[2], iVersion, iHitPoints, iNumPlayers, iTeamSize, iWide;
+	if ( 7 != sscanf( sLine.c_str(), "%d %d %d %d %d %d %d",
+		&aiFighters[0], &aiFighters[1], &iVersion, &iHitPoints, &iNumPlayers, &iTeamSize, &iWide )
+		|| iVersion < 2 )
+	{
+		a_rsOutMessage = "no recorded inputs (old replay format)";
+		return Rc_SKIP;
+	}
+
+	if ( 2 != iNumPlayers )
+	{
+		a_rsOutMessage = "only two player replays can be checked";
+		return Rc_SKIP;
+	}
+
+	std::vector<SReplayInput> aoInputs;
+	while ( 'K' == oInput.peek() || 'T' == oInput.peek() )
+	{
+		std::getline( oInput, sLine );
+		SReplayInput oInputRecord;
+		oInputRecord.iDown = 0;
+		oInputRecord.cType = sLine[0];
+		sscanf( sLine.c_str()+1, "%d %d %d %d", &oInputRecord.iTick, &oInputRecord.iPlayer,
+			&oInputRecord.iValue, &oInputRecord.iDown );
+		aoInputs.push_back( oInputRecord );
+	}
+
+	// Set up the round exactly as Game::DoOneRound does.
+
+	g_oState.m_iNumPlayers = iNumPlayers;
+	g_oBackend.PerlEvalF( "SelectStart(%d);", iNumPlayers );
+	g_oBackend.PerlEvalF( "SetPlayerNumber(%d,%d);", 0, aiFighters[0] );
+	g_oBackend.PerlEvalF( "SetPlayerNumber(%d,%d);", 1, aiFighters[1] );
+	g_oBackend.PerlEvalF( "GameStart(%d,%d,%d,%d,%d);", iHitPoints, iNumPlayers, iTeamSize, iWide, 0 );
+	g_oBackend.ReadFromPerl();
+
+	std::string sFrameDesc;
+	unsigned int iNextInput = 0;
+
+	while ( std::getline( oInput, sLine ) )
+	{
+		if ( 0 == sLine.size() )
+		{
+			continue;
+		}
+
+		// Like Game::Advance, the keys due at the current tick are sent
+		// before the tick; a "K" line has the tick before the advance.
+		// The team changes of DoOneRound come after the tick.
+
+		ApplyInputs( aoInputs, iNextInput, false );
+
+		g_oBackend.AdvancePerl();
+		g_oBackend.ReadFromPerl();
+		++a_riOutTicks;
+
+		ApplyInputs( aoInputs, iNextInput, true );
+
+		g_oBackend.WriteToString( sFrameDesc );
+		if ( sFrameDesc != sLine )
+		{
+			char acBuffer[128];
+			sprintf( acBuffer, "first mismatch at tick %d (scene %d)",
+				g_oBackend.m_iGameTick, a_riOutTicks );
+			a_rsOutMessage = acBuffer;
+			return Rc_FAIL;
+		}
+	}
+
+	if ( 0 == a_riOutTicks )
+	{
+		a_rsOutMessage = "no scenes recorded";
+		return Rc_FAIL;
+	}
+
+	return Rc_PASS;
+}
+
+
+/** Checks every a_iNumJobs'th replay starting from a_iFirst, and writes
+one line per replay to a_poOutput:
+"index result ticks seconds message". */
+static void CheckReplays( const std::vector<std::string>& a_rasFiles,
+	int a_iFirst, int a_iNumJobs, FILE* a_poOutput )
+{
+	for ( unsigned int i=a_iFirst; i<a_rasFiles.size(); i += a_iNumJobs )
+	{
+		int iTicks;
+		std::string sMessage;
+		double dStart = GetWallSeconds();
+		ReplayCheckResultEnum enResult = CheckReplay( a_rasFiles[i].c_str(), iTicks, sMessage );
+		double dSeconds = GetWallSeconds() - dStart;
+
+		fprintf( a_poOutput, "%d %d %d %f %s\n", i, enResult, iTicks, dSeconds, sMessage.c_str() );
+		fflush( a_poOutput );
+	}
+}
+
+
+
+/***************************************************************************
+                     PUBLIC FUNCTIONS
+***************************************************************************/
+
+
+/** Validates every replay file in a directory by simulating it again.
+
+The result is printed to stdout, one line per replay, followed by a summary
+with the total simulation throughput.
+
+\param a_pcDirectory The directory that contains the *.replay files.
+\param a_iNumJobs The number of worker processes to use.
+\return The number of failed replays.
+*/
+int DoReplayCheck( const char* a_pcDirectory, int a_iNumJobs )
+{
+	// 1. Collect the replay files.
+
+	std::vector<std::string> asFiles;
+	DIR* poDir = opendir( a_pcDirectory );
+	if ( NULL == poDir )
+	{
+		fprintf( stderr, "Can't open directory %s\n", a_pcDirectory );
+		return 1;
+	}
+
+	struct dirent* poEntry;
+	while ( NULL != (poEntry = readdir( poDir )) )
+	{
+		const char* pcName = poEntry->d_name;
+		int iLength = strlen( pcName );
+		if ( iLength > 7 && 0 == strcmp( pcName + iLength - 7, ".replay" ) )
+		{
+			asFiles.push_back( std::string(a_pcDirectory) + "/" + pcName );
+		}
+	}
+	closedir( poDir );
+	std::sort( asFiles.begin(), asFiles.end() );
+
+	if ( asFiles.size() == 0 )
+	{
+		printf( "No replays found in %s\n", a_pcDirectory );
+		return 0;
+	}
+
+	// 2. Load every fighter before forking, so the workers share the work.
+
+	int iNumFighterFiles = g_oBackend.GetNumberOfFighterFiles();
+	for ( int i=0; i<iNumFighterFiles; ++i )
+	{
+		g_oBackend.LoadFighterFile( i );
+	}
+
+	if ( a_iNumJobs < 1 ) a_iNumJobs = 1;
+	if ( a_iNumJobs > (int) asFiles.size() ) a_iNumJobs = asFiles.size();
+
+	// 3. Run the workers. Their reports are collected in a temporary file
+	// each; the workers only ever write to their own. The files are made
+	// first, so nothing runs if one can't be made.
+
+#ifdef _WIN32
+	a_iNumJobs = 1;
+#endif
+
+	std::vector<FILE*> apoReports;
+	int i;
+
+	for ( i=0; i<a_iNumJobs; ++i )
+	{
+		FILE* poReport = tmpfile();
+		if ( NULL == poReport )
+		{
+			perror( "Can't create a temporary file for the results" );
+			for ( unsigned int j=0; j<apoReports.size(); ++j )
+			{
+				fclose( apoReports[j] );
+			}
+			return 1;
+		}
+		apoReports.push_back( poReport );
+	}
+
+	double dStart = GetWallSeconds();
+
+#ifndef _WIN32
+	std::vector<pid_t> aiWorkers;
+	fflush( stdout );
+	fflush( stderr );
+
+	for ( i=0; i<a_iNumJobs; ++i )
+	{
+		pid_t iPid = fork();
+		if ( 0 == iPid )
+		{
+			CheckReplays( asFiles, i, a_iNumJobs, apoReports[i] );
+			_exit( 0 );
+		}
+		if ( iPid < 0 )
+		{
+			// Can't fork; do this share of the work here.
+			CheckReplays( asFiles, i, a_iNumJobs, apoReports[i] );
+		}
+		aiWorkers.push_back( iPid );
+	}
+
+	for ( i=0; i<a_iNumJobs; ++i )
+	{
+		int iStatus;
+		if ( aiWorkers[i] > 0 )
+		{
+			waitpid( aiWorkers[i], &iStatus, 0 );
+		}
+	}
+#else
+	CheckReplays( asFiles, 0, 1, apoReports[0] );
+#endif
+
+	double dSeconds = GetWallSeconds() - dStart;
+
+	// 4. Print the results in the order of the files.
+
+	std::vector<int> aiResults( asFiles.size(), -1 );
+	std::vector<int> aiTicks( asFiles.size(), 0 );
+	std::vector<double> adSeconds( asFiles.size(), 0.0 );
+	std::vector<std::string> asMessages( asFiles.size() );
+
+	for ( i=0; i<(int)apoReports.size(); ++i )
+	{
+		rewind( apoReports[i] );
+
+		char acLine[1024];
+		while ( fgets( acLine, sizeof(acLine), apoReports[i] ) )
+		{
+			int iIndex, iResult, iTicks, iOffset = 0;
+			double dReplaySeconds;
+			if ( 4 > sscanf( acLine, "%d %d %d %lf %n", &iIndex, &iResult, &iTicks, &dReplaySeconds, &iOffset )
+				|| iIndex < 0 || iIndex >= (int) asFiles.size() )
+			{
+				continue;
+			}
+			char* pcEnd = strchr( acLine, '\n' );
+			if ( pcEnd ) *pcEnd = 0;
+
+			aiResults[iIndex] = iResult;
+			aiTicks[iIndex] = iTicks;
+			adSeconds[iIndex] = dReplaySeconds;
+			asMessages[iIndex] = acLine + iOffset;
+		}
+		fclose( apoReports[i] );
+	}
+
+	int aiCount[3] = { 0, 0, 0 };
+	int iTotalTicks = 0;
+
+	for ( i=0; i<(int)asFiles.size(); ++i )
+	{
+		if ( aiResults[i] < 0 )
+		{
+			aiResults[i] = Rc_FAIL;
+			asMessages[i] = "the worker process died";
+		}
+		++aiCount[ aiResults[i] ];
+		iTotalTicks += aiTicks[i];
+
+		printf( "%s  %s  %d ticks", g_acResultNames[ aiResults[i] ], asFiles[i].c_str(), aiTicks[i] );
+		if ( adSeconds[i] > 0 )
+		{
+			printf( ", %.0f ticks/s", aiTicks[i] / adSeconds[i] );
+		}
+		if ( asMessages[i].size() )
+		{
+			printf( ", %s", asMessages[i].c_str() );
+		}
+		printf( "\n" );
+	}
+
+	printf( "\n%d replays: %d passed, %d failed, %d skipped.\n",
+		(int) asFiles.size(), aiCount[Rc_PASS], aiCount[Rc_FAIL], aiCount[Rc_SKIP] );
+	printf( "%d ticks in %.2f s with %d workers (%.0f ticks/s).\n",
+		iTotalTicks, dSeconds, a_iNumJobs, dSeconds > 0 ? iTotalTicks / dSeconds : 0.0 );
+
+	return aiCount[Rc_FAIL];
+}
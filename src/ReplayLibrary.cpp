@@ -0,0 +1,749 @@
+/***************************************************************************
+                          ReplayLibrary.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "ReplayLibrary.h"
+#include "common.h"
+#include "gfx.h"
+#include "State.h"
+#include "Backend.h"
+#include "sge_primitives.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fstream>
+#include <algorithm>
+#include <map>
+
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#if defined(_WIN32) || defined(WIN32) || defined(_WINDOWS)
+#include <direct.h>
+#define MKDIR(A) _mkdir(A)
+#else
+#define MKDIR(A) mkdir(A, 0755)
+#endif
+
+
+#define REPLAY_INDEX_FILE "replays.idx"
+#define REPLAY_INDEX_VERSION 2
+#define REPLAY_DEFAULT_SPEED 12	///< For replays that don't record the game speed.
+
+
+CReplayLibrary g_oReplayLibrary;
+
+
+/** The header of the index file. If any of these don't match, the
+index is rebuilt. */
+struct SReplayIndexHeader
+{
+	char	m_acMagic[4];
+	Uint32	m_iVersion;
+	Uint32	m_iEntrySize;
+};
+
+
+static void FillIndexHeader( SReplayIndexHeader& a_roHeader )
+{
+	memcpy( a_roHeader.m_acMagic, "OMRI", 4 );
+	a_roHeader.m_iVersion = REPLAY_INDEX_VERSION;
+	a_roHeader.m_iEntrySize = sizeof(SReplayIndexEntry);
+}
+
+
+static bool CompareEntryDates( const SReplayIndexEntry& a_roFirst, const SReplayIndexEntry& a_roSecond )
+{
+	return a_roFirst.m_iDate < a_roSecond.m_iDate;
+}
+
+
+
+/***************************************************************************
+                     CReplayLibrary CLASS
+***************************************************************************/
+
+
+CReplayLibrary::CReplayLibrary()
+{
+	m_bLoaded = false;
+}
+
+
+CReplayLibrary::~CReplayLibrary()
+{
+}
+
+
+/** Returns the directory where replays are stored, without the trailing
+slash. The directory may not exist yet. */
+std::string CReplayLibrary::GetReplayDirectory()
+{
+#if defined(_WIN32) || defined(WIN32) || defined(_WINDOWS)
+	return "replays";
+#elif defined(MACOSX)
+	return std::string(getenv("HOME")) + "/Library/OpenMortal Replays";
+#else
+	return std::string(getenv("HOME")) + "/.openmortal-replays";
+#endif
+}
+
+
+/** Reads the index file. The index is rebuilt if it is missing or
+incompatible. Calling Load() again has no effect. */
+bool CReplayLibrary::Load()
+{
+	if ( m_bLoaded )
+	{
+		return true;
+	}
+	m_bLoaded = true;
+	m_aoEntries.clear();
+
+	std::string sIndexFile = GetReplayDirectory() + "/" REPLAY_INDEX_FILE;
+	FILE* poFile = fopen( sIndexFile.c_str(), "rb" );
+	if ( NULL == poFile )
+	{
+		Rebuild();
+		return true;
+	}
+
+	SReplayIndexHeader oHeader, oExpected;
+	FillIndexHeader( oExpected );
+	if ( 1 != fread( &oHeader, sizeof(oHeader), 1, poFile )
+		|| memcmp( &oHeader, &oExpected, sizeof(oHeader) ) )
+	{
+		fclose( poFile );
+		debug( "CReplayLibrary::Load: %s is outdated, rebuilding.\n", sIndexFile.c_str() );
+		Rebuild();
+		return true;
+	}
+
+	// Read the whole array in one go.
+
+	fseek( poFile, 0, SEEK_END );
+	long iSize = ftell( poFile ) - sizeof(oHeader);
+	fseek( poFile, sizeof(oHeader), SEEK_SET );
+
+	int iNumEntries = iSize / sizeof(SReplayIndexEntry);
+	if ( iNumEntries > 0 )
+	{
+		m_aoEntries.resize( iNumEntries );
+		iNumEntries = fread( &m_aoEntries[0], sizeof(SReplayIndexEntry), iNumEntries, poFile );
+		m_aoEntries.resize( iNumEntries );
+	}
+	fclose( poFile );
+
+	if ( PruneMissing() )
+	{
+		WriteIndex();
+	}
+
+	debug( "CReplayLibrary::Load: %d replays in the index.\n", (int) m_aoEntries.size() );
+	return true;
+}
+
+
+/** Scans every replay file in the replay directory and writes a new index.
+This is the only operation which opens every replay file. */
+void CReplayLibrary::Rebuild()
+{
+	m_bLoaded = true;
+	m_aoEntries.clear();
+
+	std::string sDirectory = GetReplayDirectory();
+	DIR* poDir = opendir( sDirectory.c_str() );
+	if ( NULL == poDir )
+	{
+		return;
+	}
+
+	struct dirent* poEntry;
+	while ( NULL != (poEntry = readdir( poDir )) )
+	{
+		const char* pcName = poEntry->d_name;
+		int iLength = strlen( pcName );
+		if ( iLength <= 7 || strcmp( pcName + iLength - 7, ".replay" ) )
+		{
+			continue;
+		}
+
+		SReplayIndexEntry oEntry;
+		if ( ReadEntry( (sDirectory + "/" + pcName).c_str(), oEntry ) )
+		{
+			m_aoEntries.push_back( oEntry );
+		}
+	}
+	closedir( poDir );
+
+	std::sort( m_aoEntries.begin(), m_aoEntries.end(), CompareEntryDates );
+	PruneOldest( REPLAY_MAXREPLAYS );
+	WriteIndex();
+}
+
+
+/** Deletes the oldest files with the given extension (e.g. ".capture")
+from the replay directory, so that at most a_iKeep remain. The replays
+themselves are pruned by AddReplay(), this is for the other files which
+are stored next to them. */
+void CReplayLibrary::PruneFiles( const char* a_pcExtension, int a_iKeep )
+{
+	std::string sDirectory = GetReplayDirectory() + "/";
+	DIR* poDir = opendir( sDirectory.c_str() );
+	if ( NULL == poDir )
+	{
+		return;
+	}
+
+	int iExtensionLength = strlen( a_pcExtension );
+	std::vector< std::pair<long,std::string> > aoFiles;
+	struct dirent* poEntry;
+	while ( NULL != (poEntry = readdir( poDir )) )
+	{
+		const char* pcName = poEntry->d_name;
+		int iLength = strlen( pcName );
+		if ( iLength <= iExtensionLength || strcmp( pcName + iLength - iExtensionLength, a_pcExtension ) )
+		{
+			continue;
+		}
+
+		struct stat oStat;
+		if ( 0 == stat( ( sDirectory + pcName ).c_str(), &oStat ) )
+		{
+			aoFiles.push_back( std::make_pair( (long) oStat.st_mtime, std::string( pcName ) ) );
+		}
+	}
+	closedir( poDir );
+
+	int iNumDeleted = (int) aoFiles.size() - a_iKeep;
+	if ( iNumDeleted <= 0 )
+	{
+		return;
+	}
+
+	std::sort( aoFiles.begin(), aoFiles.end() );
+	for ( int i=0; i<iNumDeleted; ++i )
+	{
+		remove( ( sDirectory + aoFiles[i].second ).c_str() );
+	}
+	debug( "CReplayLibrary: deleted %d old %s files.\n", iNumDeleted, a_pcExtension );
+}
+
+
+/** Returns a new, unused filename in the replay directory. The directory
+is created if necessary. An empty string is returned if the directory
+can't be created. */
+std::string CReplayLibrary::GetNewReplayFilename( const char* a_pcExtension )
+{
+	std::string sDirectory = GetReplayDirectory();
+	MKDIR( sDirectory.c_str() );
+
+	time_t iNow = time( NULL );
+	char acName[32];
+	strftime( acName, sizeof(acName), "%Y%m%d-%H%M%S", localtime( &iNow ) );
+
+	std::string sFilename;
+	for ( int i=0; i<100; ++i )
+	{
+		char acSuffix[16];
+		sprintf( acSuffix, i ? "-%d" : "", i );
+		sFilename = sDirectory + "/" + acName + acSuffix + a_pcExtension;
+
+		FILE* poFile = fopen( sFilename.c_str(), "r" );
+		if ( NULL == poFile )
+		{
+			// We can create it if the directory is there.
+			poFile = fopen( sFilename.c_str(), "w" );
+			if ( NULL == poFile )
+			{
+				return "";
+			}
+			fclose( poFile );
+			return sFilename;
+		}
+		fclose( poFile );
+	}
+
+	return "";
+}
+
+
+/** Adds a freshly saved replay file to the index. The file must be in
+the replay directory.
+
+\param a_iWinner The player who won the game, or -1 for a draw.
+*/
+bool CReplayLibrary::AddReplay( const char* a_pcFilename, int a_iWinner )
+{
+	Load();
+
+	SReplayIndexEntry oEntry;
+	if ( !ReadEntry( a_pcFilename, oEntry ) )
+	{
+		return false;
+	}
+	oEntry.m_iWinner = a_iWinner;
+
+	m_aoEntries.push_back( oEntry );
+	if ( PruneOldest( REPLAY_MAXREPLAYS ) )
+	{
+		return WriteIndex();
+	}
+	return AppendToIndex( oEntry );
+}
+
+
+int CReplayLibrary::GetNumberOfReplays() const
+{
+	return m_aoEntries.size();
+}
+
+
+const SReplayIndexEntry& CReplayLibrary::GetReplay( int a_iIndex ) const
+{
+	return m_aoEntries[a_iIndex];
+}
+
+
+std::string CReplayLibrary::GetReplayPath( int a_iIndex ) const
+{
+	return GetReplayDirectory() + "/" + m_aoEntries[a_iIndex].m_acFilename;
+}
+
+
+/** Collects the indexes of the replays which match the filter, newest first.
+
+\param a_iFighter Only replays with this fighter are returned; -1 means any fighter.
+\param a_bOnlyWins Only replays which a_iFighter has won are returned.
+*/
+void CReplayLibrary::Filter( int a_iFighter, bool a_bOnlyWins, std::vector<int>& a_raiOutIndexes ) const
+{
+	a_raiOutIndexes.clear();
+
+	for ( int i=m_aoEntries.size()-1; i>=0; --i )
+	{
+		const SReplayIndexEntry& roEntry = m_aoEntries[i];
+		if ( a_iFighter >= 0 )
+		{
+			if ( a_bOnlyWins )
+			{
+				if ( roEntry.m_iWinner < 0 || roEntry.m_aiFighters[(int)roEntry.m_iWinner] != a_iFighter )
+					continue;
+			}
+			else if ( roEntry.m_aiFighters[0] != a_iFighter && roEntry.m_aiFighters[1] != a_iFighter )
+			{
+				continue;
+			}
+		}
+		a_raiOutIndexes.push_back( i );
+	}
+}
+
+
+/** Reads a replay file and fills in an index entry for it. The winner
+is guessed from the hit points in the last scene. */
+bool CReplayLibrary::ReadEntry( const char* a_pcFilename, SReplayIndexEntry& a_roOutEntry )
+{
+	std::ifstream oInput( a_pcFilename );
+	std::string sLine;
+	if ( !std::getline( oInput, sLine ) )
+	{
+		return false;
+	}
+
+	memset( &a_roOutEntry, 0, sizeof(a_roOutEntry) );
+
+	const char* pcName = strrchr( a_pcFilename, '/' );
+	pcName = pcName ? pcName + 1 : a_pcFilename;
+	strncpy( a_roOutEntry.m_acFilename, pcName, sizeof(a_roOutEntry.m_acFilename) - 1 );
+
+	// Fighters, version, hit points, players, team size, wide, game speed.
+	// The game speed is only in version 3 and later.
+	int aiFighters[2];
+	int iDummy, iGameSpeed = REPLAY_DEFAULT_SPEED;
+	if ( 2 > sscanf( sLine.c_str(), "%d %d %d %d %d %d %d %d", &aiFighters[0], &aiFighters[1],
+		&iDummy, &iDummy, &iDummy, &iDummy, &iDummy, &iGameSpeed ) )
+	{
+		return false;
+	}
+	a_roOutEntry.m_aiFighters[0] = aiFighters[0];
+	a_roOutEntry.m_aiFighters[1] = aiFighters[1];
+	a_roOutEntry.m_iGameSpeed = iGameSpeed > 0 ? iGameSpeed : REPLAY_DEFAULT_SPEED;
+
+	while ( 'K' == oInput.peek() || 'T' == oInput.peek() )
+	{
+		std::getline( oInput, sLine );
+	}
+	std::streampos iSceneOffset = oInput.tellg();
+	a_roOutEntry.m_iSceneOffset = iSceneOffset;
+
+	// Two passes over the scenes, so they need not be kept in memory:
+	// the first counts them, the second reads the sampled ones.
+
+	int iNumScenes = 0;
+	while ( std::getline( oInput, sLine ) )
+	{
+		if ( sLine.size() )
+		{
+			++iNumScenes;
+		}
+	}
+	if ( 0 == iNumScenes )
+	{
+		return false;
+	}
+
+	a_roOutEntry.m_iTicks = iNumScenes;
+	a_roOutEntry.m_iSeconds = iNumScenes * a_roOutEntry.m_iGameSpeed / 1000;
+
+	oInput.clear();
+	oInput.seekg( iSceneOffset );
+
+	int aiHitPoints[2] = { 0, 0 };
+	int iScene = 0;
+	int iSample = 0;
+	while ( iSample < REPLAY_HP_SAMPLES && std::getline( oInput, sLine ) )
+	{
+		if ( 0 == sLine.size() )
+		{
+			continue;
+		}
+		// Consecutive samples may be the same scene in a short replay.
+		while ( iSample < REPLAY_HP_SAMPLES
+			&& iSample * (iNumScenes-1) / (REPLAY_HP_SAMPLES-1) == iScene )
+		{
+			sscanf( sLine.c_str(), "%d %d %d %d %d %d %d %d %d %d",
+				&iDummy, &iDummy, &iDummy, &iDummy, &iDummy, &aiHitPoints[0],
+				&iDummy, &iDummy, &iDummy, &aiHitPoints[1] );
+			a_roOutEntry.m_aaiHitPoints[0][iSample] = MAX( 0, MIN( 100, aiHitPoints[0] ) );
+			a_roOutEntry.m_aaiHitPoints[1][iSample] = MAX( 0, MIN( 100, aiHitPoints[1] ) );
+			++iSample;
+		}
+		++iScene;
+	}
+
+	a_roOutEntry.m_iWinner = aiHitPoints[0] > aiHitPoints[1] ? 0 :
+		( aiHitPoints[1] > aiHitPoints[0] ? 1 : -1 );
+
+	struct stat oStat;
+	a_roOutEntry.m_iDate = ( 0 == stat( a_pcFilename, &oStat ) ) ? oStat.st_mtime : time( NULL );
+
+	return true;
+}
+
+
+/** Drops the entries whose replay file was deleted.
+
+\return true if any entries were dropped, and the index must be written.
+*/
+bool CReplayLibrary::PruneMissing()
+{
+	std::string sDirectory = GetReplayDirectory() + "/";
+	unsigned int iKept = 0;
+	for ( unsigned int i=0; i<m_aoEntries.size(); ++i )
+	{
+		struct stat oStat;
+		if ( 0 == stat( ( sDirectory + m_aoEntries[i].m_acFilename ).c_str(), &oStat ) )
+		{
+			m_aoEntries[iKept++] = m_aoEntries[i];
+		}
+	}
+
+	bool bPruned = iKept < m_aoEntries.size();
+	if ( bPruned )
+	{
+		debug( "CReplayLibrary: %d replays were deleted.\n", (int) ( m_aoEntries.size() - iKept ) );
+		m_aoEntries.resize( iKept );
+	}
+	return bPruned;
+}
+
+
+/** Deletes the oldest replay files, so that at most a_iKeep remain.
+
+\return true if any were deleted, and the index must be written.
+*/
+bool CReplayLibrary::PruneOldest( int a_iKeep )
+{
+	int iNumDeleted = (int) m_aoEntries.size() - a_iKeep;
+	if ( iNumDeleted <= 0 )
+	{
+		return false;
+	}
+
+	std::stable_sort( m_aoEntries.begin(), m_aoEntries.end(), CompareEntryDates );
+	std::string sDirectory = GetReplayDirectory() + "/";
+	for ( int i=0; i<iNumDeleted; ++i )
+	{
+		remove( ( sDirectory + m_aoEntries[i].m_acFilename ).c_str() );
+	}
+	m_aoEntries.erase( m_aoEntries.begin(), m_aoEntries.begin() + iNumDeleted );
+	return true;
+}
+
+
+bool CReplayLibrary::WriteIndex()
+{
+	std::string sIndexFile = GetReplayDirectory() + "/" REPLAY_INDEX_FILE;
+	FILE* poFile = fopen( sIndexFile.c_str(), "wb" );
+	if ( NULL == poFile )
+	{
+		return false;
+	}
+
+	SReplayIndexHeader oHeader;
+	FillIndexHeader( oHeader );
+	fwrite( &oHeader, sizeof(oHeader), 1, poFile );
+	if ( m_aoEntries.size() )
+	{
+		fwrite( &m_aoEntries[0], sizeof(SReplayIndexEntry), m_aoEntries.size(), poFile );
+	}
+	fclose( poFile );
+	return true;
+}
+
+
+bool CReplayLibrary::AppendToIndex( const SReplayIndexEntry& a_roEntry )
+{
+	std::string sIndexFile = GetReplayDirectory() + "/" REPLAY_INDEX_FILE;
+	FILE* poFile = fopen( sIndexFile.c_str(), "rb" );
+	if ( NULL == poFile )
+	{
+		// No index yet; write the whole thing, header and all.
+		return WriteIndex();
+	}
+	fclose( poFile );
+
+	poFile = fopen( sIndexFile.c_str(), "ab" );
+	if ( NULL == poFile )
+	{
+		return false;
+	}
+	bool bOk = 1 == fwrite( &a_roEntry, sizeof(a_roEntry), 1, poFile );
+	fclose( poFile );
+	return bOk;
+}
+
+
+
+
+/***************************************************************************
+                     CReplayBrowser CLASS
+***************************************************************************/
+
+
+#define BROWSER_ROWS		14
+#define BROWSER_ROW_HEIGHT	24
+#define BROWSER_TOP			100
+
+
+/**
+\ingroup GameLogic
+The replay browser lists the replays in the replay library. The list can
+be filtered by fighter; filtering only uses the index, so it is instant
+even with thousands of replays. The selected replay can be played back.
+*/
+class CReplayBrowser
+{
+public:
+	CReplayBrowser();
+	void Run();
+
+protected:
+	void UpdateFilter();
+	void Draw();
+	void DrawEntry( int a_iRow, const SReplayIndexEntry& a_roEntry, bool a_bSelected );
+	const char* GetFighterName( int a_iFighter );
+
+protected:
+	std::vector<int>			m_aiFighters;		///< The fighter filter values, -1 means all.
+	int							m_iFighterFilter;	///< Index into m_aiFighters.
+	bool						m_bOnlyWins;
+	std::vector<int>			m_aiVisible;		///< Library indexes of the listed replays.
+	int							m_iSelected;
+	int							m_iTop;
+	std::map<int,std::string>	m_asFighterNames;
+};
+
+
+CReplayBrowser::CReplayBrowser()
+{
+	g_oReplayLibrary.Load();
+
+	m_aiFighters.push_back( -1 );
+	int iNumFighters = g_oBackend.GetNumberOfFighters();
+	for ( int i=0; i<iNumFighters; ++i )
+	{
+		m_aiFighters.push_back( g_oBackend.GetFighterID(i) );
+	}
+
+	m_iFighterFilter = 0;
+	m_bOnlyWins = false;
+	m_iSelected = m_iTop = 0;
+	UpdateFilter();
+}
+
+
+const char* CReplayBrowser::GetFighterName( int a_iFighter )
+{
+	std::map<int,std::string>::iterator it = m_asFighterNames.find( a_iFighter );
+	if ( it != m_asFighterNames.end() )
+	{
+		return it->second.c_str();
+	}
+
+	g_oBackend.PerlEvalF( "GetFighterStats(%d);", a_iFighter );
+	std::string& rsName = m_asFighterNames[a_iFighter];
+	rsName = g_oBackend.GetPerlString( "Name" );
+	return rsName.c_str();
+}
+
+
+void CReplayBrowser::UpdateFilter()
+{
+	g_oReplayLibrary.Filter( m_aiFighters[m_iFighterFilter], m_bOnlyWins, m_aiVisible );
+	m_iSelected = m_iTop = 0;
+}
+
+
+void CReplayBrowser::DrawEntry( int a_iRow, const SReplayIndexEntry& a_roEntry, bool a_bSelected )
+{
+	int iY = BROWSER_TOP + a_iRow * BROWSER_ROW_HEIGHT;
+	if ( a_bSelected )
+	{
+		sge_FilledRect( gamescreen, 10, iY, gamescreen->w - 10, iY + BROWSER_ROW_HEIGHT - 2, C_BLUE );
+	}
+
+	char acBuffer[128];
+	time_t iDate = a_roEntry.m_iDate;
+	strftime( acBuffer, sizeof(acBuffer), "%Y-%m-%d %H:%M", localtime( &iDate ) );
+	DrawTextMSZ( acBuffer, chatFont, 20, iY, 0, C_LIGHTGRAY, gamescreen, false );
+
+	int iX = 180;
+	for ( int i=0; i<2; ++i )
+	{
+		if ( i )
+		{
+			iX += DrawTextMSZ( " vs ", chatFont, iX, iY, 0, C_LIGHTGRAY, gamescreen );
+		}
+		iX += DrawTextMSZ( GetFighterName( a_roEntry.m_aiFighters[i] ), chatFont, iX, iY, 0,
+			a_roEntry.m_iWinner == i ? C_YELLOW : C_WHITE, gamescreen, false );
+	}
+
+	sprintf( acBuffer, "%d:%02d", a_roEntry.m_iSeconds / 60, a_roEntry.m_iSeconds % 60 );
+	DrawTextMSZ( acBuffer, chatFont, 440, iY, 0, C_LIGHTGRAY, gamescreen, false );
+
+	// The hit point timeline: player 1 on top, player 2 below.
+
+	for ( int i=0; i<REPLAY_HP_SAMPLES; ++i )
+	{
+		int iBarX = 490 + i * 8;
+		int iHp1 = a_roEntry.m_aaiHitPoints[0][i] * 10 / 100;
+		int iHp2 = a_roEntry.m_aaiHitPoints[1][i] * 10 / 100;
+		if ( iHp1 ) sge_FilledRect( gamescreen, iBarX, iY + 11 - iHp1, iBarX + 6, iY + 10, C_LIGHTGREEN );
+		if ( iHp2 ) sge_FilledRect( gamescreen, iBarX, iY + 12, iBarX + 6, iY + 11 + iHp2, C_LIGHTRED );
+	}
+}
+
+
+void CReplayBrowser::Draw()
+{
+	SDL_FillRect( gamescreen, NULL, C_BLACK );
+	DrawGradientText( "Replays", titleFont, 10, gamescreen );
+
+	int iFighter = m_aiFighters[m_iFighterFilter];
+	char acBuffer[256];
+	sprintf( acBuffer, "%s: %s%s   (%d/%d)", Translate("Fighter"),
+		iFighter < 0 ? Translate("All") : GetFighterName( iFighter ),
+		iFighter >= 0 && m_bOnlyWins ? Translate(", only wins") : "",
+		(int) m_aiVisible.size(), g_oReplayLibrary.GetNumberOfReplays() );
+	DrawTextMSZ( acBuffer, impactFont, 20, 65, 0, C_WHITE, gamescreen, false );
+
+	for ( int i=0; i<BROWSER_ROWS && m_iTop + i < (int) m_aiVisible.size(); ++i )
+	{
+		DrawEntry( i, g_oReplayLibrary.GetReplay( m_aiVisible[m_iTop+i] ), m_iTop + i == m_iSelected );
+	}
+
+	if ( m_aiVisible.size() == 0 )
+	{
+		DrawTextMSZ( "No replays.", impactFont, 320, 200, AlignHCenter, C_LIGHTGRAY, gamescreen );
+	}
+
+	DrawTextMSZ( "Left/Right: fighter, W: only wins, Enter: play, Esc: back",
+		chatFont, 320, 450, AlignHCenter, C_LIGHTGRAY, gamescreen );
+
+	SDL_Flip( gamescreen );
+}
+
+
+void CReplayBrowser::Run()
+{
+	while ( 1 )
+	{
+		Draw();
+
+		SDLKey enKey = GetKey( true );
+		if ( g_oState.m_bQuitFlag || SDLK_ESCAPE == enKey )
+		{
+			break;
+		}
+
+		int iNumVisible = m_aiVisible.size();
+		switch ( enKey )
+		{
+			case SDLK_UP:		--m_iSelected; break;
+			case SDLK_DOWN:		++m_iSelected; break;
+			case SDLK_PAGEUP:	m_iSelected -= BROWSER_ROWS; break;
+			case SDLK_PAGEDOWN:	m_iSelected += BROWSER_ROWS; break;
+			case SDLK_HOME:		m_iSelected = 0; break;
+			case SDLK_END:		m_iSelected = iNumVisible - 1; break;
+
+			case SDLK_LEFT:
+				m_iFighterFilter = ( m_iFighterFilter + m_aiFighters.size() - 1 ) % m_aiFighters.size();
+				UpdateFilter();
+				break;
+
+			case SDLK_RIGHT:
+				m_iFighterFilter = ( m_iFighterFilter + 1 ) % m_aiFighters.size();
+				UpdateFilter();
+				break;
+
+			case SDLK_w:
+				m_bOnlyWins = !m_bOnlyWins;
+				UpdateFilter();
+				break;
+
+			case SDLK_RETURN:
+				if ( m_iSelected < iNumVisible )
+				{
+					std::string sPath = g_oReplayLibrary.GetReplayPath( m_aiVisible[m_iSelected] );
+					DoGame( (char*) sPath.c_str(), true, false );
+				}
+				break;
+
+			default:
+				break;
+		}
+
+		iNumVisible = m_aiVisible.size();
+		if ( m_iSelected >= iNumVisible ) m_iSelected = iNumVisible - 1;
+		if ( m_iSelected < 0 ) m_iSelected = 0;
+		if ( m_iSelected < m_iTop ) m_iTop = m_iSelected;
+		if ( m_iSelected >= m_iTop + BROWSER_ROWS ) m_iTop = m_iSelected - BROWSER_ROWS + 1;
+	}
+}
+
+
+/** Runs the replay browser until the user leaves it. */
+void DoReplayBrowser()
+{
+	CReplayBrowser oBrowser;
+	oBrowser.Run();
+}
@@ -0,0 +1,105 @@
+/***************************************************************************
+                          ReplayLibrary.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef REPLAYLIBRARY_H
+#define REPLAYLIBRARY_H
+
+
+#include "SDL_types.h"
+#include <string>
+#include <vector>
+
+
+#define REPLAY_HP_SAMPLES 16
+#define REPLAY_MAXREPLAYS 500		///< The oldest replays are deleted beyond this.
+
+
+/**
+\ingroup GameLogic
+One replay in the replay index. The entries have a fixed size, so the
+index file is simply a header followed by an array of these.
+
+A replay file only holds the last round of the game, so the ticks, the
+length and the hit point timeline are of that round. The winner is the
+result of the whole game, as passed to CReplayLibrary::AddReplay(); when
+the index is rebuilt it can only be guessed from the end of the last
+round.
+*/
+struct SReplayIndexEntry
+{
+	char	m_acFilename[32];	///< Name of the replay file within the replay directory.
+	Uint32	m_iDate;			///< Time of recording (time_t).
+	Uint32	m_iTicks;			///< Length of the round in game ticks.
+	Uint32	m_iSceneOffset;		///< File offset of the first scene line.
+	Uint16	m_iSeconds;			///< Length of the round in seconds.
+	Uint16	m_iGameSpeed;		///< Milliseconds per game tick.
+	Sint16	m_aiFighters[2];	///< FighterEnum of the two players.
+	Sint8	m_iWinner;			///< 0 or 1, or -1 for a draw; of the whole game.
+	Uint8	m_aaiHitPoints[2][REPLAY_HP_SAMPLES];	///< Hit point timeline (0-100) of the last round.
+};
+
+
+/**
+\ingroup GameLogic
+\brief The collection of recorded replays.
+
+The replay library keeps every replay file in a single directory, along
+with a compact index file (replays.idx). The index contains all the
+information needed for browsing and filtering replays, so the replay files
+themselves need not be opened until one is actually played.
+
+The index is updated incrementally: AddReplay() appends a single entry.
+The index is only rebuilt by scanning the replay files if it is missing or
+was written by an incompatible version. When the index is loaded, the
+entries of deleted replay files are dropped from it.
+
+At most REPLAY_MAXREPLAYS replays are kept; AddReplay() deletes the
+oldest files beyond that. Other files kept in the replay directory (like
+the captures of CGameCapture) are limited with PruneFiles().
+*/
+
+class CReplayLibrary
+{
+public:
+	CReplayLibrary();
+	~CReplayLibrary();
+
+	bool				Load();
+	void				Rebuild();
+	std::string			GetNewReplayFilename( const char* a_pcExtension = ".replay" );
+	bool				AddReplay( const char* a_pcFilename, int a_iWinner );
+	void				PruneFiles( const char* a_pcExtension, int a_iKeep );
+
+	int					GetNumberOfReplays() const;
+	const SReplayIndexEntry& GetReplay( int a_iIndex ) const;
+	std::string			GetReplayPath( int a_iIndex ) const;
+	void				Filter( int a_iFighter, bool a_bOnlyWins, std::vector<int>& a_raiOutIndexes ) const;
+
+	static std::string	GetReplayDirectory();
+
+protected:
+	bool				ReadEntry( const char* a_pcFilename, SReplayIndexEntry& a_roOutEntry );
+	bool				PruneMissing();
+	bool				PruneOldest( int a_iKeep );
+	bool				WriteIndex();
+	bool				AppendToIndex( const SReplayIndexEntry& a_roEntry );
+
+protected:
+	bool				m_bLoaded;
+	std::vector<SReplayIndexEntry>	m_aoEntries;
+};
+
+
+extern CReplayLibrary g_oReplayLibrary;
+
+
+void DoReplayBrowser();
+
+
+#endif // REPLAYLIBRARY_H
@@ -15,6 +15,7 @@
 #include "SDL.h"
 #include "gfx.h"
 #include "common.h"
+#include "DataArchive.h"
 
 
 /// Sanity: This is the maximal number of entries in a .DAT file.
@@ -96,6 +97,7 @@ struct RlePack_P
 	int				m_iArraysize;
 	RLE_SPRITE**	m_pSprites;
 	void*			m_pData;
+	int				m_iDataSize;
 	
 	int				m_iColorCount;
 	int				m_iColorOffset;
@@ -121,6 +123,7 @@ RlePack::RlePack( const char* a_pcFilename, int a_iNumColors )
 	p->m_iArraysize = 0;
 	p->m_pSprites = NULL;
 	p->m_pData = NULL;
+	p->m_iDataSize = 0;
 	
 	p->m_iColorCount = 0;
 	p->m_iColorOffset = 0;
@@ -160,35 +163,27 @@ void RlePack::Clear()
 
 int RlePack::LoadFile( const char* a_pcFilename, int a_iNumColors )
 {
-	FILE* f;
-	
-	f = fopen( a_pcFilename, "rb" );
-	if (f==NULL)
+	CDataFile oFile;
+	if ( !oFile.Open( a_pcFilename ) )
 	{
 		debug( "Can't open file '%s'.\n", a_pcFilename );
 		return -1;
 	}
 	
-	fseek( f, 0, SEEK_END );
-	long iFileSize = ftell ( f );
+	// The sprites are converted in place, so the data is copied even if
+	// it is in the mapped archive.
+	long iFileSize = oFile.GetSize();
 	p->m_pData = malloc( iFileSize );
 	if ( NULL == p->m_pData )
 	{
-		fclose( f );
 		return -1;
 	}
-	
-	fseek( f, 0, SEEK_SET );
-	int iRead = fread( p->m_pData, 1, iFileSize, f );
-	fclose( f );
+	memcpy( p->m_pData, oFile.GetData(), iFileSize );
+	p->m_iDataSize = iFileSize;
+	oFile.Close();
 	
 	p->m_iColorCount = a_iNumColors;
 	
-	if ( iFileSize != iRead )
-	{
-		debug( "Warning RlePack(): iFileSize=%d, iRead=%d\n", iFileSize, iRead );
-	}
-	
 	struct SHeader
 	{
 		char	acDummy[8];
@@ -381,6 +376,13 @@ int RlePack::Count()
 }
 
 
+/** Returns the number of bytes the sprites take up in memory. */
+int RlePack::GetMemorySize()
+{
+	return p->m_iDataSize + p->m_iArraysize * sizeof(RLE_SPRITE*);
+}
+
+
 /** Worker method of RlePack::OffsetSprites() .*/
 
 void OffsetRLESprite( RLE_SPRITE* spr, int offset ) // Static method
@@ -423,13 +425,17 @@ you might load an RlePack with 16 colors, and another with 64 colors. You
 can offset the second RlePack by 16 colors; the total effect is that the
 two RlePacks now use 80 colors of the available 256 colors, the first using
 colors 0-15, the second using colors 16-79.
+
+The offset is absolute: calling OffsetSprites(0) moves the sprites back to
+their original colors, so the RlePack can be reused with another offset.
 */
 
 void RlePack::OffsetSprites( int a_iOffset )
 {
-	if ( (a_iOffset<=0) || (a_iOffset>255) || (8!=gamescreen->format->BitsPerPixel) )
+	if ( (a_iOffset<0) || (a_iOffset>255) || (8!=gamescreen->format->BitsPerPixel) )
 		return;
 
+	int iDelta = a_iOffset - p->m_iColorOffset;
 	p->m_iColorOffset = a_iOffset;
 
 	int i;
@@ -438,7 +444,7 @@ void RlePack::OffsetSprites( int a_iOffset )
 	
 	for ( i=0; i<p->m_iCount; ++i )
 	{
-		OffsetRLESprite( p->m_pSprites[i], a_iOffset );
+		OffsetRLESprite( p->m_pSprites[i], iDelta );
 	}
 }
 
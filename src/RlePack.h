@@ -56,6 +56,7 @@ public:
 	void		Clear();
 	int			LoadFile( const char* a_pcFilename, int a_iNumColors );	
 	int			Count();
+	int			GetMemorySize();
 	void		OffsetSprites( int a_iOffset );
 	void		SetTint( TintEnum a_enTint );
 	void		ApplyPalette();
@@ -0,0 +1,94 @@
+/***************************************************************************
+                          SpscQueue.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#define SPSC_BARRIER() MemoryBarrier()
+#else
+#define SPSC_BARRIER() __sync_synchronize()
+#endif
+
+
+/**
+\ingroup Media
+\brief Lock-free queue for exactly one producer and one consumer thread.
+
+The queue is a fixed size ring buffer of SIZE elements; SIZE must be a
+power of two. Push() never blocks: it fails if the queue is full, and the
+caller decides what to do with the element. Pop() fails if the queue is
+empty.
+
+Each index is only ever written by one of the threads (m_iHead by the
+producer, m_iTail by the consumer), so there is no need for locks; the
+barriers make sure the element itself is visible before the index that
+publishes it.
+*/
+
+template <class T, unsigned int SIZE>
+class CSpscQueue
+{
+public:
+	CSpscQueue()
+	{
+		m_iHead = m_iTail = 0;
+	}
+
+	/** Called by the producer thread only. */
+	bool Push( const T& a_roElement )
+	{
+		unsigned int iHead = m_iHead;
+		if ( iHead - m_iTail >= SIZE )
+		{
+			return false;
+		}
+		m_aoElements[ iHead & (SIZE-1) ] = a_roElement;
+		SPSC_BARRIER();
+		m_iHead = iHead + 1;
+		return true;
+	}
+
+	/** Called by the consumer thread only. */
+	bool Pop( T& a_roOutElement )
+	{
+		unsigned int iTail = m_iTail;
+		if ( iTail == m_iHead )
+		{
+			return false;
+		}
+		SPSC_BARRIER();
+		a_roOutElement = m_aoElements[ iTail & (SIZE-1) ];
+		SPSC_BARRIER();
+		m_iTail = iTail + 1;
+		return true;
+	}
+
+	/** Only a hint if called while the other thread is running. */
+	bool IsEmpty() const
+	{
+		return m_iHead == m_iTail;
+	}
+
+	/** Only valid if no thread is using the queue. */
+	void Reset()
+	{
+		m_iHead = m_iTail = 0;
+	}
+
+protected:
+	T						m_aoElements[SIZE];
+	volatile unsigned int	m_iHead;		///< Next element to write; written by the producer.
+	volatile unsigned int	m_iTail;		///< Next element to read; written by the consumer.
+};
+
+
+#endif // SPSCQUEUE_H
@@ -0,0 +1,316 @@
+/***************************************************************************
+                          Startup.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "Startup.h"
+#include "common.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include <stdio.h>
+
+
+
+/*************************************************************************
+                           STARTUP TASK
+*************************************************************************/
+
+
+CStartupTask::CStartupTask( const char* a_pcName, StartupFunction a_pfFunction, bool a_bWorkerThread )
+{
+	m_pcName = a_pcName;
+	m_pfFunction = a_pfFunction;
+	m_bWorkerThread = a_bWorkerThread;
+	m_bStarted = false;
+	m_bFinished = false;
+	m_bOk = false;
+	m_dStartNs = m_dEndNs = 0.0;
+	m_iThreadId = 0;
+}
+
+
+void CStartupTask::DependsOn( CStartupTask* a_poTask )
+{
+	m_apoDependencies.push_back( a_poTask );
+}
+
+
+/** Returns true if every task this depends on finished successfully. */
+bool CStartupTask::IsReady() const
+{
+	for ( unsigned int i=0; i<m_apoDependencies.size(); ++i )
+	{
+		if ( !m_apoDependencies[i]->m_bFinished
+			|| !m_apoDependencies[i]->m_bOk )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void CStartupTask::Run()
+{
+	m_dStartNs = GetNanoseconds();
+	m_iThreadId = SDL_ThreadID();
+	m_bOk = m_pfFunction();
+	m_dEndNs = GetNanoseconds();
+}
+
+
+
+/*************************************************************************
+                           STARTUP
+*************************************************************************/
+
+
+CStartup::CStartup()
+{
+	m_dStartNs = GetNanoseconds();
+	m_iMainThreadId = SDL_ThreadID();
+	m_bFailed = false;
+}
+
+
+CStartup::~CStartup()
+{
+	for ( unsigned int i=0; i<m_apoTasks.size(); ++i )
+	{
+		delete m_apoTasks[i];
+	}
+}
+
+
+/** Adds a step to the startup. Set up its dependencies with
+CStartupTask::DependsOn() before the next Run(). */
+
+CStartupTask* CStartup::Add( const char* a_pcName, StartupFunction a_pfFunction, bool a_bWorkerThread )
+{
+	CStartupTask* poTask = new CStartupTask( a_pcName, a_pfFunction, a_bWorkerThread );
+	m_apoTasks.push_back( poTask );
+	return poTask;
+}
+
+
+/** Runs the tasks that were not run yet, and returns when all of them are
+finished.
+\retval false if a task failed. The tasks that depend on it are not run. */
+
+bool CStartup::Run( StartupProgressFunction a_pfProgress, void* a_pvData )
+{
+	while ( !m_bFailed )
+	{
+		bool bChanged = CollectFinishedTasks();
+		if ( m_bFailed )
+		{
+			break;
+		}
+		bChanged = StartNextTask() || bChanged;
+		if ( m_bFailed )
+		{
+			break;
+		}
+
+		int iDone = 0, iRunning = 0;
+		for ( unsigned int i=0; i<m_apoTasks.size(); ++i )
+		{
+			if ( m_apoTasks[i]->m_bFinished ) ++iDone;
+			else if ( m_apoTasks[i]->m_bStarted ) ++iRunning;
+		}
+		if ( a_pfProgress )
+		{
+			a_pfProgress( a_pvData, iDone, m_apoTasks.size() );
+		}
+		if ( iDone == (int) m_apoTasks.size() )
+		{
+			return true;
+		}
+		if ( !bChanged && 0 == iRunning )
+		{
+			debug( "CStartup: the remaining tasks depend on each other.\n" );
+			m_bFailed = true;
+			break;
+		}
+		if ( !bChanged && !RunQueuedTask() )
+		{
+			// Only the workers are busy; keep the window responsive.
+			SDL_PumpEvents();
+			SDL_Delay( 5 );
+		}
+	}
+
+	Abort();
+	return false;
+}
+
+
+/** Queues every task that is ready to run on the worker threads, then runs
+the first ready main thread task. Without worker threads every task is
+run on the main thread, in the order they were added.
+\retval true if a task was started. */
+
+bool CStartup::StartNextTask()
+{
+	bool bStarted = false;
+	bool bQueue = g_oWorkerPool.GetNumThreads() > 0;
+	unsigned int i;
+
+	for ( i=0; bQueue && i<m_apoTasks.size(); ++i )
+	{
+		CStartupTask* poTask = m_apoTasks[i];
+		if ( poTask->m_bWorkerThread && !poTask->m_bStarted && poTask->IsReady() )
+		{
+			poTask->m_bStarted = true;
+			g_oWorkerPool.Add( poTask );
+			bStarted = true;
+		}
+	}
+
+	for ( i=0; i<m_apoTasks.size(); ++i )
+	{
+		CStartupTask* poTask = m_apoTasks[i];
+		if ( ( !bQueue || !poTask->m_bWorkerThread ) && !poTask->m_bStarted && poTask->IsReady() )
+		{
+			poTask->m_bStarted = true;
+			poTask->Run();
+			poTask->m_bFinished = true;
+			if ( !poTask->m_bOk )
+			{
+				debug( "CStartup: %s failed.\n", poTask->m_pcName );
+				m_bFailed = true;
+			}
+			return true;
+		}
+	}
+
+	return bStarted;
+}
+
+
+/** Runs a worker thread task on the main thread, if no worker has
+started it yet. The task that would be run last by the workers is taken.
+\retval true if a task was run. */
+
+bool CStartup::RunQueuedTask()
+{
+	for ( int i=m_apoTasks.size()-1; i>=0; --i )
+	{
+		CStartupTask* poTask = m_apoTasks[i];
+		if ( !poTask->m_bWorkerThread || !poTask->m_bStarted || poTask->m_bFinished
+			|| !g_oWorkerPool.Cancel( poTask, false ) )
+		{
+			continue;
+		}
+
+		poTask->Run();
+		poTask->m_bFinished = true;
+		if ( !poTask->m_bOk )
+		{
+			debug( "CStartup: %s failed.\n", poTask->m_pcName );
+			m_bFailed = true;
+		}
+		return true;
+	}
+	return false;
+}
+
+
+/** Marks the worker thread tasks that are done as finished.
+\retval true if a task was finished. */
+
+bool CStartup::CollectFinishedTasks()
+{
+	bool bCollected = false;
+
+	for ( unsigned int i=0; i<m_apoTasks.size(); ++i )
+	{
+		CStartupTask* poTask = m_apoTasks[i];
+		if ( !poTask->m_bWorkerThread || !poTask->m_bStarted
+			|| poTask->m_bFinished || !poTask->IsDone() )
+		{
+			continue;
+		}
+
+		// Wait() makes the results of the job visible to this thread.
+		g_oWorkerPool.Wait( poTask );
+		poTask->m_bFinished = true;
+		bCollected = true;
+		if ( !poTask->m_bOk )
+		{
+			debug( "CStartup: %s failed.\n", poTask->m_pcName );
+			m_bFailed = true;
+		}
+	}
+
+	return bCollected;
+}
+
+
+/** Takes the queued tasks back from the workers, and waits for the ones
+that are running. */
+
+void CStartup::Abort()
+{
+	// All the queued tasks are taken back first, so that the workers
+	// don't start them while the running ones are waited for.
+	for ( int iPass=0; iPass<2; ++iPass )
+	{
+		for ( unsigned int i=0; i<m_apoTasks.size(); ++i )
+		{
+			CStartupTask* poTask = m_apoTasks[i];
+			if ( !poTask->m_bWorkerThread || !poTask->m_bStarted || poTask->m_bFinished )
+			{
+				continue;
+			}
+			if ( g_oWorkerPool.Cancel( poTask, iPass > 0 ) )
+			{
+				poTask->m_bOk = false;
+				poTask->m_dStartNs = 0.0;
+				poTask->m_bFinished = true;
+			}
+			else if ( iPass > 0 )
+			{
+				poTask->m_bFinished = true;
+			}
+		}
+	}
+}
+
+
+void CStartup::Report() const
+{
+	double dEndNs = m_dStartNs;
+	double dSumNs = 0.0;
+
+	printf( "Startup times in ms, %d worker threads:\n", g_oWorkerPool.GetNumThreads() );
+	printf( "%-16s %-8s %10s %10s %10s\n", "phase", "thread", "start", "end", "duration" );
+	for ( unsigned int i=0; i<m_apoTasks.size(); ++i )
+	{
+		const CStartupTask* poTask = m_apoTasks[i];
+		if ( !poTask->m_bFinished || 0.0 == poTask->m_dStartNs )
+		{
+			printf( "%-16s %-8s %10s\n", poTask->m_pcName, "", "not run" );
+			continue;
+		}
+		printf( "%-16s %-8s %10.1f %10.1f %10.1f%s\n", poTask->m_pcName,
+			poTask->m_iThreadId == m_iMainThreadId ? "main" : "worker",
+			( poTask->m_dStartNs - m_dStartNs ) / 1e6,
+			( poTask->m_dEndNs - m_dStartNs ) / 1e6,
+			( poTask->m_dEndNs - poTask->m_dStartNs ) / 1e6,
+			poTask->m_bOk ? "" : " FAILED" );
+		dSumNs += poTask->m_dEndNs - poTask->m_dStartNs;
+		if ( poTask->m_dEndNs > dEndNs )
+		{
+			dEndNs = poTask->m_dEndNs;
+		}
+	}
+	printf( "Total: %.1f ms; the phases took %.1f ms together.\n",
+		( dEndNs - m_dStartNs ) / 1e6, dSumNs / 1e6 );
+}
@@ -0,0 +1,104 @@
+/***************************************************************************
+                          Startup.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+
+#include "WorkerPool.h"
+
+#include "SDL_types.h"
+
+#include <vector>
+
+
+/** A startup step. Returns false if the program can't run without it. */
+typedef bool (*StartupFunction)();
+
+/** Called on the main thread while the startup tasks are running. */
+typedef void (*StartupProgressFunction)( void* a_pvData, int a_iDone, int a_iTotal );
+
+
+/**
+\ingroup Media
+\brief One step of the program's startup, see CStartup.
+*/
+
+class CStartupTask: public CJob
+{
+public:
+	CStartupTask( const char* a_pcName, StartupFunction a_pfFunction, bool a_bWorkerThread );
+
+	void				DependsOn( CStartupTask* a_poTask );
+	bool				IsReady() const;
+	virtual void		Run();
+
+protected:
+	friend class CStartup;
+
+	const char*			m_pcName;
+	StartupFunction		m_pfFunction;
+	bool				m_bWorkerThread;	///< Run on CWorkerPool instead of the main thread.
+	std::vector<CStartupTask*>	m_apoDependencies;
+
+	bool				m_bStarted;
+	bool				m_bFinished;		///< Set on the main thread, after the job is done.
+	bool				m_bOk;
+	double				m_dStartNs;
+	double				m_dEndNs;
+	Uint32				m_iThreadId;		///< The thread that ran the task.
+};
+
+
+/**
+\ingroup Media
+\brief Runs the startup steps of the program in dependency order.
+
+The steps which don't touch the screen, the palette or the event queue
+are run on the worker threads, the rest on the main thread, each as soon
+as the steps it depends on are finished. The main thread calls the
+progress function between its own steps, so the splash screen can be
+updated while the workers are busy. When it has nothing else to do, it
+takes back a queued task that no worker has started yet, so a startup on
+few processors isn't slower than doing everything in sequence.
+
+The Perl interpreter can only be used by one thread at a time, so the
+steps that use the backend must depend on each other, and call
+Backend::AttachThread() first.
+
+Run() can be called more than once as new tasks are added; the tasks that
+were already run are skipped. Report() prints when each step started and
+ended, relative to the creation of the CStartup object.
+*/
+
+class CStartup
+{
+public:
+	CStartup();
+	~CStartup();
+
+	CStartupTask*		Add( const char* a_pcName, StartupFunction a_pfFunction, bool a_bWorkerThread );
+	bool				Run( StartupProgressFunction a_pfProgress = NULL, void* a_pvData = NULL );
+	void				Report() const;
+
+protected:
+	bool				StartNextTask();
+	bool				RunQueuedTask();
+	bool				CollectFinishedTasks();
+	void				Abort();
+
+protected:
+	std::vector<CStartupTask*>	m_apoTasks;
+	double				m_dStartNs;
+	Uint32				m_iMainThreadId;
+	bool				m_bFailed;
+};
+
+
+#endif // STARTUP_H
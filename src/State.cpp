@@ -83,6 +83,7 @@ SState::SState()
 	m_iGameTime = 60;
 	m_iHitPoints = 100;
 	m_iGameSpeed = 12;
+	m_iRenderFps = 0;
 
 	#if defined(_WIN32) || defined(WIN32) || defined(_WINDOWS)
 		#ifdef _DEBUG
@@ -106,6 +107,10 @@ SState::SState()
 	m_iMixingBits = 2;
 	m_iMusicVolume = 50;
 	m_iSoundVolume = 100;
+	m_iAudioBuffer = 512;
+	m_iAssetCacheSize = 32;
+	m_iFighterCacheSize = 64;
+	m_bProfileLog = false;
 
 	static const int aiDefaultKeys[MAXPLAYERS][9] = {
   		{ SDLK_UP, SDLK_DOWN, SDLK_LEFT, SDLK_RIGHT, SDLK_PAGEDOWN,
@@ -298,6 +303,7 @@ void SState::Load()
 	poSv = get_sv("GAMETIME", FALSE); if (poSv) m_iGameTime = SvIV( poSv );
 	poSv = get_sv("HITPOINTS", FALSE); if (poSv) m_iHitPoints = SvIV( poSv );
 	poSv = get_sv("GAMESPEED", FALSE); if (poSv) m_iGameSpeed = SvIV( poSv );
+	poSv = get_sv("RENDERFPS", FALSE); if (poSv) m_iRenderFps = SvIV( poSv );
 
 	poSv = get_sv("FULLSCREEN", FALSE); if (poSv) m_bFullscreen = SvIV( poSv );
 	poSv = get_sv("CHANNELS", FALSE); if (poSv) m_iChannels = SvIV( poSv );
@@ -305,6 +311,10 @@ void SState::Load()
 	poSv = get_sv("MIXINGBITS", FALSE); if (poSv) m_iMixingBits = SvIV( poSv );
 	poSv = get_sv("MUSICVOLUME", FALSE); if (poSv) m_iMusicVolume = SvIV( poSv );
 	poSv = get_sv("SOUNDVOLUME", FALSE); if (poSv) m_iSoundVolume = SvIV( poSv );
+	poSv = get_sv("AUDIOBUFFER", FALSE); if (poSv) m_iAudioBuffer = SvIV( poSv );
+	poSv = get_sv("ASSETCACHE", FALSE); if (poSv) m_iAssetCacheSize = SvIV( poSv );
+	poSv = get_sv("FIGHTERCACHE", FALSE); if (poSv) m_iFighterCacheSize = SvIV( poSv );
+	poSv = get_sv("PROFILELOG", FALSE); if (poSv) m_bProfileLog = SvIV( poSv );
 	poSv = get_sv("LANGUAGE", FALSE); if (poSv) { strncpy( m_acLanguage, SvPV_nolen( poSv ), 9 ); m_acLanguage[9] = 0; }
 
 	poSv = get_sv("LATESTSERVER", FALSE); if (poSv) { strncpy( m_acLatestServer, SvPV_nolen( poSv ), 255 ); m_acLatestServer[255] = 0; }
@@ -345,6 +355,7 @@ void SState::Save()
 	oStream << "GAMETIME=" << m_iGameTime << '\n';
 	oStream << "HITPOINTS=" << m_iHitPoints << '\n';
 	oStream << "GAMESPEED=" << m_iGameSpeed << '\n';
+	oStream << "RENDERFPS=" << m_iRenderFps << '\n';
 
 	oStream << "FULLSCREEN=" << m_bFullscreen << '\n';
 	oStream << "CHANNELS=" << m_iChannels << '\n';
@@ -352,6 +363,10 @@ void SState::Save()
 	oStream << "MIXINGBITS=" << m_iMixingBits << '\n';
 	oStream << "MUSICVOLUME=" << m_iMusicVolume << '\n';
 	oStream << "SOUNDVOLUME=" << m_iSoundVolume << '\n';
+	oStream << "AUDIOBUFFER=" << m_iAudioBuffer << '\n';
+	oStream << "ASSETCACHE=" << m_iAssetCacheSize << '\n';
+	oStream << "FIGHTERCACHE=" << m_iFighterCacheSize << '\n';
+	oStream << "PROFILELOG=" << m_bProfileLog << '\n';
 	oStream << "LANGUAGE=" << m_acLanguage << '\n';
 
 	oStream << "LATESTSERVER=" << m_acLatestServer << '\n';
@@ -69,6 +69,7 @@ struct SState
 	int		m_iGameTime;		// Time of rounds in seconds.
 	int		m_iHitPoints;		// The initial number of hit points.
 	int		m_iGameSpeed;		// The speed of the game (fps = 1000/GameSpeed)
+	int		m_iRenderFps;		// Frames drawn per second during a fight, interpolated; 0: one per game tick
 	
 	bool	m_bFullscreen;		// True in fullscreen mode.
 	
@@ -77,6 +78,10 @@ struct SState
 	int		m_iMixingBits;		// 1: 8bit, 2: 16bit
 	int		m_iMusicVolume;		// Volume of music; 0: off, 100: max
 	int		m_iSoundVolume;		// Volume of sound effects; 0: off, 100: max
+	int		m_iAudioBuffer;		// Size of the audio buffer in sample frames (latency)
+	int		m_iAssetCacheSize;	// Memory budget of the image cache, in megabytes
+	int		m_iFighterCacheSize;	// Memory budget of the fighter cache, in megabytes
+	bool	m_bProfileLog;		// Write the frame times of the games to a CSV file, see CProfiler
 	
 	int		m_aiPlayerKeys[MAXPLAYERS][9];	// Player keysyms
 	char	m_acLanguage[10];	// Language ID (en,hu,fr,es,..)
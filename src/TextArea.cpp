@@ -14,6 +14,7 @@
 #include "common.h"
 
 #include <ctype.h>
+#include <stdlib.h>
 
 
 CTextArea::CTextArea( SDL_Surface* a_poScreen, _sge_TTFont* a_poFont, int a_x, int a_y, int a_w, int a_h )
@@ -21,6 +22,7 @@ CTextArea::CTextArea( SDL_Surface* a_poScreen, _sge_TTFont* a_poFont, int a_x, i
 	m_poScreen = a_poScreen;
 	m_poFont = a_poFont;
 	m_iScrollOffset = 0;
+	m_iRowHeight = sge_TTF_FontHeight( m_poFont );
 
 	m_oClipRect.x = x = a_x;
 	m_oClipRect.y = y = a_y;
@@ -28,11 +30,24 @@ CTextArea::CTextArea( SDL_Surface* a_poScreen, _sge_TTFont* a_poFont, int a_x, i
 	m_oClipRect.h = h = a_h;
 	
 	m_poBackground = sge_copy_surface( a_poScreen, x, y, w, h );
+	
+	// Build the advance table for wrapping
+	
+	for ( int i=0; i<256; ++i )
+	{
+		int iAdvance = 0;
+		if ( sge_TTF_GlyphMetrics( m_poFont, i, NULL, NULL, NULL, NULL, &iAdvance ) )
+		{
+			iAdvance = 0;
+		}
+		m_aiAdvance[i] = iAdvance;
+	}
 }
 
 
 CTextArea::~CTextArea()
 {
+	Clear();
 	SDL_FreeSurface( m_poBackground );
 	m_poBackground = NULL;
 }
@@ -40,8 +55,11 @@ CTextArea::~CTextArea()
 
 void CTextArea::Clear()
 {
-	m_aiRowColors.clear();
-	m_asRowTexts.clear();
+	for ( TRowDeque::iterator it = m_aoRows.begin(); it != m_aoRows.end(); ++it )
+	{
+		FreeRow( *it );
+	}
+	m_aoRows.clear();
 	m_iScrollOffset = 0;
 }
 
@@ -62,56 +80,63 @@ void CTextArea::AddString( const char* a_poText, int a_iColor )
 	{
 		// 1. FORMAT THE TEXT SO IT FITS US NICELY
 		
-		SDL_Rect oRect;
-		int i, j;
+		int i, j = 0;
+		int iWidth = 0;
 		
 		for ( i=0; a_poText[i]; ++i )
 		{
-			oRect = sge_TTF_TextSize( m_poFont, a_poText, i );
-			if ( oRect.w > w )
+			iWidth += m_aiAdvance[ (unsigned char) a_poText[i] ];
+			if ( iWidth > w && i > 0 )
 			{
-				if ( i>0 )--i;
 				break;
 			}
+			if ( isspace( (unsigned char) a_poText[i] ) )
+			{
+				j = i;		// The last space BEFORE the first character that doesn't fit
+			}
 		}
 		
 		// i now points to the character AFTER the last good character.
-		//if ( a_poText[i] && i>1 ) --i;
+		// Break at the last space before it, if there is one.
 		
-		// Trace back to the first space BEFORE i
-		if ( a_poText[i] )
+		if ( a_poText[i] && j>0 )
 		{
-			for ( j = i; j>0; --j )
-			{
-				if ( isspace( a_poText[j] ) )
-				{
-					break;
-				}
-			}
-			if ( j>0 )
-			{
-				i = j;
-			}
+			i = j;
 		}
 		
 		// 2. ADD IT.
 		
-		m_asRowTexts.push_front( std::string(a_poText,i) );
-		m_aiRowColors.push_front( a_iColor );
+		SRow oRow;
+		oRow.m_sText.assign( a_poText, i );
+		oRow.m_iColor = a_iColor;
+		oRow.m_poSurface = NULL;
+		m_aoRows.push_front( oRow );
+		
+		if ( m_aoRows.size() > TEXTAREA_MAXROWS )
+		{
+			FreeRow( m_aoRows.back() );
+			m_aoRows.pop_back();
+		}
+		
 		if ( m_iScrollOffset > 0 )
 		{
 			++m_iScrollOffset;
 		}
 		
 		a_poText += i;
-		debug( "Added '%s', number of texts is %d\n", m_asRowTexts.front().c_str(), m_asRowTexts.size() );
+	}
+	
+	int iMaxOffset = (int) m_aoRows.size() - h / m_iRowHeight;
+	if ( m_iScrollOffset > iMaxOffset )
+	{
+		m_iScrollOffset = iMaxOffset > 0 ? iMaxOffset : 0;
 	}
 }
 
 
 void CTextArea::ScrollUp()
 {
-	if ( m_iScrollOffset < (int) m_asRowTexts.size() - h / sge_TTF_FontHeight(m_poFont) )
+	if ( m_iScrollOffset < (int) m_aoRows.size() - h / m_iRowHeight )
 	{
 		++m_iScrollOffset;
 		Redraw();
@@ -129,48 +154,87 @@ void CTextArea::ScrollDown()
 }
 
 
-void CTextArea::Redraw()
+/** Renders the text of the row into its own surface, unless it is
+already rendered. The surface is colorkeyed on the antialiasing
+background, and is converted to the display format for fast blitting.
+
+\return The surface of the row, or NULL if the row is empty.
+*/
+SDL_Surface* CTextArea::RenderRow( SRow& a_roRow )
 {
-	TStringList::const_iterator itString = m_asRowTexts.begin();
-	TIntList::const_iterator itColors = m_aiRowColors.begin();
+	if ( a_roRow.m_poSurface || a_roRow.m_sText.size() == 0 )
+	{
+		return a_roRow.m_poSurface;
+	}
+	
+	Uint16* puText = sge_Latin1_Uni( a_roRow.m_sText.c_str() );
+	if ( NULL == puText )
+	{
+		return NULL;
+	}
+	
+	SDL_Color oBlack = sge_GetRGB( m_poScreen, C_BLACK );
+	sge_TTF_AAOn();
+	SDL_Surface* poText = sge_TTF_RenderUNICODE( m_poFont, puText, sge_GetRGB( m_poScreen, a_roRow.m_iColor ), oBlack );
+	sge_TTF_AAOff();
+	free( puText );
+	
+	if ( NULL == poText )
+	{
+		return NULL;
+	}
+	
+	SDL_SetColorKey( poText, SDL_SRCCOLORKEY | SDL_RLEACCEL, SDL_MapRGB( poText->format, oBlack.r, oBlack.g, oBlack.b ) );
+	a_roRow.m_poSurface = SDL_DisplayFormat( poText );
+	if ( a_roRow.m_poSurface )
+	{
+		SDL_FreeSurface( poText );
+	}
+	else
+	{
+		a_roRow.m_poSurface = poText;
+	}
+	
+	return a_roRow.m_poSurface;
+}
+
 
-	for ( int i=0; i<m_iScrollOffset; ++i )
+void CTextArea::FreeRow( SRow& a_roRow )
+{
+	if ( a_roRow.m_poSurface )
 	{
-		++itString;
-		++itColors;
+		SDL_FreeSurface( a_roRow.m_poSurface );
+		a_roRow.m_poSurface = NULL;
 	}
+}
 
+
+void CTextArea::Redraw()
+{
 	SDL_Rect oOldClipRect;
 	SDL_GetClipRect( m_poScreen, &oOldClipRect );
 	SDL_SetClipRect( m_poScreen, &m_oClipRect );
-	sge_TTF_AAOn();
 	
 	sge_Blit( m_poBackground, m_poScreen, 0, 0, x, y, w, h );
 
-	int iRows = h / sge_TTF_FontHeight( m_poFont );
-	int yPos = y + (iRows-1) * sge_TTF_FontHeight( m_poFont );
+	int iRows = h / m_iRowHeight;
+	int yPos = y + (iRows-1) * m_iRowHeight;
+	int iRow = m_iScrollOffset;
 	
-	for ( ; yPos >= y; yPos -= sge_TTF_FontHeight( m_poFont ) )
+	for ( ; yPos >= y && iRow < (int) m_aoRows.size(); yPos -= m_iRowHeight, ++iRow )
 	{
-		if ( itColors == m_aiRowColors.end() )
+		SDL_Surface* poText = RenderRow( m_aoRows[iRow] );
+		if ( NULL == poText )
 		{
-			break;
+			continue;
 		}
-
-		// Print the current text
-		sge_tt_textout( m_poScreen, m_poFont, itString->c_str(), x, yPos + sge_TTF_FontAscent(m_poFont), *itColors, C_BLACK, 255 );
-		++itString;
-		++itColors;
+		
+		SDL_Rect oDest;
+		oDest.x = x;
+		oDest.y = yPos;
+		SDL_BlitSurface( poText, NULL, m_poScreen, &oDest );
 	}
 	
 	sge_UpdateRect( m_poScreen, x, y, w, h );
 	SDL_SetClipRect( m_poScreen, &oOldClipRect );
-	sge_TTF_AAOff();
 }
-
-/*
-int CTextArea::RenderLine( SDL_Surface* a_poScreen, const char* a_poText, int a_iLength, int a_iColor )
-{
-}
-*/
-
@@ -16,15 +16,23 @@ struct SDL_Surface;
 struct _sge_TTFont;
 
 #include <string>
-#include <list>
+#include <deque>
 
 
-typedef std::list<std::string> TStringList;
-typedef std::list<int> TIntList;
+/** The text area forgets its oldest rows above this number. */
+#define TEXTAREA_MAXROWS 256
+
 
 /**
 \brief CTextArea displays scrolling text.
 \ingroup Media
+
+Incoming text is wrapped in a single pass, using a table of the glyph
+advances of the font, which is built when the text area is created.
+
+Each wrapped row is rendered through the font only once, into a surface
+of its own, the first time it becomes visible. Redrawing and scrolling
+only blit these surfaces over the saved background.
 */
 
 class CTextArea
@@ -40,6 +48,18 @@ public:
 	void ScrollUp();
 	void ScrollDown();
 	
+protected:
+	struct SRow
+	{
+		std::string		m_sText;
+		int				m_iColor;
+		SDL_Surface*	m_poSurface;		///< The rendered text, or NULL if not rendered yet.
+	};
+	typedef std::deque<SRow> TRowDeque;
+	
+	SDL_Surface*		RenderRow( SRow& a_roRow );
+	void				FreeRow( SRow& a_roRow );
+	
 protected:
 	SDL_Surface*		m_poScreen;
 	SDL_Surface*		m_poBackground;
@@ -48,8 +68,9 @@ protected:
 	int					x, y, w, h;
 	
 	int					m_iScrollOffset;
-	TStringList			m_asRowTexts;
-	TIntList			m_aiRowColors;
+	int					m_iRowHeight;
+	int					m_aiAdvance[256];	///< The advance of each Latin-1 glyph.
+	TRowDeque			m_aoRows;			///< The newest row is the first.
 };
 
 
@@ -0,0 +1,252 @@
+/***************************************************************************
+                          Tracer.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "Tracer.h"
+#include "SpscQueue.h"
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+
+#if defined(_MSC_VER)
+#define TRACER_THREADLOCAL		__declspec(thread)
+#define TRACER_TAKESLOT(P)		( InterlockedIncrement( (volatile LONG*) (P) ) - 1 )
+#else
+#define TRACER_THREADLOCAL		__thread
+#define TRACER_TAKESLOT(P)		__sync_fetch_and_add( (P), 1 )
+#endif
+
+
+CTracer g_oTracer;
+
+
+struct STraceEvent
+{
+	double					m_dNs;
+	const char*				m_pcName;
+	char					m_cPhase;		///< 'B'egin, 'E'nd or 'i'nstant
+};
+
+
+/** The events of one thread. */
+struct STraceBuffer
+{
+	const char*				m_pcThreadName;
+	STraceEvent				m_aoEvents[TRACER_BUFFERSIZE];
+	volatile unsigned int	m_iHead;		///< Events written so far; written by the thread.
+};
+
+
+static TRACER_THREADLOCAL STraceBuffer*	g_poThreadBuffer = NULL;
+static TRACER_THREADLOCAL const char*	g_pcThreadName = NULL;
+static TRACER_THREADLOCAL bool			g_bNoBuffer = false;		///< All buffers were taken.
+
+
+
+CTracer::CTracer()
+{
+	m_bEnabled = false;
+	m_dStartNs = 0.0;
+	m_poBuffers = NULL;
+	m_iNumBuffers = 0;
+}
+
+
+CTracer::~CTracer()
+{
+	// The buffers are not freed: a thread may still be recording.
+}
+
+
+/** Starts recording. Call it from the main thread. */
+
+void CTracer::Enable()
+{
+	if ( m_bEnabled )
+	{
+		return;
+	}
+	m_poBuffers = new STraceBuffer[TRACER_MAXTHREADS];
+	for ( int i=0; i<TRACER_MAXTHREADS; ++i )
+	{
+		m_poBuffers[i].m_pcThreadName = NULL;
+		m_poBuffers[i].m_iHead = 0;
+	}
+	m_dStartNs = GetNanoseconds();
+	SPSC_BARRIER();
+	m_bEnabled = true;
+}
+
+
+/** Names the calling thread in the trace. Cheap, so threads can call it
+whenever they run, even before tracing is enabled. */
+
+void CTracer::SetThreadName( const char* a_pcName )
+{
+	g_pcThreadName = a_pcName;
+	if ( g_poThreadBuffer )
+	{
+		g_poThreadBuffer->m_pcThreadName = a_pcName;
+	}
+}
+
+
+STraceBuffer* CTracer::GetThreadBuffer()
+{
+	if ( g_poThreadBuffer || g_bNoBuffer )
+	{
+		return g_poThreadBuffer;
+	}
+
+	int iSlot = TRACER_TAKESLOT( &m_iNumBuffers );
+	if ( iSlot >= TRACER_MAXTHREADS )
+	{
+		g_bNoBuffer = true;
+		return NULL;
+	}
+	g_poThreadBuffer = &m_poBuffers[iSlot];
+	g_poThreadBuffer->m_pcThreadName = g_pcThreadName;
+	return g_poThreadBuffer;
+}
+
+
+void CTracer::Add( char a_cPhase, const char* a_pcName )
+{
+	STraceBuffer* poBuffer = GetThreadBuffer();
+	if ( NULL == poBuffer )
+	{
+		return;
+	}
+
+	unsigned int iHead = poBuffer->m_iHead;
+	STraceEvent& roEvent = poBuffer->m_aoEvents[ iHead & (TRACER_BUFFERSIZE-1) ];
+	roEvent.m_dNs = GetNanoseconds();
+	roEvent.m_pcName = a_pcName;
+	roEvent.m_cPhase = a_cPhase;
+	SPSC_BARRIER();
+	poBuffer->m_iHead = iHead + 1;
+}
+
+
+
+/*************************************************************************
+                           TRACE FILE
+*************************************************************************/
+
+
+/** Returns the name of a new trace file, with the time of the call in it. */
+
+std::string CTracer::GetTraceFilename()
+{
+	char acTime[32];
+	time_t iNow = time( NULL );
+	strftime( acTime, sizeof(acTime), "%Y%m%d-%H%M%S", localtime( &iNow ) );
+
+#if defined(_WIN32) || defined(WIN32) || defined(_WINDOWS)
+	return std::string( "trace-" ) + acTime + ".json";
+#else
+	return std::string( getenv("HOME") ) + "/.openmortal-trace-" + acTime + ".json";
+#endif
+}
+
+
+bool CTracer::Write()
+{
+	return Write( GetTraceFilename().c_str() );
+}
+
+
+/** Writes the events recorded so far in the trace event format. Each
+thread is a "tid" of the same process. End events whose begin event was
+already overwritten are left out. */
+
+bool CTracer::Write( const char* a_pcFilename )
+{
+	if ( !m_bEnabled )
+	{
+		return false;
+	}
+
+	FILE* poFile = fopen( a_pcFilename, "w" );
+	if ( NULL == poFile )
+	{
+		debug( "Can't create the trace %s\n", a_pcFilename );
+		return false;
+	}
+
+	fprintf( poFile, "{\"traceEvents\":[\n" );
+	const char* pcSeparator = "";
+	int iNumEvents = 0;
+
+	int iNumBuffers = MIN( (int) m_iNumBuffers, TRACER_MAXTHREADS );
+	std::vector<STraceEvent> aoEvents;
+	aoEvents.reserve( TRACER_BUFFERSIZE );
+
+	for ( int iThread=0; iThread<iNumBuffers; ++iThread )
+	{
+		STraceBuffer& roBuffer = m_poBuffers[iThread];
+
+		// 1. COPY THE EVENTS, THEN DROP THOSE OVERWRITTEN MEANWHILE
+
+		unsigned int iHead = roBuffer.m_iHead;
+		SPSC_BARRIER();
+		unsigned int iFirst = iHead > TRACER_BUFFERSIZE ? iHead - TRACER_BUFFERSIZE : 0;
+		aoEvents.clear();
+		unsigned int i;
+		for ( i=iFirst; i<iHead; ++i )
+		{
+			aoEvents.push_back( roBuffer.m_aoEvents[ i & (TRACER_BUFFERSIZE-1) ] );
+		}
+		SPSC_BARRIER();
+		unsigned int iNewHead = roBuffer.m_iHead;
+		unsigned int iValidFrom = iNewHead > TRACER_BUFFERSIZE ? iNewHead - TRACER_BUFFERSIZE : 0;
+		unsigned int iSkip = iValidFrom > iFirst ? MIN( iValidFrom - iFirst, iHead - iFirst ) : 0;
+
+		// 2. WRITE THEM
+
+		const char* pcThreadName = roBuffer.m_pcThreadName ? roBuffer.m_pcThreadName : "thread";
+		fprintf( poFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			pcSeparator, iThread, pcThreadName );
+		pcSeparator = ",\n";
+
+		int iDepth = 0;
+		for ( i=iSkip; i<aoEvents.size(); ++i )
+		{
+			const STraceEvent& roEvent = aoEvents[i];
+			if ( 'E' == roEvent.m_cPhase )
+			{
+				if ( 0 == iDepth ) continue;
+				--iDepth;
+			}
+			else if ( 'B' == roEvent.m_cPhase )
+			{
+				++iDepth;
+			}
+
+			fprintf( poFile, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s}",
+				pcSeparator, roEvent.m_pcName, roEvent.m_cPhase,
+				( roEvent.m_dNs - m_dStartNs ) / 1e3, iThread,
+				'i' == roEvent.m_cPhase ? ",\"s\":\"t\"" : "" );
+			++iNumEvents;
+		}
+	}
+
+	fprintf( poFile, "\n]}\n" );
+	if ( ferror( poFile ) | fclose( poFile ) )
+	{
+		debug( "Error writing the trace %s\n", a_pcFilename );
+		return false;
+	}
+
+	debug( "Trace of %d events in %d threads written to %s\n", iNumEvents, iNumBuffers, a_pcFilename );
+	return true;
+}
@@ -0,0 +1,100 @@
+/***************************************************************************
+                          Tracer.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+
+#include <string>
+
+
+#define TRACER_MAXTHREADS	16			///< Threads after these are not traced.
+#define TRACER_BUFFERSIZE	16384		///< Events kept per thread; a power of two.
+
+
+struct STraceBuffer;
+
+
+/**
+\ingroup Media
+\brief Records begin, end and instant events of every thread, for a
+timeline in the Chrome trace viewer (chrome://tracing or Perfetto).
+
+Tracing is off unless the game is started with -trace; then every call
+costs a check of a flag. Enable() allocates a ring buffer for each
+thread up front. A thread takes the next free one with an atomic
+increment the first time it records an event, so recording never locks
+and never allocates, even in the audio callback. Each buffer is written
+only by its own thread, and keeps the last TRACER_BUFFERSIZE events.
+
+Write() (F11 in the game) saves the events of every thread as trace event
+JSON. It can run while the other threads are recording: it drops the
+events which were overwritten while it was copying them.
+
+The event names are not copied, so they must be string literals.
+*/
+
+class CTracer
+{
+public:
+	CTracer();
+	~CTracer();
+
+	void				Enable();
+	bool				IsEnabled() const { return m_bEnabled; }
+	void				SetThreadName( const char* a_pcName );
+
+	void				Begin( const char* a_pcName ) { if ( m_bEnabled ) Add( 'B', a_pcName ); }
+	void				End( const char* a_pcName ) { if ( m_bEnabled ) Add( 'E', a_pcName ); }
+	void				Instant( const char* a_pcName ) { if ( m_bEnabled ) Add( 'i', a_pcName ); }
+
+	bool				Write( const char* a_pcFilename );
+	bool				Write();
+	static std::string	GetTraceFilename();
+
+protected:
+	void				Add( char a_cPhase, const char* a_pcName );
+	STraceBuffer*		GetThreadBuffer();
+
+protected:
+	volatile bool		m_bEnabled;
+	double				m_dStartNs;
+	STraceBuffer*		m_poBuffers;				///< TRACER_MAXTHREADS of them.
+	volatile int		m_iNumBuffers;				///< Taken by threads so far (can be more than TRACER_MAXTHREADS).
+};
+
+extern CTracer g_oTracer;
+
+
+/**
+\ingroup Media
+\brief Records a begin event at construction, and an end event at
+destruction.
+*/
+
+class CTraceScope
+{
+public:
+	CTraceScope( const char* a_pcName )
+	{
+		m_pcName = a_pcName;
+		g_oTracer.Begin( a_pcName );
+	}
+
+	~CTraceScope()
+	{
+		g_oTracer.End( m_pcName );
+	}
+
+protected:
+	const char*			m_pcName;
+};
+
+
+#endif // TRACER_H
@@ -0,0 +1,281 @@
+/***************************************************************************
+                          WorkerPool.cpp  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#include "WorkerPool.h"
+#include "common.h"
+#include "Tracer.h"
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+CWorkerPool g_oWorkerPool;
+
+
+
+/*************************************************************************
+                           JOB
+*************************************************************************/
+
+
+CJob::CJob()
+{
+	m_bDone = false;
+	m_bQueued = false;
+}
+
+
+CJob::~CJob()
+{
+}
+
+
+bool CJob::IsDone() const
+{
+	return m_bDone;
+}
+
+
+
+/*************************************************************************
+                           WORKER POOL
+*************************************************************************/
+
+
+CWorkerPool::CWorkerPool()
+{
+	m_poLock = NULL;
+	m_poJobAdded = NULL;
+	m_poJobDone = NULL;
+	m_bQuit = false;
+}
+
+
+CWorkerPool::~CWorkerPool()
+{
+	Shutdown();
+}
+
+
+/** Starts the worker threads. By default, one less than the number of
+processors, so that the game thread keeps a processor to itself.
+\retval false if no thread could be started; the jobs will be run by the
+caller then. */
+
+bool CWorkerPool::Start( int a_iNumThreads )
+{
+	if ( m_apoThreads.size() )
+	{
+		return true;
+	}
+
+	if ( a_iNumThreads <= 0 )
+	{
+		int iNumProcessors = 2;
+#if !defined(_WIN32) && defined(_SC_NPROCESSORS_ONLN)
+		iNumProcessors = sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+		a_iNumThreads = iNumProcessors - 1;
+	}
+	a_iNumThreads = std::max( 1, std::min( a_iNumThreads, WORKERPOOL_MAXTHREADS ) );
+
+	m_poLock = SDL_CreateMutex();
+	m_poJobAdded = SDL_CreateCond();
+	m_poJobDone = SDL_CreateCond();
+	if ( NULL == m_poLock || NULL == m_poJobAdded || NULL == m_poJobDone )
+	{
+		Shutdown();
+		return false;
+	}
+
+	m_bQuit = false;
+	for ( int i=0; i<a_iNumThreads; ++i )
+	{
+		SDL_Thread* poThread = SDL_CreateThread( WorkerThread, this );
+		if ( NULL == poThread )
+		{
+			break;
+		}
+		m_apoThreads.push_back( poThread );
+	}
+
+	debug( "CWorkerPool: %d worker threads.\n", (int) m_apoThreads.size() );
+	if ( m_apoThreads.empty() )
+	{
+		Shutdown();
+		return false;
+	}
+	return true;
+}
+
+
+/** Stops the worker threads after their current job. The jobs still in
+the queue are run by Wait(). */
+
+void CWorkerPool::Shutdown()
+{
+	if ( m_apoThreads.size() )
+	{
+		SDL_mutexP( m_poLock );
+		m_bQuit = true;
+		SDL_CondBroadcast( m_poJobAdded );
+		SDL_mutexV( m_poLock );
+
+		for ( unsigned int i=0; i<m_apoThreads.size(); ++i )
+		{
+			SDL_WaitThread( m_apoThreads[i], NULL );
+		}
+		m_apoThreads.clear();
+	}
+
+	for ( unsigned int i=0; i<m_apoQueue.size(); ++i )
+	{
+		m_apoQueue[i]->m_bQueued = false;
+	}
+	m_apoQueue.clear();
+
+	if ( m_poJobDone ) SDL_DestroyCond( m_poJobDone );
+	if ( m_poJobAdded ) SDL_DestroyCond( m_poJobAdded );
+	if ( m_poLock ) SDL_DestroyMutex( m_poLock );
+	m_poJobDone = m_poJobAdded = NULL;
+	m_poLock = NULL;
+}
+
+
+int CWorkerPool::GetNumThreads() const
+{
+	return m_apoThreads.size();
+}
+
+
+void CWorkerPool::Add( CJob* a_poJob )
+{
+	a_poJob->m_bDone = false;
+
+	if ( m_apoThreads.empty() )
+	{
+		a_poJob->Run();
+		a_poJob->m_bDone = true;
+		return;
+	}
+
+	SDL_mutexP( m_poLock );
+	a_poJob->m_bQueued = true;
+	m_apoQueue.push_back( a_poJob );
+	SDL_CondSignal( m_poJobAdded );
+	SDL_mutexV( m_poLock );
+}
+
+
+/** Returns when the job is done. If no worker has started the job yet, it
+is taken out of the queue and run on the calling thread. */
+
+void CWorkerPool::Wait( CJob* a_poJob )
+{
+	if ( NULL == m_poLock )
+	{
+		if ( !a_poJob->m_bDone )
+		{
+			a_poJob->Run();
+			a_poJob->m_bDone = true;
+		}
+		return;
+	}
+
+	SDL_mutexP( m_poLock );
+	if ( a_poJob->m_bQueued )
+	{
+		m_apoQueue.erase( std::find( m_apoQueue.begin(), m_apoQueue.end(), a_poJob ) );
+		a_poJob->m_bQueued = false;
+		SDL_mutexV( m_poLock );
+
+		a_poJob->Run();
+		a_poJob->m_bDone = true;
+		return;
+	}
+	while ( !a_poJob->m_bDone )
+	{
+		SDL_CondWait( m_poJobDone, m_poLock );
+	}
+	SDL_mutexV( m_poLock );
+}
+
+
+/** Takes the job out of the queue if no worker has started it yet.
+Otherwise waits until it is done, or returns right away if a_bWait is
+false.
+\retval true if the job was cancelled, and never run. */
+
+bool CWorkerPool::Cancel( CJob* a_poJob, bool a_bWait )
+{
+	if ( NULL == m_poLock )
+	{
+		return !a_poJob->m_bDone;
+	}
+
+	SDL_mutexP( m_poLock );
+	bool bCancelled = a_poJob->m_bQueued;
+	if ( bCancelled )
+	{
+		m_apoQueue.erase( std::find( m_apoQueue.begin(), m_apoQueue.end(), a_poJob ) );
+		a_poJob->m_bQueued = false;
+	}
+	while ( a_bWait && !bCancelled && !a_poJob->m_bDone )
+	{
+		SDL_CondWait( m_poJobDone, m_poLock );
+	}
+	SDL_mutexV( m_poLock );
+	return bCancelled;
+}
+
+
+int CWorkerPool::WorkerThread( void* a_pvPool )
+{
+	((CWorkerPool*)a_pvPool)->RunWorker();
+	return 0;
+}
+
+
+void CWorkerPool::RunWorker()
+{
+	g_oTracer.SetThreadName( "worker" );
+	SDL_mutexP( m_poLock );
+	while ( true )
+	{
+		while ( m_apoQueue.empty() && !m_bQuit )
+		{
+			SDL_CondWait( m_poJobAdded, m_poLock );
+		}
+		if ( m_bQuit )
+		{
+			break;
+		}
+
+		CJob* poJob = m_apoQueue.front();
+		m_apoQueue.pop_front();
+		poJob->m_bQueued = false;
+		SDL_mutexV( m_poLock );
+
+		{
+			CTraceScope oTrace( "Job" );
+			poJob->Run();
+		}
+
+		SDL_mutexP( m_poLock );
+		poJob->m_bDone = true;
+		SDL_CondBroadcast( m_poJobDone );
+	}
+	SDL_mutexV( m_poLock );
+}
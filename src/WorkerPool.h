@@ -0,0 +1,96 @@
+/***************************************************************************
+                          WorkerPool.h  -  description
+                             -------------------
+    begin                : Sat Oct 17 2026
+    copyright            : (C) 2026 by upi
+    email                : upi@apocalypse.rulez.org
+ ***************************************************************************/
+
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+
+#include <deque>
+#include <vector>
+
+
+#define WORKERPOOL_MAXTHREADS	4
+
+
+struct SDL_Thread;
+struct SDL_mutex;
+struct SDL_cond;
+
+
+/**
+\ingroup Media
+\brief A piece of work for CWorkerPool.
+
+Run() is called on a worker thread, so it must not touch the screen, the
+event queue or the Perl backend. The results are picked up by the thread
+that added the job, after CWorkerPool::Wait().
+*/
+
+class CJob
+{
+public:
+	CJob();
+	virtual ~CJob();
+
+	virtual void		Run() = 0;
+	bool				IsDone() const;
+
+private:
+	friend class CWorkerPool;
+	volatile bool		m_bDone;
+	bool				m_bQueued;
+};
+
+
+/**
+\ingroup Media
+\brief Runs CJob objects on a few background threads.
+
+The jobs are run in the order they were added. The pool doesn't own the
+jobs; a job must not be deleted before Wait() returned for it.
+
+If the pool wasn't started (or couldn't start any threads), Add() runs the
+job right away, so the callers don't need a separate code path. Wait()
+also runs the job itself if no worker picked it up yet, so waiting for a
+job that is at the end of the queue doesn't leave the calling thread idle.
+Cancel() is for the results that are no longer needed.
+*/
+
+class CWorkerPool
+{
+public:
+	CWorkerPool();
+	~CWorkerPool();
+
+	bool				Start( int a_iNumThreads = 0 );
+	void				Shutdown();
+	int					GetNumThreads() const;
+
+	void				Add( CJob* a_poJob );
+	void				Wait( CJob* a_poJob );
+	bool				Cancel( CJob* a_poJob, bool a_bWait = true );
+
+protected:
+	static int			WorkerThread( void* a_pvPool );
+	void				RunWorker();
+
+protected:
+	std::vector<SDL_Thread*>	m_apoThreads;
+	std::deque<CJob*>	m_apoQueue;
+	SDL_mutex*			m_poLock;
+	SDL_cond*			m_poJobAdded;		///< Signalled when a job is queued, or on Shutdown().
+	SDL_cond*			m_poJobDone;		///< Broadcast when a job is finished.
+	bool				m_bQuit;
+};
+
+
+extern CWorkerPool g_oWorkerPool;
+
+
+#endif // WORKERPOOL_H
@@ -8,12 +8,18 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <time.h>
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
 
 #include "common.h"
 #include "State.h"
 #include "Joystick.h"
 #include "SDL.h"
 #include "Event.h"
+#include "Profiler.h"
+#include "Tracer.h"
 
 
 SDL_Surface* gamescreen = NULL;
@@ -27,6 +33,24 @@ void debug( const char* format, ... )
 }
 
 
+/** Returns a monotonic time in nanoseconds, for measuring short
+intervals. Falls back to gettimeofday, or to SDL_GetTicks on Windows. */
+double GetNanoseconds()
+{
+#if defined(CLOCK_MONOTONIC) && !defined(_WIN32)
+	struct timespec oTime;
+	clock_gettime( CLOCK_MONOTONIC, &oTime );
+	return oTime.tv_sec * 1e9 + oTime.tv_nsec;
+#elif !defined(_WIN32)
+	struct timeval oTime;
+	gettimeofday( &oTime, NULL );
+	return oTime.tv_sec * 1e9 + oTime.tv_usec * 1e3;
+#else
+	return SDL_GetTicks() * 1e6;
+#endif
+}
+
+
 
 bool FindPlayerKey( SDLKey a_enKey, int& a_riOutPlayer, int& a_riOutKey )
 {
@@ -62,6 +86,8 @@ or false if it couldn't (a_poOutEvent will be set to Me_NOTHING).
 bool TranslateEvent( const SDL_Event* a_poInEvent, SMortalEvent* a_poOutEvent )
 {
 	a_poOutEvent->m_enType = Me_NOTHING;
+	// SDL 1.2 events have no timestamp; reading them is the earliest we know of them.
+	a_poOutEvent->m_dNs = GetNanoseconds();
 	
 	switch ( a_poInEvent->type )
 	{
@@ -83,6 +109,18 @@ bool TranslateEvent( const SDL_Event* a_poInEvent, SMortalEvent* a_poOutEvent )
 			a_poOutEvent->m_enType = Me_SKIP;
 			return true;
 		}
+		if ( enKey == SDLK_F11 )
+		{
+			// Saves the trace, if the game was started with -trace.
+			g_oTracer.Write();
+			return false;
+		}
+		if ( enKey == SDLK_F12 )
+		{
+			// Not a game event; the profiler overlay is drawn by the game.
+			g_oProfiler.ToggleOverlay();
+			return false;
+		}
 		
 		// Check the player keys
 		int iPlayer;
@@ -19,6 +19,7 @@ struct SDL_Surface;
 
 
 void debug( const char* format, ... );
+double GetNanoseconds();
 #ifndef ABS
 #define ABS(A) ( (A>=0) ? (A) : -(A) )
 #endif
@@ -38,6 +39,14 @@ void GameOver( int a_iPlayerWon );
 void DoDemos();
 int  DoGame( char* replay, bool isReplay, bool bDebug );
 void DoOnlineChat();
+void SetMortalNetServer( const char* a_pcServer );
+int  DoReplayCheck( const char* a_pcDirectory, int a_iNumJobs );
+int  DoBatchMatches( int a_iNumMatches, const char* a_pcFighters, const char* a_pcInputScript,
+	unsigned int a_iSeed, int a_iNumJobs, double a_dMaxAllocationsPerTick );
+int  DoMixerBenchmark();
+int  DoAudioTest();
+int  DoPacerBenchmark();
+int  DoEngineBenchmark();
 
 // -----------------------------------------------------------------------
 // Other subroutines
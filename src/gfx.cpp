@@ -21,6 +21,7 @@
 #endif
 #ifndef  _GFX_H
 #include "gfx.h"
+#include "DataArchive.h"
 #endif
 #include "State.h"
 #include "Event.h"
@@ -176,6 +177,81 @@ int DrawTextMSZ( const char* string, _sge_TTFont* font, int x, int y, int flags,
 
 
 
+CCachedText::CCachedText()
+{
+	m_poFont = NULL;
+	m_iColor = 0;
+	m_iColorKey = 0;
+	m_poSurface = NULL;
+}
+
+
+CCachedText::~CCachedText()
+{
+	Clear();
+}
+
+
+void CCachedText::Clear()
+{
+	if ( m_poSurface )
+	{
+		SDL_FreeSurface( m_poSurface );
+		m_poSurface = NULL;
+	}
+	m_sText = "";
+}
+
+
+/** Draws the text the same way as DrawTextMSZ() would; it is only rendered
+again if the text, the font or the color is different from the last call. */
+
+int CCachedText::Draw( const char* a_pcText, _sge_TTFont* a_poFont, int a_iX, int a_iY,
+	int a_iFlags, int a_iColor, SDL_Surface* a_poTarget )
+{
+	if ( NULL == m_poSurface
+		|| a_poFont != m_poFont
+		|| a_iColor != m_iColor
+		|| m_sText != a_pcText )
+	{
+		Clear();
+		if ( !a_pcText || !*a_pcText )
+		{
+			return 0;
+		}
+
+#ifdef MSZ_USES_UTF8
+		Uint16* puText = sge_UTF8_Uni( a_pcText );
+#else
+		Uint16* puText = sge_Latin1_Uni( a_pcText );
+#endif
+		SDL_Color oBackground = sge_GetRGB( a_poTarget, C_BLACK );
+		sge_TTF_AAOn();
+		m_poSurface = sge_TTF_RenderUNICODE( a_poFont, puText, sge_GetRGB( a_poTarget, a_iColor ), oBackground );
+		sge_TTF_AAOff();
+		free( puText );
+		if ( NULL == m_poSurface )
+		{
+			return 0;
+		}
+
+		m_sText = a_pcText;
+		m_poFont = a_poFont;
+		m_iColor = a_iColor;
+		m_iColorKey = SDL_MapRGB( m_poSurface->format, oBackground.r, oBackground.g, oBackground.b );
+	}
+
+	int x = a_iFlags & AlignHCenter ? a_iX - m_poSurface->w / 2 : a_iX;
+	int y = a_iFlags & AlignVCenter ? a_iY - m_poSurface->h / 2 : a_iY;
+
+	CSurfaceLocker oLock;
+	sge_BlitTransparent( m_poSurface, a_poTarget, 0, 0, x, y, m_poSurface->w, m_poSurface->h, m_iColorKey, 255 );
+	sge_UpdateRect( a_poTarget, x, y, m_poSurface->w, m_poSurface->h );
+	return m_poSurface->w;
+}
+
+
+
 void DrawGradientText( const char* text, _sge_TTFont* font, int y, SDL_Surface* target, bool a_bTranslate )
 {
 	int i, j;
@@ -339,65 +415,115 @@ SDLKey GetKey( bool a_bTranslate )
 
 SDL_Surface* LoadBackground( const char* a_pcFilename, int a_iNumColors, int a_iPaletteOffset, bool a_bTransparent )
 {
+	SDL_Surface* poMask;
+	SDL_Surface* poBackground = DecodeBackground( a_pcFilename, &poMask );
+	if ( !poBackground )
+	{
+		return NULL;
+	}
+	
+	return ConvertBackground( poBackground, poMask, a_iNumColors, a_iPaletteOffset );
+}
+
+
+/** Loads a background image from the gfx directory, and its mask.
+
+The mask is a .png file which acts as a mask for the original [jpg]
+image. If the original file is <Basename>.jpg, the mask is
+<Basename>.mask.png. a_ppoOutMask is set to NULL if there is no usable
+mask.
+
+This only decodes the files, so it can be called from any thread.
+*/
+
+SDL_Surface* DecodeBackground( const char* a_pcFilename, SDL_Surface** a_ppoOutMask )
+{
+	*a_ppoOutMask = NULL;
+	
 	char acFilepath[FILENAME_MAX+1];
 	strcpy( acFilepath, DATADIR );
 	strcat( acFilepath, "/gfx/" );
 	strcat( acFilepath, a_pcFilename );
 
-	SDL_Surface* poBackground = IMG_Load( acFilepath );
+	SDL_Surface* poBackground = LoadDataImage( acFilepath );
 	if (!poBackground)
 	{
 		debug( "Can't load file: %s\n", acFilepath );
 		return NULL;
 	}
 	
-	SDL_Palette* pal = poBackground->format->palette;
-	if ( pal && gamescreen->format->palette )
-	{
-		int ncolors = pal->ncolors;
-		if (ncolors>a_iNumColors) ncolors = a_iNumColors;
-		if (ncolors+a_iPaletteOffset > 255) ncolors = 255 - a_iPaletteOffset;
-		SDL_SetColors( gamescreen, pal->colors, a_iPaletteOffset, ncolors );
-	}
-		
-	SDL_Surface* poRetval = SDL_DisplayFormat( poBackground );
-	SDL_FreeSurface( poBackground );
-	
-	// 2. TRY TO LOAD AN IMAGE MASK
-	// This means trying to load a .png file which acts as a mask for the
-	// original [jpg] image.
-	// If the original file is <Basename>.jpg, the mask is <Basename>.mask.png
-	
 	int iLength = strlen( acFilepath );
 	char acMaskFilename[FILENAME_MAX+1];
 	strncpy( acMaskFilename, acFilepath, iLength-4 );
 	acMaskFilename[iLength-4] = 0;
 	strcat( acMaskFilename, ".mask.png" );
 	
-	SDL_Surface* poMask = IMG_Load( acMaskFilename );
+	SDL_Surface* poMask = LoadDataImage( acMaskFilename );
 	if ( !poMask )
 	{
 		// No mask.
-		return poRetval;
+		return poBackground;
 	}
 	
-	if ( poMask->w < poRetval->w
-		|| poMask->h < poRetval->h )
+	if ( poMask->w < poBackground->w
+		|| poMask->h < poBackground->h )
 	{
 		debug( "Error loading mask for %s: mask is too small.\n", acFilepath );
 		SDL_FreeSurface( poMask );
-		return poRetval;
+		return poBackground;
 	}
 	
 	debug( "Loading mask for %s.\n", acFilepath );
+	*a_ppoOutMask = poMask;
+	return poBackground;
+}
+
+
+/** Converts a background returned by DecodeBackground() to the format of
+the screen, and makes the pixels under the mask transparent. The image
+and the mask are freed.
+
+On a palettized screen this sets the colors of the screen, so it must be
+called on the main thread then. Otherwise it can be called from a worker
+thread with a_poFormat set to a copy of the screen's format, taken on the
+main thread: this makes a software surface in that format instead of
+calling SDL_DisplayFormat(), and doesn't touch the screen, whose format
+is freed if the video mode changes meanwhile.
+*/
+
+SDL_Surface* ConvertBackground( SDL_Surface* a_poBackground, SDL_Surface* a_poMask, int a_iNumColors, int a_iPaletteOffset, const SDL_PixelFormat* a_poFormat )
+{
+	SDL_Palette* pal = a_poBackground->format->palette;
+	if ( NULL == a_poFormat && pal && gamescreen->format->palette )
+	{
+		int ncolors = pal->ncolors;
+		if (ncolors>a_iNumColors) ncolors = a_iNumColors;
+		if (ncolors+a_iPaletteOffset > 255) ncolors = 255 - a_iPaletteOffset;
+		SDL_SetColors( gamescreen, pal->colors, a_iPaletteOffset, ncolors );
+	}
+		
+	SDL_Surface* poRetval = a_poFormat
+		? SDL_ConvertSurface( a_poBackground, (SDL_PixelFormat*) a_poFormat, SDL_SWSURFACE )
+		: SDL_DisplayFormat( a_poBackground );
+	SDL_FreeSurface( a_poBackground );
+	
+	if ( !a_poMask )
+	{
+		return poRetval;
+	}
+	if ( !poRetval )
+	{
+		SDL_FreeSurface( a_poMask );
+		return NULL;
+	}
 	
-	Uint32 iTransparent = SDL_MapRGB( gamescreen->format, 255, 217, 0 ); // an unlikely color in openmortal..
-	Uint32 iMask = sge_GetPixel( poMask, 0, 0 );
+	Uint32 iTransparent = SDL_MapRGB( poRetval->format, 255, 217, 0 ); // an unlikely color in openmortal..
+	Uint32 iMask = sge_GetPixel( a_poMask, 0, 0 );
 	Uint32 iPixel;
 	
 	for ( int y = 0; y < poRetval->h; ++y ) {
 		for ( int x=0; x< poRetval->w; ++x ) {
-			iPixel = sge_GetPixel( poMask, x, y );
+			iPixel = sge_GetPixel( a_poMask, x, y );
 //			debug( "%d ", iPixel );
 			if ( iPixel == iMask ) { 
 				sge_PutPixel( poRetval, x, y, iTransparent );
@@ -406,7 +532,7 @@ SDL_Surface* LoadBackground( const char* a_pcFilename, int a_iNumColors, int a_i
 //		debug( "\n" );
 	}
 	
-	SDL_FreeSurface( poMask );
+	SDL_FreeSurface( a_poMask );
 	
 	SDL_SetColorKey( poRetval, SDL_SRCCOLORKEY, iTransparent );
 	
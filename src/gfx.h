@@ -20,6 +20,8 @@ struct _sge_TTFont;
 
 #include "SDL.h"
 
+#include <string>
+
 enum GFX_Constants {
 	AlignHCenter	= 1,
 	AlignVCenter	= 2,
@@ -39,6 +41,8 @@ SDL_Color		MakeColor( Uint8 r, Uint8 g, Uint8 b );
 SDLKey			GetKey( bool a_bTranslate );
 
 SDL_Surface*	LoadBackground( const char* a_pcFilename, int a_iNumColors, int a_iPaletteOffset=0, bool a_bTransparent = false );
+SDL_Surface*	DecodeBackground( const char* a_pcFilename, SDL_Surface** a_ppoOutMask );
+SDL_Surface*	ConvertBackground( SDL_Surface* a_poBackground, SDL_Surface* a_poMask, int a_iNumColors, int a_iPaletteOffset=0, const SDL_PixelFormat* a_poFormat=NULL );
 SDL_Surface*	LoadImage( const char* a_pcFilename );
 
 bool			SetVideoMode( bool a_bLarge, bool a_bFullscreen, int a_iAdditionalFlags=0 );
@@ -76,6 +80,34 @@ protected:
 	static int m_giLockCount;
 };
 
+/**
+\ingroup Media
+\brief Draws a text like DrawTextMSZ(), but keeps the rendered text until
+it changes.
+
+DrawTextMSZ() renders the text into a new surface every time it is
+called. This is fine for menus, but the game draws some texts (e.g. the
+time left of the round) in every frame, and these rarely change. The
+text is not translated, and UseTilde and UseShadow are not supported.
+*/
+class CCachedText
+{
+public:
+	CCachedText();
+	~CCachedText();
+
+	int				Draw( const char* a_pcText, _sge_TTFont* a_poFont, int a_iX, int a_iY,
+						int a_iFlags, int a_iColor, SDL_Surface* a_poTarget );
+	void			Clear();
+
+protected:
+	std::string		m_sText;
+	_sge_TTFont*	m_poFont;
+	int				m_iColor;
+	Uint32			m_iColorKey;
+	SDL_Surface*	m_poSurface;
+};
+
 extern _sge_TTFont* titleFont;		// Largest font, for titles
 extern _sge_TTFont* inkFont;		// Medium-size front, headings
 extern _sge_TTFont* impactFont;		// Smallest font, for long descriptions
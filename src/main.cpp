@@ -148,6 +148,16 @@ protected:
 #include "State.h"
 #include "FighterStats.h"
 #include "MortalNetwork.h"
+#include "ReplayLibrary.h"
+#include "DataArchive.h"
+#include "WorkerPool.h"
+#include "AssetCache.h"
+#include "FighterCache.h"
+#include "Background.h"
+#include "Startup.h"
+#include "Chooser.h"
+#include "Profiler.h"
+#include "Tracer.h"
 
 
 #if defined(_WIN32) || defined(WIN32) || defined(_WINDOWS)
@@ -191,7 +201,15 @@ void Complain( const char* a_pcError )
 _sge_TTFont* LoadTTF( const char* a_pcFilename, int a_iSize )
 {
 	std::string sPath = std::string(DATADIR) + "/fonts/" + a_pcFilename;
-	_sge_TTFont* poFont = sge_TTF_OpenFont( sPath.c_str(), a_iSize );
+	
+	// FreeType reads the face lazily, so the data must stay in memory.
+	int iSize;
+	const char* pcData = g_oDataArchive.IsOpen()
+		? g_oDataArchive.GetPersistentData( CDataArchive::GetRelativePath( sPath.c_str() ), iSize )
+		: NULL;
+	_sge_TTFont* poFont = pcData
+		? sge_TTF_OpenFontMem( pcData, iSize, sPath.c_str(), a_iSize )
+		: sge_TTF_OpenFont( sPath.c_str(), a_iSize );
 	
 	if ( NULL == poFont )
 	{
@@ -202,37 +220,85 @@ _sge_TTFont* LoadTTF( const char* a_pcFilename, int a_iSize )
 }
 
 
-sge_bmpFont* LoadBMPFont( const char* a_pcFilename )
+int InitJoystick();
+
+
+
+/*************************************************************************
+                           STARTUP
+*************************************************************************/
+
+/*
+The startup steps run by CStartup. The ones that run on the worker threads
+leave their results in these variables, which are picked up by the main
+thread steps that depend on them.
+*/
+
+static const char* g_apcBitmapFontFiles[3] = { "brandybun3.png", "CreditsFont2.png", "glossyfont.png" };
+static SDL_Surface* g_apoBitmapFontImages[3];
+static bool g_bFontsLoaded = false;
+
+static const char* g_apcMenuImageFiles[] = { "Credits.jpg", "eu.jpg", "Story1.jpg",
+	"Story2.jpg", "FighterStats.jpg", "PlayerSelect.png", "GameOver.jpg", NULL };
+static SDL_Surface* g_apoMenuImages[ sizeof(g_apcMenuImageFiles) / sizeof(g_apcMenuImageFiles[0]) ];
+
+static SDL_PixelFormat g_oMenuImageFormat;	///< Set by StartVideo() for StartMenuImages().
+static int g_iVideoBpp = 0;				///< If set, StartVideo() uses this depth (for -enginebench).
+static volatile int g_iFightersLoaded = 0;	///< Only for the splash screen.
+static bool g_bVideoReady = false;
+
+
+/** Starts the Perl backend. The configuration is read with it. */
+static bool StartBackend()
 {
-	std::string sPath = std::string(DATADIR) + "/fonts/" + a_pcFilename;
-	sge_bmpFont* poFont = sge_BF_OpenFont( sPath.c_str(), SGE_BFSFONT | SGE_BFTRANSP );
-	if ( NULL == poFont )
+	if ( !g_oBackend.Construct() )
 	{
-		Complain( ("Couldn't load font: " + sPath).c_str() );
+		fprintf(stderr, "couldn't start backend.\n" );
+		return false;
 	}
-	return poFont;
+	return true;
+}
+
+
+static bool StartConfig()
+{
+	g_oState.Load();
+	CMortalNetwork::Create();
+	return true;
 }
 
 
-int init()
+static bool StartVideo()
 {
 	if (SDL_Init(SDL_INIT_VIDEO /*| SDL_INIT_AUDIO*/) < 0)
 	{
 		fprintf(stderr, "Failed to initialize SDL: %s\n", SDL_GetError());
-		return -1;
+		return false;
 	}
 	atexit(SDL_Quit);
 	
-	SetVideoMode( false, g_oState.m_bFullscreen );
+	if ( g_iVideoBpp )
+	{
+		// SetVideoMode() would keep the depth of the display.
+		gamescreen = SDL_SetVideoMode( 640, 480, g_iVideoBpp, SDL_SWSURFACE );
+	}
+	else
+	{
+		SetVideoMode( false, g_oState.m_bFullscreen );
+	}
 	if (gamescreen == NULL)
 	{
 		fprintf(stderr, "failed to set video mode: %s\n", SDL_GetError());
-		return -1;
+		return false;
 	}
 	
+	// The menu images are converted on a worker, which must not read the screen.
+	g_oMenuImageFormat = *gamescreen->format;
+	g_oMenuImageFormat.palette = NULL;
+	
 	SDL_WM_SetCaption( "OpenMortal", "OpenMortal" );
 	std::string sPath = std::string(DATADIR) + "/gfx/icon.png";
-	SDL_WM_SetIcon(IMG_Load(sPath.c_str()), NULL);
+	SDL_WM_SetIcon(LoadDataImage(sPath.c_str()), NULL);
 	SDL_ShowCursor( SDL_DISABLE );
 
 	int i;
@@ -286,133 +352,324 @@ int init()
 		C_YELLOW		= 254;
 		C_WHITE			= 255;
 	}
+	
+	g_bVideoReady = true;
+	return true;
+}
 
+
+/** Worker thread: loads the TrueType fonts, and decodes the images of the
+bitmap fonts. */
+static bool StartFonts()
+{
 	if ( sge_TTF_Init() )
 	{
 		fprintf(stderr, "couldn't start ttf engine: %s\n", SDL_GetError());
-		return -1;
+		return false;
 	}
 
 	sge_TTF_AAOff();
 	
 	inkFont = LoadTTF( "aardvark.ttf", 20 );
-	if ( !inkFont ) return -1;
+	if ( !inkFont ) return false;
 	impactFont = LoadTTF( "bradybun.ttf", 20 );	// gooddogc.ttf, 20
-	if ( !impactFont ) return -1;
+	if ( !impactFont ) return false;
 	titleFont = LoadTTF( "deadgrit.ttf", 48 );		// deadgrit.ttf, 48
-	if ( !titleFont ) return -1;
+	if ( !titleFont ) return false;
 	chatFont = LoadTTF( "thin.ttf", 20 );		// deadgrit.ttf, 48
-	if ( !chatFont ) return -1;
+	if ( !chatFont ) return false;
 
-	fastFont = LoadBMPFont( "brandybun3.png" );
-	if ( !fastFont ) return -1;
-	creditsFont = LoadBMPFont( "CreditsFont2.png" );//"fangfont.png" );
-	if ( !creditsFont ) return -1;
-	storyFont = LoadBMPFont( "glossyfont.png" );
-	if ( !storyFont ) return -1;
-	
-    return 0;
+	for ( int i=0; i<3; ++i )
+	{
+		std::string sPath = std::string(DATADIR) + "/fonts/" + g_apcBitmapFontFiles[i];
+		g_apoBitmapFontImages[i] = LoadDataImage( sPath.c_str() );
+		if ( NULL == g_apoBitmapFontImages[i] )
+		{
+			Complain( ("Couldn't load font: " + sPath).c_str() );
+			return false;
+		}
+	}
+	return true;
 }
 
 
-int init2()
+/** Converts the bitmap fonts to the format of the screen. */
+static bool StartBitmapFonts()
 {
-	if ( !g_oBackend.Construct() )
+	sge_bmpFont** appoFonts[3] = { &fastFont, &creditsFont, &storyFont };	//"fangfont.png"
+	
+	for ( int i=0; i<3; ++i )
 	{
+		*appoFonts[i] = sge_BF_CreateFont( g_apoBitmapFontImages[i], SGE_BFSFONT | SGE_BFTRANSP | SGE_FLAG8 );
+		g_apoBitmapFontImages[i] = NULL;
+		if ( NULL == *appoFonts[i] )
+		{
+			Complain( (std::string("Couldn't load font: ") + g_apcBitmapFontFiles[i]).c_str() );
+			return false;
+		}
+	}
+	g_bFontsLoaded = true;
+	return true;
+}
 
-		fprintf(stderr, "couldn't start backend.\n" );
-		return -1;
+
+static bool StartLanguage()
+{
+	g_oBackend.AttachThread();
+	g_oState.SetLanguage( g_oState.m_acLanguage );
+	return true;
+}
+
+
+/** Worker thread: loads every fighter's file in the backend. */
+static bool StartFighters()
+{
+	g_oBackend.AttachThread();
+	
+	int iNumFighterFiles = g_oBackend.GetNumberOfFighterFiles();
+	for ( int i=0; i<iNumFighterFiles; ++i )
+	{
+		g_oBackend.LoadFighterFile( i );
+		g_iFightersLoaded = i + 1;
 	}
-	return 0;
+	return true;
 }
 
 
+static bool StartPlayers()
+{
+	g_oBackend.AttachThread();
+	g_oPlayerSelect.SetPlayer( 0, UPI );
+	g_oPlayerSelect.SetPlayer( 1, ULMAR );
+	return true;
+}
+
 
+/** Worker thread: loads the portraits of the fighter selection screen. */
+static bool StartPortraits()
+{
+	g_oBackend.AttachThread();
+	g_oChooser.Init();
+	return true;
+}
 
 
-int DrawMainScreen()
+static bool StartAudio()
 {
-	SDL_Surface* background = LoadBackground( "Mortal.jpg", 240 );
-	
-	DrawTextMSZ( "Version " VERSION " - European Union Editition", inkFont, 320, 430, UseShadow | AlignHCenter, C_WHITE, background, false );
-	SDL_Rect r;
-	r.x = r.y = 0;
-	
-	std::string sStaffFilename = DATADIR;
-	sStaffFilename += "/characters/staff.dat";
-	RlePack pack( sStaffFilename.c_str(), 256 );
-	pack.ApplyPalette();
-	SDL_BlitSurface( background, NULL, gamescreen, &r );
-	SDL_Flip( gamescreen );
-
-/*	char* filename[15] = {
-		"Jacint.pl", "Jozsi.pl", "Agent.pl", "Mrsmith.pl",
-		"Sleepy.pl", "Tejszin.pl",
-		"UPi.pl", "Zoli.pl", "Ulmar.pl", "Bence.pl",
-		"Descant.pl", "Grizli.pl", "Sirpi.pl", "Macy.pl", "Cumi.pl" };*/
-	int x[14] = {
-		0, 26, 67, 125, 159, 209,
-		249, 289, 358, 397, 451, 489, 532, 161 };
-	int y[14] = {
-		5, 4, 5, 5, 5, 7, 
-		4, 0, 7, 5, 5, 6, 5, 243 };
+	new MszAudio;
+//	Audio->LoadMusic( "Last_Ninja_-_The_Wilderness.mid", "DemoMusic" );
+	Audio->LoadMusic( "ride.mod", "DemoMusic" );
+	Audio->PlayMusic( "DemoMusic" );
+	Audio->LoadMusic( "2nd_pm.s3m", "GameMusic" );
+	return true;
+}
 
-	/*
-	int i;
 
-	g_oBackend.PerlEvalF( "eval( \"require '%s/characters/Kinga.pl';\" )", DATADIR );
-	g_oBackend.PerlEvalF( "eval( \"require '%s/characters/Ambrus.pl';\" )", DATADIR );
-	g_oBackend.PerlEvalF( "eval( \"require '%s/characters/Dani.pl';\" )", DATADIR );
+static bool StartJoystick()
+{
+	InitJoystick();
+	return true;
+}
+
 
-	for ( i=0; i<15; ++i )
+/** Worker thread: decodes and converts the images of the demos and
+menus. The asset cache isn't used on a palettized screen, so they are
+not loaded there. */
+static bool StartMenuImages()
+{
+	if ( g_oMenuImageFormat.BitsPerPixel <= 8 )
 	{
-		pack.Draw( i, x[i], y[i], false );
-		SDL_Flip( gamescreen );
-		if ( filename[i] != NULL )
-		{
-			debug( "Loading fighter %s", filename[i] );
-			g_oBackend.PerlEvalF( "eval( \"require '%s/characters/%s';\" )", DATADIR, filename[i] );
+		return true;
+	}
+	
+	for ( int i=0; g_apcMenuImageFiles[i]; ++i )
+	{
+		SDL_Surface* poMask;
+		SDL_Surface* poImage = DecodeBackground( g_apcMenuImageFiles[i], &poMask );
+		// The number of colors only matters on a palettized screen.
+		g_apoMenuImages[i] = poImage ? ConvertBackground( poImage, poMask, 0, 0, &g_oMenuImageFormat ) : NULL;
+	}
+	return true;
+}
 
 
+static bool StartMenuCache()
+{
+	for ( int i=0; g_apcMenuImageFiles[i]; ++i )
+	{
+		if ( g_apoMenuImages[i] )
+		{
+			g_oAssetCache.AddBackground( g_apcMenuImageFiles[i], g_apoMenuImages[i] );
+			g_apoMenuImages[i] = NULL;
 		}
 	}
-	
-	int retval = 0;
-	i = 0;
-	*/
+	return true;
+}
 
-	int iNumFighterFiles, i;
 
-#ifdef MACOSX
-	//[segabor]
-	char char_buf[256];
-	sprintf(char_buf, "%s/characters", DATADIR);
-	g_oBackend.PerlEvalF( "$CppRetval = GetNumberOfFighterFiles('%s')", char_buf );
-#else
-	g_oBackend.PerlEvalF( "$CppRetval = GetNumberOfFighterFiles('%s')", DATADIR "/characters" );
-#endif
-	iNumFighterFiles = g_oBackend.GetPerlInt( "CppRetval" );
+
+/**
+The splash screen is the title picture, shown as soon as the video mode
+is set. The portraits of the staff appear on it as the fighters are
+loaded, and a progress bar shows how many startup steps are finished.
+*/
+
+class CSplashScreen
+{
+public:
+	CSplashScreen()
+	{
+		m_poBackground = NULL;
+		m_poPack = NULL;
+	}
 	
-	for ( i=0; i<iNumFighterFiles; ++i )
+	~CSplashScreen()
 	{
-		g_oBackend.PerlEvalF( "LoadFighterFile(%d);", i );
-		
-		if ( i < 15 ) {
-			pack.Draw( i, x[i], y[i], false );
-			SDL_Flip( gamescreen );
+		if ( NULL == m_poBackground )
+		{
+			return;
 		}
+		
+		// The title picture stays on the screen, without the progress bar.
+		SDL_Rect oBar = m_oBar;
+		SDL_BlitSurface( m_poBackground, &oBar, gamescreen, &oBar );
+		SDL_Flip( gamescreen );
+		
+		delete m_poPack;
+		SDL_FreeSurface( m_poBackground );
 	}
 	
-    SDL_FreeSurface( background );
-	return 0;
+	static void Progress( void* a_pvSplashScreen, int a_iDone, int a_iTotal )
+	{
+		((CSplashScreen*)a_pvSplashScreen)->Update( a_iDone, a_iTotal );
+	}
 	
-}
+	void Update( int a_iDone, int a_iTotal )
+	{
+		static const int x[14] = {
+			0, 26, 67, 125, 159, 209,
+			249, 289, 358, 397, 451, 489, 532, 161 };
+		static const int y[14] = {
+			5, 4, 5, 5, 5, 7, 
+			4, 0, 7, 5, 5, 6, 5, 243 };
+		
+		if ( NULL == m_poBackground )
+		{
+			if ( !g_bVideoReady )
+			{
+				return;
+			}
+			Start();
+		}
+		
+		bool bChanged = false;
+		int iFightersLoaded = g_iFightersLoaded;
+		for ( ; m_iFightersDrawn < iFightersLoaded; ++m_iFightersDrawn )
+		{
+			if ( m_iFightersDrawn < 14 )
+			{
+				m_poPack->Draw( m_iFightersDrawn, x[m_iFightersDrawn], y[m_iFightersDrawn], false );
+				bChanged = true;
+			}
+		}
+		
+		if ( g_bFontsLoaded && !m_bVersionDrawn )
+		{
+			DrawTextMSZ( "Version " VERSION " - European Union Editition", inkFont, 320, 430, UseShadow | AlignHCenter, C_WHITE, gamescreen, false );
+			m_bVersionDrawn = true;
+			bChanged = true;
+		}
+		
+		if ( a_iDone != m_iDone )
+		{
+			m_iDone = a_iDone;
+			SDL_Rect oRect = m_oBar;
+			SDL_FillRect( gamescreen, &oRect, C_DARKGRAY );
+			oRect.w = m_oBar.w * a_iDone / ( a_iTotal ? a_iTotal : 1 );
+			SDL_FillRect( gamescreen, &oRect, C_YELLOW );
+			bChanged = true;
+		}
+		
+		if ( bChanged )
+		{
+			SDL_Flip( gamescreen );
+		}
+	}
+
+protected:
+	void Start()
+	{
+		m_poBackground = g_oAssetCache.CopyBackground( "Mortal.jpg", 240 );
+		
+		std::string sStaffFilename = DATADIR;
+		sStaffFilename += "/characters/staff.dat";
+		m_poPack = new RlePack( sStaffFilename.c_str(), 256 );
+		m_poPack->ApplyPalette();
+		
+		m_oBar.x = 170; m_oBar.y = 462;
+		m_oBar.w = 300; m_oBar.h = 6;
+		m_iFightersDrawn = 0;
+		m_iDone = -1;
+		m_bVersionDrawn = false;
+		
+		SDL_BlitSurface( m_poBackground, NULL, gamescreen, NULL );
+		SDL_Flip( gamescreen );
+	}
 
+	SDL_Surface*	m_poBackground;
+	RlePack*		m_poPack;
+	SDL_Rect		m_oBar;
+	int				m_iFightersDrawn;
+	int				m_iDone;
+	bool			m_bVersionDrawn;
+};
 
 
+/**
+Sets the video mode, and loads everything else that is needed before the
+demos start, with the splash screen showing the progress.
 
+The Perl backend is used by the language, fighters, players and portraits
+steps, in this order; the dependencies make sure that no two of them run
+at the same time.
+*/
+
+bool StartGame( CStartup& a_roStartup )
+{
+	CStartupTask* poLanguage = a_roStartup.Add( "language", StartLanguage, false );
+	CStartupTask* poVideo = a_roStartup.Add( "video", StartVideo, false );
+	CStartupTask* poFighters = a_roStartup.Add( "fighters", StartFighters, true );
+	CStartupTask* poFonts = a_roStartup.Add( "fonts", StartFonts, true );
+	CStartupTask* poMenuImages = a_roStartup.Add( "menu images", StartMenuImages, true );
+	CStartupTask* poAudio = a_roStartup.Add( "audio", StartAudio, false );
+	CStartupTask* poJoystick = a_roStartup.Add( "joystick", StartJoystick, false );
+	CStartupTask* poBitmapFonts = a_roStartup.Add( "bitmap fonts", StartBitmapFonts, false );
+	CStartupTask* poPlayers = a_roStartup.Add( "players", StartPlayers, false );
+	CStartupTask* poPortraits = a_roStartup.Add( "portraits", StartPortraits, true );
+	CStartupTask* poMenuCache = a_roStartup.Add( "menu cache", StartMenuCache, false );
+	
+	poFighters->DependsOn( poLanguage );
+	poMenuImages->DependsOn( poVideo );
+	poAudio->DependsOn( poVideo );
+	poJoystick->DependsOn( poVideo );
+	poBitmapFonts->DependsOn( poFonts );
+	poBitmapFonts->DependsOn( poVideo );
+	poPlayers->DependsOn( poFighters );
+	poPlayers->DependsOn( poBitmapFonts );	// For the name of the fighter.
+	poPortraits->DependsOn( poPlayers );
+	poMenuCache->DependsOn( poMenuImages );
+	
+	bool bOk;
+	{
+		CSplashScreen oSplashScreen;
+		bOk = a_roStartup.Run( CSplashScreen::Progress, &oSplashScreen );
+	}
+	
+	// The last user of the backend may have been a worker.
+	g_oBackend.AttachThread();
+	return bOk;
+}
 
-int InitJoystick();
 
 
 
@@ -500,11 +757,8 @@ void GameLoop()
 		
 		if ( !IS_GAME_MODE ) break;
 
-		//sprintf( acReplayFile, "/tmp/msz%d.replay", ++iGameNumber );
-
-		int iGameResult = DoGame( NULL, false, bDebug );
-		//int iGameResult = DoGame( acReplayFile, false, bDebug );
-		//DoGame( acReplayFile, true, bDebug );
+		std::string sReplayFile = g_oReplayLibrary.GetNewReplayFilename();
+		int iGameResult = DoGame( sReplayFile.size() ? (char*) sReplayFile.c_str() : NULL, false, bDebug );
 		debug ( "iGameResult = %d\n", iGameResult );
 
 		if ( !IS_GAME_MODE ) break;
@@ -575,18 +829,38 @@ void PgTest();
 
 int main(int argc, char *argv[])
 {
+	CStartup oStartup;
+	
 	srand( (unsigned int)time(NULL) );
-	if ( 0 != init2() )
+	g_oTracer.SetThreadName( "main" );
+	
+	// Without the archive, everything is loaded from the loose files.
+	g_oDataArchive.Open( DATADIR "/" DATAARCHIVE_NAME );
+	
+	// The configuration is read by the backend, and the command line
+	// is parsed after it.
+	g_oState.m_pcArgv0 = argv[0];
+	oStartup.Add( "config", StartConfig, false )->DependsOn(
+		oStartup.Add( "backend", StartBackend, false ) );
+	if ( !oStartup.Run() )
 	{
-		fprintf( stderr, "init2() failed." );
+		fprintf( stderr, "Startup failed.\n" );
 		return -1;
 	}
 	
-	g_oState.m_pcArgv0 = argv[0];
-	g_oState.Load();
-	CMortalNetwork::Create();
-	
 	bDebug = false;
+	const char* pcReplayCheckDir = NULL;
+	int iNumJobs = 1;
+	int iNumBatchMatches = 0;
+	const char* pcBatchFighters = NULL;
+	const char* pcBatchInputs = NULL;
+	unsigned int iBatchSeed = (unsigned int) time(NULL);
+	double dMaxAllocationsPerTick = 0.0;
+	bool bMixerBenchmark = false;
+	bool bAudioTest = false;
+	bool bPacerBenchmark = false;
+	int iEngineBenchmarkBpp = 0;
+	bool bStartupTimes = false;
 
 	int i;
 	for ( i=1; i<argc; ++i )
@@ -595,6 +869,63 @@ int main(int argc, char *argv[])
 		{
 			bDebug = true;
 		}
+		else if ( !strcmp(argv[i], "-checkreplays") && i+1 < argc )
+		{
+			pcReplayCheckDir = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-jobs") && i+1 < argc )
+		{
+			iNumJobs = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-batch") && i+1 < argc )
+		{
+			iNumBatchMatches = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-fighters") && i+1 < argc )
+		{
+			pcBatchFighters = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-inputs") && i+1 < argc )
+		{
+			pcBatchInputs = argv[++i];
+		}
+		else if ( !strcmp(argv[i], "-seed") && i+1 < argc )
+		{
+			iBatchSeed = (unsigned int) strtoul( argv[++i], NULL, 10 );
+		}
+		else if ( !strcmp(argv[i], "-maxallocs") && i+1 < argc )
+		{
+			dMaxAllocationsPerTick = atof( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-mortalnet") && i+1 < argc )
+		{
+			SetMortalNetServer( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-mixerbench") )
+		{
+			bMixerBenchmark = true;
+		}
+		else if ( !strcmp(argv[i], "-audiotest") )
+		{
+			bAudioTest = true;
+		}
+		else if ( !strcmp(argv[i], "-pacerbench") )
+		{
+			bPacerBenchmark = true;
+		}
+		else if ( !strcmp(argv[i], "-enginebench") && i+1 < argc )
+		{
+			iEngineBenchmarkBpp = atoi( argv[++i] );
+		}
+		else if ( !strcmp(argv[i], "-trace") )
+		{
+			// The trace is saved with F11.
+			g_oTracer.Enable();
+		}
+		else if ( !strcmp(argv[i], "-startuptimes") )
+		{
+			bStartupTimes = true;
+		}
 /*
 		else if ( !strcmp(argv[i], "-fullscreen") )
 		{
@@ -617,30 +948,75 @@ int main(int argc, char *argv[])
 		else
 		{
 //			printf( "Usage: %s [-debug] [-fullscreen] [-hwsurface] [-doublebuf] [-anyformat]\n", argv[0] );
-			printf( "Usage: %s [-debug]\n", argv[0] );
+			printf( "Usage: %s [-debug] [-mortalnet <host[:port]>] [-checkreplays <directory> [-jobs <n>]] [-batch <matches> [-fighters <id1,id2>] [-inputs <file>] [-seed <n>] [-maxallocs <n>] [-jobs <n>]] [-mixerbench] [-audiotest] [-pacerbench] [-enginebench <bpp>] [-trace] [-startuptimes]\n", argv[0] );
 			return 0;
 		}
 	}
 
-	if (init()<0)
+	if ( pcReplayCheckDir )
 	{
-		return -1;
+		// Batch replay validation doesn't need video or audio.
+		return DoReplayCheck( pcReplayCheckDir, iNumJobs ) ? 1 : 0;
 	}
-
-	InitJoystick();
 	
-	g_oState.SetLanguage( g_oState.m_acLanguage );
+	if ( iNumBatchMatches > 0 )
+	{
+		// So are the batch matches.
+		return DoBatchMatches( iNumBatchMatches, pcBatchFighters, pcBatchInputs,
+			iBatchSeed, iNumJobs, dMaxAllocationsPerTick );
+	}
 	
-	new MszAudio;
-//	Audio->LoadMusic( "Last_Ninja_-_The_Wilderness.mid", "DemoMusic" );
-	Audio->LoadMusic( "ride.mod", "DemoMusic" );
-	Audio->PlayMusic( "DemoMusic" );
-	Audio->LoadMusic( "2nd_pm.s3m", "GameMusic" );
+	if ( bMixerBenchmark )
+	{
+		// The mixer is measured without an audio device.
+		return DoMixerBenchmark();
+	}
 	
-	DrawMainScreen();
+	if ( bAudioTest )
+	{
+		// Runs on SDL's dummy audio driver, without video.
+		return DoAudioTest();
+	}
 	
-	g_oPlayerSelect.SetPlayer( 0, UPI );
-	g_oPlayerSelect.SetPlayer( 1, ULMAR );
+	if ( bPacerBenchmark )
+	{
+		// Only the timer is used, without video.
+		return DoPacerBenchmark();
+	}
+	
+	if ( iEngineBenchmarkBpp )
+	{
+		// Draws into the offscreen screen of the dummy video driver.
+		if ( NULL == getenv( "SDL_VIDEODRIVER" ) )
+		{
+			putenv( (char*) "SDL_VIDEODRIVER=dummy" );
+		}
+		// The same steps as StartGame(), in the order of its dependencies.
+		g_iVideoBpp = iEngineBenchmarkBpp;
+		g_oWorkerPool.Start();
+		bool bReady = StartLanguage() && StartVideo() && StartFonts()
+			&& StartBitmapFonts() && StartFighters() && StartPlayers();
+		int iRetval = bReady ? DoEngineBenchmark() : 1;
+		g_oFighterCache.Clear();
+		g_oWorkerPool.Shutdown();
+		return iRetval;
+	}
+
+	g_oWorkerPool.Start();
+	g_oAssetCache.SetBudget( g_oState.m_iAssetCacheSize * 1024 * 1024 );
+	g_oFighterCache.SetBudget( g_oState.m_iFighterCacheSize * 1024 * 1024 );
+
+	bool bStarted = StartGame( oStartup );
+	if ( bStartupTimes )
+	{
+		oStartup.Report();
+	}
+	if ( !bStarted )
+	{
+		g_oFighterCache.Clear();
+		g_oWorkerPool.Shutdown();
+		return -1;
+	}
 	
 	/*
 	{
@@ -751,7 +1127,14 @@ int main(int argc, char *argv[])
 	}
 	
 	g_oState.Save();
+	g_oProfiler.CloseLog();
 	
+	Background::DiscardPrefetch();
+	g_oFighterCache.Report();
+	g_oFighterCache.Clear();
+	g_oWorkerPool.Shutdown();
+	g_oAssetCache.Report();
+	g_oAssetCache.Clear();
 	SDL_Quit();
 	
 	return EXIT_SUCCESS;
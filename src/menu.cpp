@@ -20,6 +20,7 @@
 #include "sge_surface.h"
 #include "MortalNetwork.h"
 #include "Joystick.h"
+#include "ReplayLibrary.h"
 
 #include <stdarg.h>
 
@@ -950,6 +951,13 @@ void Menu::ItemActivated( int a_iItemCode, MenuItem* a_poMenuItem )
 			m_iReturnCode = -1;
 			break;
 		
+		case MENU_REPLAYS:
+			Audio->PlaySample( "MENU_ITEM_INVOKED" );
+			DoReplayBrowser();
+			Clear();
+			Draw();
+			break;
+		
 		case MENU_KEYS_LEFT:
 			InputKeys(1);
 			Draw();
@@ -1292,6 +1300,10 @@ void DoMenu()
 	oMenu.AddEnumMenuItem( "~LANGUAGE: ", g_oState.m_iLanguageCode, g_ppcLanguage, g_piLanguage, MENU_LANGUAGE );
 
 	oMenu.AddMenuItem( "~OPTIONS", SDLK_o, MENU_OPTIONS );
+	if ( SState::IN_DEMO == g_oState.m_enGameMode )
+	{
+		oMenu.AddMenuItem( "~REPLAYS", SDLK_r, MENU_REPLAYS );
+	}
 	oMenu.AddMenuItem( "~INFO", SDLK_i, MENU_INFO )->SetEnabled(false);
 	oMenu.AddMenuItem( "QUIT", SDLK_UNKNOWN, MENU_QUIT );
 	
@@ -60,6 +60,7 @@ MENU_UNKNOWN,
 		MENU_KEYS_LEFT,
 		MENU_OPTIONS_OK,
 	MENU_LANGUAGE,
+	MENU_REPLAYS,
 	MENU_INFO,
 	MENU_QUIT,					// (confirm)
 };
@@ -47,6 +47,7 @@ typedef struct{
 #ifdef _SGE_C
 extern "C" {
 #endif
+DECLSPEC sge_bmpFont* sge_BF_CreateFont(SDL_Surface *surface, Uint8 flags);
 DECLSPEC sge_bmpFont* sge_BF_OpenFont(const char *file, Uint8 flags);
 DECLSPEC void sge_BF_CloseFont(sge_bmpFont *font);
 DECLSPEC void sge_BF_SetColor(sge_bmpFont *font, Uint8 R, Uint8 G, Uint8 B);
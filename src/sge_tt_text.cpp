@@ -210,29 +210,14 @@ void sge_TTF_CloseFont(sge_TTFont *font)
 
 
 //==================================================================================
-// Open the TT font file and returns the font with pt size
+// Sets up a font after its face was opened
 //==================================================================================
-sge_TTFont *sge_TTF_OpenFont(const char *file, int ptsize)
+static sge_TTFont *sge_TTF_SetupFont(sge_TTFont *font, const char *file, int ptsize)
 {
-	sge_TTFont *font;
 	FT_Error error;
 	FT_Face face;
 	FT_Fixed scale;
 
-	font = (sge_TTFont *)malloc(sizeof(*font));
-	if ( font == NULL ) {
-		SDL_SetError("SGE - Out of memory");
-		return(NULL);
-	}
-	memset(font, 0, sizeof(*font));
-
-	/* Open the font and create ancillary data */
-	error = FT_New_Face( _sge_library, file, 0, &font->face );
-	if ( error ) {
-		sge_SetError("SGE - Couldn't load font file: %s",file);
-		free(font);
-		return(NULL);
-	}
 	face = font->face;
 	
 	/* Make sure that our font face is scalable (global metrics) */
@@ -274,6 +259,60 @@ sge_TTFont *sge_TTF_OpenFont(const char *file, int ptsize)
 }
 
 
+//==================================================================================
+// Open the TT font file and returns the font with pt size
+//==================================================================================
+sge_TTFont *sge_TTF_OpenFont(const char *file, int ptsize)
+{
+	sge_TTFont *font;
+	FT_Error error;
+
+	font = (sge_TTFont *)malloc(sizeof(*font));
+	if ( font == NULL ) {
+		SDL_SetError("SGE - Out of memory");
+		return(NULL);
+	}
+	memset(font, 0, sizeof(*font));
+
+	/* Open the font and create ancillary data */
+	error = FT_New_Face( _sge_library, file, 0, &font->face );
+	if ( error ) {
+		sge_SetError("SGE - Couldn't load font file: %s",file);
+		free(font);
+		return(NULL);
+	}
+	
+	return sge_TTF_SetupFont( font, file, ptsize );
+}
+
+
+//==================================================================================
+// Open a TT font from memory. The data must stay valid until the font is
+// closed. The name is only used in the error messages.
+//==================================================================================
+sge_TTFont *sge_TTF_OpenFontMem(const void *data, long size, const char *name, int ptsize)
+{
+	sge_TTFont *font;
+	FT_Error error;
+
+	font = (sge_TTFont *)malloc(sizeof(*font));
+	if ( font == NULL ) {
+		SDL_SetError("SGE - Out of memory");
+		return(NULL);
+	}
+	memset(font, 0, sizeof(*font));
+
+	error = FT_New_Memory_Face( _sge_library, (const FT_Byte*)data, size, 0, &font->face );
+	if ( error ) {
+		sge_SetError("SGE - Couldn't load font file: %s",name);
+		free(font);
+		return(NULL);
+	}
+	
+	return sge_TTF_SetupFont( font, name, ptsize );
+}
+
+
 //==================================================================================
 // Load a glyph
 //==================================================================================
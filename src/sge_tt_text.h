@@ -50,12 +50,14 @@ DECLSPEC void sge_TTF_AA_Alpha(void);
 
 DECLSPEC int sge_TTF_Init(void);
 DECLSPEC sge_TTFont *sge_TTF_OpenFont(const char *file, int ptsize);
+DECLSPEC sge_TTFont *sge_TTF_OpenFontMem(const void *data, long size, const char *name, int ptsize);
 DECLSPEC int sge_TTF_SetFontSize(sge_TTFont *font, int ptsize);
 
 DECLSPEC int sge_TTF_FontHeight(sge_TTFont *font);
 DECLSPEC int sge_TTF_FontAscent(sge_TTFont *font);
 DECLSPEC int sge_TTF_FontDescent(sge_TTFont *font);
 DECLSPEC int sge_TTF_FontLineSkip(sge_TTFont *font);
+DECLSPEC int sge_TTF_GlyphMetrics(sge_TTFont *font, Uint16 ch, int* minx, int* maxx, int* miny, int* maxy, int* advance);
 
 DECLSPEC void sge_TTF_SetFontStyle(sge_TTFont *font, Uint8 style);
 DECLSPEC Uint8 sge_TTF_GetFontStyle(sge_TTFont *font);
@@ -83,6 +85,7 @@ DECLSPEC int keyrepeat(SDL_Event *event, int wait);
 DECLSPEC void insert_char(Uint16 *string, Uint16 ch, int pos, int max);
 DECLSPEC void delete_char(Uint16 *string, int pos, int max);
 DECLSPEC Uint16 *sge_Latin1_Uni(const char *text);
+DECLSPEC Uint16 *sge_UTF8_Uni(const char *text);
 #ifdef _SGE_C
 }
 #endif